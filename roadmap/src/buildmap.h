@@ -57,8 +57,13 @@ void buildmap_message_adjust_level (int level);
 int buildmap_get_error_count (void);
 int buildmap_get_error_total (void);
 
+/* Only the pointer is tested, not the memory it points to. */
 void buildmap_check_allocated_with_source_line
-                (char *source, int line, const void *allocated);
+                (char *source, int line, const void *allocated)
+#if defined(__GNUC__) && (__GNUC__ >= 10)
+                __attribute__ ((access (none, 3)))
+#endif
+                ;
 #define buildmap_check_allocated(p) \
             buildmap_check_allocated_with_source_line(__FILE__,__LINE__,p)
 
@@ -100,6 +105,9 @@ typedef struct {
    buildmap_db_action summary;
    buildmap_db_action reset;
 
+   /* The modules that must be sorted before this one, NULL terminated. */
+   const char *const *sort_after;
+
 } buildmap_db_module;
 
 
@@ -117,13 +125,37 @@ buildmap_db *buildmap_db_add_child (buildmap_db *parent,
                                     int count,
                                     int size);
 
+/* The hash table of a dictionary volume, built from its strings: */
+void buildmap_dictionary_add_hash
+         (buildmap_db *parent, const char *data,
+          const unsigned int *string_index, int string_count);
+
 /* The functions that call the registered actions: */
 void buildmap_db_sort    (void);
+void buildmap_db_set_sort_threads (int count);
 int  buildmap_db_save    (void);
 void buildmap_db_summary (void);
 void buildmap_db_reset   (void);
 
 void buildmap_db_close (void);
 
+/* Memory released all at once by buildmap_db_reset(): */
+void *buildmap_arena_alloc  (int size);
+void *buildmap_arena_calloc (int count, int size);
+char *buildmap_arena_strdup (const char *string);
+void  buildmap_arena_reset  (void);
+void  buildmap_arena_summary (void);
+
+/* Stable sort of record indexes on a 64 bits key per record: */
+void buildmap_sort_on_key (int *index, int count,
+                           const unsigned long long *keys);
+unsigned long long buildmap_sort_key (int high, int low);
+
+/* Compressed coordinate tables (.rdm v2): */
+void buildmap_packed_enable  (int packed);
+int  buildmap_packed_enabled (void);
+void buildmap_packed_add     (buildmap_db *parent,
+                              const unsigned short *values, int count);
+
 #endif // INCLUDED__ROADMAP_BUILDMAP__H
 
@@ -0,0 +1,169 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/**
+ * @file
+ * @brief a bump allocator for the memory that lives as long as one map.
+ *
+ * Most of what buildmap allocates while building a map (table blocks,
+ * dictionary trees, names) is released all at once by buildmap_db_reset().
+ * Allocating it here costs a pointer increment, and releasing it costs
+ * nothing per object: the arena goes back to its first chunk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buildmap.h"
+
+
+#define BUILDMAP_ARENA_CHUNK  (1024 * 1024)
+#define BUILDMAP_ARENA_ALIGN  8
+
+struct buildmap_arena_chunk {
+   struct buildmap_arena_chunk *next;
+   int size;
+   int cursor;
+   /* The data follows, aligned. */
+};
+
+#define BUILDMAP_ARENA_HEADER \
+   ((sizeof(struct buildmap_arena_chunk) + BUILDMAP_ARENA_ALIGN - 1) \
+       & ~(BUILDMAP_ARENA_ALIGN - 1))
+
+static struct buildmap_arena_chunk *ArenaFirst = NULL;
+static struct buildmap_arena_chunk *ArenaCurrent = NULL;
+
+static unsigned long ArenaUsed = 0;
+static unsigned long ArenaPeak = 0;
+static int ArenaChunkCount = 0;
+
+
+static struct buildmap_arena_chunk *buildmap_arena_new_chunk (int size) {
+
+   struct buildmap_arena_chunk *chunk;
+
+   if (size < BUILDMAP_ARENA_CHUNK) size = BUILDMAP_ARENA_CHUNK;
+
+   chunk = malloc (BUILDMAP_ARENA_HEADER + size);
+   buildmap_check_allocated(chunk);
+
+   chunk->next = NULL;
+   chunk->size = size;
+   chunk->cursor = 0;
+
+   ArenaChunkCount += 1;
+
+   return chunk;
+}
+
+
+/**
+ * @brief allocate memory that is released by buildmap_db_reset()
+ * @param size
+ * @return the memory, never NULL
+ */
+void *buildmap_arena_alloc (int size) {
+
+   char *data;
+
+   size = (size + BUILDMAP_ARENA_ALIGN - 1) & ~(BUILDMAP_ARENA_ALIGN - 1);
+
+   if (ArenaCurrent == NULL) {
+      ArenaFirst = ArenaCurrent = buildmap_arena_new_chunk (size);
+   }
+
+   if (ArenaCurrent->cursor + size > ArenaCurrent->size) {
+      struct buildmap_arena_chunk *chunk = buildmap_arena_new_chunk (size);
+      ArenaCurrent->next = chunk;
+      ArenaCurrent = chunk;
+   }
+
+   data = (char *)ArenaCurrent + BUILDMAP_ARENA_HEADER + ArenaCurrent->cursor;
+   ArenaCurrent->cursor += size;
+
+   ArenaUsed += size;
+   if (ArenaUsed > ArenaPeak) ArenaPeak = ArenaUsed;
+
+   return data;
+}
+
+
+/**
+ * @brief same as buildmap_arena_alloc(), but the memory is cleared
+ * @param count
+ * @param size
+ * @return
+ */
+void *buildmap_arena_calloc (int count, int size) {
+
+   void *data = buildmap_arena_alloc (count * size);
+
+   memset (data, 0, count * size);
+   return data;
+}
+
+
+/**
+ * @brief copy a string into the arena
+ * @param string
+ * @return
+ */
+char *buildmap_arena_strdup (const char *string) {
+
+   int length = strlen(string) + 1;
+   char *copy = buildmap_arena_alloc (length);
+
+   memcpy (copy, string, length);
+   return copy;
+}
+
+
+/**
+ * @brief release everything allocated since the last reset
+ *
+ * The first chunk is kept for the next map.
+ */
+void buildmap_arena_reset (void) {
+
+   struct buildmap_arena_chunk *chunk;
+   struct buildmap_arena_chunk *next;
+
+   if (ArenaFirst == NULL) return;
+
+   for (chunk = ArenaFirst->next; chunk != NULL; chunk = next) {
+      next = chunk->next;
+      free (chunk);
+   }
+
+   ArenaFirst->next = NULL;
+   ArenaFirst->cursor = 0;
+   ArenaCurrent = ArenaFirst;
+   ArenaChunkCount = 1;
+   ArenaUsed = 0;
+}
+
+
+void buildmap_arena_summary (void) {
+
+   fprintf (stderr,
+            "-- arena statistics: %lu bytes used, %lu bytes peak, %d chunks\n",
+            ArenaUsed, ArenaPeak, ArenaChunkCount);
+}
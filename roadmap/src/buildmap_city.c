@@ -208,7 +208,8 @@ static buildmap_db_module BuildMapCityModule = {
    NULL,
    NULL,
    buildmap_city_summary,
-   buildmap_city_reset
+   buildmap_city_reset,
+   NULL
 };
 
 /**
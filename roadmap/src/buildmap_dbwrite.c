@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "roadmap_types.h"
 #include "roadmap_path.h"
@@ -56,6 +57,24 @@ static buildmap_db *BuildmapCurrentDbSection = NULL;
 static const buildmap_db_module *BuildmapModuleRegistration[BUILDMAP_MAX_MODULE];
 static int BuildmapModuleCount = 0;
 
+
+/* The modules are sorted concurrently, each one as soon as the modules
+ * listed in its sort_after are sorted.  A module may register another
+ * one while it is being sorted, so the registration is locked too.
+ */
+#define BUILDMAP_SORT_MAX_THREADS 16
+
+#define BUILDMAP_SORT_PENDING 0
+#define BUILDMAP_SORT_RUNNING 1
+#define BUILDMAP_SORT_DONE    2
+
+static pthread_mutex_t BuildmapModuleLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  BuildmapSortChanged = PTHREAD_COND_INITIALIZER;
+
+static int BuildmapSortState[BUILDMAP_MAX_MODULE];
+static int BuildmapSortRunning = 0;
+static int BuildmapSortThreads = 0;   /* 0: one per processor. */
+
 /**
  * @brief
  * @param section
@@ -432,32 +451,156 @@ void buildmap_db_register (const buildmap_db_module *module) {
 
    int i;
 
+   pthread_mutex_lock (&BuildmapModuleLock);
+
    /* First check if that module was not already registered. */
 
    for (i = BuildmapModuleCount - 1; i >= 0; --i) {
-      if (BuildmapModuleRegistration[i] == module) return;
+      if (BuildmapModuleRegistration[i] == module) {
+         pthread_mutex_unlock (&BuildmapModuleLock);
+         return;
+      }
    }
 
    if (BuildmapModuleCount >= BUILDMAP_MAX_MODULE) {
       buildmap_fatal (0, "too many modules");
    }
 
+   BuildmapSortState[BuildmapModuleCount] = BUILDMAP_SORT_PENDING;
    BuildmapModuleRegistration[BuildmapModuleCount++] = module;
+
+   pthread_mutex_unlock (&BuildmapModuleLock);
 }
 
 /**
- * @brief
- * @return
+ * @brief check if all the modules a module depends on are sorted
+ * @param module the index of the module in the registration list
+ * @return 1 if the module can be sorted now, 0 otherwise
+ *
+ * A module that is not registered has nothing to sort.
+ * Called with BuildmapModuleLock held.
+ */
+static int buildmap_db_sort_ready (int module) {
+
+   int i;
+   const char *const *after = BuildmapModuleRegistration[module]->sort_after;
+
+   if (after == NULL) return 1;
+
+   for (; *after != NULL; ++after) {
+
+      for (i = 0; i < BuildmapModuleCount; ++i) {
+         if (strcmp (BuildmapModuleRegistration[i]->name, *after) == 0) break;
+      }
+      if (i < BuildmapModuleCount &&
+          BuildmapSortState[i] != BUILDMAP_SORT_DONE) {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+/**
+ * @brief sort the modules that are ready, until none is left
+ * @param data unused
+ * @return NULL
+ */
+static void *buildmap_db_sort_worker (void *data) {
+
+   int i;
+   int pending;
+   const buildmap_db_module *module;
+
+   pthread_mutex_lock (&BuildmapModuleLock);
+
+   for (;;) {
+
+      pending = 0;
+
+      for (i = 0; i < BuildmapModuleCount; ++i) {
+         if (BuildmapSortState[i] == BUILDMAP_SORT_PENDING) {
+            if (buildmap_db_sort_ready (i)) break;
+            pending = 1;
+         }
+      }
+
+      if (i < BuildmapModuleCount) {
+
+         module = BuildmapModuleRegistration[i];
+         BuildmapSortState[i] = BUILDMAP_SORT_RUNNING;
+         BuildmapSortRunning += 1;
+
+         pthread_mutex_unlock (&BuildmapModuleLock);
+
+         if (module->sort != NULL) module->sort ();
+
+         pthread_mutex_lock (&BuildmapModuleLock);
+
+         BuildmapSortState[i] = BUILDMAP_SORT_DONE;
+         BuildmapSortRunning -= 1;
+         pthread_cond_broadcast (&BuildmapSortChanged);
+         continue;
+      }
+
+      if (! pending) break;
+
+      if (BuildmapSortRunning == 0) {
+         buildmap_fatal (0, "circular dependency between the module sorts");
+      }
+      pthread_cond_wait (&BuildmapSortChanged, &BuildmapModuleLock);
+   }
+
+   pthread_mutex_unlock (&BuildmapModuleLock);
+
+   return NULL;
+}
+
+/**
+ * @brief set the number of threads used to sort the modules
+ * @param count the number of threads, 0 for one per processor
+ */
+void buildmap_db_set_sort_threads (int count) {
+
+   BuildmapSortThreads = count;
+}
+
+/**
+ * @brief sort all the registered modules, concurrently when possible
  */
 void buildmap_db_sort (void) {
 
    int i;
+   int threads = BuildmapSortThreads;
+   int started;
+   pthread_t thread[BUILDMAP_SORT_MAX_THREADS];
 
+   if (threads <= 0) {
+      threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+   }
+   if (threads < 1) threads = 1;
+   if (threads > BUILDMAP_SORT_MAX_THREADS) threads = BUILDMAP_SORT_MAX_THREADS;
+
+   pthread_mutex_lock (&BuildmapModuleLock);
    for (i = 0; i < BuildmapModuleCount; ++i) {
-      if (BuildmapModuleRegistration[i]->sort != NULL) {
-         BuildmapModuleRegistration[i]->sort ();
+      BuildmapSortState[i] = BUILDMAP_SORT_PENDING;
+   }
+   BuildmapSortRunning = 0;
+   pthread_mutex_unlock (&BuildmapModuleLock);
+
+   /* The calling thread sorts too. */
+   for (started = 0; started < threads - 1; ++started) {
+      if (pthread_create (&thread[started], NULL,
+                          buildmap_db_sort_worker, NULL) != 0) {
+         break;
       }
    }
+
+   buildmap_db_sort_worker (NULL);
+
+   for (i = 0; i < started; ++i) {
+      pthread_join (thread[i], NULL);
+   }
 }
 
 
@@ -492,6 +635,7 @@ void buildmap_db_summary (void) {
          BuildmapModuleRegistration[i]->summary ();
       }
    }
+   buildmap_arena_summary ();
 }
 
 /**
@@ -502,6 +646,11 @@ void buildmap_db_reset (void) {
 
    int i;
 
+   /* Release the arena first: some modules allocate again while
+    * resetting, and that memory must survive until the next reset.
+    */
+   buildmap_arena_reset ();
+
    for (i = 0; i < BuildmapModuleCount; ++i) {
       if (BuildmapModuleRegistration[i]->reset != NULL) {
          BuildmapModuleRegistration[i]->reset ();
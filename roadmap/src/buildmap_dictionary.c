@@ -31,6 +31,10 @@
  *
  *   char *buildmap_dictionary_get (BuildMapDictionary d, RoadMapString index);
  *
+ *   void buildmap_dictionary_add_hash
+ *           (buildmap_db *parent, const char *data,
+ *            const unsigned int *string_index, int string_count);
+ *
  * These functions are used to build a dictionary of strings from
  * the Tiger maps. The objective is double: (1) reduce the size of
  * the Tiger data by sharing all duplicated strings and (2) serve
@@ -55,6 +59,7 @@
 
 #include "buildmap.h"
 #include "roadmap_db_dictionary.h"
+#include "roadmap_dictionary.h"
 
 
 #define DICTIONARY_INDEX_SIZE 0x10000
@@ -221,10 +226,8 @@ buildmap_dictionary_add_reference (struct dictionary_volume *dictionary,
 
    struct dictionary_reference *reference;
 
-   reference = malloc (sizeof(struct dictionary_reference));
-   if (reference == NULL) {
-      buildmap_fatal (0, "no more memory");
-   }
+   /* The references are released all at once by buildmap_db_reset(). */
+   reference = buildmap_arena_alloc (sizeof(struct dictionary_reference));
 
    reference->type = type;
    reference->child = child;
@@ -442,6 +445,44 @@ static int buildmap_dictionary_save_subtree
 }
 
 
+/**
+ * @brief add the hash table of a dictionary volume
+ * @param parent the section of the volume
+ * @param data the strings
+ * @param string_index the offset of each string in data
+ * @param string_count the number of strings, including the empty one
+ */
+void buildmap_dictionary_add_hash (buildmap_db *parent,
+                                   const char *data,
+                                   const unsigned int *string_index,
+                                   int string_count) {
+
+   int i;
+   unsigned int size;
+   unsigned int slot;
+   buildmap_db *table_hash;
+   RoadMapString *db_hash;
+
+   for (size = 1; size < 2 * (unsigned int) string_count; size *= 2) ;
+
+   table_hash =
+      buildmap_db_add_child (parent, "hash", size, sizeof(RoadMapString));
+   db_hash = (RoadMapString *) buildmap_db_get_data (table_hash);
+
+   memset (db_hash, 0, size * sizeof(RoadMapString));
+
+   /* The empty string is never searched this way: 0 marks a free slot. */
+   for (i = 1; i < string_count; i++) {
+
+      for (slot = roadmap_dictionary_hash (data + string_index[i]) & (size-1);
+           db_hash[slot] != 0;
+           slot = (slot + 1) & (size - 1)) ;
+
+      db_hash[slot] = (RoadMapString) i;
+   }
+}
+
+
 static int  buildmap_dictionary_save_one
                 (struct dictionary_volume *dictionary,
                  buildmap_db *parent) {
@@ -509,40 +550,11 @@ static int  buildmap_dictionary_save_one
            dictionary->string_count * sizeof(unsigned int));
    memcpy (db_data, dictionary->data, dictionary->cursor);
 
-   return 0;
-}
+   buildmap_dictionary_add_hash (child, dictionary->data,
+                                 dictionary->string_index,
+                                 dictionary->string_count);
 
-
-static void buildmap_dictionary_free_subtree
-               (struct dictionary_volume *dictionary,
-                struct dictionary_tree *tree) {
-
-   struct dictionary_reference *reference;
-   struct dictionary_reference *next;
-
-   for (reference = tree->first; reference != NULL; reference = next) {
-
-      next = reference->next;
-
-      switch (reference->type) {
-
-      case ROADMAP_DICTIONARY_STRING:
-
-         break;
-
-      case ROADMAP_DICTIONARY_TREE:
-
-         buildmap_dictionary_free_subtree
-            (dictionary, dictionary->tree + reference->child);
-
-         break;
-
-      default:
-         buildmap_fatal (0, "corrupted node type %d when releasing tree",
-                            reference->type);
-      }
-      free (reference);
-   }
+   return 0;
 }
 
 
@@ -842,9 +854,6 @@ static void buildmap_dictionary_reset (void) {
 
        if (DictionaryVolume[i] != NULL) {
 
-          buildmap_dictionary_free_subtree
-             (DictionaryVolume[i], DictionaryVolume[i]->tree);
-
           free (DictionaryVolume[i]->data);
           free (DictionaryVolume[i]->name);
           free (DictionaryVolume[i]);
@@ -861,7 +870,8 @@ static buildmap_db_module BuildMapDictionaryModule = {
    NULL,
    buildmap_dictionary_save,
    buildmap_dictionary_summary,
-   buildmap_dictionary_reset
+   buildmap_dictionary_reset,
+   NULL
 }; 
       
          
@@ -829,6 +829,7 @@ static buildmap_db_module BuildMapIndexModule = {
    buildmap_index_sort,
    buildmap_index_save,
    buildmap_index_summary,
+   NULL,
    NULL
 }; 
       
@@ -50,6 +50,8 @@ static int   BuildMapPolygonLayerCount = 0;
 static char *BuildMapPlaceLayerList[BUILDMAP_LAYER_MAX];
 static int   BuildMapPlaceLayerCount = 0;
 
+static const char *BuildMapLayerConfig = NULL;
+
 /**
  * @brief look up the layer number, for a given layer name
  * @param name a layer name (string)
@@ -80,6 +82,49 @@ int buildmap_layer_get (const char *name) {
    return 0;
 }
 
+/**
+ * @brief the number of layers, places, lines and polygons together
+ * @return the highest layer number buildmap_layer_get() can return
+ */
+int buildmap_layer_count (void) {
+
+   return BuildMapPlaceLayerCount + BuildMapLineLayerCount +
+             BuildMapPolygonLayerCount;
+}
+
+/**
+ * @brief the zoom level at which RoadMap stops drawing a layer
+ * @param layer the layer number, as returned by buildmap_layer_get()
+ * @return the layer's Declutter value in the class file, or 99999
+ *         (as RoadMap assumes) if it has none
+ */
+int buildmap_layer_declutter (int layer) {
+
+   static int declutter[3 * BUILDMAP_LAYER_MAX];
+
+   const char *name = NULL;
+   const char *value;
+   int index = layer - 1;
+
+   if (layer <= 0 || layer > 3 * BUILDMAP_LAYER_MAX) return 0;
+   if (declutter[index]) return declutter[index];
+
+   if (index < BuildMapPlaceLayerCount) {
+      name = BuildMapPlaceLayerList[index];
+   } else if ((index -= BuildMapPlaceLayerCount) < BuildMapLineLayerCount) {
+      name = BuildMapLineLayerList[index];
+   } else if ((index -= BuildMapLineLayerCount) < BuildMapPolygonLayerCount) {
+      name = BuildMapPolygonLayerList[index];
+   }
+   if (name == NULL || BuildMapLayerConfig == NULL) return 0;
+
+   value = roadmap_config_get_from (BuildMapLayerConfig, name, "Declutter");
+
+   declutter[layer - 1] = (value == NULL || *value == 0) ? 99999 : atoi (value);
+
+   return declutter[layer - 1];
+}
+
 
 /* Initialization code. ------------------------------------------- */
 /**
@@ -178,6 +223,7 @@ void buildmap_layer_load (const char *class_file) {
     if (config == NULL) {
        buildmap_fatal (0, "cannot access class file %s", class_file);
     }
+    BuildMapLayerConfig = config;
 
     BuildMapLineLayerCount =
        buildmap_layer_decode
@@ -25,6 +25,8 @@
 #define INCLUDED__BUILDMAP_LAYER__H
 
 int  buildmap_layer_get (const char *name);
+int  buildmap_layer_declutter (int layer);
+int  buildmap_layer_count (void);
 
 void buildmap_layer_load (const char *class_file);
 
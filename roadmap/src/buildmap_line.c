@@ -68,7 +68,7 @@ static int LineCount = 0;
 static int LineCrossingCount = 0;
 static BuildMapLine *Line[BUILDMAP_BLOCK] = {NULL};
 
-static RoadMapHash *LineById = NULL;
+static RoadMapIntHash *LineById = NULL;
 
 static int *SortedLine = NULL;
 static int *SortedLine2 = NULL;
@@ -188,13 +188,10 @@ static int buildmap_line_get_layer_sorted (int line) {
  */         
 static void buildmap_line_initialize (void) {
 
-   LineById = roadmap_hash_new ("LineById", BUILDMAP_BLOCK);
+   LineById = roadmap_hash_int_new ("LineById", BUILDMAP_BLOCK);
    LongLinesHash = roadmap_hash_new ("LongLines", MAX_LONG_LINES);
 
-   Line[0] = calloc (BUILDMAP_BLOCK, sizeof(BuildMapLine));
-   if (Line[0] == NULL) {
-      buildmap_fatal (0, "no more memory");
-   }
+   Line[0] = buildmap_arena_calloc (BUILDMAP_BLOCK, sizeof(BuildMapLine));
 
    LineCount = 0;
    LongLinesCount = 0;
@@ -232,12 +229,9 @@ int buildmap_line_add (int tlid, int layer, int from, int to, int oneway)
 
       /* We need to add a new block to the table. */
 
-      Line[block] = calloc (BUILDMAP_BLOCK, sizeof(BuildMapLine));
-      if (Line[block] == NULL) {
-         buildmap_fatal (0, "no more memory");
-      }
+      Line[block] =
+         buildmap_arena_calloc (BUILDMAP_BLOCK, sizeof(BuildMapLine));
 
-      roadmap_hash_resize (LineById, (block+1) * BUILDMAP_BLOCK);
    }
 
    this_line = Line[block] + offset;
@@ -261,7 +255,7 @@ int buildmap_line_add (int tlid, int layer, int from, int to, int oneway)
    this_line->data2.layer = layer;
 #endif
 
-   roadmap_hash_add (LineById, tlid, LineCount);
+   roadmap_hash_int_set (LineById, tlid, LineCount);
 
 #ifdef BUILDMAP_NAVIGATION_SUPPORT
    /*
@@ -367,18 +361,12 @@ int  buildmap_line_find_sorted (int tlid) {
       buildmap_fatal (0, "lines not sorted yet");
    }
 
-   for (index = roadmap_hash_get_first (LineById, tlid);
-        index >= 0;
-        index = roadmap_hash_get_next (LineById, index)) {
+   index = roadmap_hash_int_get (LineById, tlid);
+   if (index < 0) return -1;
 
-      this_line = Line[index / BUILDMAP_BLOCK] + (index % BUILDMAP_BLOCK);
-
-      if (this_line->tlid == tlid) {
-         return this_line->sorted;
-      }
-   }
+   this_line = Line[index / BUILDMAP_BLOCK] + (index % BUILDMAP_BLOCK);
 
-   return -1;
+   return this_line->sorted;
 }
 
 
@@ -464,101 +452,6 @@ int buildmap_line_get_square_sorted (int line) {
              (buildmap_line_get_record_sorted(line)->record.from);
 }
 
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */         
-static int buildmap_line_compare (const void *r1, const void *r2) {
-
-   int square1;
-   int square2;
-
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapLine *record1;
-   BuildMapLine *record2;
-
-   record1 = Line[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Line[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-
-   /* The lines are first sorted by square.
-    * Within a square, lines are sorted by category.
-    * Within a category, lines are sorted by the "from" and "to" points.
-    */
-
-   square1 = buildmap_point_get_square_sorted (record1->record.from);
-   square2 = buildmap_point_get_square_sorted (record2->record.from);
-
-   if (square1 != square2) {
-      return square1 - square2;
-   }
-
-   if (record1->layer != record2->layer) {
-      return record1->layer - record2->layer;
-   }
-
-   if (record1->record.from != record2->record.from) {
-      return record1->record.from - record2->record.from;
-   }
-
-   return record1->record.to - record2->record.to;
-}
-
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */         
-static int buildmap_line_compare2 (const void *r1, const void *r2) {
-
-   int square1;
-   int square2;
-
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapLine *record1;
-   BuildMapLine *record2;
-
-   record1 = Line[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Line[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-
-   /* The lines are first sorted by square.
-    * Within a square, lines are sorted by category.
-    * Within a category, lines are sorted by the "from" and "to" points.
-    */
-
-   square1 = buildmap_point_get_square_sorted (record1->record.to);
-   square2 = buildmap_point_get_square_sorted (record2->record.to);
-
-   if (square1 != square2) {
-      return square1 - square2;
-   }
-
-   if (record1->layer != record2->layer) {
-      return record1->layer - record2->layer;
-   }
-
-   square1 = buildmap_point_get_square_sorted (record1->record.from);
-   square2 = buildmap_point_get_square_sorted (record2->record.from);
-
-   if (square1 != square2) {
-      return square1 - square2;
-   }
-
-   if (record1->record.to != record2->record.to) {
-      return record1->record.to - record2->record.to;
-   }
-
-   return record1->record.from - record2->record.from;
-}
-
 /**
  * @brief
  */         
@@ -567,6 +460,7 @@ void buildmap_line_sort (void) {
    int i, j;
    int to_square, from_square;
    BuildMapLine *one_line;
+   unsigned long long *keys;
 
    if (LineCount == 0) return; /* No line to sort. */
 
@@ -601,7 +495,26 @@ void buildmap_line_sort (void) {
       one_line->record.to   = buildmap_point_get_sorted (one_line->record.to);
    }
 
-   qsort (SortedLine, LineCount, sizeof(int), buildmap_line_compare);
+   /* The lines are first sorted by square.
+    * Within a square, lines are sorted by category.
+    * Within a category, lines are sorted by the "from" and "to" points.
+    */
+   keys = malloc (LineCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
+   for (i = 0; i < LineCount; ++i) {
+      one_line = Line[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (one_line->record.from, one_line->record.to);
+   }
+   buildmap_sort_on_key (SortedLine, LineCount, keys);
+
+   for (i = 0; i < LineCount; ++i) {
+      one_line = Line[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key
+                   (buildmap_point_get_square_sorted (one_line->record.from),
+                    one_line->layer);
+   }
+   buildmap_sort_on_key (SortedLine, LineCount, keys);
 
    for (i = 0; i < LineCount; ++i) {
       j = SortedLine[i];
@@ -632,7 +545,36 @@ void buildmap_line_sort (void) {
       buildmap_fatal (0, "non matching crossing count");
    }
 
-   qsort (SortedLine2, LineCrossingCount, sizeof(int), buildmap_line_compare2);
+   /* The crossing lines are sorted by the square of their "to" point,
+    * then by category, then by the square of their "from" point,
+    * then by the "to" and "from" points.
+    */
+   for (i = 0; i < LineCrossingCount; ++i) {
+      j = SortedLine2[i];
+      one_line = Line[j/BUILDMAP_BLOCK] + (j % BUILDMAP_BLOCK);
+      keys[j] = buildmap_sort_key (one_line->record.to, one_line->record.from);
+   }
+   buildmap_sort_on_key (SortedLine2, LineCrossingCount, keys);
+
+   for (i = 0; i < LineCrossingCount; ++i) {
+      j = SortedLine2[i];
+      one_line = Line[j/BUILDMAP_BLOCK] + (j % BUILDMAP_BLOCK);
+      keys[j] = buildmap_sort_key
+                   (buildmap_point_get_square_sorted (one_line->record.from),
+                    0);
+   }
+   buildmap_sort_on_key (SortedLine2, LineCrossingCount, keys);
+
+   for (i = 0; i < LineCrossingCount; ++i) {
+      j = SortedLine2[i];
+      one_line = Line[j/BUILDMAP_BLOCK] + (j % BUILDMAP_BLOCK);
+      keys[j] = buildmap_sort_key
+                   (buildmap_point_get_square_sorted (one_line->record.to),
+                    one_line->layer);
+   }
+   buildmap_sort_on_key (SortedLine2, LineCrossingCount, keys);
+
+   free (keys);
    
    /* The LineByPoint stuff gets sorted in the buildmap_line_transform_linebypoint
     * function, when we need to pass over the info for other purposes anyway. */
@@ -1057,11 +999,9 @@ static void buildmap_line_reset (void) {
 
    int i;
 
-   for (i = 0; i < BUILDMAP_BLOCK; ++i) {
-      if (Line[i] != NULL) {
-         free(Line[i]);
-         Line[i] = NULL;
-      }
+   /* The blocks themselves belong to the buildmap arena. */
+   for (i = 0; i < BUILDMAP_BLOCK; i++) {
+      Line[i] = NULL;
    }
 
    free (SortedLine);
@@ -1073,7 +1013,7 @@ static void buildmap_line_reset (void) {
    LineCount = 0;
    LineCrossingCount = 0;
 
-   roadmap_hash_delete (LineById);
+   roadmap_hash_int_delete (LineById);
    LineById = NULL;
 
 #ifdef BUILDMAP_NAVIGATION_SUPPORT
@@ -1087,12 +1027,15 @@ static void buildmap_line_reset (void) {
 /**
  * @brief
  */         
+static const char *const BuildMapLineSortAfter[] = {"point", NULL};
+
 static buildmap_db_module BuildMapLineModule = {
    "line",
    buildmap_line_sort,
    buildmap_line_save,
    buildmap_line_summary,
-   buildmap_line_reset
+   buildmap_line_reset,
+   BuildMapLineSortAfter
 }; 
 
 /**
@@ -69,6 +69,7 @@ static int   BuildMapFormatFamily = 0;
 static int   BuildMapVerbose = 0;
 static char *BuildMapFormat  = "2002";
 static char *BuildMapClass   = "default/All";
+static int   BuildMapPacked  = 0;
 
 static char *BuildMapResult;
 
@@ -88,6 +89,8 @@ struct opt_defs options[] = {
         "Location for the generated map files"},
    {"nolonglines", "n", opt_flag, "0",
         "Suppress 'long line' lists (inter-square lines)"},
+   {"packed", "", opt_flag, "0",
+        "Compress the point and shape tables (needs a recent RoadMap)"},
    {"verbose", "v", opt_flag, "0",
         "Show more progress information"},
    OPT_DEFS_END
@@ -272,10 +275,13 @@ int main (int argc, char **argv) {
            opt_val("format", &BuildMapFormat) ||
            opt_val("class", &BuildMapClass) ||
            opt_val("maps", &BuildMapResult) ||
-           opt_val("nolonglines", &BuildMapNoLongLines);
+           opt_val("nolonglines", &BuildMapNoLongLines) ||
+           opt_val("packed", &BuildMapPacked);
    if (error)
       usage(argv[0], opt_strerror(error));
 
+   buildmap_packed_enable (BuildMapPacked);
+
    if (!buildmap_county_select_format())
       exit(1);
 
@@ -138,6 +138,9 @@ void buildmap_error (int column, const char *format, ...) {
    va_list ap;
    FILE    *log;
 
+   /* The modules may be sorted by several threads. */
+   flockfile (stderr);
+
    if (BuildMapMessageLevel >= BUILDMAP_MESSAGE_ERROR)
       buildmap_show_source (stderr, "**", column);
 
@@ -167,6 +170,8 @@ void buildmap_error (int column, const char *format, ...) {
 
    ErrorCount += 1;
    ErrorTotal += 1;
+
+   funlockfile (stderr);
 }
 
 /**
@@ -246,6 +251,8 @@ void buildmap_info (const char *format, ...) {
 
    if (BuildMapMessageLevel >= BUILDMAP_MESSAGE_INFO) {
 
+      flockfile (stdout);
+
       buildmap_show_source (stdout, "--", -1);
 
       va_start(ap, format);
@@ -253,6 +260,8 @@ void buildmap_info (const char *format, ...) {
       va_end(ap);
 
       fprintf (stdout, "\n");
+
+      funlockfile (stdout);
    }
 
 }
@@ -277,11 +286,15 @@ void buildmap_verbose (const char *format, ...) {
    if (BuildMapMessageLevel < BUILDMAP_MESSAGE_VERBOSE)
       return;
 
+   flockfile (stdout);
+
    va_start(ap, format);
    vfprintf(stdout, format, ap);
    va_end(ap);
 
    fprintf (stdout, "\n");
+
+   funlockfile (stdout);
 }
 
 void buildmap_debug (const char *format, ...) {
@@ -291,11 +304,15 @@ void buildmap_debug (const char *format, ...) {
    if (BuildMapMessageLevel < BUILDMAP_MESSAGE_DEBUG)
       return;
 
+   flockfile (stdout);
+
    va_start(ap, format);
    vfprintf(stdout, format, ap);
    va_end(ap);
 
    fprintf (stdout, "\n");
+
+   funlockfile (stdout);
 }
 
 /**
@@ -55,7 +55,9 @@
  * when buildmap_osm is creating a single country iso), the metadata
  * will be used just once before we exit.  so:  we skip doing a reset
  * of the metadata table, which allows it to be duplicated for all
- * .rdm files created in a single invocation.
+ * .rdm files created in a single invocation.  the attributes dictionary
+ * is reset with all the others, though, so we keep the strings we put in
+ * it, and put them back in the same order after each reset.
  */
 #define DO_METADATA_RESET 0
 
@@ -78,10 +80,44 @@ static RoadMapHash *AttributeByName = NULL;
 
 BuildMapDictionary AttributeDictionary = NULL;
 
+#if ! DO_METADATA_RESET
+static char **AttributeText = NULL;
+static int    AttributeTextCount = 0;
+static int    AttributeTextSize = 0;
+#endif
+
 
 static void buildmap_metadata_register (void);
 
 
+static RoadMapString buildmap_metadata_string (const char *text) {
+
+   RoadMapString coded =
+      buildmap_dictionary_add (AttributeDictionary, text, strlen(text));
+
+#if ! DO_METADATA_RESET
+   /* All the attribute strings come through here, and the dictionary
+    * numbers them from 1 in the order they are added: a string seen
+    * for the first time is the next one. Only those are kept.
+    */
+   if (coded > AttributeTextCount) {
+
+      if (AttributeTextCount >= AttributeTextSize) {
+         AttributeTextSize += 64;
+         AttributeText =
+            realloc (AttributeText, AttributeTextSize * sizeof(char *));
+         buildmap_check_allocated(AttributeText);
+      }
+      AttributeText[AttributeTextCount] = strdup (text);
+      buildmap_check_allocated(AttributeText[AttributeTextCount]);
+      AttributeTextCount += 1;
+   }
+#endif
+
+   return coded;
+}
+
+
 static void buildmap_metadata_initialize (void) {
 
    AttributeByName =
@@ -115,14 +151,9 @@ void buildmap_metadata_add_attribute (const char *category,
 
    /* First check if the attribute is already known. */
 
-   coded_category =
-      buildmap_dictionary_add (AttributeDictionary, category, strlen(category));
-
-   coded_name =
-      buildmap_dictionary_add (AttributeDictionary, name, strlen(name));
-
-   coded_value =
-      buildmap_dictionary_add (AttributeDictionary, value, strlen(value));
+   coded_category = buildmap_metadata_string (category);
+   coded_name = buildmap_metadata_string (name);
+   coded_value = buildmap_metadata_string (value);
 
    for (i = roadmap_hash_get_first (AttributeByName, coded_name);
         i >= 0;
@@ -186,8 +217,7 @@ void buildmap_metadata_add_value (const char *category,
    RoadMapString coded_name =
       buildmap_dictionary_locate (AttributeDictionary, name);
 
-   RoadMapString coded_value =
-      buildmap_dictionary_add (AttributeDictionary, value, strlen(value));
+   RoadMapString coded_value = buildmap_metadata_string (value);
 
    for (i = roadmap_hash_get_first (AttributeByName, coded_name);
         i >= 0;
@@ -297,6 +327,16 @@ static void buildmap_metadata_reset (void) {
 
    roadmap_hash_delete (AttributeByName);
    AttributeByName = NULL;
+#else
+   int i;
+
+   /* The dictionary module, registered first, was reset already. */
+   AttributeDictionary = buildmap_dictionary_open ("attributes");
+
+   for (i = 0; i < AttributeTextCount; ++i) {
+      buildmap_dictionary_add
+         (AttributeDictionary, AttributeText[i], strlen(AttributeText[i]));
+   }
 #endif
 }
 
@@ -306,7 +346,8 @@ static buildmap_db_module BuildMapMetadataModule = {
    NULL,
    buildmap_metadata_save,
    buildmap_metadata_summary,
-   buildmap_metadata_reset
+   buildmap_metadata_reset,
+   NULL
 }; 
       
          
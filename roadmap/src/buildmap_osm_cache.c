@@ -0,0 +1,383 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief a module to avoid rebuilding the tiles whose inputs did not change
+ *
+ * Each tile gets a manifest (a .man file next to its .rdm) that lists
+ * the hashes of everything the tile was built from: the OSM data, the
+ * class file, the buildmap_osm program and the .cov files of its
+ * neighbors.  These hashes make the key of the tile.
+ *
+ * A tile whose manifest has the current key is left alone.  Otherwise
+ * the tile's files are looked up by key in the cache directory, and
+ * only built if they are not found there.  Built tiles are added to
+ * the cache, so going back to a previous configuration costs no build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_copyright.h"
+#include "roadmap_path.h"
+#include "roadmap_file.h"
+#include "roadmap_osm.h"
+
+#include "buildmap.h"
+#include "buildmap_osm_cache.h"
+
+
+extern char *BuildMapResult;
+
+#define CACHE_HASH_INIT 14695981039346656037ULL
+
+static const char *CacheDirectory = NULL;
+
+static unsigned long long CacheClassHash;
+static unsigned long long CacheProgramHash;
+static int CacheOverview;
+
+/* the input file is often the same for all tiles (a PBF extract):
+ * it is then hashed once, before the tiles are built.
+ */
+static char *CacheInputName = NULL;
+static unsigned long long CacheInputHash;
+
+/* the key computed by the last lookup, used by the next store */
+static int  CacheTileId = 0;
+static char CacheKey[17];
+static char CacheManifest[1024];
+
+
+/* 64 bits FNV-1a */
+static unsigned long long buildmap_osm_cache_hash
+                  (unsigned long long hash, const void *data, int size) {
+
+   const unsigned char *p = data;
+   int i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= p[i];
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+
+/**
+ * @brief hash the content of a file
+ * @param path
+ * @param name
+ * @return the hash, 0 if the file cannot be read
+ */
+static unsigned long long buildmap_osm_cache_hash_file
+                  (const char *path, const char *name) {
+
+   FILE *file;
+   char buffer[65536];
+   unsigned long long hash = CACHE_HASH_INIT;
+   int count;
+
+   file = roadmap_file_fopen (path, name, "sr");
+   if (file == NULL) return 0;
+
+   while ((count = fread (buffer, 1, sizeof(buffer), file)) > 0) {
+      hash = buildmap_osm_cache_hash (hash, buffer, count);
+   }
+
+   fclose (file);
+   return hash;
+}
+
+
+static void buildmap_osm_cache_entry (char *name, const char *key,
+                                      const char *suffix) {
+
+   sprintf (name, "%.2s/%s%s", key, key, suffix);
+}
+
+
+/**
+ * @brief copy a file, through a temporary file so that a copy
+ *        interrupted midway is never taken for a good one
+ * @return 0 on success, -1 on error
+ */
+static int buildmap_osm_cache_copy (const char *from_path, const char *from,
+                                    const char *to_path, const char *to) {
+
+   FILE *input;
+   FILE *output;
+   char temporary[1024];
+   char buffer[65536];
+   int count;
+   int ret = 0;
+
+   input = roadmap_file_fopen (from_path, from, "sr");
+   if (input == NULL) return -1;
+
+   snprintf (temporary, sizeof(temporary), "%s.tmp", to);
+   output = roadmap_file_fopen (to_path, temporary, "w");
+   if (output == NULL) {
+      fclose (input);
+      return -1;
+   }
+
+   while ((count = fread (buffer, 1, sizeof(buffer), input)) > 0) {
+      if (fwrite (buffer, 1, count, output) != (size_t)count) {
+         ret = -1;
+         break;
+      }
+   }
+
+   fclose (input);
+   if (fclose (output) != 0) ret = -1;
+
+   if (ret != 0 || !roadmap_file_rename (to_path, temporary, to)) {
+      roadmap_file_remove (to_path, temporary);
+      return -1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief enable the cache
+ * @param directory where the tiles are cached
+ * @param classfile the class file the maps are built with
+ * @param input the OSM data all tiles are built from, NULL if each
+ *        tile is built from its own file
+ * @param overview 1 if overview tiles are built
+ */
+void buildmap_osm_cache_initialize (const char *directory,
+                                    const char *classfile,
+                                    const char *input, int overview) {
+
+   roadmap_path_create (directory);
+   CacheDirectory = directory;
+   CacheOverview = overview;
+
+   CacheClassHash = buildmap_osm_cache_hash_file (NULL, classfile);
+   if (CacheClassHash == 0) {
+      buildmap_fatal (0, "cannot read class file %s", classfile);
+   }
+
+   /* any change to the program may change the maps */
+   CacheProgramHash = buildmap_osm_cache_hash_file (NULL, "/proc/self/exe");
+   if (CacheProgramHash == 0) {
+      CacheProgramHash = buildmap_osm_cache_hash
+         (CACHE_HASH_INIT, ROADMAP_VERSION, strlen(ROADMAP_VERSION));
+   }
+
+   /* done here, so that the tiles built in parallel share it */
+   if (input != NULL) {
+      CacheInputName = strdup (input);
+      buildmap_check_allocated(CacheInputName);
+      CacheInputHash = buildmap_osm_cache_hash_file (NULL, input);
+      if (CacheInputHash == 0) {
+         buildmap_fatal (0, "cannot read input file %s", input);
+      }
+   }
+}
+
+
+/**
+ * @brief decide if a tile must be built, once its inputs are hashed
+ * @param tileid
+ * @param input the hash of the data the tile would be built from
+ * @param neighbors the hash of the .cov files of its neighbors
+ * @return 1 if the tile's files are current, 0 if it must be built
+ */
+static int buildmap_osm_cache_check (int tileid, unsigned long long input,
+                                     unsigned long long neighbors) {
+
+   char manifest[1024];
+   char name[1024];
+   char *p;
+   FILE *file;
+   int count;
+
+   snprintf (CacheManifest, sizeof(CacheManifest),
+             "tile 0x%x\n"
+             "input %016llx\n"
+             "class %016llx\n"
+             "program %016llx\n"
+             "packed %d\n"
+             "overview %d\n"
+             "neighbors %016llx\n",
+             tileid, input, CacheClassHash, CacheProgramHash,
+             buildmap_packed_enabled (), CacheOverview, neighbors);
+
+   sprintf (CacheKey, "%016llx",
+            buildmap_osm_cache_hash
+               (CACHE_HASH_INIT, CacheManifest, strlen(CacheManifest)));
+   CacheTileId = tileid;
+
+   /* is the tile already built from these inputs? */
+   file = roadmap_file_fopen (BuildMapResult,
+             roadmap_osm_filename (0, 1, tileid, ".man"), "sr");
+   if (file != NULL) {
+      count = fread (manifest, 1, sizeof(manifest) - 1, file);
+      fclose (file);
+      manifest[count] = 0;
+      p = strstr (manifest, "key ");
+      if (p != NULL && strncmp (p + 4, CacheKey, 16) == 0 &&
+          roadmap_file_exists
+             (BuildMapResult, roadmap_osm_filename (0, 1, tileid, ".cov"))) {
+         buildmap_info ("tile 0x%x is up to date", tileid);
+         return 1;
+      }
+   }
+
+   /* was the tile built from these inputs before? */
+   buildmap_osm_cache_entry (name, CacheKey, ".cov");
+   if (!roadmap_file_exists (CacheDirectory, name)) return 0;
+
+   buildmap_osm_cache_entry (name, CacheKey, ".rdm");
+   if (roadmap_file_exists (CacheDirectory, name)) {
+      if (buildmap_osm_cache_copy (CacheDirectory, name, BuildMapResult,
+                roadmap_osm_filename (0, 1, tileid, ".rdm")) < 0) {
+         return 0;
+      }
+   } else {
+      roadmap_file_remove
+         (BuildMapResult, roadmap_osm_filename (0, 1, tileid, ".rdm"));
+   }
+
+   buildmap_osm_cache_entry (name, CacheKey, ".cov");
+   if (buildmap_osm_cache_copy (CacheDirectory, name, BuildMapResult,
+             roadmap_osm_filename (0, 1, tileid, ".cov")) < 0) {
+      return 0;
+   }
+
+   buildmap_osm_cache_store (tileid);
+
+   buildmap_info ("tile 0x%x restored from the cache", tileid);
+   return 1;
+}
+
+
+/**
+ * @brief decide if a tile must be built
+ * @param tileid
+ * @param input the OSM data the tile would be built from
+ * @return 1 if the tile's files are current, 0 if it must be built
+ */
+int buildmap_osm_cache_lookup (int tileid, const char *input) {
+
+   unsigned long long neighbors;
+   int neighbor;
+   int i;
+
+   if (CacheDirectory == NULL) return 0;
+
+   if (CacheInputName == NULL || strcmp (CacheInputName, input) != 0) {
+      free (CacheInputName);
+      CacheInputName = strdup (input);
+      buildmap_check_allocated(CacheInputName);
+      CacheInputHash = buildmap_osm_cache_hash_file (NULL, input);
+   }
+
+   neighbors = CACHE_HASH_INIT;
+   for (i = 0; i < 8; i++) {
+      unsigned long long hash = 0;
+      neighbor = roadmap_osm_tileid_to_neighbor (tileid, i);
+      if (neighbor > 0) {
+         hash = buildmap_osm_cache_hash_file
+                   (BuildMapResult,
+                    roadmap_osm_filename (0, 1, neighbor, ".cov"));
+      }
+      neighbors = buildmap_osm_cache_hash (neighbors, &hash, sizeof(hash));
+   }
+
+   return buildmap_osm_cache_check (tileid, CacheInputHash, neighbors);
+}
+
+
+/**
+ * @brief decide if an overview tile must be built
+ * @param tileid
+ * @param names the finer tiles it would be built from, in the maps
+ *        directory
+ * @param count
+ * @return 1 if the tile's files are current, 0 if it must be built
+ *
+ * An overview tile does not depend on its neighbors: its input is the
+ * list of the finer tiles, and their content.
+ */
+int buildmap_osm_cache_lookup_tiles (int tileid, char **names, int count) {
+
+   unsigned long long input;
+   int i;
+
+   if (CacheDirectory == NULL) return 0;
+
+   input = CACHE_HASH_INIT;
+   for (i = 0; i < count; i++) {
+      unsigned long long hash =
+         buildmap_osm_cache_hash_file (BuildMapResult, names[i]);
+      input = buildmap_osm_cache_hash (input, names[i], strlen(names[i]));
+      input = buildmap_osm_cache_hash (input, &hash, sizeof(hash));
+   }
+
+   return buildmap_osm_cache_check (tileid, input, CACHE_HASH_INIT);
+}
+
+
+/**
+ * @brief record that a tile was built from the inputs of its last lookup
+ * @param tileid
+ */
+void buildmap_osm_cache_store (int tileid) {
+
+   char name[1024];
+   char *directory;
+   const char *rdm;
+   FILE *file;
+
+   if (CacheDirectory == NULL || tileid != CacheTileId) return;
+
+   /* the .cov goes last: it marks the cache entry as complete */
+   buildmap_osm_cache_entry (name, CacheKey, "");
+   name[2] = 0;
+   directory = roadmap_path_join (CacheDirectory, name);
+   roadmap_path_create (directory);
+   roadmap_path_free (directory);
+
+   rdm = roadmap_osm_filename (0, 1, tileid, ".rdm");
+   if (roadmap_file_exists (BuildMapResult, rdm)) {
+      buildmap_osm_cache_entry (name, CacheKey, ".rdm");
+      buildmap_osm_cache_copy (BuildMapResult, rdm, CacheDirectory, name);
+   }
+   buildmap_osm_cache_entry (name, CacheKey, ".cov");
+   buildmap_osm_cache_copy (BuildMapResult,
+         roadmap_osm_filename (0, 1, tileid, ".cov"), CacheDirectory, name);
+
+   file = roadmap_file_fopen
+             (BuildMapResult, roadmap_osm_filename (0, 1, tileid, ".man"), "w");
+   if (file == NULL) {
+      buildmap_error (0, "cannot write the manifest of tile 0x%x", tileid);
+      return;
+   }
+   fprintf (file, "%skey %s\n", CacheManifest, CacheKey);
+   fclose (file);
+}
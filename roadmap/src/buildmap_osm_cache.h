@@ -0,0 +1,37 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief a module to avoid rebuilding the tiles whose inputs did not change
+ */
+
+#ifndef INCLUDED__BUILDMAP_OSM_CACHE__H
+#define INCLUDED__BUILDMAP_OSM_CACHE__H
+
+void buildmap_osm_cache_initialize (const char *directory,
+                                    const char *classfile,
+                                    const char *input, int overview);
+
+int  buildmap_osm_cache_lookup (int tileid, const char *input);
+int  buildmap_osm_cache_lookup_tiles (int tileid, char **names, int count);
+void buildmap_osm_cache_store  (int tileid);
+
+#endif // INCLUDED__BUILDMAP_OSM_CACHE__H
@@ -0,0 +1,356 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief a module to find the tiles touched by an OSM change file
+ *
+ * An osmChange file (.osc, gzipped or not) lists the nodes, ways and
+ * relations that were created, modified or deleted since the maps were
+ * built.  A tile is rebuilt if its .cov file lists one of them, or if
+ * one of the nodes of the change file now lies inside it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "roadmap.h"
+#include "roadmap_osm.h"
+
+#include "buildmap.h"
+#include "buildmap_osm_text.h"
+#include "buildmap_osm_change.h"
+
+
+#define CHANGE_NODE     0
+#define CHANGE_WAY      1
+#define CHANGE_RELATION 2
+
+static long long *ChangeIds[3];
+static int ChangeCount[3];
+static int ChangeMax[3];
+
+struct change_position {
+   int lon;
+   int lat;
+};
+
+static struct change_position *ChangePositions;
+static int ChangePositionCount;
+static int ChangePositionMax;
+
+/* the tiles holding the changed nodes, for one tile size at a time */
+static int *ChangeTiles;
+static int ChangeTileBits;
+
+
+static void buildmap_osm_change_add (int type, long long id) {
+
+   if (ChangeCount[type] == ChangeMax[type]) {
+      ChangeMax[type] = ChangeMax[type] ? ChangeMax[type] * 2 : 1024;
+      ChangeIds[type] =
+         realloc (ChangeIds[type], ChangeMax[type] * sizeof(long long));
+      buildmap_check_allocated(ChangeIds[type]);
+   }
+   ChangeIds[type][ChangeCount[type]++] = id;
+}
+
+
+static void buildmap_osm_change_add_position (double lat, double lon) {
+
+   struct change_position *position;
+
+   if (ChangePositionCount == ChangePositionMax) {
+      ChangePositionMax = ChangePositionMax ? ChangePositionMax * 2 : 1024;
+      ChangePositions = realloc (ChangePositions,
+                           ChangePositionMax * sizeof(*ChangePositions));
+      buildmap_check_allocated(ChangePositions);
+   }
+
+   position = &ChangePositions[ChangePositionCount++];
+   position->lon = (int)(lon * 1000000.0 + (lon < 0 ? -0.5 : 0.5));
+   position->lat = (int)(lat * 1000000.0 + (lat < 0 ? -0.5 : 0.5));
+}
+
+
+static int buildmap_osm_change_compare_ids (const void *r1, const void *r2) {
+
+   long long id1 = *(const long long *)r1;
+   long long id2 = *(const long long *)r2;
+
+   return (id1 > id2) - (id1 < id2);
+}
+
+
+static int buildmap_osm_change_compare_ints (const void *r1, const void *r2) {
+
+   int i1 = *(const int *)r1;
+   int i2 = *(const int *)r2;
+
+   return (i1 > i2) - (i1 < i2);
+}
+
+
+/**
+ * @brief is this tag the given element?
+ * @param tag the text following the '<'
+ * @param name the element name
+ * @return 1 if so
+ */
+static int buildmap_osm_change_is (const char *tag, const char *name) {
+
+   int length = strlen(name);
+
+   return strncmp (tag, name, length) == 0 &&
+          (tag[length] == ' ' || tag[length] == '\t' ||
+           tag[length] == '\n' || tag[length] == '\r' ||
+           tag[length] == '/' || tag[length] == '>');
+}
+
+
+/**
+ * @brief find the value of an attribute of a tag
+ * @param tag the text following the '<'
+ * @param end the end of the tag
+ * @param name the attribute name, with its leading space
+ * @return the value, or NULL if the tag has no such attribute
+ */
+static const char *buildmap_osm_change_attribute
+                      (const char *tag, const char *end, const char *name) {
+
+   int length = strlen(name);
+   const char *p;
+
+   for (p = tag; p + length + 2 < end; p++) {
+      if (memcmp (p, name, length) == 0 && p[length] == '=' &&
+          (p[length+1] == '"' || p[length+1] == '\'')) {
+         return p + length + 2;
+      }
+   }
+   return NULL;
+}
+
+
+static char *buildmap_osm_change_load (const char *filename) {
+
+   gzFile file;
+   char *data = NULL;
+   int size = 0;
+   int max = 0;
+   int count;
+
+   file = gzopen (filename, "rb");
+   if (file == NULL) {
+      buildmap_error (0, "cannot open change file %s", filename);
+      return NULL;
+   }
+
+   do {
+      if (max - size < 65536) {
+         max = max ? max * 2 : 1024 * 1024;
+         data = realloc (data, max + 1);
+         buildmap_check_allocated(data);
+      }
+      count = gzread (file, data + size, max - size);
+      if (count < 0) {
+         buildmap_error (0, "cannot read change file %s", filename);
+         gzclose (file);
+         free (data);
+         return NULL;
+      }
+      size += count;
+   } while (count > 0);
+
+   gzclose (file);
+
+   data[size] = 0;
+   return data;
+}
+
+
+/**
+ * @brief read the ids and positions listed in an osmChange file
+ * @param filename the change file
+ * @return 0 on success, -1 on error
+ */
+int buildmap_osm_change_read (const char *filename) {
+
+   char *data;
+   const char *p;
+   const char *end;
+   const char *value;
+   int element = -1;
+   int type, i, n;
+
+   data = buildmap_osm_change_load (filename);
+   if (data == NULL) return -1;
+
+   buildmap_set_source (filename);
+
+   for (p = strchr (data, '<'); p != NULL; p = strchr (end, '<')) {
+
+      p++;
+      end = strchr (p, '>');
+      if (end == NULL) break;
+
+      if (buildmap_osm_change_is (p, "node")) {
+         element = CHANGE_NODE;
+      } else if (buildmap_osm_change_is (p, "way")) {
+         element = CHANGE_WAY;
+      } else if (buildmap_osm_change_is (p, "relation")) {
+         element = CHANGE_RELATION;
+      } else if (buildmap_osm_change_is (p, "nd")) {
+         if (element == CHANGE_WAY) {
+            value = buildmap_osm_change_attribute (p, end, " ref");
+            if (value) buildmap_osm_change_add (CHANGE_NODE, atoll(value));
+         }
+         continue;
+      } else if (buildmap_osm_change_is (p, "member")) {
+         value = buildmap_osm_change_attribute (p, end, " type");
+         if (value == NULL || element != CHANGE_RELATION) continue;
+         if (strncmp (value, "node", 4) == 0) {
+            type = CHANGE_NODE;
+         } else if (strncmp (value, "way", 3) == 0) {
+            type = CHANGE_WAY;
+         } else {
+            type = CHANGE_RELATION;
+         }
+         value = buildmap_osm_change_attribute (p, end, " ref");
+         if (value) buildmap_osm_change_add (type, atoll(value));
+         continue;
+      } else {
+         continue;
+      }
+
+      value = buildmap_osm_change_attribute (p, end, " id");
+      if (value == NULL) {
+         buildmap_error (0, "element without an id in %s", filename);
+         continue;
+      }
+      buildmap_osm_change_add (element, atoll(value));
+
+      if (element == CHANGE_NODE) {
+         const char *lat = buildmap_osm_change_attribute (p, end, " lat");
+         const char *lon = buildmap_osm_change_attribute (p, end, " lon");
+         if (lat && lon) {
+            buildmap_osm_change_add_position (atof(lat), atof(lon));
+         }
+      }
+   }
+
+   free (data);
+
+   for (type = 0; type < 3; type++) {
+      qsort (ChangeIds[type], ChangeCount[type], sizeof(long long),
+             buildmap_osm_change_compare_ids);
+      for (i = n = 0; i < ChangeCount[type]; i++) {
+         if (n == 0 || ChangeIds[type][i] != ChangeIds[type][n-1]) {
+            ChangeIds[type][n++] = ChangeIds[type][i];
+         }
+      }
+      ChangeCount[type] = n;
+   }
+
+   buildmap_info ("change file %s: %d nodes, %d ways, %d relations",
+                  filename, ChangeCount[CHANGE_NODE], ChangeCount[CHANGE_WAY],
+                  ChangeCount[CHANGE_RELATION]);
+
+   free (ChangeTiles);
+   ChangeTiles = NULL;
+   ChangeTileBits = 0;
+   return 0;
+}
+
+
+static int buildmap_osm_change_has_position (int tileid) {
+
+   int bits = tileid2bits(tileid);
+   int i;
+
+   if (ChangePositionCount == 0) return 0;
+
+   if (bits != ChangeTileBits) {
+
+      if (ChangeTiles == NULL) {
+         ChangeTiles = malloc (ChangePositionCount * sizeof(int));
+         buildmap_check_allocated(ChangeTiles);
+      }
+      for (i = 0; i < ChangePositionCount; i++) {
+         ChangeTiles[i] = roadmap_osm_latlon2tileid
+               (ChangePositions[i].lat, ChangePositions[i].lon, bits);
+      }
+      qsort (ChangeTiles, ChangePositionCount, sizeof(int),
+             buildmap_osm_change_compare_ints);
+      ChangeTileBits = bits;
+   }
+
+   return bsearch (&tileid, ChangeTiles, ChangePositionCount, sizeof(int),
+                   buildmap_osm_change_compare_ints) != NULL;
+}
+
+
+/**
+ * @brief does the change file touch this tile, or its subtiles if
+ *        it was split?
+ * @param tileid
+ * @return 1 if the tile must be rebuilt
+ */
+int buildmap_osm_change_touches (int tileid) {
+
+   int bits, j, used;
+
+   if (buildmap_osm_change_has_position (tileid)) return 1;
+
+   used = buildmap_osm_text_coverage_uses (tileid, ChangeIds, ChangeCount);
+   if (used >= 0) return used;
+
+   /* no .cov file: the tile was never built, or was split */
+   bits = tileid2bits(tileid);
+   if (bits >= TILE_MAXBITS-1) return 0;
+
+   for (j = 0; j < 4; j++) {
+      if (buildmap_osm_change_touches
+             (mktileid((tileid2trutile(tileid) << 2) | j, bits+2))) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+
+/**
+ * @brief keep only the tiles touched by the change file
+ * @param tiles the tiles list, compacted in place
+ * @param count the number of tiles in the list
+ * @return the number of tiles left
+ */
+int buildmap_osm_change_filter_tiles (int *tiles, int count) {
+
+   int i, n;
+
+   for (i = n = 0; i < count; i++) {
+      if (buildmap_osm_change_touches (tiles[i])) {
+         tiles[n++] = tiles[i];
+      }
+   }
+   return n;
+}
@@ -0,0 +1,34 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief a module to find the tiles touched by an OSM change file
+ */
+
+#ifndef INCLUDED__BUILDMAP_OSM_CHANGE__H
+#define INCLUDED__BUILDMAP_OSM_CHANGE__H
+
+int buildmap_osm_change_read (const char *filename);
+
+int buildmap_osm_change_touches (int tileid);
+int buildmap_osm_change_filter_tiles (int *tiles, int count);
+
+#endif // INCLUDED__BUILDMAP_OSM_CHANGE__H
@@ -33,6 +33,8 @@
 #include <ctype.h>
 #include <errno.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "roadmap.h"
 #include "roadmap_types.h"
@@ -40,6 +42,7 @@
 #include "roadmap_path.h"
 #include "roadmap_math.h"
 #include "roadmap_file.h"
+#include "roadmap_layer.h"
 
 
 #include "buildmap.h"
@@ -47,6 +50,8 @@
 #include "buildmap_metadata.h"
 #include "buildmap_layer.h"
 #include "buildmap_osm_text.h"
+#include "buildmap_osm_change.h"
+#include "buildmap_osm_cache.h"
 
 #include "roadmap_osm.h"
 #include "roadmap_iso.h"
@@ -57,8 +62,30 @@ int BuildMapNoLongLines;
 static int   BuildMapReplaceAll = 0;
 static int   BuildMapReDownload = 0;
 static char *BuildMapFileName = 0;
+static char *BuildMapPbfFile = 0;
+
+/* the tile whose cache lookup the parent already did before forking */
+static int BuildMapLookedUp = 0;
+static char *BuildMapChangeFile = 0;
+static char *BuildMapCacheDir = 0;
+static int   BuildMapJobs = 1;
+static int   BuildMapPacked = 0;
+static int   BuildMapOverview = 0;
 
 char *BuildMapResult;
+int BuildMapSinglePass;
+
+/* the map readers used for the overview tiles come with the locator,
+ * whose layer mapping is only set up by RoadMap itself: without it,
+ * the layers of the maps are used as they are.
+ */
+unsigned int roadmap_layer_max_defined (void) {
+   return 0;
+}
+
+int roadmap_layer_find (const char *name) {
+   return 0;
+}
 
 
 struct opt_defs options[] = {
@@ -76,6 +103,8 @@ struct opt_defs options[] = {
         "commandname for accessing map data to stdout"},
    {"tileid", "t", opt_int, "",
         "Fetch the given numeric tileid (use 0x for hex)"},
+   {"tiles", "T", opt_string, "",
+        "Fetch the tileids listed in this file, one per line (- for stdin)"},
    {"decode", "d", opt_string, "",
         "Analyze given tileid (or quadtile filename) (hex only)"},
    {"encode", "e", opt_string, "",
@@ -92,6 +121,20 @@ struct opt_defs options[] = {
         "Convert arbitrary (non-quadtile) OSM xml data file"},
    {"outputfile", "o", opt_string, "",
         "Write output to this file (use with --inputfile)"},
+   {"singlepass", "s", opt_flag, "0",
+        "Read the OSM data once, keeping nodes in a temporary file"},
+   {"pbf", "p", opt_string, "",
+        "Cut the tiles out of this PBF extract, instead of fetching them"},
+   {"jobs", "j", opt_int, "1",
+        "Build this many tiles at once, in separate processes"},
+   {"changes", "C", opt_string, "",
+        "Only rebuild the tiles touched by this OSM change (.osc) file"},
+   {"cache", "", opt_string, "",
+        "Only rebuild the tiles whose inputs changed, caching them here"},
+   {"packed", "", opt_flag, "0",
+        "Compress the point and shape tables (needs a recent RoadMap)"},
+   {"overview", "", opt_flag, "0",
+        "Build simplified overview tiles, for fewer bits than the maps"},
    OPT_DEFS_END
 };
 
@@ -192,14 +235,51 @@ buildmap_osm_neighbors_to_mask(int tileid) {
 }
 #endif
 
+/**
+ * @brief list the finer tiles an overview tile is built from
+ * @param tileid the overview tile, then its subtiles
+ * @param namesp the .rdm files found, relative to BuildMapResult
+ * @param countp how many there are
+ *
+ * The closest finer level is used: an overview level between this one
+ * and the maps, when built, is quicker to read than the maps.  A subtile
+ * with a .cov but no .rdm is empty.
+ */
+static void
+buildmap_osm_overview_sources (int tileid, char ***namesp, int *countp)
+{
+    const char *name;
+    int childid, bits, j;
+
+    bits = tileid2bits(tileid);
+    if (bits >= TILE_MAXBITS-1)
+        return;
+
+    for (j = 0; j < 4; j++) {
+        childid = mktileid( (tileid2trutile(tileid) << 2) | j, bits+2);
+        name = roadmap_osm_filename(NULL, 1, childid, ".rdm");
+        if (roadmap_file_exists (BuildMapResult, name)) {
+            *namesp = realloc(*namesp, (*countp + 1) * sizeof(**namesp));
+            buildmap_check_allocated(*namesp);
+            (*namesp)[*countp] = strdup(name);
+            buildmap_check_allocated((*namesp)[*countp]);
+            (*countp)++;
+        } else if (!roadmap_file_exists (BuildMapResult,
+                        roadmap_osm_filename(NULL, 1, childid, ".cov"))) {
+            buildmap_osm_overview_sources(childid, namesp, countp);
+        }
+    }
+}
+
 #define DEFAULT_NEIGHBORS \
     ( 1<<TILE_EAST | 1<<TILE_SOUTHEAST | 1<<TILE_SOUTH | 1<<TILE_SOUTHWEST )
 
 /**
- * @brief use a helper command to fetch OSM data for a tile, and process it
+ * @brief use a helper command to fetch OSM data for a tile, and process it,
+ *        or read the finer tiles under an overview tile
  * @param tileid
  * @param fetcher
- * @return
+ * @return 0 when processed, 1 if the tile is up to date, -1 on error
  */
 static int
 buildmap_osm_process_one_tile (int tileid, const char *fetcher)
@@ -216,6 +296,34 @@ buildmap_osm_process_one_tile (int tileid, const char *fetcher)
     buildmap_verbose("buildmap_osm_process_one_tile: tileid 0x%x, bits %d",
 		tileid, bits);
 
+    if (BuildMapOverview) {
+	char **names = NULL;
+	int count = 0;
+
+	buildmap_osm_overview_sources(tileid, &names, &count);
+	if (count == 0) {
+	    buildmap_info("no finer tile under tile 0x%x", tileid);
+	    ret = 1;
+	} else if (buildmap_osm_cache_lookup_tiles(tileid, names, count)) {
+	    ret = 1;
+	} else {
+	    buildmap_osm_text_read_overview(tileid, names, count);
+	    ret = 0;
+	}
+	while (count > 0)
+	    free(names[--count]);
+	free(names);
+	return ret;
+    }
+
+    if (*BuildMapPbfFile) {
+	if (tileid != BuildMapLookedUp &&
+		buildmap_osm_cache_lookup(tileid, BuildMapPbfFile))
+	    return 1;
+	buildmap_osm_text_read(BuildMapPbfFile, tileid, 0, 0);
+	return 0;
+    }
+
     roadmap_osm_tileid_to_bbox(tileid, edges);
     /* s, w, n, e */
     bbp = bbox;
@@ -247,6 +355,8 @@ buildmap_osm_process_one_tile (int tileid, const char *fetcher)
 	(WIFSIGNALED(ret) &&
 	    (WTERMSIG(ret) == SIGINT || WTERMSIG(ret) == SIGQUIT))) {
 	ret = -1;
+    } else if (buildmap_osm_cache_lookup(tileid, xmlfile)) {
+	ret = 1;
     } else {
 	buildmap_osm_text_read(xmlfile, tileid, 0, 0);
 	ret = 0;
@@ -525,6 +635,62 @@ buildmap_osm_which_tiles(const char *latlonarg, int **tilesp, int bits)
     return count;
 }
 
+/**
+ * @brief read a list of tileids, one per line
+ * @param filename the list, "-" for the standard input
+ * @param tilesp
+ * @return the number of tiles read
+ *
+ * This lets a script hand many tiles to a single run, so that the
+ * work shared by all tiles (reading a change file, for instance)
+ * is only done once.
+ */
+static int
+buildmap_osm_read_tiles(const char *filename, int **tilesp)
+{
+    FILE *file;
+    char line[128];
+    char *p, *end;
+    int *tiles = NULL;
+    int count = 0;
+    int lineno = 0;
+
+    if (strcmp(filename, "-") == 0) {
+        file = stdin;
+    } else {
+        file = fopen(filename, "r");
+        if (file == NULL)
+            buildmap_fatal(0, "cannot open tile list %s: %s",
+                           filename, strerror(errno));
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        lineno++;
+
+        p = line + strspn(line, " \t");
+        if (*p == '\n' || *p == '\0' || *p == '#')
+            continue;
+
+        tiles = realloc(tiles, (count + 1) * sizeof(int));
+        buildmap_check_allocated(tiles);
+
+        tiles[count] = strtol(p, &end, 0);
+        if (end == p || tiles[count] == 0 ||
+                (*end != '\0' && !isspace((unsigned char)*end)))
+            buildmap_fatal(0, "%s, line %d: bad tileid", filename, lineno);
+        count++;
+    }
+
+    if (file != stdin)
+        fclose(file);
+
+    buildmap_info("will process %d tiles", count);
+
+    *tilesp = tiles;
+    return count;
+}
+
 /**
  * @brief
  * @param tileid
@@ -539,8 +705,9 @@ static int roadmap_osm_tile_has_coverage(int tileid) {
         return 1;
     }
 
+    /* the smaller tiles are the detailed maps, not an overview */
     bits = tileid2bits(tileid);
-    if (bits >= TILE_MAXBITS-1)
+    if (bits >= TILE_MAXBITS-1 || BuildMapOverview)
         return 0;
 
     for (j = 0; j < 4; j++) {
@@ -552,22 +719,98 @@ static int roadmap_osm_tile_has_coverage(int tileid) {
     return 1;
 }
 
+/**
+ * @brief replace the tile at index i in the list with its four subtiles
+ * @param tilesp
+ * @param countp
+ * @param i
+ * @return 0 on success, -1 if the tile can't be split further
+ */
+static int
+buildmap_osm_split_tile (int **tilesp, int *countp, int i)
+{
+    int *tiles;
+    int tileid = (*tilesp)[i];
+    int n, nbits;
+
+    /* we got a "tile too big" error.  try for four
+     * subtiles instead.
+     */
+    nbits = tileid2bits(tileid);
+    if (nbits >= TILE_MAXBITS-1) {
+	buildmap_info("can't split tile 0x%x further", tileid);
+	return -1;
+    }
+    buildmap_info
+	("splitting tile 0x%x, new bits %d", tileid, nbits+2);
+
+    *countp += 3;
+    tiles = realloc(*tilesp, sizeof(*tiles) * *countp);
+    buildmap_check_allocated(tiles);
+    *tilesp = tiles;
+
+    /* insert new tiles in-place, so that we try the new size right away.
+     * this doesn't matter, except for the user who is trying
+     * to figure out what tile size is needed.
+     */
+    for (n = *countp - 1; n >= i + 4; n--) {
+	    tiles[n] = tiles[n-3];
+    }
+    roadmap_osm_tilesplit(tileid, &tiles[i], 2);
+
+    return 0;
+}
+
+/**
+ * @brief fetch and convert one tile, and write its .rdm file
+ * @param tileid
+ * @param fetcher
+ * @return 0 on success, -2 if the tile must be split, -1 on error
+ */
+static int
+buildmap_osm_build_tile (int tileid, const char *fetcher)
+{
+    int ret;
+
+    ret = buildmap_osm_process_one_tile (tileid, fetcher);
+    if (ret == -2)
+	return ret;
+    if (ret > 0)
+	return 0;  /* up to date */
+
+    if (ret >= 0) {
+	buildmap_db_sort();
+
+	if (buildmap_is_verbose()) {
+	    roadmap_hash_summary();
+	    buildmap_db_summary();
+	}
+
+	buildmap_osm_save(tileid, 1);
+	buildmap_osm_cache_store(tileid);
+    }
+
+    buildmap_db_reset();
+    roadmap_hash_reset();
+
+    return ret;
+}
+
 /**
  * @brief called directly from main to convert a tiles list
- * @param tiles
+ * @param tilesp the tiles list, which may grow when tiles are split
  * @param bits
  * @param count
  * @param fetcher
  * @return
  */
 static int
-buildmap_osm_process_tiles (int *tiles, int bits, int count,
+buildmap_osm_process_tiles (int **tilesp, int bits, int count,
                 const char *fetcher)
 {
+    int *tiles = *tilesp;
     int i, ret = 0;
-    int nbits;
     char name[128];
-    char osmfile[128];
 
     for (i = 0; i < count; i++) {
 
@@ -583,57 +826,193 @@ buildmap_osm_process_tiles (int *tiles, int bits, int count,
 	buildmap_info
 	    ("processing tile %d of %d, file '%s'", i+1, count, name);
 
-        roadmap_osm_filename(osmfile, 1, tileid, ".osm");
-	ret = buildmap_osm_process_one_tile (tileid, fetcher);
+	ret = buildmap_osm_build_tile (tileid, fetcher);
 
 	if (ret == -2) {
-	    /* we got a "tile too big" error.  try for four
-	     * subtiles instead.
-	     */
-	    int n;
+	    if (buildmap_osm_split_tile (tilesp, &count, i) == 0)
+		i--;
+	    tiles = *tilesp;
+	    continue;
+	}
+
+	if (ret < 0) break;
+    }
+
+    return ret < 0;
+}
+
+#define JOB_PENDING 0
+#define JOB_RUNNING 1
+#define JOB_DONE    2
+
+/**
+ * @brief is any tile ahead of tile i in the list, and still unfinished,
+ *        one of its neighbors?
+ *
+ * A tile's .cov file is read by the neighbors built after it, so a tile
+ * must wait for its earlier neighbors to be saved, exactly as it would
+ * in a serial build.  The later neighbors wait for this one in turn.
+ */
+static int
+buildmap_osm_tile_blocked (int *tiles, char *state, int first, int i)
+{
+    int neighbors[8];
+    int j, k;
+
+    for (k = 0; k < 8; k++)
+	neighbors[k] = roadmap_osm_tileid_to_neighbor(tiles[i], k);
+
+    for (j = first; j < i; j++) {
+	if (state[j] == JOB_DONE) continue;
+	for (k = 0; k < 8; k++) {
+	    if (tiles[j] == neighbors[k]) return 1;
+	}
+    }
+    return 0;
+}
+
+/**
+ * @brief convert a tiles list using several worker processes
+ * @param tilesp the tiles list, which may grow when tiles are split
+ * @param bits
+ * @param count
+ * @param fetcher
+ * @param jobs how many tiles may be built at once
+ * @return
+ *
+ * Each tile is built in a forked child, which starts with the same
+ * (empty) tables a serial build would have.  The parent only schedules:
+ * tiles are started in list order, as soon as their earlier neighbors
+ * are done, so the resulting .rdm and .cov files match a serial build.
+ *
+ * With a PBF extract, the parent also reads it, once, before the first
+ * fork: the children cut their tile out of the shared copy.
+ */
+static int
+buildmap_osm_process_tiles_parallel (int **tilesp, int bits, int count,
+                const char *fetcher, int jobs)
+{
+    int *tiles = *tilesp;
+    char *state;
+    pid_t *pids;
+    int i, first = 0, running = 0;
+    int failed = 0;
+    char name[128];
+
+    state = calloc(count, sizeof(*state));
+    pids = calloc(count, sizeof(*pids));
+    buildmap_check_allocated(state);
+    buildmap_check_allocated(pids);
+
+    for (;;) {
+
+	pid_t pid;
+	int status;
+
+	while (first < count && state[first] == JOB_DONE)
+	    first++;
+
+	/* start as many runnable tiles as we have room for */
+	for (i = first; !failed && running < jobs && i < count; i++) {
 
-	    nbits = tileid2bits(tileid);
-	    if (nbits >= TILE_MAXBITS-1) {
-		buildmap_info("can't split tile 0x%x further", tileid);
+	    int tileid = tiles[i];
+
+	    if (state[i] != JOB_PENDING) continue;
+	    if (buildmap_osm_tile_blocked (tiles, state, first, i)) continue;
+
+	    roadmap_osm_filename(name, 1, tileid, ".rdm");
+	    if (!BuildMapReplaceAll && roadmap_osm_tile_has_coverage(tileid)) {
+		buildmap_info("have coverage for tile %s already, skipping",
+				name);
+		state[i] = JOB_DONE;
 		continue;
 	    }
-	    buildmap_info
-		("splitting tile 0x%x, new bits %d", tileid, nbits+2);
 
-	    count += 3;
-	    tiles = realloc(tiles, sizeof(*tiles) * count);
-	    buildmap_check_allocated(tiles);
+	    buildmap_info("");
+	    buildmap_info
+		("processing tile %d of %d, file '%s'", i+1, count, name);
 
-	    /* insert new tiles in-place, so that we try the new size right away.
-	     * this doesn't matter, except for the user who is trying
-	     * to figure out what tile size is needed.
+	    /* the children share the extract, which is read only once,
+	     * and only for a tile which isn't up to date.
 	     */
-	    for (n = count - 1; n >= i + 3; n--) {
-		    tiles[n] = tiles[n-4];
+	    if (*BuildMapPbfFile) {
+		if (buildmap_osm_cache_lookup(tileid, BuildMapPbfFile)) {
+		    state[i] = JOB_DONE;
+		    continue;
+		}
+		buildmap_osm_text_extract_load();
+		BuildMapLookedUp = tileid;
 	    }
-	    roadmap_osm_tilesplit(tileid, &tiles[i], 2);
-	    i--;
-	    continue;
-	}
 
-	if (ret < 0) break;
+	    fflush(stdout);
+	    fflush(stderr);
+	    pid = fork();
+	    if (pid < 0) {
+		buildmap_error(0, "fork failed: %s", strerror(errno));
+		failed = 1;
+		break;
+	    }
+	    if (pid == 0) {
+		switch (buildmap_osm_build_tile (tileid, fetcher)) {
+		case 0:  exit(0);
+		case -2: exit(2);
+		default: exit(1);
+		}
+	    }
+	    pids[i] = pid;
+	    state[i] = JOB_RUNNING;
+	    running++;
+	}
 
-        if (ret >= 0) {
-	    buildmap_db_sort();
+	if (running == 0)
+	    break;
 
-            if (buildmap_is_verbose()) {
-		roadmap_hash_summary();
-		buildmap_db_summary();
-	    }
+	pid = waitpid(-1, &status, 0);
+	if (pid < 0) {
+	    if (errno == EINTR) continue;
+	    buildmap_error(0, "waitpid failed: %s", strerror(errno));
+	    failed = 1;
+	    break;
+	}
 
-	    buildmap_osm_save(tileid, 1);
+	for (i = first; i < count; i++) {
+	    if (state[i] == JOB_RUNNING && pids[i] == pid) break;
 	}
+	if (i == count) continue;
+
+	running--;
+	state[i] = JOB_DONE;
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 2) {
+
+	    int newcount = count;
 
-	buildmap_db_reset();
-	roadmap_hash_reset();
+	    if (buildmap_osm_split_tile (tilesp, &newcount, i) < 0)
+		continue;
+	    tiles = *tilesp;
+
+	    state = realloc(state, newcount * sizeof(*state));
+	    pids = realloc(pids, newcount * sizeof(*pids));
+	    buildmap_check_allocated(state);
+	    buildmap_check_allocated(pids);
+	    memmove(&state[i + 4], &state[i + 1], count - i - 1);
+	    memmove(&pids[i + 4], &pids[i + 1],
+			(count - i - 1) * sizeof(*pids));
+	    memset(&state[i], JOB_PENDING, 4);
+	    count = newcount;
+
+	} else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+
+	    roadmap_osm_filename(name, 1, tiles[i], ".rdm");
+	    buildmap_error(0, "tile %s failed, waiting for the others", name);
+	    failed = 1;
+	}
     }
 
-    return ret < 0;
+    free (state);
+    free (pids);
+
+    return failed;
 }
 
 /**
@@ -842,7 +1221,7 @@ main(int argc, char **argv)
     char *decode, *encode;
     int listonly;
     int tileid;
-    char *class, *latlonarg, *fetcher, *inputfile;
+    char *class, *latlonarg, *fetcher, *inputfile, *tilesfile;
 
     progname = strrchr(argv[0], '/');
 
@@ -867,14 +1246,24 @@ main(int argc, char **argv)
             opt_val("maps", &BuildMapResult) ||
             opt_val("fetcher", &fetcher) ||
             opt_val("tileid", &tileid) ||
+            opt_val("tiles", &tilesfile) ||
             opt_val("decode", &decode) ||
             opt_val("encode", &encode) ||
             opt_val("listonly", &listonly) ||
             opt_val("outputfile", &BuildMapFileName) ||
+            opt_val("singlepass", &BuildMapSinglePass) ||
+            opt_val("pbf", &BuildMapPbfFile) ||
+            opt_val("jobs", &BuildMapJobs) ||
+            opt_val("changes", &BuildMapChangeFile) ||
+            opt_val("cache", &BuildMapCacheDir) ||
+            opt_val("packed", &BuildMapPacked) ||
+            opt_val("overview", &BuildMapOverview) ||
             opt_val("inputfile", &inputfile);
     if (error)
         usage(opt_strerror(error));
 
+    buildmap_packed_enable (BuildMapPacked);
+
     if (osm_bits < TILE_MINBITS || TILE_MAXBITS < osm_bits) {
         fprintf (stderr, "bits value %d out of range (%d to %d)",
                 osm_bits, TILE_MINBITS, TILE_MAXBITS);
@@ -905,6 +1294,32 @@ main(int argc, char **argv)
 
     buildmap_metadata_add_attribute ("MapFormat", "Version", "1.4 alpha");
 
+    if (BuildMapOverview) {
+        char zoom[16];
+
+        if (*BuildMapPbfFile) {
+            usage_err ("overview tiles are built from the maps under --maps, "
+                       "not from --pbf");
+        }
+
+        if (osm_bits >= atoi(ROADMAP_OSM_DEFAULT_BITS)) {
+            buildmap_info ("RoadMap only uses overview tiles with fewer bits "
+                           "than its Map.QuadTile bits (%s by default)",
+                           ROADMAP_OSM_DEFAULT_BITS);
+        }
+        sprintf (zoom, "%d", roadmap_osm_overview_zoom(osm_bits));
+        buildmap_metadata_add_attribute ("Overview", "Zoom", zoom);
+        buildmap_osm_text_overview (roadmap_osm_overview_zoom(osm_bits));
+    }
+
+    if (*BuildMapCacheDir) {
+        /* the manifests decide which tiles to rebuild */
+        buildmap_osm_cache_initialize(BuildMapCacheDir, class,
+                                      *BuildMapPbfFile ? BuildMapPbfFile : NULL,
+                                      BuildMapOverview);
+        BuildMapReplaceAll = 1;
+    }
+
     if (tileid) {
 
         tileslist = malloc(sizeof(int));
@@ -912,6 +1327,10 @@ main(int argc, char **argv)
         *tileslist = tileid;
         count = 1;
 
+    } else if (*tilesfile) {
+
+        count = buildmap_osm_read_tiles(tilesfile, &tileslist);
+
     } else if (*inputfile && *BuildMapFileName) {
             int r;
 
@@ -947,13 +1366,36 @@ main(int argc, char **argv)
 
     if (argc != 1) usage_err("too many arguments");
 
+    if (*BuildMapChangeFile) {
+
+        if (buildmap_osm_change_read(BuildMapChangeFile) < 0)
+            exit(1);
+
+        count = buildmap_osm_change_filter_tiles(tileslist, count);
+        buildmap_info("%d tiles touched by %s", count, BuildMapChangeFile);
+
+        /* the touched tiles are stale: rebuild them from fresh data */
+        BuildMapReplaceAll = 1;
+        if (!*BuildMapPbfFile)
+            BuildMapReDownload = 1;
+    }
+
     if (listonly) {
 	buildmap_osm_list_tiles(tileslist, count);
 	exit(0);
     }
 
-    error = buildmap_osm_process_tiles
-                (tileslist, osm_bits, count, fetcher);
+    if (*BuildMapPbfFile)
+        buildmap_osm_text_extract(BuildMapPbfFile, tileslist, count);
+
+    if (BuildMapJobs > 1) {
+        /* The tiles built at once already keep the processors busy. */
+        buildmap_db_set_sort_threads (1);
+        error = buildmap_osm_process_tiles_parallel
+                    (&tileslist, osm_bits, count, fetcher, BuildMapJobs);
+    } else
+        error = buildmap_osm_process_tiles
+                    (&tileslist, osm_bits, count, fetcher);
 
     free (tileslist);
 
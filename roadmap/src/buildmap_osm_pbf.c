@@ -0,0 +1,1074 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief a module to read the OSM PBF (protocol buffer) format
+ *
+ * A PBF file is a sequence of blobs, each preceded by a BlobHeader and
+ * its (big endian) length.  Apart from the OSMHeader blob, each blob
+ * holds a zlib compressed PrimitiveBlock.  See
+ *  http://wiki.openstreetmap.org/wiki/PBF_Format
+ *
+ * Inflating the blocks is most of the work, so it is done by a group
+ * of threads, a batch of blobs at a time.  The blocks are then decoded
+ * in the file's order, and the elements handed to the callbacks from
+ * the main thread only: the callbacks don't have to be thread safe.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <readosm.h>
+
+#include "roadmap.h"
+
+#include "buildmap.h"
+#include "buildmap_osm_pbf.h"
+
+
+#define PBF_MAX_HEADER   (64 * 1024)
+#define PBF_MAX_BLOB     (32 * 1024 * 1024)
+#define PBF_MAX_THREADS  16
+#define PBF_BATCH        4      /* blobs per thread and per batch. */
+
+static int PbfThreads = 0;      /* 0: one per processor. */
+
+
+/* Protocol buffer decoding -------------------------------------------- */
+
+typedef struct {
+   const unsigned char *cursor;
+   const unsigned char *end;
+} PbfBuffer;
+
+#define PBF_VARINT   0
+#define PBF_FIXED64  1
+#define PBF_BYTES    2
+#define PBF_FIXED32  5
+
+
+static int pbf_varint (PbfBuffer *buffer, unsigned long long *value) {
+
+   unsigned long long result = 0;
+   int shift;
+
+   for (shift = 0; shift < 64; shift += 7) {
+
+      unsigned char byte;
+
+      if (buffer->cursor >= buffer->end) return 0;
+
+      byte = *buffer->cursor++;
+      result |= (unsigned long long)(byte & 0x7f) << shift;
+
+      if (! (byte & 0x80)) {
+         *value = result;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+
+static long long pbf_zigzag (unsigned long long value) {
+   return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+
+/**
+ * @brief read the next field of a message
+ * @param buffer the message
+ * @param field returns the field number
+ * @param value returns the value of a varint or fixed field
+ * @param content returns the content of a length delimited field
+ * @return the wire type, -1 at the end of the message or on error
+ */
+static int pbf_field (PbfBuffer *buffer,
+                      int *field,
+                      unsigned long long *value,
+                      PbfBuffer *content) {
+
+   unsigned long long key;
+   unsigned long long length;
+
+   if (buffer->cursor >= buffer->end) return -1;
+   if (! pbf_varint (buffer, &key)) return -1;
+
+   *field = (int)(key >> 3);
+
+   switch (key & 7) {
+
+   case PBF_VARINT:
+      if (! pbf_varint (buffer, value)) return -1;
+      return PBF_VARINT;
+
+   case PBF_FIXED64:
+   case PBF_FIXED32:
+      length = ((key & 7) == PBF_FIXED64) ? 8 : 4;
+      if (buffer->end - buffer->cursor < (long)length) return -1;
+      buffer->cursor += length;
+      *value = 0;
+      return (int)(key & 7);
+
+   case PBF_BYTES:
+      if (! pbf_varint (buffer, &length)) return -1;
+      if ((unsigned long long)(buffer->end - buffer->cursor) < length) {
+         return -1;
+      }
+      content->cursor = buffer->cursor;
+      content->end = buffer->cursor + length;
+      buffer->cursor += length;
+      return PBF_BYTES;
+   }
+
+   return -1;
+}
+
+
+/* Element decoding ---------------------------------------------------- */
+
+/* A repeated numeric field, as one run of varints. */
+typedef struct {
+
+   PbfBuffer buffer;
+
+   /* Used when the field came in several pieces. */
+   unsigned char *data;
+   int size;
+   int max;
+   int pieces;
+
+} PbfRepeated;
+
+#define PBF_MAX_REPEATED 5
+
+typedef struct {
+
+   /* The string table, each string now terminated. */
+   char  *strings;
+   char **string;
+   int    string_count;
+
+   long long granularity;
+   long long lat_offset;
+   long long lon_offset;
+
+   readosm_tag *tags;
+   int tags_max;
+
+   long long *refs;
+   int refs_max;
+
+   readosm_member *members;
+   int members_max;
+
+   PbfRepeated repeated[PBF_MAX_REPEATED];
+
+   const void *user_data;
+   readosm_node_callback node_fnct;
+   readosm_way_callback way_fnct;
+   readosm_relation_callback relation_fnct;
+
+} PbfContext;
+
+
+static void pbf_grow (void **array, int *max, int needed, int size) {
+
+   if (needed > *max) {
+      *max = needed + needed / 2 + 16;
+      *array = realloc (*array, *max * size);
+      buildmap_check_allocated(*array);
+   }
+}
+
+
+static PbfRepeated *pbf_repeated_start (PbfContext *context, int count) {
+
+   int i;
+
+   for (i = 0; i < count; ++i) {
+      context->repeated[i].buffer.cursor = NULL;
+      context->repeated[i].buffer.end = NULL;
+      context->repeated[i].size = 0;
+      context->repeated[i].pieces = 0;
+   }
+   return context->repeated;
+}
+
+
+/**
+ * @brief the repeated numeric fields are normally packed in a single
+ * length delimited field, but they may also come as one field per
+ * value, or as several packed pieces: gather all the values.
+ */
+static void pbf_repeated (PbfRepeated *repeated,
+                          int wire,
+                          unsigned long long value,
+                          const PbfBuffer *content) {
+
+   if (repeated->pieces++ == 0 && wire == PBF_BYTES) {
+      repeated->buffer = *content;  /* The usual case: no copy. */
+      return;
+   }
+
+   if (repeated->buffer.cursor != NULL &&
+       repeated->buffer.cursor != repeated->data) {
+
+      /* The first piece was read in place: copy it. */
+      int length = repeated->buffer.end - repeated->buffer.cursor;
+
+      pbf_grow ((void **)&repeated->data, &repeated->max, length, 1);
+      memcpy (repeated->data, repeated->buffer.cursor, length);
+      repeated->size = length;
+   }
+
+   if (wire == PBF_BYTES) {
+
+      int length = content->end - content->cursor;
+
+      pbf_grow ((void **)&repeated->data, &repeated->max,
+                repeated->size + length, 1);
+      memcpy (repeated->data + repeated->size, content->cursor, length);
+      repeated->size += length;
+
+   } else {
+
+      pbf_grow ((void **)&repeated->data, &repeated->max,
+                repeated->size + 10, 1);
+      do {
+         repeated->data[repeated->size++] =
+            (value & 0x7f) | ((value > 0x7f) ? 0x80 : 0);
+         value >>= 7;
+      } while (value != 0);
+   }
+
+   repeated->buffer.cursor = repeated->data;
+   repeated->buffer.end = repeated->data + repeated->size;
+}
+
+
+static const char *pbf_string (PbfContext *context, unsigned long long id) {
+
+   if (id >= (unsigned long long)context->string_count) return "";
+   return context->string[id];
+}
+
+
+static int pbf_string_table (PbfContext *context, PbfBuffer *table) {
+
+   PbfBuffer buffer = *table;
+   PbfBuffer content;
+   unsigned long long value;
+   int field;
+   int wire;
+   int count = 0;
+   char *cursor;
+
+   free (context->strings);
+   free (context->string);
+
+   /* Each string gets one more byte for its terminator, and has at
+    * least one byte of overhead in the table: the table's size is
+    * enough.
+    */
+   context->strings = malloc ((table->end - table->cursor) + 1);
+   buildmap_check_allocated(context->strings);
+
+   while ((wire = pbf_field (&buffer, &field, &value, &content)) >= 0) {
+      if (field == 1 && wire == PBF_BYTES) count += 1;
+   }
+
+   context->string = malloc ((count + 1) * sizeof(char *));
+   buildmap_check_allocated(context->string);
+   context->string_count = count;
+
+   buffer = *table;
+   cursor = context->strings;
+   count = 0;
+
+   while ((wire = pbf_field (&buffer, &field, &value, &content)) >= 0) {
+
+      if (field == 1 && wire == PBF_BYTES) {
+
+         int length = content.end - content.cursor;
+
+         memcpy (cursor, content.cursor, length);
+         cursor[length] = 0;
+         context->string[count++] = cursor;
+         cursor += length + 1;
+      }
+   }
+   return 1;
+}
+
+
+/**
+ * @brief pair the keys and values of a way or relation into tags
+ */
+static int pbf_tags (PbfContext *context, PbfBuffer *keys, PbfBuffer *vals) {
+
+   unsigned long long key;
+   unsigned long long val;
+   int count = 0;
+
+   while (pbf_varint (keys, &key) && pbf_varint (vals, &val)) {
+
+      pbf_grow ((void **)&context->tags, &context->tags_max,
+                count + 1, sizeof(readosm_tag));
+
+      context->tags[count].key = pbf_string (context, key);
+      context->tags[count].value = pbf_string (context, val);
+      count += 1;
+   }
+   return count;
+}
+
+
+static double pbf_latitude (PbfContext *context, long long lat) {
+   return 0.000000001 * (context->lat_offset + context->granularity * lat);
+}
+
+
+static double pbf_longitude (PbfContext *context, long long lon) {
+   return 0.000000001 * (context->lon_offset + context->granularity * lon);
+}
+
+
+static int pbf_node (PbfContext *context, PbfBuffer *message) {
+
+   PbfBuffer content;
+   PbfRepeated *keys = pbf_repeated_start (context, 2);
+   PbfRepeated *vals = keys + 1;
+   unsigned long long value;
+   long long id = 0;
+   long long lat = 0;
+   long long lon = 0;
+   int field;
+   int wire;
+
+   while ((wire = pbf_field (message, &field, &value, &content)) >= 0) {
+      switch (field) {
+      case 1: id = pbf_zigzag (value); break;
+      case 2: pbf_repeated (keys, wire, value, &content); break;
+      case 3: pbf_repeated (vals, wire, value, &content); break;
+      case 8: lat = pbf_zigzag (value); break;
+      case 9: lon = pbf_zigzag (value); break;
+      }
+   }
+
+   {
+      int tag_count = pbf_tags (context, &keys->buffer, &vals->buffer);
+      readosm_node node = {
+         .id = id,
+         .latitude = pbf_latitude (context, lat),
+         .longitude = pbf_longitude (context, lon),
+         .tag_count = tag_count,
+         .tags = context->tags
+      };
+      return context->node_fnct (context->user_data, &node);
+   }
+}
+
+
+static int pbf_dense_nodes (PbfContext *context, PbfBuffer *message) {
+
+   PbfBuffer content;
+   PbfRepeated *ids = pbf_repeated_start (context, 4);
+   PbfRepeated *lats = ids + 1;
+   PbfRepeated *lons = ids + 2;
+   PbfRepeated *keys_vals = ids + 3;
+   unsigned long long value;
+   unsigned long long delta;
+   long long id = 0;
+   long long lat = 0;
+   long long lon = 0;
+   int field;
+   int wire;
+   int ret;
+
+   while ((wire = pbf_field (message, &field, &value, &content)) >= 0) {
+      switch (field) {
+      case 1:  pbf_repeated (ids, wire, value, &content); break;
+      case 8:  pbf_repeated (lats, wire, value, &content); break;
+      case 9:  pbf_repeated (lons, wire, value, &content); break;
+      case 10: pbf_repeated (keys_vals, wire, value, &content); break;
+      }
+   }
+
+   while (pbf_varint (&ids->buffer, &delta)) {
+
+      int tag_count = 0;
+
+      id += pbf_zigzag (delta);
+      if (pbf_varint (&lats->buffer, &delta)) lat += pbf_zigzag (delta);
+      if (pbf_varint (&lons->buffer, &delta)) lon += pbf_zigzag (delta);
+
+      /* The tags of all nodes, as key, value pairs, each node's list
+       * ending with a 0.
+       */
+      while (pbf_varint (&keys_vals->buffer, &value) && value != 0) {
+
+         unsigned long long val = 0;
+
+         pbf_varint (&keys_vals->buffer, &val);
+
+         pbf_grow ((void **)&context->tags, &context->tags_max,
+                   tag_count + 1, sizeof(readosm_tag));
+
+         context->tags[tag_count].key = pbf_string (context, value);
+         context->tags[tag_count].value = pbf_string (context, val);
+         tag_count += 1;
+      }
+
+      {
+         readosm_node node = {
+            .id = id,
+            .latitude = pbf_latitude (context, lat),
+            .longitude = pbf_longitude (context, lon),
+            .tag_count = tag_count,
+            .tags = context->tags
+         };
+         ret = context->node_fnct (context->user_data, &node);
+         if (ret != READOSM_OK) return ret;
+      }
+   }
+
+   return READOSM_OK;
+}
+
+
+static int pbf_way (PbfContext *context, PbfBuffer *message) {
+
+   PbfBuffer content;
+   PbfRepeated *keys = pbf_repeated_start (context, 3);
+   PbfRepeated *vals = keys + 1;
+   PbfRepeated *refs = keys + 2;
+   unsigned long long value;
+   unsigned long long delta;
+   long long id = 0;
+   long long ref = 0;
+   int ref_count = 0;
+   int field;
+   int wire;
+
+   while ((wire = pbf_field (message, &field, &value, &content)) >= 0) {
+      switch (field) {
+      case 1: id = (long long)value; break;
+      case 2: pbf_repeated (keys, wire, value, &content); break;
+      case 3: pbf_repeated (vals, wire, value, &content); break;
+      case 8: pbf_repeated (refs, wire, value, &content); break;
+      }
+   }
+
+   while (pbf_varint (&refs->buffer, &delta)) {
+
+      pbf_grow ((void **)&context->refs, &context->refs_max,
+                ref_count + 1, sizeof(long long));
+
+      ref += pbf_zigzag (delta);
+      context->refs[ref_count++] = ref;
+   }
+
+   {
+      int tag_count = pbf_tags (context, &keys->buffer, &vals->buffer);
+      readosm_way way = {
+         .id = id,
+         .node_ref_count = ref_count,
+         .node_refs = context->refs,
+         .tag_count = tag_count,
+         .tags = context->tags
+      };
+      return context->way_fnct (context->user_data, &way);
+   }
+}
+
+
+static int pbf_relation (PbfContext *context, PbfBuffer *message) {
+
+   static const int member_type[] = {
+      READOSM_MEMBER_NODE, READOSM_MEMBER_WAY, READOSM_MEMBER_RELATION
+   };
+
+   PbfBuffer content;
+   PbfRepeated *keys = pbf_repeated_start (context, 5);
+   PbfRepeated *vals = keys + 1;
+   PbfRepeated *roles = keys + 2;
+   PbfRepeated *memids = keys + 3;
+   PbfRepeated *types = keys + 4;
+   unsigned long long value;
+   unsigned long long role;
+   unsigned long long type;
+   unsigned long long delta;
+   long long id = 0;
+   long long memid = 0;
+   int member_count = 0;
+   int field;
+   int wire;
+
+   while ((wire = pbf_field (message, &field, &value, &content)) >= 0) {
+      switch (field) {
+      case 1:  id = (long long)value; break;
+      case 2:  pbf_repeated (keys, wire, value, &content); break;
+      case 3:  pbf_repeated (vals, wire, value, &content); break;
+      case 8:  pbf_repeated (roles, wire, value, &content); break;
+      case 9:  pbf_repeated (memids, wire, value, &content); break;
+      case 10: pbf_repeated (types, wire, value, &content); break;
+      }
+   }
+
+   while (pbf_varint (&memids->buffer, &delta)) {
+
+      if (! pbf_varint (&roles->buffer, &role)) role = 0;
+      if (! pbf_varint (&types->buffer, &type) || type > 2) type = 0;
+
+      memid += pbf_zigzag (delta);
+
+      pbf_grow ((void **)&context->members, &context->members_max,
+                member_count + 1, sizeof(readosm_member));
+
+      {
+         /* The fields of readosm_member are const. */
+         readosm_member member = {
+            .member_type = member_type[type],
+            .id = memid,
+            .role = pbf_string (context, role)
+         };
+         memcpy (&context->members[member_count++], &member, sizeof(member));
+      }
+   }
+
+   {
+      int tag_count = pbf_tags (context, &keys->buffer, &vals->buffer);
+      readosm_relation relation = {
+         .id = id,
+         .member_count = member_count,
+         .members = context->members,
+         .tag_count = tag_count,
+         .tags = context->tags
+      };
+      return context->relation_fnct (context->user_data, &relation);
+   }
+}
+
+
+static int pbf_primitive_group (PbfContext *context, PbfBuffer *group) {
+
+   PbfBuffer content;
+   unsigned long long value;
+   int field;
+   int wire;
+   int ret = READOSM_OK;
+
+   while ((wire = pbf_field (group, &field, &value, &content)) >= 0) {
+
+      if (wire != PBF_BYTES) continue;
+
+      switch (field) {
+      case 1:
+         if (context->node_fnct) ret = pbf_node (context, &content);
+         break;
+      case 2:
+         if (context->node_fnct) ret = pbf_dense_nodes (context, &content);
+         break;
+      case 3:
+         if (context->way_fnct) ret = pbf_way (context, &content);
+         break;
+      case 4:
+         if (context->relation_fnct) ret = pbf_relation (context, &content);
+         break;
+      }
+      if (ret != READOSM_OK) return READOSM_ABORT;
+   }
+   return READOSM_OK;
+}
+
+
+static int pbf_primitive_block (PbfContext *context,
+                                const unsigned char *data, int size) {
+
+   PbfBuffer block = {data, data + size};
+   PbfBuffer content;
+   unsigned long long value;
+   int field;
+   int wire;
+   int ret;
+
+   context->granularity = 100;
+   context->lat_offset = 0;
+   context->lon_offset = 0;
+
+   /* The string table and the scale may follow the groups. */
+   while ((wire = pbf_field (&block, &field, &value, &content)) >= 0) {
+      switch (field) {
+      case 1:  pbf_string_table (context, &content); break;
+      case 17: context->granularity = (long long)value; break;
+      case 19: context->lat_offset = (long long)value; break;
+      case 20: context->lon_offset = (long long)value; break;
+      }
+   }
+
+   block.cursor = data;
+   while ((wire = pbf_field (&block, &field, &value, &content)) >= 0) {
+      if (field == 2 && wire == PBF_BYTES) {
+         ret = pbf_primitive_group (context, &content);
+         if (ret != READOSM_OK) return ret;
+      }
+   }
+   return READOSM_OK;
+}
+
+
+static int pbf_header_block (const unsigned char *data, int size) {
+
+   PbfBuffer block = {data, data + size};
+   PbfBuffer content;
+   unsigned long long value;
+   int field;
+   int wire;
+
+   while ((wire = pbf_field (&block, &field, &value, &content)) >= 0) {
+
+      if (field == 4 && wire == PBF_BYTES) {
+
+         int length = content.end - content.cursor;
+
+         if ((length == 14 &&
+                 memcmp (content.cursor, "OsmSchema-V0.6", 14) == 0) ||
+             (length == 10 &&
+                 memcmp (content.cursor, "DenseNodes", 10) == 0)) {
+            continue;
+         }
+
+         buildmap_error (0, "unsupported PBF feature %.*s",
+                         length, content.cursor);
+         return READOSM_INVALID_PBF_HEADER;
+      }
+   }
+   return READOSM_OK;
+}
+
+
+/* Blob reading and inflating ------------------------------------------ */
+
+#define PBF_BLOB_OTHER   0  /* Unknown blob types are skipped. */
+#define PBF_BLOB_HEADER  1
+#define PBF_BLOB_DATA    2
+
+typedef struct {
+
+   int type;
+
+   unsigned char *blob;     /* As read from the file. */
+   int blob_size;
+
+   unsigned char *raw;      /* Once inflated. */
+   int raw_size;
+   const unsigned char *zlib_data;
+   int zlib_size;
+
+   int status;
+
+} PbfBlob;
+
+/* The inflate threads are started once per file, and wait for each
+ * batch of blobs: blobs are handed out one at a time, so that a thread
+ * stuck on a large one doesn't hold the others back.
+ */
+typedef struct {
+
+   pthread_t thread[PBF_MAX_THREADS];
+   int started;
+
+   pthread_mutex_t lock;
+   pthread_cond_t ready;    /* A new batch, or the end. */
+   pthread_cond_t done;     /* The batch is inflated. */
+
+   PbfBlob *blobs;
+   int count;
+   int next;                /* The next blob to hand out. */
+   int finished;            /* The blobs inflated so far. */
+   int quit;
+
+} PbfPool;
+
+
+static int pbf_read_be32 (FILE *fp, unsigned int *value) {
+
+   unsigned char bytes[4];
+
+   if (fread (bytes, 1, 4, fp) != 4) return 0;
+
+   *value = ((unsigned int)bytes[0] << 24) | (bytes[1] << 16) |
+            (bytes[2] << 8) | bytes[3];
+   return 1;
+}
+
+
+/**
+ * @brief read the next blob from the file
+ * @return 1 if a blob was read, 0 at the end of the file, or an error
+ */
+static int pbf_read_blob (FILE *fp, PbfBlob *blob) {
+
+   unsigned char header[PBF_MAX_HEADER];
+   unsigned int header_size;
+   unsigned long long value;
+   PbfBuffer buffer;
+   PbfBuffer content;
+   PbfBuffer type = {NULL, NULL};
+   int data_size = -1;
+   int field;
+   int wire;
+
+   if (! pbf_read_be32 (fp, &header_size)) return 0;
+
+   if (header_size > PBF_MAX_HEADER ||
+       fread (header, 1, header_size, fp) != header_size) {
+      return READOSM_INVALID_PBF_HEADER;
+   }
+
+   buffer.cursor = header;
+   buffer.end = header + header_size;
+
+   while ((wire = pbf_field (&buffer, &field, &value, &content)) >= 0) {
+      if (field == 1 && wire == PBF_BYTES) type = content;
+      if (field == 3 && wire == PBF_VARINT) data_size = (int)value;
+   }
+
+   if (type.cursor == NULL || data_size < 0 || data_size > PBF_MAX_BLOB) {
+      return READOSM_INVALID_PBF_HEADER;
+   }
+
+   if (type.end - type.cursor == 7 &&
+       memcmp (type.cursor, "OSMData", 7) == 0) {
+      blob->type = PBF_BLOB_DATA;
+   } else if (type.end - type.cursor == 9 &&
+              memcmp (type.cursor, "OSMHeader", 9) == 0) {
+      blob->type = PBF_BLOB_HEADER;
+   } else {
+      blob->type = PBF_BLOB_OTHER;
+   }
+
+   blob->blob = malloc (data_size);
+   buildmap_check_allocated(blob->blob);
+   blob->blob_size = data_size;
+
+   if (fread (blob->blob, 1, data_size, fp) != (size_t)data_size) {
+      return READOSM_READ_ERROR;
+   }
+
+   blob->raw = NULL;
+   blob->raw_size = 0;
+   blob->zlib_data = NULL;
+   blob->zlib_size = 0;
+   blob->status = READOSM_OK;
+
+   buffer.cursor = blob->blob;
+   buffer.end = blob->blob + data_size;
+
+   while ((wire = pbf_field (&buffer, &field, &value, &content)) >= 0) {
+
+      switch (field) {
+
+      case 1: /* raw */
+         blob->raw_size = content.end - content.cursor;
+         blob->raw = malloc (blob->raw_size + 1);
+         buildmap_check_allocated(blob->raw);
+         memcpy (blob->raw, content.cursor, blob->raw_size);
+         break;
+
+      case 2: /* raw_size */
+         if (value > PBF_MAX_BLOB) return READOSM_INVALID_PBF_HEADER;
+         blob->raw_size = (int)value;
+         break;
+
+      case 3: /* zlib_data */
+         blob->zlib_data = content.cursor;
+         blob->zlib_size = content.end - content.cursor;
+         break;
+
+      case 4: /* lzma_data */
+      case 6: /* lz4_data */
+      case 7: /* zstd_data */
+         buildmap_error (0, "unsupported PBF compression (%d)", field);
+         return READOSM_UNZIP_ERROR;
+      }
+   }
+
+   if (blob->raw == NULL && blob->zlib_data == NULL) {
+      return READOSM_INVALID_PBF_HEADER;
+   }
+
+   return 1;
+}
+
+
+static void pbf_inflate (PbfBlob *blob) {
+
+   uLongf size;
+
+   if (blob->raw != NULL) return; /* Stored without compression. */
+   if (blob->type == PBF_BLOB_OTHER) return;
+
+   blob->raw = malloc (blob->raw_size + 1);
+   buildmap_check_allocated(blob->raw);
+
+   size = blob->raw_size;
+   if (uncompress (blob->raw, &size,
+                   blob->zlib_data, blob->zlib_size) != Z_OK ||
+       size != (uLongf)blob->raw_size) {
+      blob->status = READOSM_UNZIP_ERROR;
+   }
+}
+
+
+/**
+ * @brief inflate the current batch's blobs until none is left
+ * @param pool the pool, locked on entry and on return
+ */
+static void pbf_inflate_share (PbfPool *pool) {
+
+   int i;
+
+   while (pool->next < pool->count) {
+
+      i = pool->next++;
+      pthread_mutex_unlock (&pool->lock);
+
+      pbf_inflate (&pool->blobs[i]);
+
+      pthread_mutex_lock (&pool->lock);
+      if (++pool->finished == pool->count) {
+         pthread_cond_signal (&pool->done);
+      }
+   }
+}
+
+
+static void *pbf_inflate_thread (void *data) {
+
+   PbfPool *pool = (PbfPool *)data;
+
+   pthread_mutex_lock (&pool->lock);
+   while (!pool->quit) {
+      pbf_inflate_share (pool);
+      if (!pool->quit) pthread_cond_wait (&pool->ready, &pool->lock);
+   }
+   pthread_mutex_unlock (&pool->lock);
+
+   return NULL;
+}
+
+
+/**
+ * @brief start the inflate threads
+ * @param pool the pool
+ * @param threads how many threads inflate, the main thread included
+ */
+static void pbf_inflate_start (PbfPool *pool, int threads) {
+
+   memset (pool, 0, sizeof(*pool));
+   pthread_mutex_init (&pool->lock, NULL);
+   pthread_cond_init (&pool->ready, NULL);
+   pthread_cond_init (&pool->done, NULL);
+
+   /* If some can't be started, the others do their share. */
+   for (pool->started = 0; pool->started < threads - 1; ++pool->started) {
+      if (pthread_create (&pool->thread[pool->started], NULL,
+                          pbf_inflate_thread, pool) != 0) {
+         break;
+      }
+   }
+}
+
+
+static void pbf_inflate_stop (PbfPool *pool) {
+
+   int i;
+
+   pthread_mutex_lock (&pool->lock);
+   pool->quit = 1;
+   pthread_cond_broadcast (&pool->ready);
+   pthread_mutex_unlock (&pool->lock);
+
+   for (i = 0; i < pool->started; ++i) {
+      pthread_join (pool->thread[i], NULL);
+   }
+
+   pthread_cond_destroy (&pool->done);
+   pthread_cond_destroy (&pool->ready);
+   pthread_mutex_destroy (&pool->lock);
+}
+
+
+/**
+ * @brief inflate a batch of blobs, using all threads
+ */
+static void pbf_inflate_batch (PbfPool *pool, PbfBlob *blobs, int count) {
+
+   if (count == 0) return;
+
+   pthread_mutex_lock (&pool->lock);
+
+   pool->blobs = blobs;
+   pool->count = count;
+   pool->next = 0;
+   pool->finished = 0;
+   pthread_cond_broadcast (&pool->ready);
+
+   /* The main thread does its share, too. */
+   pbf_inflate_share (pool);
+
+   while (pool->finished < pool->count) {
+      pthread_cond_wait (&pool->done, &pool->lock);
+   }
+
+   pthread_mutex_unlock (&pool->lock);
+}
+
+
+static void pbf_free_blob (PbfBlob *blob) {
+
+   free (blob->blob);
+   free (blob->raw);
+   blob->blob = NULL;
+   blob->raw = NULL;
+}
+
+
+/* Public interface ---------------------------------------------------- */
+
+/**
+ * @brief tell whether a file is in PBF format, going by its name
+ * @param filename the file name
+ * @return 1 if PBF
+ */
+int buildmap_osm_pbf_is_pbf (const char *filename) {
+
+   int length = strlen(filename);
+
+   return (length > 4 && strcmp (filename + length - 4, ".pbf") == 0);
+}
+
+
+/**
+ * @brief set the number of threads used to inflate the blocks
+ * @param count the number of threads, 0 for one per processor
+ */
+void buildmap_osm_pbf_set_threads (int count) {
+
+   PbfThreads = count;
+}
+
+
+/**
+ * @brief read a PBF file, and hand its elements to the callbacks
+ * @param fp the open file
+ * @param user_data passed to the callbacks
+ * @param node_fnct called for each node, may be NULL
+ * @param way_fnct called for each way, may be NULL
+ * @param relation_fnct called for each relation, may be NULL
+ * @return READOSM_OK, or a READOSM error code
+ */
+int buildmap_osm_pbf_parse (FILE *fp,
+                            const void *user_data,
+                            readosm_node_callback node_fnct,
+                            readosm_way_callback way_fnct,
+                            readosm_relation_callback relation_fnct) {
+
+   PbfContext context;
+   PbfPool pool;
+   PbfBlob *blobs;
+   int threads = PbfThreads;
+   int batch;
+   int count;
+   int ret = READOSM_OK;
+   int i;
+
+   if (threads <= 0) {
+      threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+   }
+   if (threads < 1) threads = 1;
+   if (threads > PBF_MAX_THREADS) threads = PBF_MAX_THREADS;
+
+   batch = threads * PBF_BATCH;
+   blobs = calloc (batch, sizeof(PbfBlob));
+   buildmap_check_allocated(blobs);
+
+   memset (&context, 0, sizeof(context));
+   context.user_data = user_data;
+   context.node_fnct = node_fnct;
+   context.way_fnct = way_fnct;
+   context.relation_fnct = relation_fnct;
+
+   pbf_inflate_start (&pool, threads);
+
+   do {
+
+      for (count = 0; count < batch; ++count) {
+         ret = pbf_read_blob (fp, &blobs[count]);
+         if (ret != 1) break;
+      }
+      if (ret == 1 || ret == 0) ret = READOSM_OK;
+
+      pbf_inflate_batch (&pool, blobs, count);
+
+      for (i = 0; i < count; ++i) {
+
+         if (ret == READOSM_OK) {
+            ret = blobs[i].status;
+         }
+         if (ret == READOSM_OK) {
+            switch (blobs[i].type) {
+            case PBF_BLOB_DATA:
+               ret = pbf_primitive_block
+                        (&context, blobs[i].raw, blobs[i].raw_size);
+               break;
+            case PBF_BLOB_HEADER:
+               ret = pbf_header_block (blobs[i].raw, blobs[i].raw_size);
+               break;
+            }
+         }
+         pbf_free_blob (&blobs[i]);
+      }
+
+   } while (count == batch && ret == READOSM_OK);
+
+   /* A failed read may have left a partial blob behind. */
+   if (count < batch) pbf_free_blob (&blobs[count]);
+
+   pbf_inflate_stop (&pool);
+
+   free (blobs);
+   free (context.strings);
+   free (context.string);
+   free (context.tags);
+   free (context.refs);
+   free (context.members);
+   for (i = 0; i < PBF_MAX_REPEATED; ++i) {
+      free (context.repeated[i].data);
+   }
+
+   return ret;
+}
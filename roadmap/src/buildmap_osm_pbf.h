@@ -0,0 +1,42 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief a module to read the OSM PBF (protocol buffer) format
+ *
+ * The elements are handed to the same callbacks as readosm_parse(),
+ * so that buildmap_osm_text.c can process either format.
+ */
+
+#ifndef INCLUDED__BUILDMAP_OSM_PBF__H
+#define INCLUDED__BUILDMAP_OSM_PBF__H
+
+int buildmap_osm_pbf_is_pbf (const char *filename);
+
+void buildmap_osm_pbf_set_threads (int count);
+
+int buildmap_osm_pbf_parse (FILE *fp,
+                            const void *user_data,
+                            readosm_node_callback node_fnct,
+                            readosm_way_callback way_fnct,
+                            readosm_relation_callback relation_fnct);
+
+#endif // INCLUDED__BUILDMAP_OSM_PBF__H
@@ -47,6 +47,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
+#include <math.h>
+#include <sys/mman.h>
 #include <readosm.h>
 
 #include "roadmap.h"
@@ -57,6 +59,14 @@
 #include "roadmap_osm.h"
 #include "roadmap_line.h"
 #include "roadmap_hash.h"
+#include "roadmap_dbread.h"
+#include "roadmap_dictionary.h"
+#include "roadmap_square.h"
+#include "roadmap_point.h"
+#include "roadmap_shape.h"
+#include "roadmap_street.h"
+#include "roadmap_polygon.h"
+#include "roadmap_place.h"
 
 #include "buildmap.h"
 #include "buildmap_square.h"
@@ -71,19 +81,18 @@
 
 #include "buildmap_layer.h"
 #include "buildmap_osm_text.h"
+#include "buildmap_osm_pbf.h"
 
 #include "buildmap_osm_layers.h"
 
 extern char *BuildMapResult;
+extern int BuildMapSinglePass;
 
-/* OSM has over 3G nodes already -- enough to overflow a 32 bit signed
- * integer.  nodeid_t should really be "long long".  i think that may have
- * repercussions for the roadmap_hash layer, though.
- *
- * NB: the way->id and node->id elements passed in from readosm
- * are already long longs.
+/* OSM has more nodes than fit in 32 bits, so all ids are kept as
+ * "long long", as readosm hands them to us.  the long tables of ids
+ * (the interesting nodes, the .cov files) are stored more compactly.
  */
-typedef unsigned osm_id_t;
+typedef long long osm_id_t;
 typedef osm_id_t nodeid_t;
 typedef osm_id_t wayid_t;
 typedef osm_id_t relid_t;
@@ -93,6 +102,7 @@ struct relinfo {
     int layer;
     int flags;
     char *name;
+    int found;  // member ways present in the file (single pass only)
 };
 typedef struct relinfo relinfo;
 
@@ -102,7 +112,7 @@ struct wayinfo {
     int layer;
     int flags;
     char *name;
-    unsigned relation_id;
+    relid_t relation_id;
     int relation_layer;
     int relation_flags;
     nodeid_t from;
@@ -122,6 +132,15 @@ int polygon_debug = 0;
 
 static int  CurrentTileID;
 
+/* set when the tile is cut out of a larger extract, rather than
+ * fetched for its own bounding box.
+ */
+static int  TileFilter;
+static RoadMapArea TileArea;
+
+/* set when building an overview tile: the zoom it will be drawn at */
+static int  OverviewZoom = 0;
+
 static int  PolygonId = 0;
 static int  LineId = 0;
 
@@ -180,46 +199,27 @@ qsort_compare_osm_ids(const void *id1, const void *id2)
  * @brief incoming lat/lon nodes are translated to roadmap points,
  *	and a hash is maintained
  */
-static int nPointsAlloc = 0;
 static int nPoints = 0;
-static struct points {
-        nodeid_t    id;
-        int         point;
-} *Points = 0;
 
-RoadMapHash	*PointsHash = NULL;
+RoadMapIntHash	*PointsHash = NULL;
+
+static int buildmap_osm_text_node_store_get(long long id, int *lon, int *lat);
 
 static void
 buildmap_osm_text_point_hash_reset(void)
 {
     nPoints = 0;
     PointsHash = 0;
-    if (Points) free(Points);
-    Points = 0;
-    nPointsAlloc = 0;
 }
 
 static void
 buildmap_osm_text_point_add(nodeid_t id, int point)
 {
-    if (nPoints == nPointsAlloc) {
-	if (Points)
-	    nPointsAlloc *= 2;
-	else
-	    nPointsAlloc = 10000;
-	if (PointsHash == NULL)
-		PointsHash = roadmap_hash_new("PointsHash", nPointsAlloc);
-	else
-		roadmap_hash_resize(PointsHash, nPointsAlloc);
-
-	Points = realloc(Points, sizeof(struct points) * nPointsAlloc);
-	buildmap_check_allocated(Points);
-    }
-
-    roadmap_hash_add(PointsHash, id, nPoints);
+    if (PointsHash == NULL)
+	PointsHash = roadmap_hash_int_new("PointsHash", 10000);
 
-    Points[nPoints].id = id;
-    Points[nPoints++].point = point;
+    roadmap_hash_int_set(PointsHash, id, point);
+    nPoints++;
 }
 
 /**
@@ -230,13 +230,20 @@ buildmap_osm_text_point_add(nodeid_t id, int point)
 static int
 buildmap_osm_text_point_get(nodeid_t id)
 {
-    int     i;
+    int     lon, lat, point;
+
+    if (PointsHash) {
+	point = roadmap_hash_int_get(PointsHash, id);
+	if (point >= 0)
+	    return point;
+    }
 
-    for (i = roadmap_hash_get_first(PointsHash, id);
-	    i >= 0;
-	    i = roadmap_hash_get_next(PointsHash, i))
-    if (Points[i].id == id)
-	    return Points[i].point;
+    /* in single pass mode, points are only created when first used */
+    if (buildmap_osm_text_node_store_get(id, &lon, &lat)) {
+	    point = buildmap_point_add(lon, lat);
+	    buildmap_osm_text_point_add(id, point);
+	    return point;
+    }
     return -1;
 }
 
@@ -374,10 +381,112 @@ isWayInteresting(wayid_t wayid)
 	return NULL;
 }
 
-static int maxNodeTable = 0;
+/* the interesting nodes are kept as their low 32 bits, in one table
+ * for each value of the high 32 bits.  only a handful of those exist.
+ */
+struct nodetable {
+    int high;
+    int count;
+    int max;
+    unsigned int *low;
+};
+
 static int nNodeTable = 0;
-static nodeid_t *NodeTable = NULL;
+static int nNodeTables = 0;
+static struct nodetable *NodeTables = NULL;
+
+
+/* the .cov files start with this, followed by a version number.
+ * files without it are the old format: 32 bit way ids, ~0, and 32 bit
+ * relation ids.  the second word of the magic is smaller than the first,
+ * which can't happen with the sorted ids of an old file.
+ * the way and relation lists may be followed by the list of nodes used
+ * by the tile's ways, which is only needed to apply change files.
+ */
+static const char CovMagic[8] = { 'R', 'M', 'C', 'O', 'V', 0, 2, 0 };
+#define COV_VERSION 2
+
+static void
+buildmap_osm_text_put_varint(FILE *fp, unsigned long long value)
+{
+    while (value >= 0x80) {
+	fputc((int)(value & 0x7f) | 0x80, fp);
+	value >>= 7;
+    }
+    fputc((int)value, fp);
+}
+
+static int
+buildmap_osm_text_get_varint(const unsigned char **p,
+			const unsigned char *end, unsigned long long *value)
+{
+    int shift = 0;
+
+    *value = 0;
+    while (*p < end && shift < 64) {
+	unsigned char c = *(*p)++;
+	*value |= (unsigned long long)(c & 0x7f) << shift;
+	if (!(c & 0x80)) return 1;
+	shift += 7;
+    }
+    return 0;
+}
 
+/**
+ * @brief write a sorted list of ids, each as the varint of the
+ *	difference with the previous one.
+ */
+static void
+buildmap_osm_text_put_ids(FILE *fp, osm_id_t *ids, int count)
+{
+    osm_id_t previous = 0;
+    int i, n = 0;
+
+    qsort(ids, count, sizeof(*ids), qsort_compare_osm_ids);
+
+    for (i = 0; i < count; i++)
+	if (i == 0 || ids[i] != ids[i-1])
+	    ids[n++] = ids[i];
+
+    buildmap_osm_text_put_varint(fp, n);
+    for (i = 0; i < n; i++) {
+	/* zigzag, in case the first id is negative */
+	long long delta = ids[i] - previous;
+	buildmap_osm_text_put_varint(fp,
+		((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63));
+	previous = ids[i];
+    }
+}
+
+static int
+buildmap_osm_text_get_ids(const unsigned char **p,
+			const unsigned char *end, osm_id_t **ids)
+{
+    unsigned long long count, value;
+    osm_id_t previous = 0;
+    unsigned long long i;
+
+    *ids = NULL;
+    if (!buildmap_osm_text_get_varint(p, end, &count) ||
+	    count > (unsigned long long)(end - *p))
+	return -1;
+    if (count == 0)
+	return 0;
+
+    *ids = malloc(count * sizeof(**ids));
+    buildmap_check_allocated(*ids);
+
+    for (i = 0; i < count; i++) {
+	if (!buildmap_osm_text_get_varint(p, end, &value)) {
+	    free(*ids);
+	    *ids = NULL;
+	    return -1;
+	}
+	previous += (long long)(value >> 1) ^ -(long long)(value & 1);
+	(*ids)[i] = previous;
+    }
+    return (int)count;
+}
 
 /*
  * @brief creates our .cov table, later used by our neighbors so they
@@ -389,9 +498,8 @@ buildmap_osm_text_save_wayids(const char *path, const char *outfile)
     char nfn[1024];
     char *p;
     FILE *fp = 0;
-    wayinfo *wp;
-    relinfo *rp;
-    relinfo delim;
+    osm_id_t *ids;
+    int i, n;
 
     strcpy(nfn, outfile);
     p = strrchr(nfn, '.');
@@ -401,32 +509,46 @@ buildmap_osm_text_save_wayids(const char *path, const char *outfile)
     fp = roadmap_file_fopen (path, nfn, "w");
     if (!fp) buildmap_fatal(0, "can't open %s/%s to write ways", path, nfn);
 
-    if (nWayTable) {
-	for (wp = WayTable; wp < &WayTable[nWayTable]; wp++) {
-	    if (wp->id) {
-		fwrite(wp, sizeof(wp->id), 1, fp);
-	    }
-	}
-    }
+    fwrite(CovMagic, sizeof(CovMagic), 1, fp);
 
-    delim.id = ~0;
-    fwrite(&delim, sizeof(rp->id), 1, fp);
+    ids = malloc(((nWayTable > nRelTable ? nWayTable : nRelTable) + 1)
+			* sizeof(*ids));
+    buildmap_check_allocated(ids);
 
-    if (nRelTable) {
-	for (rp = RelTable; rp < &RelTable[nRelTable]; rp++) {
-	    if (rp->id) {
-		fwrite(rp, sizeof(rp->id), 1, fp);
-	    }
-	}
+    for (i = n = 0; i < nWayTable; i++)
+	if (WayTable[i].id)
+	    ids[n++] = WayTable[i].id;
+    buildmap_osm_text_put_ids(fp, ids, n);
+
+    for (i = n = 0; i < nRelTable; i++)
+	if (RelTable[i].id)
+	    ids[n++] = RelTable[i].id;
+    buildmap_osm_text_put_ids(fp, ids, n);
+
+    free(ids);
+
+    for (i = n = 0; i < nNodeTables; i++)
+	n += NodeTables[i].count;
+
+    ids = malloc((n + 1) * sizeof(*ids));
+    buildmap_check_allocated(ids);
+
+    for (i = n = 0; i < nNodeTables; i++) {
+	int j;
+	for (j = 0; j < NodeTables[i].count; j++)
+	    ids[n++] = ((osm_id_t)NodeTables[i].high << 32) |
+			NodeTables[i].low[j];
     }
+    buildmap_osm_text_put_ids(fp, ids, n);
 
+    free(ids);
     fclose(fp);
 
 }
 
 
 /**
- * @brief  we mark a node as interesting by adding it to NodeTable.  this
+ * @brief  we mark a node as interesting by adding it to NodeTables.  this
  *	is later sorted, and we can use it later to quickly check if
  *	we thought it was interesting.
  * @param nodeid
@@ -434,36 +556,74 @@ buildmap_osm_text_save_wayids(const char *path, const char *outfile)
 static void
 saveInterestingNode(nodeid_t nodeid)
 {
+	int high = (int)(nodeid >> 32);
+	struct nodetable *t;
+	int i;
+
+	for (i = 0; i < nNodeTables; i++)
+	    if (NodeTables[i].high == high) break;
+
+	if (i == nNodeTables) {
+	    NodeTables = realloc(NodeTables, sizeof(*NodeTables) * (i + 1));
+	    buildmap_check_allocated(NodeTables);
+	    NodeTables[i].high = high;
+	    NodeTables[i].count = NodeTables[i].max = 0;
+	    NodeTables[i].low = NULL;
+	    nNodeTables++;
+	}
+	t = &NodeTables[i];
 
-	if (nNodeTable == maxNodeTable) {
-		if (NodeTable)
-		    maxNodeTable *= 2;
+	if (t->count == t->max) {
+		if (t->low)
+		    t->max *= 2;
 		else
-		    maxNodeTable = 1000;
-		NodeTable = (nodeid_t *) realloc(NodeTable,
-				sizeof(*NodeTable) * maxNodeTable);
-		buildmap_check_allocated(NodeTable);
+		    t->max = 1000;
+		t->low = realloc(t->low, sizeof(*t->low) * t->max);
+		buildmap_check_allocated(t->low);
 	}
 
-	NodeTable[nNodeTable] = nodeid;
+	t->low[t->count++] = (unsigned int)nodeid;
 	nNodeTable++;
 }
 
+static void
+buildmap_osm_text_sort_nodes(void)
+{
+	int i;
+
+	for (i = 0; i < nNodeTables; i++)
+	    qsort(NodeTables[i].low, NodeTables[i].count,
+		    sizeof(*NodeTables[i].low), qsort_compare_unsigneds);
+}
+
+static void
+buildmap_osm_text_reset_nodes(void)
+{
+	while (nNodeTables > 0)
+	    free(NodeTables[--nNodeTables].low);
+	free(NodeTables);
+	NodeTables = NULL;
+	nNodeTable = 0;
+}
+
 /**
- * @brief after NodeTable has been sorted, see if this node is interesting
+ * @brief after NodeTables have been sorted, see if this node is interesting
  * @param nodeid
  * @return whether we thought way was interesting when we found it
  */
 static int
 isNodeInteresting(nodeid_t nodeid)
 {
-	int *r;
-
-        r = bsearch(&nodeid, NodeTable, nNodeTable,
-                             sizeof(*NodeTable), qsort_compare_unsigneds);
-	if (!r) return 0;
-
-	return *r;
+	int high = (int)(nodeid >> 32);
+	unsigned int low = (unsigned int)nodeid;
+	int i;
+
+	for (i = 0; i < nNodeTables; i++) {
+	    if (NodeTables[i].high == high)
+		return bsearch(&low, NodeTables[i].low, NodeTables[i].count,
+			sizeof(low), qsort_compare_unsigneds) != NULL;
+	}
+	return 0;
 }
 
 
@@ -501,71 +661,133 @@ buildmap_osm_get_layer(int lookfor, const char *tag, const char *value,
 }
 
 
+/**
+ * @brief build overview tiles: keep only what is drawn at the given zoom,
+ *	and drop the shape points that would not show at that zoom.
+ * @param zoom the zoom the tiles will be drawn at, 0 for regular tiles
+ */
+void
+buildmap_osm_text_overview(int zoom)
+{
+    OverviewZoom = zoom;
+}
+
+/**
+ * @brief is this layer hidden at the zoom of the overview tile?
+ */
+static int
+buildmap_osm_text_overview_drops(int layer)
+{
+    return OverviewZoom && layer &&
+		buildmap_layer_declutter(layer) <= OverviewZoom;
+}
+
+
 /**
  * @brief neighbor_coverage keeps track of ways our neighbors are already 
  *	taking care of.
  */
 struct neighbor_coverage {
     int tileid;		    // these are the ways for this tileid
-    RoadMapFileContext fc;  // file context for the mmap
     int waycount;	    // how many ways
-    const wayid_t *wayids; // the way ids for that tileid.
+    wayid_t *wayids;	    // the way ids for that tileid.
     int relcount;	    // how many relations
-    const relid_t *relids; // the relations ids for that tileid.
+    relid_t *relids;	    // the relations ids for that tileid.
+    int nodecount;	    // how many nodes, only loaded on request
+    nodeid_t *nodeids;	    // the nodes of that tileid's ways.
 } Neighbor_Coverage[8];
 
 /*
- * @brief memory maps the way list for the give tileid, if it exists
+ * @brief reads the way list for the give tileid, if it exists
  */
-void
+static void
+buildmap_osm_text_unload_coverage(struct neighbor_coverage *coverage)
+{
+	free(coverage->wayids);
+	free(coverage->relids);
+	free(coverage->nodeids);
+	coverage->wayids = 0;
+	coverage->relids = 0;
+	coverage->nodeids = 0;
+	coverage->waycount = coverage->relcount = coverage->nodecount = 0;
+}
+
+static void
 buildmap_osm_text_load_neighbor_coverage(int neighbor,
-			struct neighbor_coverage *neighbor_coverage)
+			struct neighbor_coverage *neighbor_coverage,
+			int with_nodes)
 {
-	const wayid_t *covmap;
+	const unsigned char *covmap, *p, *end;
         RoadMapFileContext fc;
-	const wayid_t *idp;
 	int fs = 0;
 
-	covmap = (wayid_t *)roadmap_file_map(BuildMapResult,
+	neighbor_coverage->tileid = neighbor;
+	neighbor_coverage->waycount = 0;
+	neighbor_coverage->wayids = 0;
+	neighbor_coverage->relcount = 0;
+	neighbor_coverage->relids = 0;
+	neighbor_coverage->nodecount = 0;
+	neighbor_coverage->nodeids = 0;
+
+	covmap = (const unsigned char *)roadmap_file_map(BuildMapResult,
 		    roadmap_osm_filename(0, 1, neighbor, ".cov"), "r", &fc);
-	if (covmap)
-	    fs = roadmap_file_size(fc) / sizeof(wayid_t);
+	if (!covmap)
+	    return;
 
-	neighbor_coverage->tileid = neighbor;
+	fs = roadmap_file_size(fc);
+	end = covmap + fs;
+
+	if (fs >= (int)sizeof(CovMagic) &&
+		memcmp(covmap, CovMagic, sizeof(CovMagic)) == 0) {
+
+	    p = covmap + sizeof(CovMagic);
+	    neighbor_coverage->waycount =
+		buildmap_osm_text_get_ids(&p, end, &neighbor_coverage->wayids);
+	    if (neighbor_coverage->waycount >= 0)
+		neighbor_coverage->relcount = buildmap_osm_text_get_ids
+				(&p, end, &neighbor_coverage->relids);
+	    if (with_nodes && neighbor_coverage->relcount >= 0 && p < end)
+		neighbor_coverage->nodecount = buildmap_osm_text_get_ids
+				(&p, end, &neighbor_coverage->nodeids);
+
+	    if (neighbor_coverage->waycount < 0 ||
+		    neighbor_coverage->relcount < 0 ||
+		    neighbor_coverage->nodecount < 0) {
+		buildmap_error(0, "bad coverage file for tile 0x%x", neighbor);
+		buildmap_osm_text_unload_coverage(neighbor_coverage);
+	    }
 
-	if (!covmap || fs <= 1) {
-	    if (covmap) roadmap_file_unmap (&fc);
-	    neighbor_coverage->fc = fc;
-	    neighbor_coverage->waycount = 0;
-	    neighbor_coverage->relcount = 0;
-	    return;
-	}
+	} else {
 
-	idp = covmap;
-	while (*idp != (wayid_t)~0) {
-	    idp++;
-	    if ((idp - covmap) == fs) // didn't find delimiter
-		break;
-	}
+	    /* the old format, with 32 bit ids */
+	    const unsigned int *ids = (const unsigned int *)covmap;
+	    int count = fs / sizeof(*ids);
+	    int i, n;
 
-	neighbor_coverage->waycount = idp - covmap;
-	if (neighbor_coverage->waycount)
-	    neighbor_coverage->wayids = covmap;
-	else
-	    neighbor_coverage->wayids = 0;
+	    for (n = 0; n < count && ids[n] != ~0U; n++) ;
 
-	neighbor_coverage->relcount = fs - neighbor_coverage->waycount - 1;
-	if (neighbor_coverage->relcount > 0)
-	    neighbor_coverage->relids = (relid_t *)(idp + 1);
-	else
-	    neighbor_coverage->relids = 0;
-}
+	    if (n > 0) {
+		neighbor_coverage->wayids =
+			malloc(n * sizeof(*neighbor_coverage->wayids));
+		buildmap_check_allocated(neighbor_coverage->wayids);
+		for (i = 0; i < n; i++)
+		    neighbor_coverage->wayids[i] = ids[i];
+		neighbor_coverage->waycount = n;
+	    }
 
-void
-buildmap_osm_text_unload_neighbor_coverage(int i)
-{
-	roadmap_file_unmap (&Neighbor_Coverage[i].fc);
-	Neighbor_Coverage[i].waycount = Neighbor_Coverage[i].relcount = 0;
+	    ids += n + 1;
+	    count -= n + 1;
+	    if (count > 0) {
+		neighbor_coverage->relids =
+			malloc(count * sizeof(*neighbor_coverage->relids));
+		buildmap_check_allocated(neighbor_coverage->relids);
+		for (i = 0; i < count; i++)
+		    neighbor_coverage->relids[i] = ids[i];
+		neighbor_coverage->relcount = count;
+	    }
+	}
+
+	roadmap_file_unmap (&fc);
 }
 
 /*
@@ -589,7 +811,9 @@ buildmap_osm_text_neighbor_way_maps(int tileid)
 	    for (j = 0; j < 8; j++) {
 		if (Neighbor_Coverage[j].tileid == neighbor_tile) {
 		    new_neighbor_coverage[i] = Neighbor_Coverage[j];
-		    Neighbor_Coverage[i].waycount = Neighbor_Coverage[i].relcount = 0;
+		    Neighbor_Coverage[j].wayids = 0;
+		    Neighbor_Coverage[j].relids = 0;
+		    Neighbor_Coverage[j].nodeids = 0;
 		    break;
 		}
 	    }
@@ -597,14 +821,13 @@ buildmap_osm_text_neighbor_way_maps(int tileid)
 	    /* didn't find it -- fetch the neighbor's ways */
 	    if (j == 8) {
 		buildmap_osm_text_load_neighbor_coverage(neighbor_tile,
-				&new_neighbor_coverage[i]);
+				&new_neighbor_coverage[i], 0);
 	    }
 	}
 
 	/* release any old way lists we're not reusing */
 	for (i = 0; i < 8; i++)
-	    if (Neighbor_Coverage[i].waycount || Neighbor_Coverage[i].relcount )
-		buildmap_osm_text_unload_neighbor_coverage(i);
+	    buildmap_osm_text_unload_coverage(&Neighbor_Coverage[i]);
 
 	/* our new set of reused or freshly loaded way lists into place */
 	for (i = 0; i < 8; i++)
@@ -612,6 +835,51 @@ buildmap_osm_text_neighbor_way_maps(int tileid)
 
 }
 
+/**
+ * @brief tell whether a tile was built from any of the given osm ids
+ * @param tileid the tile, whose .cov file is read
+ * @param ids sorted node, way and relation ids
+ * @param counts how many ids of each kind
+ * @return 1 if any id is listed, 0 if none is, -1 if there is no .cov file
+ */
+int
+buildmap_osm_text_coverage_uses(int tileid, long long *ids[3], int counts[3])
+{
+	struct neighbor_coverage coverage;
+	osm_id_t *lists[3];
+	int lengths[3];
+	int found = 0;
+	int i, j;
+
+	if (!roadmap_file_exists(BuildMapResult,
+		    roadmap_osm_filename(0, 1, tileid, ".cov")))
+	    return -1;
+
+	buildmap_osm_text_load_neighbor_coverage(tileid, &coverage, 1);
+
+	lists[0] = coverage.nodeids;
+	lengths[0] = coverage.nodecount;
+	lists[1] = coverage.wayids;
+	lengths[1] = coverage.waycount;
+	lists[2] = coverage.relids;
+	lengths[2] = coverage.relcount;
+
+	for (i = 0; i < 3 && !found; i++) {
+	    if (!counts[i])
+		continue;
+	    for (j = 0; j < lengths[i]; j++) {
+		if (bsearch(&lists[i][j], ids[i], counts[i], sizeof(*ids[i]),
+			    qsort_compare_osm_ids)) {
+		    found = 1;
+		    break;
+		}
+	    }
+	}
+
+	buildmap_osm_text_unload_coverage(&coverage);
+	return found;
+}
+
 /*
  * @brief check to see if the given way exists in any of
  *        our neighbors.
@@ -672,6 +940,96 @@ static int nShapes = 0;
 static int nShapesAlloc = 0;
 static struct shapeinfo *shapes;
 
+/**
+ * @brief Douglas-Peucker simplification of a shape, for overview tiles:
+ *	drop the points closer than one pixel (at OverviewZoom) to the
+ *	line through the points kept around them.
+ * @param lons the longitudes, compacted in place
+ * @param lats the latitudes, compacted in place
+ * @param count the number of points, including both ends
+ * @return the number of points left
+ *
+ * roadmap_math_reduce_points() is not used: it is compiled out, its unit
+ * vector is truncated to an integer (so it only works along the axes),
+ * and it mallocs for every stack push.  This one works in doubles and
+ * reuses its buffers from one shape to the next.
+ */
+static int
+buildmap_osm_text_simplify(int *lons, int *lats, int count)
+{
+    static char *keep;
+    static int *stack;
+    static int max;
+    double scale, tolerance, dx, dy, length, distance, worst;
+    int first, last, farthest;
+    int depth, i, n;
+
+    if (count > max) {
+	max = count;
+	keep = realloc(keep, max);
+	stack = realloc(stack, 2 * max * sizeof(int));
+	buildmap_check_allocated(keep);
+	buildmap_check_allocated(stack);
+    }
+
+    /* a pixel covers OverviewZoom microdegrees of longitude, but
+     * fewer microdegrees of latitude: work in longitude units.
+     */
+    scale = 1.0 / cos(lats[0] * M_PI / 180000000.0);
+    tolerance = (double)OverviewZoom * OverviewZoom;
+
+    memset(keep, 0, count);
+    keep[0] = keep[count-1] = 1;
+
+    depth = 0;
+    stack[depth++] = 0;
+    stack[depth++] = count - 1;
+
+    while (depth > 0) {
+
+	last = stack[--depth];
+	first = stack[--depth];
+
+	dx = lons[last] - lons[first];
+	dy = (lats[last] - lats[first]) * scale;
+	length = dx * dx + dy * dy;
+
+	worst = 0;
+	farthest = -1;
+	for (i = first + 1; i < last; i++) {
+	    double px = lons[i] - lons[first];
+	    double py = (lats[i] - lats[first]) * scale;
+	    if (length == 0) {
+		distance = px * px + py * py;
+	    } else {
+		double cross = px * dy - py * dx;
+		distance = cross * cross / length;
+	    }
+	    if (distance > worst) {
+		worst = distance;
+		farthest = i;
+	    }
+	}
+
+	if (farthest >= 0 && worst > tolerance) {
+	    keep[farthest] = 1;
+	    stack[depth++] = first;
+	    stack[depth++] = farthest;
+	    stack[depth++] = farthest;
+	    stack[depth++] = last;
+	}
+    }
+
+    for (i = n = 0; i < count; i++) {
+	if (keep[i]) {
+	    lons[n] = lons[i];
+	    lats[n] = lats[i];
+	    n++;
+	}
+    }
+    return n;
+}
+
 /**
  * @brief a postprocessing step to load shape info
  *
@@ -686,6 +1044,7 @@ buildmap_osm_text_ways_shapeinfo(void)
     int i, j, count, lineid;  /* , need; */
     int *lons, *lats;  /* , *used; */
     int line_index;
+    int before = 0, after = 0;
 
     buildmap_info("loading shape info (from %d ways) ...", nShapes);
 
@@ -695,6 +1054,13 @@ buildmap_osm_text_ways_shapeinfo(void)
 
         count = shapes[i].count;
 
+        if (OverviewZoom && count > 2) {
+            before += count;
+            count = buildmap_osm_text_simplify
+                        (shapes[i].lons, shapes[i].lats, count);
+            after += count;
+        }
+
         if (count <= 2)
             continue;
 
@@ -714,6 +1080,11 @@ buildmap_osm_text_ways_shapeinfo(void)
         }
     }
 
+    if (OverviewZoom) {
+        buildmap_info("simplified the shapes from %d to %d points",
+                      before, after);
+    }
+
     return 1;
 }
 
@@ -842,45 +1213,28 @@ road_name(const char *name, const char *ref)
 }
 
 /**
- * @brief callback for initial way parsing, called via readosm_parse()
+ * @brief classify a way by its own tags.  this is the part of the way
+ *	processing that doesn't depend on the relations the way belongs to.
+ * @param way the way
+ * @param player in/out: the layer, left alone if already set
+ * @param pflags in/out: the layer flags
+ * @param pname returns the label (name and ref), possibly NULL
+ * @param popen returns whether the way is an area that isn't closed.
+ *	such a way is only an area if a relation says so.
  */
-static int
-parse_way(const void *user_data, const readosm_way *way)
+static void
+buildmap_osm_text_way_layer(const readosm_way *way, int *player, int *pflags,
+		const char **pname, int *popen)
 {
     const readosm_tag *tag;
     const char *tourism = NULL, *amenity = NULL;
     int adminlevel = 0;
     int is_building = 0, is_territorial = 0, is_coast = 0;  // booleans
-    int layer = 0, flags = 0;
-    int relation_layer = 0, relation_flags = 0;
+    int layer = *player, flags = *pflags;
     const char *name = 0, *ref = 0;
-    wayinfo *wp;
     int i;
 
-    nWays++;
-
-    /* if this way was referred to in a relation, fetch what we
-     * found then. */
-    wp = isWayInteresting(way->id);
-    if (wp) {
-	relation_layer = wp->relation_layer;
-	relation_flags = wp->relation_flags;
-	layer = wp->layer;
-	flags = wp->flags;
-    }
-
-    if (way->node_ref_count < 2) {
-	return READOSM_OK;
-    }
-
-    /* if we're processing a quadtile, don't include any
-     * ways that our neighbors already include */
-    if (CurrentTileID && buildmap_osm_text_check_neighbor_way(way->id) &&
-    		!relation_layer) {
-	buildmap_verbose("dropping way %lld because a neighbor "
-		    "already has it", way->id);
-	return READOSM_OK;
-    }
+    *popen = 0;
 
     for (i = 0; i < way->tag_count; i++) {
 	tag = way->tags + i;
@@ -958,19 +1312,66 @@ parse_way(const void *user_data, const readosm_way *way)
     if (!tourism && !amenity)
 	flags &= ~PLACE;
 
-    if ((flags & AREA) && !relation_layer) {
+    if (flags & AREA) {
 	// if it's supposed to be a polygon, but isn't, then it's not.
 	if (way->node_refs[0] != way->node_refs[way->node_ref_count-1])
-	    flags &= ~AREA;
+	    *popen = 1;
     }
 
 out:
+    *player = layer;
+    *pflags = flags;
+    *pname = road_name(name, ref);
+}
+
+/**
+ * @brief callback for initial way parsing, called via readosm_parse()
+ */
+static int
+parse_way(const void *user_data, const readosm_way *way)
+{
+    int layer = 0, flags = 0;
+    int relation_layer = 0, relation_flags = 0;
+    int open_area;
+    const char *n;
+    wayinfo *wp;
+    int i;
+
+    nWays++;
+
+    /* if this way was referred to in a relation, fetch what we
+     * found then. */
+    wp = isWayInteresting(way->id);
+    if (wp) {
+	relation_layer = wp->relation_layer;
+	relation_flags = wp->relation_flags;
+	layer = wp->layer;
+	flags = wp->flags;
+    }
+
+    if (way->node_ref_count < 2) {
+	return READOSM_OK;
+    }
+
+    /* if we're processing a quadtile, don't include any
+     * ways that our neighbors already include */
+    if (CurrentTileID && buildmap_osm_text_check_neighbor_way(way->id) &&
+    		!relation_layer) {
+	buildmap_verbose("dropping way %lld because a neighbor "
+		    "already has it", way->id);
+	return READOSM_OK;
+    }
+
+    buildmap_osm_text_way_layer(way, &layer, &flags, &n, &open_area);
+
+    if (open_area && !relation_layer)
+	flags &= ~AREA;
+
     if (layer || relation_layer) {
-	const char *n = road_name(name, ref);
 
 	if (wp) { // then we're part of a relation
 	    if (n)
-		wp->name = strdup(n);
+		wp->name = buildmap_arena_strdup(n);
 
 	    // we might have already set the way, e.g. we might have
 	    // set it to "island" if it's an inner polygon of a lake
@@ -986,7 +1387,8 @@ out:
 	    wp->from = way->node_refs[0];
 	    wp->to = way->node_refs[way->node_ref_count-1];
 	} else { // not in a relation
-	    saveInterestingWay( way->id, way, n ?  strdup(n) :  0,
+	    saveInterestingWay( way->id, way,
+			n ? buildmap_arena_strdup(n) : 0,
 	    		layer, flags, 0, 0, 0);
 	}
 
@@ -1005,6 +1407,36 @@ void adjust_polybox(RoadMapArea *pbox, int lat, int lon)
       if (lat > pbox->north) pbox->north = lat;
 }
 
+/**
+ * @brief keep the points of a line, for buildmap_osm_text_ways_shapeinfo()
+ * @param lonsbuf the longitudes, including both ends
+ * @param latsbuf the latitudes, including both ends
+ * @param count the number of points
+ */
+static void
+buildmap_osm_text_shape_add(int *lonsbuf, int *latsbuf, int count)
+{
+    if (nShapes == nShapesAlloc) {
+	    /* Allocate additional space (in big
+	     * chunks) when needed */
+	    if (shapes)
+		nShapesAlloc *= 2;
+	    else
+		nShapesAlloc = 1000;
+	    shapes = realloc(shapes,
+		nShapesAlloc * sizeof(struct shapeinfo));
+	    buildmap_check_allocated(shapes);
+    }
+
+    /* Keep info for the shapes */
+    shapes[nShapes].lons = lonsbuf;
+    shapes[nShapes].lats = latsbuf;
+    shapes[nShapes].count = count;
+    shapes[nShapes].lineid = LineId;
+
+    nShapes++;
+}
+
 static void
 add_line_shapes(const readosm_way *way, int from, int to, RoadMapArea *pbox)
 {
@@ -1034,27 +1466,9 @@ add_line_shapes(const readosm_way *way, int from, int to, RoadMapArea *pbox)
 	    buildmap_square_adjust_limits(lon, lat);
     }
 
-    if (nShapes == nShapesAlloc) {
-	    /* Allocate additional space (in big
-	     * chunks) when needed */
-	    if (shapes)
-		nShapesAlloc *= 2;
-	    else
-		nShapesAlloc = 1000;
-	    shapes = realloc(shapes,
-		nShapesAlloc * sizeof(struct shapeinfo));
-	    buildmap_check_allocated(shapes);
-    }
-
     buildmap_debug("lineid %d way->node_ref_count %d",
 	    LineId, way->node_ref_count);
-    /* Keep info for the shapes */
-    shapes[nShapes].lons = lonsbuf;
-    shapes[nShapes].lats = latsbuf;
-    shapes[nShapes].count = to - from + 1;
-    shapes[nShapes].lineid = LineId;
-
-    nShapes++;
+    buildmap_osm_text_shape_add(lonsbuf, latsbuf, to - from + 1);
 }
 
 static int
@@ -1204,7 +1618,7 @@ parse_way_final(const void *user_data, const readosm_way *way)
 	    PolygonId++;
 
 	    if (polygon_debug)
-		buildmap_info("adding %d (%s) as polygon %d", wp->id, wp->name, PolygonId);
+		buildmap_info("adding %lld (%s) as polygon %d", wp->id, wp->name, PolygonId);
 	    buildmap_polygon_add_landmark (PolygonId, wp->layer, rms_name);
 	    buildmap_polygon_add(PolygonId, 0, PolygonId, &polyarea);
 
@@ -1219,28 +1633,33 @@ parse_way_final(const void *user_data, const readosm_way *way)
     return READOSM_OK;
 }
 
+/**
+ * @brief decide whether a relation is interesting: we only keep
+ *	multipolygons which map to one of our area layers.
+ * @param relation the relation
+ * @param pflags returns the layer flags
+ * @param pname returns the relation's name, possibly NULL
+ * @return the layer, 0 if the relation is of no interest
+ */
 static int
-parse_relation(const void *user_data, const readosm_relation * relation)
+buildmap_osm_text_relation_layer(const readosm_relation *relation,
+		int *pflags, const char **pname)
 {
     const readosm_tag *tag;
-    const readosm_member *member;
-    wayinfo *wp;
     const char *name = 0;
     int is_multipolygon = 0;
     int layer = 0, flags = 0;
     int i;
 
-    nRels++;
-
     if (relation->member_count == 0)
-	return READOSM_OK;
+	return 0;
 
     /* if we're processing a quadtile, don't include any
      * relations that our neighbors already include */
     if (CurrentTileID && buildmap_osm_text_check_neighbor_relation(relation->id)) {
 	buildmap_verbose("dropping relation %lld because a neighbor "
 		    "already has it", relation->id);
-	return READOSM_OK;
+	return 0;
     }
 
 
@@ -1260,14 +1679,31 @@ parse_relation(const void *user_data, const readosm_relation * relation)
     }
 
 
-    if (flags & PLACE) {
-	flags = 0;
-	layer = 0;
-	return READOSM_OK;
-    }
+    if (flags & PLACE)
+	return 0;
+
+    if (!is_multipolygon)
+	return 0;
+
+    *pflags = flags;
+    *pname = name;
+    return layer;
+}
+
+static int
+parse_relation(const void *user_data, const readosm_relation * relation)
+{
+    const readosm_member *member;
+    wayinfo *wp;
+    const char *name = 0;
+    int layer, flags = 0;
+    int i;
+
+    nRels++;
 
+    layer = buildmap_osm_text_relation_layer(relation, &flags, &name);
 
-    if (is_multipolygon && layer) {
+    if (layer) {
 	for (i = 0; i < relation->member_count; i++)
 	{
 
@@ -1295,7 +1731,8 @@ parse_relation(const void *user_data, const readosm_relation * relation)
 		break;
 	    }
 	}
-	saveInterestingRelation(relation->id, name ?  strdup(name) : 0,
+	saveInterestingRelation(relation->id,
+			name ? buildmap_arena_strdup(name) : 0,
 			layer, flags);
     }
 
@@ -1312,8 +1749,7 @@ static void add_multipolygon(relid_t id, wayinfo **wayinfos, int layer,
     int i, j, k;
     RoadMapArea *polyarea;
 
-    twi = calloc(count, sizeof(*wayinfos));
-    buildmap_check_allocated(twi);
+    twi = buildmap_arena_calloc(count, sizeof(*wayinfos));
 
     for (i = 0; i < count; i++) {
 	wp = wayinfos[i];
@@ -1362,7 +1798,7 @@ static void add_multipolygon(relid_t id, wayinfo **wayinfos, int layer,
 	} else {
 	    PolygonId++;
 	    if (polygon_debug)
-		buildmap_info("add_multi: adding %d (%s) as polygon %d", wp->id, name, PolygonId);
+		buildmap_info("add_multi: adding %lld (%s) as polygon %d", wp->id, name, PolygonId);
 	    buildmap_polygon_add_landmark (PolygonId, layer, rms_name);
 	    buildmap_polygon_add(PolygonId, 0, PolygonId, &polyarea);
 	    for (j = 0; j < k; j++) {
@@ -1383,8 +1819,6 @@ static void add_multipolygon(relid_t id, wayinfo **wayinfos, int layer,
 	wp = wayinfos[i];
 	wp->ring = 0;
     }
-
-    free(twi);
 }
 
 static int
@@ -1407,10 +1841,10 @@ parse_relation_final(const void *user_data, const readosm_relation * relation)
 
     rms_name = str2dict(DictionaryStreet, rp->name);
 
-    wayinfos = calloc(relation->member_count, sizeof(*wayinfos));
-    buildmap_check_allocated(wayinfos);
-    innerwayinfos = calloc(relation->member_count, sizeof(*wayinfos));
-    buildmap_check_allocated(innerwayinfos);
+    wayinfos = buildmap_arena_calloc(relation->member_count,
+		    sizeof(*wayinfos));
+    innerwayinfos = buildmap_arena_calloc(relation->member_count,
+		    sizeof(*wayinfos));
 
     wc = iwc = 0;
     for (i = 0; i < relation->member_count; i++)
@@ -1454,180 +1888,1689 @@ parse_relation_final(const void *user_data, const readosm_relation * relation)
 
     add_multipolygon(relation->id, innerwayinfos, innerlayer, rms_name, iwc, rp->name);
 
-    free(wayinfos);
-    free(innerwayinfos);
     return READOSM_OK;
 }
 
-static int text_file_is_pipe;
-FILE *buildmap_osm_text_fopen(char *fn)
+/**
+ * @brief single pass import.
+ *
+ *	the three pass import re-parses the XML (and re-runs gzip) for
+ *	every pass, because relations come last in the file but decide
+ *	about the ways, which decide about the nodes.  instead, this
+ *	mode reads the file once and keeps what it will need later:
+ *	 - the coordinates of every node, in a memory-mapped dense array
+ *	   indexed by node id (a sparse temporary file, so only the
+ *	   pages covering the extract's ids use any disk),
+ *	 - every way, with its own classification and its node list, in
+ *	   a sequential temporary file,
+ *	 - the way members of the interesting relations.
+ *	the ways and relations are then resolved from sorted id tables,
+ *	and replayed through the same code as the final pass.
+ */
+
+#define NODE_STORE_LAT_BIAS 100000000	/* so that 0 means "no node" */
+#define NODE_STORE_CHUNK    (1 << 20)	/* nodes, i.e. 8 Mbytes */
+
+static int NodeStoreFd = -1;
+static int *NodeStore = NULL;		/* lon, lat + bias per node id */
+static long long NodeStoreCount = 0;
+
+static FILE *WayStore = NULL;
+
+struct waystore_rec {
+    long long id;
+    int layer;
+    int flags;
+    int node_count;
+    int name_length;	/* including the terminating null, 0 if none */
+    char dropped;	/* a neighbor tile already has this way */
+    char open_area;	/* an area only if a relation says so */
+    char unused[6];
+};
+
+struct relmember {
+    wayid_t wayid;
+    relid_t relid;
+    int seq;		/* relation order in the file */
+    int inner;
+};
+
+static int nRelMembers = 0;
+static int maxRelMembers = 0;
+static struct relmember *RelMembers = NULL;
+
+struct placenode {
+    long long id;
+    int layer;
+    char *name;
+};
+
+static int nPlaceNodes = 0;
+static int maxPlaceNodes = 0;
+static struct placenode *PlaceNodes = NULL;
+
+/**
+ * @brief create an anonymous temporary file next to the maps.
+ *	/tmp is often a memory filesystem, too small for the node store.
+ */
+static int
+buildmap_osm_text_tempfile(const char *prefix)
 {
-    FILE *fp;
-    int len;
+    char *template;
+    int fd;
 
-    len = strlen(fn);
-    errno = 0;
-    if (len > 3 && strcmp(&fn[len-3], ".gz") == 0) {
-	char command[1024];
-	sprintf(command, "gzip -d -c %s", fn);
-	fp = popen(command, "r");
-	text_file_is_pipe = 1;
-    } else {
-	fp = fopen(fn, "r");
-	text_file_is_pipe = 0;
-    }
+    template = malloc(strlen(BuildMapResult) + strlen(prefix) + 8);
+    buildmap_check_allocated(template);
+    sprintf(template, "%s/%sXXXXXX", BuildMapResult, prefix);
 
-    if (fp == NULL) {
-            buildmap_fatal(0, "couldn't open \"%s\", %s", fn, strerror(errno));
-            return NULL;
+    fd = mkstemp(template);
+    if (fd < 0)
+	buildmap_fatal(0, "can't create temporary file %s: %s",
+		template, strerror(errno));
+    unlink(template);
+
+    free(template);
+    return fd;
+}
+
+static void
+buildmap_osm_text_node_store_put(long long id, int lon, int lat)
+{
+    if (id < 0)
+	buildmap_fatal(0, "negative node id %lld", id);
+
+    if (id >= NodeStoreCount) {
+	long long count = NodeStoreCount * 2;
+
+	if (count <= id)
+	    count = id + 1;
+	count = (count + NODE_STORE_CHUNK - 1) & ~(long long)(NODE_STORE_CHUNK - 1);
+
+	if ((long long)(size_t)(count * 2 * sizeof(int)) !=
+			count * 2 * (long long)sizeof(int))
+	    buildmap_fatal(0, "node id %lld too large for the node store", id);
+
+	if (NodeStore)
+	    munmap(NodeStore, NodeStoreCount * 2 * sizeof(int));
+
+	if (ftruncate(NodeStoreFd, count * 2 * sizeof(int)) != 0)
+	    buildmap_fatal(0, "can't grow the node store: %s", strerror(errno));
+
+	NodeStore = mmap(NULL, count * 2 * sizeof(int),
+			PROT_READ|PROT_WRITE, MAP_SHARED, NodeStoreFd, 0);
+	if (NodeStore == MAP_FAILED)
+	    buildmap_fatal(0, "can't map the node store: %s", strerror(errno));
+
+	NodeStoreCount = count;
     }
 
-    return fp;
+    NodeStore[2*id] = lon;
+    NodeStore[2*id+1] = lat + NODE_STORE_LAT_BIAS;
 }
 
-int buildmap_osm_text_fclose(FILE *fp)
+static int
+buildmap_osm_text_node_store_get(long long id, int *lon, int *lat)
 {
-    if (text_file_is_pipe)
-	return pclose(fp);
-    else
-	return fclose(fp);
+    if (id < 0 || id >= NodeStoreCount || NodeStore[2*id+1] == 0)
+	return 0;
+
+    *lon = NodeStore[2*id];
+    *lat = NodeStore[2*id+1] - NODE_STORE_LAT_BIAS;
+    return 1;
 }
-/**
- * @brief rather than trying to put an entire file's contents in memory,
- *	we parse it in two passes.  this routine is called for each pass.
- */
-void buildmap_readosm_pass(int pass, char *fn)
+
+static int
+buildmap_osm_text_in_tile(int lon, int lat)
 {
-    int ret;
-    const void *handle;
-    void *user_data = 0;
-    FILE *fp;
+    return lon >= TileArea.west && lon < TileArea.east &&
+	    lat >= TileArea.south && lat < TileArea.north;
+}
 
-    buildmap_info("Starting pass %d", pass);
+/* set once the extract store, below, holds the node store */
+static int ExtractLoaded = 0;
 
-    fp = buildmap_osm_text_fopen(fn);
-    ret = readosm_fopen(fp, READOSM_OSM_FORMAT, &handle);
-    if (ret != READOSM_OK) {
-	buildmap_fatal(0, "buildmap_osm_text: couldn't open \"%s\", %s",
-		fn, readosm_errors[-ret]);
-	return;
+static void
+buildmap_osm_text_single_pass_reset(void)
+{
+    /* the extract's node store is kept for its other tiles */
+    if (!ExtractLoaded) {
+	if (NodeStore) munmap(NodeStore, NodeStoreCount * 2 * sizeof(int));
+	NodeStore = NULL;
+	NodeStoreCount = 0;
+	if (NodeStoreFd >= 0) close(NodeStoreFd);
+	NodeStoreFd = -1;
     }
 
-    switch (pass) {
-    case 1: ret = readosm_parse(handle, user_data,
-    		NULL, NULL, parse_relation);
-	    break;
-    case 2: ret = readosm_parse(handle, user_data,
-    		NULL, parse_way, NULL);
-	    break;
-    case 3: ret = readosm_parse(handle, user_data,
-    		parse_node_final, parse_way_final, parse_relation_final);
-	    break;
+    if (WayStore) fclose(WayStore);
+    WayStore = NULL;
+
+    nRelMembers = 0;
+    nPlaceNodes = 0;
+}
+
+/**
+ * @brief read the next way back from the way store
+ * @param rec the way's header
+ * @param name buffer for the way's name, grown as needed
+ * @param refs buffer for the way's nodes, grown as needed
+ * @return 0 at the end of the store
+ */
+static int
+buildmap_osm_text_way_store_next(struct waystore_rec *rec,
+		char **name, int *name_max, long long **refs, int *refs_max)
+{
+    if (fread(rec, sizeof(*rec), 1, WayStore) != 1)
+	return 0;
+
+    if (rec->name_length > *name_max) {
+	*name_max = rec->name_length;
+	*name = realloc(*name, *name_max);
+	buildmap_check_allocated(*name);
     }
-    if (ret != READOSM_OK) {
-	buildmap_fatal(0, "buildmap_osm_text pass %d: %s",
-		pass, readosm_errors[-ret]);
-	return;
+    if (rec->node_count > *refs_max) {
+	*refs_max = rec->node_count;
+	*refs = realloc(*refs, *refs_max * sizeof(**refs));
+	buildmap_check_allocated(*refs);
     }
 
-    ret = readosm_close(handle);
-    if (ret != READOSM_OK) {
-	buildmap_fatal(0, "buildmap_osm_text pass %d: %s",
-		pass, readosm_errors[-ret]);
-	return;
+    if ((rec->name_length &&
+	    fread(*name, rec->name_length, 1, WayStore) != 1) ||
+	fread(*refs, sizeof(**refs), rec->node_count, WayStore) !=
+	    (size_t)rec->node_count) {
+	buildmap_fatal(0, "way store is truncated");
     }
-    if (buildmap_osm_text_fclose(fp)) {
-	buildmap_fatal(0, "buildmap_osm_text pass %d: %s",
-		pass, strerror(errno));
-	return;
+    return 1;
+}
+
+/**
+ * @brief the layer of a place node, 0 if the node is not a place
+ * @param pname returns the place's name, or NULL
+ */
+static int
+buildmap_osm_text_place_layer(const readosm_node *node, const char **pname)
+{
+    const readosm_tag *tag;
+    int layer = 0, flags = 0;
+    int i;
+
+    *pname = NULL;
+
+    for (i = 0; i < node->tag_count; i++)
+    {
+	tag = node->tags + i;
+	if (strcasecmp(tag->key, "name") == 0) {
+	    *pname = tag->value;
+        } else {
+	    buildmap_osm_get_layer(PLACE, tag->key, tag->value,
+			    &flags, &layer);
+	}
     }
+
+    return layer;
 }
 
+static void
+buildmap_osm_text_place_add(nodeid_t id, int layer, const char *name)
+{
+    if (nPlaceNodes == maxPlaceNodes) {
+	if (PlaceNodes)
+	    maxPlaceNodes *= 2;
+	else
+	    maxPlaceNodes = 1000;
+	PlaceNodes = realloc(PlaceNodes,
+			sizeof(*PlaceNodes) * maxPlaceNodes);
+	buildmap_check_allocated(PlaceNodes);
+    }
+    PlaceNodes[nPlaceNodes].id = id;
+    PlaceNodes[nPlaceNodes].layer = layer;
+    PlaceNodes[nPlaceNodes].name = name ? buildmap_arena_strdup(name) : 0;
+    nPlaceNodes++;
+}
 
 /**
- * @brief This is the gut of buildmap_osm_text : parse an OSM XML file
- * @param fdata an open file pointer, this will get read twice
- * @param country_num the country id that we're working for
- * @param division_num the country subdivision id that we're working for
- *
- * currently this only handles tiles.  the country and division parameters
- *  are ignored.
- *
+ * @brief single pass node callback: keep the position, and the place
  */
-void 
-buildmap_osm_text_read(char *fn, int tileid,
-			int country_num, int division_num)
+static int
+parse_node_store(const void *user_data, const readosm_node * node)
 {
+    const char *name;
+    int layer;
 
-    if (tileid)
-	buildmap_osm_text_neighbor_way_maps(tileid);
+    nNodes++;
 
-    CurrentTileID = tileid;
+    buildmap_osm_text_node_store_put(node->id,
+		osmfloat_to_rdmint(node->longitude),
+		osmfloat_to_rdmint(node->latitude));
 
-    buildmap_osm_text_point_hash_reset();
+    layer = buildmap_osm_text_place_layer(node, &name);
+    if (layer)
+	buildmap_osm_text_place_add(node->id, layer, name);
 
-    DictionaryPrefix = buildmap_dictionary_open("prefix");
-    DictionaryStreet = buildmap_dictionary_open("street");
-    DictionaryType = buildmap_dictionary_open("type");
-    DictionarySuffix = buildmap_dictionary_open("suffix");
-    DictionaryCity = buildmap_dictionary_open("city");
+    return READOSM_OK;
+}
 
-    buildmap_osm_common_find_layers ();
-    l_shoreline = buildmap_layer_get("shore");;
-    l_boundary = buildmap_layer_get("boundaries");;
-    l_lake = buildmap_layer_get("lakes");;
-    l_river = buildmap_layer_get("rivers");;
-    l_island = buildmap_layer_get("islands");;
+/**
+ * @brief classify a way by its own tags, for the way store
+ * @param rec the way's header, filled in
+ * @return the way's name, or NULL
+ */
+static const char *
+buildmap_osm_text_way_store_rec(const readosm_way *way,
+		struct waystore_rec *rec)
+{
+    const char *n;
+    int open_area;
 
-    nRels = 0;
-    nWays = 0;
-    nNodes = 0;
-    nShapes = 0;
-    nWayTable = 0;
-    nSearchableWays = 0;
-    nNodeTable = 0;
-    PolygonId = 0;
-    LineId = 0;
+    memset(rec, 0, sizeof(*rec));
+    rec->id = way->id;
+    rec->node_count = way->node_ref_count;
 
-    /* pass 1:
-     *  record entire interesting relations, including layer and name, and
-     *  record the ways and nodes they refer to.
-     */
-    buildmap_readosm_pass(1, fn);
+    buildmap_osm_text_way_layer(way, &rec->layer, &rec->flags, &n, &open_area);
+    rec->open_area = open_area;
+    rec->name_length = n ? strlen(n) + 1 : 0;
 
-    qsort(RelTable, nRelTable, sizeof(*RelTable), qsort_compare_osm_ids);
-    qsort(WayTable, nWayTable, sizeof(*WayTable), qsort_compare_osm_ids);
-    nSearchableWays = nWayTable;
+    return n;
+}
 
-    /* pass 2:
-     *  record interesting ways, including layer and and name.  if there's
-     * FIXME:  how is naming done?  bbox of entire relation?  assigned
-     * to biggest member?  at what point do i have all the information
-     * present to calculate this?
-     */
-    buildmap_readosm_pass(2, fn);
+static void
+buildmap_osm_text_way_store_write(FILE *store, const struct waystore_rec *rec,
+		const char *name, const void *refs)
+{
+    if (fwrite(rec, sizeof(*rec), 1, store) != 1 ||
+	(rec->name_length &&
+	    fwrite(name, rec->name_length, 1, store) != 1) ||
+	fwrite(refs, sizeof(long long), rec->node_count, store) !=
+		(size_t)rec->node_count) {
+	buildmap_fatal(0, "can't write the way store: %s", strerror(errno));
+    }
+}
 
-    /* we've added to the WayTable, so need to sort again, and bump
-     * the number of searchable ways.
-     */
-    qsort(WayTable, nWayTable, sizeof(*WayTable), qsort_compare_osm_ids);
-    nSearchableWays = nWayTable;
+/**
+ * @brief single pass way callback: classify the way by its own tags,
+ *	and save it for later, since relations may still claim it.
+ */
+static int
+parse_way_store(const void *user_data, const readosm_way *way)
+{
+    struct waystore_rec rec;
+    const char *n;
 
-    qsort(NodeTable, nNodeTable, sizeof(*NodeTable), qsort_compare_unsigneds);
+    nWays++;
 
-    /* pass 3:
-     *  save interesting nodes, either previously recorded,
-     *      or which are interesting by themselves.
-     *  save recorded ways
-     *  save recorded relations.  assign relation's layer and/or name to
-     *      some or all of the related ways.
-     */
-    buildmap_readosm_pass(3, fn);
+    if (way->node_ref_count < 2)
+	return READOSM_OK;
 
-    buildmap_osm_text_ways_shapeinfo();
+    n = buildmap_osm_text_way_store_rec(way, &rec);
+    rec.dropped = CurrentTileID &&
+		buildmap_osm_text_check_neighbor_way(way->id);
 
-    buildmap_info("Relations %d", nRels);
-    buildmap_info("Ways %d, interesting %d", nWays, nWayTable);
-    buildmap_info("Number of nodes : %d, interesting %d", nNodes, nNodeTable);
-    buildmap_info("Number of points: %d", nPoints);
+    buildmap_osm_text_way_store_write(WayStore, &rec, n, way->node_refs);
+
+    return READOSM_OK;
+}
+
+/**
+ * @brief single pass relation callback: ways come before relations in
+ *	OSM files, so all we can do here is record the members.
+ */
+static int
+parse_relation_store(const void *user_data, const readosm_relation * relation)
+{
+    const readosm_member *member;
+    const char *name = 0;
+    int layer, flags = 0;
+    int i;
+
+    nRels++;
+
+    layer = buildmap_osm_text_relation_layer(relation, &flags, &name);
+    if (!layer)
+	return READOSM_OK;
+
+    for (i = 0; i < relation->member_count; i++) {
+
+	member = relation->members + i;
+	if (member->member_type != READOSM_MEMBER_WAY)
+	    continue;
+
+	if (nRelMembers == maxRelMembers) {
+	    if (RelMembers)
+		maxRelMembers *= 2;
+	    else
+		maxRelMembers = 1000;
+	    RelMembers = realloc(RelMembers,
+			    sizeof(*RelMembers) * maxRelMembers);
+	    buildmap_check_allocated(RelMembers);
+	}
+	RelMembers[nRelMembers].wayid = member->id;
+	RelMembers[nRelMembers].relid = relation->id;
+	RelMembers[nRelMembers].seq = nRelTable;
+	RelMembers[nRelMembers].inner =
+		member->role && strcmp(member->role, "inner") == 0;
+	nRelMembers++;
+    }
+
+    saveInterestingRelation(relation->id,
+			name ? buildmap_arena_strdup(name) : 0,
+			layer, flags);
+
+    return READOSM_OK;
+}
+
+static int
+qsort_compare_relmembers(const void *m1, const void *m2)
+{
+    const struct relmember *r1 = m1, *r2 = m2;
+
+    if (r1->wayid != r2->wayid)
+	return r1->wayid < r2->wayid ? -1 : 1;
+    return r1->seq - r2->seq;
+}
+
+/**
+ * @brief find the first relation (in file order) a way belongs to
+ * @param byway the members, sorted by way id then relation order
+ * @param count the number of members
+ */
+static struct relmember *
+buildmap_osm_text_first_relation(struct relmember *byway, int count,
+		wayid_t wayid)
+{
+    int low = 0, high = count;
+
+    while (low < high) {
+	int mid = (low + high) / 2;
+	if (byway[mid].wayid < wayid)
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    if (low < count && byway[low].wayid == wayid)
+	return &byway[low];
+    return NULL;
+}
+
+/**
+ * @brief resolve the ways and relations read in the single pass, and
+ *	replay them through the final pass callbacks.
+ */
+static void
+buildmap_osm_text_single_pass_resolve(void)
+{
+    struct waystore_rec rec;
+    struct relmember *byway, *m;
+    relinfo *rp;
+    wayinfo *wp;
+    readosm_member *members;
+    char *name = NULL;
+    int name_max = 0;
+    long long *refs = NULL;
+    int refs_max = 0;
+    int relation_layer, relation_flags;
+    int layer, flags;
+    int i, j, k;
+
+    /* which relation claims each way: the first one in the file. */
+    byway = malloc((nRelMembers + 1) * sizeof(*byway));
+    buildmap_check_allocated(byway);
+    memcpy(byway, RelMembers, nRelMembers * sizeof(*byway));
+    qsort(byway, nRelMembers, sizeof(*byway), qsort_compare_relmembers);
+
+    /* decide about the ways, now that the relations are known.  RelTable
+     * is still in file order, i.e. indexed by the relation sequence.
+     */
+    rewind(WayStore);
+    while (buildmap_osm_text_way_store_next
+		(&rec, &name, &name_max, &refs, &refs_max)) {
+
+	m = buildmap_osm_text_first_relation(byway, nRelMembers, rec.id);
+	rp = m ? &RelTable[m->seq] : NULL;
+
+	for (i = 0; m && m + i < byway + nRelMembers &&
+			m[i].wayid == m->wayid; i++)
+	    RelTable[m[i].seq].found++;
+	relation_layer = rp ? rp->layer : 0;
+	relation_flags = rp ? rp->flags : 0;
+
+	if (rec.dropped && !relation_layer) {
+	    buildmap_verbose("dropping way %lld because a neighbor "
+		    "already has it", rec.id);
+	    continue;
+	}
+
+	layer = rec.layer;
+	flags = rec.flags;
+	if (rec.open_area && !relation_layer)
+	    flags &= ~AREA;
+
+	if (!layer && !relation_layer)
+	    continue;
+
+	if (!layer) {
+	    layer = relation_layer;
+	    flags = relation_flags;
+	}
+	saveInterestingWay(rec.id, 0,
+		rec.name_length ? buildmap_arena_strdup(name) : 0,
+		layer, flags, relation_layer, relation_flags,
+		rp ? rp->id : 0);
+
+	wp = &WayTable[nWayTable-1];
+	wp->from = refs[0];
+	wp->to = refs[rec.node_count-1];
+
+	for (i = 0; i < rec.node_count; i++)
+	    saveInterestingNode(refs[i]);
+    }
+
+    qsort(WayTable, nWayTable, sizeof(*WayTable), qsort_compare_osm_ids);
+    nSearchableWays = nWayTable;
+
+    /* a relation none of whose ways are in this tile belongs to
+     * someone else.
+     */
+    if (TileFilter) {
+	for (rp = RelTable; rp < &RelTable[nRelTable]; rp++) {
+	    if (!rp->found)
+		rp->id = 0;
+	}
+    }
+
+    /* relation members missing from the file (or too short) can't be
+     * drawn, but the relation must still find them.
+     */
+    k = nWayTable;
+    for (i = 0; i < nRelMembers; i++) {
+	m = &byway[i];
+	if (i > 0 && byway[i-1].wayid == m->wayid)
+	    continue;
+	if (isWayInteresting(m->wayid))
+	    continue;
+	rp = &RelTable[m->seq];
+	if (!rp->id)
+	    continue;
+	saveInterestingWay(m->wayid, 0, 0, 0, 0,
+		rp->layer, rp->flags, rp->id);
+	WayTable[nWayTable-1].lineid = -1;
+    }
+    if (nWayTable != k) {
+	qsort(WayTable, nWayTable, sizeof(*WayTable), qsort_compare_osm_ids);
+	nSearchableWays = nWayTable;
+    }
+
+    qsort(RelTable, nRelTable, sizeof(*RelTable), qsort_compare_osm_ids);
+    free(byway);
+
+    /* final pass, in the same order as the XML: nodes first ... */
+    for (i = 0; i < nPlaceNodes; i++) {
+	int point = buildmap_osm_text_point_get(PlaceNodes[i].id);
+	if (point < 0)
+	    continue;
+	buildmap_place_add(str2dict(DictionaryCity, PlaceNodes[i].name),
+		PlaceNodes[i].layer, point);
+    }
+
+    /* ... then the ways ... */
+    rewind(WayStore);
+    while (buildmap_osm_text_way_store_next
+		(&rec, &name, &name_max, &refs, &refs_max)) {
+
+	readosm_way way = {
+	    .id = rec.id,
+	    .node_ref_count = rec.node_count,
+	    .node_refs = refs
+	};
+
+	if (isWayInteresting(rec.id))
+	    parse_way_final(NULL, &way);
+    }
+
+    /* ... and the relations. */
+    members = malloc((nRelMembers + 1) * sizeof(*members));
+    buildmap_check_allocated(members);
+
+    for (i = 0; i < nRelMembers; i = j) {
+
+	for (j = i; j < nRelMembers && RelMembers[j].seq == RelMembers[i].seq;
+			j++) {
+	    readosm_member member = {
+		.member_type = READOSM_MEMBER_WAY,
+		.id = RelMembers[j].wayid,
+		.role = RelMembers[j].inner ? "inner" : "outer"
+	    };
+	    memcpy(&members[j - i], &member, sizeof(member));
+	}
+
+	{
+	    readosm_relation relation = {
+		.id = RelMembers[i].relid,
+		.member_count = j - i,
+		.members = members
+	    };
+	    parse_relation_final(NULL, &relation);
+	}
+    }
+
+    free(members);
+    free(name);
+    free(refs);
+}
+
+static int text_file_is_pipe;
+FILE *buildmap_osm_text_fopen(char *fn)
+{
+    FILE *fp;
+    int len;
+
+    len = strlen(fn);
+    errno = 0;
+    if (len > 3 && strcmp(&fn[len-3], ".gz") == 0) {
+	char command[1024];
+	sprintf(command, "gzip -d -c %s", fn);
+	fp = popen(command, "r");
+	text_file_is_pipe = 1;
+    } else {
+	fp = fopen(fn, "r");
+	text_file_is_pipe = 0;
+    }
+
+    if (fp == NULL) {
+            buildmap_fatal(0, "couldn't open \"%s\", %s", fn, strerror(errno));
+            return NULL;
+    }
+
+    return fp;
+}
+
+int buildmap_osm_text_fclose(FILE *fp)
+{
+    if (text_file_is_pipe)
+	return pclose(fp);
+    else
+	return fclose(fp);
+}
+/**
+ * @brief parse an OSM file, XML (possibly compressed) or PBF, with
+ *	the given callbacks.
+ * @param what names the pass, for error messages
+ */
+static void
+buildmap_osm_text_parse(char *fn, const char *what,
+		readosm_node_callback node_fnct,
+		readosm_way_callback way_fnct,
+		readosm_relation_callback relation_fnct)
+{
+    int ret;
+    const void *handle;
+    void *user_data = 0;
+    FILE *fp;
+
+    fp = buildmap_osm_text_fopen(fn);
+
+    if (buildmap_osm_pbf_is_pbf(fn)) {
+	ret = buildmap_osm_pbf_parse(fp, user_data,
+			node_fnct, way_fnct, relation_fnct);
+	if (ret != READOSM_OK) {
+	    buildmap_fatal(0, "buildmap_osm_text %s: %s",
+		    what, readosm_errors[-ret]);
+	    return;
+	}
+    } else {
+	ret = readosm_fopen(fp, READOSM_OSM_FORMAT, &handle);
+	if (ret != READOSM_OK) {
+	    buildmap_fatal(0, "buildmap_osm_text: couldn't open \"%s\", %s",
+		    fn, readosm_errors[-ret]);
+	    return;
+	}
+
+	ret = readosm_parse(handle, user_data,
+			node_fnct, way_fnct, relation_fnct);
+	if (ret != READOSM_OK) {
+	    buildmap_fatal(0, "buildmap_osm_text %s: %s",
+		    what, readosm_errors[-ret]);
+	    return;
+	}
+
+	ret = readosm_close(handle);
+	if (ret != READOSM_OK) {
+	    buildmap_fatal(0, "buildmap_osm_text %s: %s",
+		    what, readosm_errors[-ret]);
+	    return;
+	}
+    }
+
+    if (buildmap_osm_text_fclose(fp)) {
+	buildmap_fatal(0, "buildmap_osm_text %s: %s",
+		what, strerror(errno));
+	return;
+    }
+}
+
+/**
+ * @brief rather than trying to put an entire file's contents in memory,
+ *	we parse it in two passes.  this routine is called for each pass.
+ */
+void buildmap_readosm_pass(int pass, char *fn)
+{
+    char what[16];
+
+    buildmap_info("Starting pass %d", pass);
+
+    sprintf(what, "pass %d", pass);
+
+    switch (pass) {
+    case 1: buildmap_osm_text_parse(fn, what,
+    		NULL, NULL, parse_relation);
+	    break;
+    case 2: buildmap_osm_text_parse(fn, what,
+    		NULL, parse_way, NULL);
+	    break;
+    case 3: buildmap_osm_text_parse(fn, what,
+    		parse_node_final, parse_way_final, parse_relation_final);
+	    break;
+    }
+}
+
+
+/**
+ * @brief read the file once, see the single pass import above
+ * @param fn the file name
+ */
+static void
+buildmap_osm_text_single_pass(char *fn)
+{
+    buildmap_info("Starting single pass");
+
+    NodeStoreFd = buildmap_osm_text_tempfile("nodes");
+    WayStore = fdopen(buildmap_osm_text_tempfile("ways"), "w+");
+    if (WayStore == NULL)
+	buildmap_fatal(0, "can't open the way store: %s", strerror(errno));
+
+    buildmap_osm_text_parse(fn, "single pass",
+		parse_node_store, parse_way_store, parse_relation_store);
+
+    buildmap_info("Resolving ways and relations");
+    buildmap_osm_text_single_pass_resolve();
+
+    buildmap_osm_text_ways_shapeinfo();
+
+    buildmap_info("Relations %d, interesting %d", nRels, nRelTable);
+    buildmap_info("Ways %d, interesting %d", nWays, nWayTable);
+    buildmap_info("Number of nodes : %d", nNodes);
+    buildmap_info("Number of points: %d", nPoints);
+
+    buildmap_osm_text_single_pass_reset();
+}
+
+static void
+buildmap_osm_text_find_layers(void)
+{
+    buildmap_osm_common_find_layers ();
+    l_shoreline = buildmap_layer_get("shore");
+    l_boundary = buildmap_layer_get("boundaries");
+    l_lake = buildmap_layer_get("lakes");
+    l_river = buildmap_layer_get("rivers");
+    l_island = buildmap_layer_get("islands");
+}
+
+/**
+ * @brief the extract store.
+ *
+ *	a PBF extract usually covers many tiles.  rather than reading it
+ *	again for each of them, it is read once, in the single pass
+ *	mode's format, and kept for the whole run:
+ *	 - the node store, which is a shared mapping: the tiles built in
+ *	   forked processes use the parent's copy,
+ *	 - every way, in a way store which is then mapped in memory,
+ *	 - the interesting relations and their way members,
+ *	 - the place nodes.
+ *	while reading, the ways and places are put in a bucket for each
+ *	tile they fall in, so that a tile only replays its own ways into
+ *	the single pass code.  a tile split during the run uses its
+ *	parent's bucket.
+ */
+
+struct extractbucket {
+    int tileid;
+    int nways, maxways;
+    long long *ways;	/* offsets in the way store, in file order */
+    int nplaces, maxplaces;
+    int *places;	/* indexes in ExtractPlaces */
+};
+
+/* the bucket a node went in, for each tile size in the list */
+struct extractgrid {
+    int bits;
+    int tileid;
+    RoadMapArea area;
+};
+
+static char *ExtractName = NULL;
+
+static int nExtractBuckets = 0;
+static struct extractbucket *ExtractBuckets = NULL;	/* by tileid */
+static int nExtractGrids = 0;
+static struct extractgrid ExtractGrids[TILE_MAXBITS - TILE_MINBITS + 1];
+
+static const char *ExtractWays = NULL;
+static long long ExtractWaysSize = 0;
+
+static int nExtractRels = 0;
+static int maxExtractRels = 0;
+static relinfo *ExtractRels = NULL;	/* in file order, names malloc'ed */
+static int *ExtractRelFirst = NULL;	/* first member of each relation */
+
+static int nExtractMembers = 0;
+static int maxExtractMembers = 0;
+static struct relmember *ExtractMembers = NULL;	/* seq: ExtractRels index */
+static struct relmember *ExtractByWay = NULL;
+
+static int nExtractPlaces = 0;
+static int maxExtractPlaces = 0;
+static struct placenode *ExtractPlaces = NULL;	/* names malloc'ed */
+
+static int nExtractNodes, nExtractWays, nExtractRelations;
+
+static int
+qsort_compare_buckets(const void *b1, const void *b2)
+{
+    const struct extractbucket *e1 = b1, *e2 = b2;
+
+    if (e1->tileid != e2->tileid)
+	return e1->tileid < e2->tileid ? -1 : 1;
+    return 0;
+}
+
+static struct extractbucket *
+buildmap_osm_text_extract_find(int tileid)
+{
+    struct extractbucket key;
+
+    key.tileid = tileid;
+    return bsearch(&key, ExtractBuckets, nExtractBuckets,
+		sizeof(*ExtractBuckets), qsort_compare_buckets);
+}
+
+/**
+ * @brief the bucket of a tile, or of the tile it was split from
+ * @return NULL if the tile was not in the list
+ */
+static struct extractbucket *
+buildmap_osm_text_extract_bucket(int tileid)
+{
+    struct extractbucket *bucket;
+    int bits = tileid2bits(tileid);
+
+    for (;;) {
+	bucket = buildmap_osm_text_extract_find(tileid);
+	if (bucket || bits < TILE_MINBITS + 2)
+	    return bucket;
+	bits -= 2;
+	tileid = mktileid(tileid2trutile(tileid) >> 2, bits);
+    }
+}
+
+/**
+ * @brief the tile of the given size a position falls in.
+ *	roadmap_osm_latlon2tileid() rounds differently from the tiles'
+ *	bounding boxes on their edges, and the bounding box is what
+ *	buildmap_osm_text_in_tile() goes by.
+ */
+static int
+buildmap_osm_text_extract_tile(struct extractgrid *grid, int lon, int lat)
+{
+    RoadMapArea *area = &grid->area;
+    int dir;
+
+    if (grid->tileid &&
+	    lon >= area->west && lon < area->east &&
+	    lat >= area->south && lat < area->north)
+	return grid->tileid;
+
+    grid->tileid = roadmap_osm_latlon2tileid(lat, lon, grid->bits);
+    roadmap_osm_tileid_to_bbox(grid->tileid, area);
+
+    if (lat < area->south)
+	dir = (lon < area->west) ? TILE_SOUTHWEST :
+		(lon >= area->east) ? TILE_SOUTHEAST : TILE_SOUTH;
+    else if (lat >= area->north)
+	dir = (lon < area->west) ? TILE_NORTHWEST :
+		(lon >= area->east) ? TILE_NORTHEAST : TILE_NORTH;
+    else
+	dir = (lon < area->west) ? TILE_WEST :
+		(lon >= area->east) ? TILE_EAST : -1;
+
+    if (dir >= 0) {
+	int neighbor = roadmap_osm_tileid_to_neighbor(grid->tileid, dir);
+	if (neighbor > 0) {
+	    grid->tileid = neighbor;
+	    roadmap_osm_tileid_to_bbox(grid->tileid, area);
+	}
+    }
+    return grid->tileid;
+}
+
+static void
+buildmap_osm_text_extract_add_way(int tileid, long long offset)
+{
+    struct extractbucket *bucket = buildmap_osm_text_extract_find(tileid);
+
+    if (bucket == NULL)
+	return;
+    if (bucket->nways && bucket->ways[bucket->nways-1] == offset)
+	return;
+
+    if (bucket->nways == bucket->maxways) {
+	bucket->maxways = bucket->maxways ? bucket->maxways * 2 : 1000;
+	bucket->ways = realloc(bucket->ways,
+			sizeof(*bucket->ways) * bucket->maxways);
+	buildmap_check_allocated(bucket->ways);
+    }
+    bucket->ways[bucket->nways++] = offset;
+}
+
+static void
+buildmap_osm_text_extract_add_place(int tileid, int place)
+{
+    struct extractbucket *bucket = buildmap_osm_text_extract_find(tileid);
+
+    if (bucket == NULL)
+	return;
+
+    if (bucket->nplaces == bucket->maxplaces) {
+	bucket->maxplaces = bucket->maxplaces ? bucket->maxplaces * 2 : 100;
+	bucket->places = realloc(bucket->places,
+			sizeof(*bucket->places) * bucket->maxplaces);
+	buildmap_check_allocated(bucket->places);
+    }
+    bucket->places[bucket->nplaces++] = place;
+}
+
+/**
+ * @brief extract node callback: keep the position, and the place
+ */
+static int
+parse_node_extract(const void *user_data, const readosm_node * node)
+{
+    struct placenode *pn;
+    const char *name;
+    int lon = osmfloat_to_rdmint(node->longitude);
+    int lat = osmfloat_to_rdmint(node->latitude);
+    int layer;
+    int i;
+
+    nExtractNodes++;
+
+    buildmap_osm_text_node_store_put(node->id, lon, lat);
+
+    layer = buildmap_osm_text_place_layer(node, &name);
+    if (!layer)
+	return READOSM_OK;
+
+    if (nExtractPlaces == maxExtractPlaces) {
+	maxExtractPlaces = maxExtractPlaces ? maxExtractPlaces * 2 : 1000;
+	ExtractPlaces = realloc(ExtractPlaces,
+			sizeof(*ExtractPlaces) * maxExtractPlaces);
+	buildmap_check_allocated(ExtractPlaces);
+    }
+    pn = &ExtractPlaces[nExtractPlaces];
+    pn->id = node->id;
+    pn->layer = layer;
+    pn->name = NULL;
+    if (name) {
+	pn->name = strdup(name);
+	buildmap_check_allocated(pn->name);
+    }
+
+    for (i = 0; i < nExtractGrids; i++) {
+	buildmap_osm_text_extract_add_place
+	    (buildmap_osm_text_extract_tile(&ExtractGrids[i], lon, lat),
+	     nExtractPlaces);
+    }
+    nExtractPlaces++;
+
+    return READOSM_OK;
+}
+
+/**
+ * @brief extract way callback: store the way, and put it in the
+ *	bucket of every tile one of its nodes falls in.
+ */
+static int
+parse_way_extract(const void *user_data, const readosm_way *way)
+{
+    struct waystore_rec rec;
+    const char *n;
+    int lon, lat;
+    int i, j;
+
+    nExtractWays++;
+
+    if (way->node_ref_count < 2)
+	return READOSM_OK;
+
+    for (i = 0; i < way->node_ref_count; i++) {
+	if (!buildmap_osm_text_node_store_get(way->node_refs[i], &lon, &lat))
+	    continue;
+	for (j = 0; j < nExtractGrids; j++) {
+	    buildmap_osm_text_extract_add_way
+		(buildmap_osm_text_extract_tile(&ExtractGrids[j], lon, lat),
+		 ExtractWaysSize);
+	}
+    }
+
+    n = buildmap_osm_text_way_store_rec(way, &rec);
+    buildmap_osm_text_way_store_write(WayStore, &rec, n, way->node_refs);
+
+    ExtractWaysSize += sizeof(rec) + rec.name_length +
+			rec.node_count * sizeof(long long);
+
+    return READOSM_OK;
+}
+
+/**
+ * @brief extract relation callback: keep the interesting relations,
+ *	and their way members.
+ */
+static int
+parse_relation_extract(const void *user_data,
+			const readosm_relation * relation)
+{
+    const readosm_member *member;
+    const char *name = 0;
+    relinfo *rp;
+    int layer, flags = 0;
+    int i;
+
+    nExtractRelations++;
+
+    layer = buildmap_osm_text_relation_layer(relation, &flags, &name);
+    if (!layer)
+	return READOSM_OK;
+
+    for (i = 0; i < relation->member_count; i++) {
+
+	member = relation->members + i;
+	if (member->member_type != READOSM_MEMBER_WAY)
+	    continue;
+
+	if (nExtractMembers == maxExtractMembers) {
+	    maxExtractMembers = maxExtractMembers ? maxExtractMembers * 2 : 1000;
+	    ExtractMembers = realloc(ExtractMembers,
+			    sizeof(*ExtractMembers) * maxExtractMembers);
+	    buildmap_check_allocated(ExtractMembers);
+	}
+	ExtractMembers[nExtractMembers].wayid = member->id;
+	ExtractMembers[nExtractMembers].relid = relation->id;
+	ExtractMembers[nExtractMembers].seq = nExtractRels;
+	ExtractMembers[nExtractMembers].inner =
+		member->role && strcmp(member->role, "inner") == 0;
+	nExtractMembers++;
+    }
+
+    if (nExtractRels == maxExtractRels) {
+	maxExtractRels = maxExtractRels ? maxExtractRels * 2 : 1000;
+	ExtractRels = realloc(ExtractRels,
+			sizeof(*ExtractRels) * maxExtractRels);
+	buildmap_check_allocated(ExtractRels);
+    }
+    rp = &ExtractRels[nExtractRels++];
+    memset(rp, 0, sizeof(*rp));
+    rp->id = relation->id;
+    rp->layer = layer;
+    rp->flags = flags;
+    if (name) {
+	rp->name = strdup(name);
+	buildmap_check_allocated(rp->name);
+    }
+
+    return READOSM_OK;
+}
+
+static void
+buildmap_osm_text_extract_free(void)
+{
+    int i;
+
+    if (ExtractWays)
+	munmap((void *)ExtractWays, ExtractWaysSize);
+    ExtractWays = NULL;
+    ExtractWaysSize = 0;
+
+    if (NodeStore) munmap(NodeStore, NodeStoreCount * 2 * sizeof(int));
+    NodeStore = NULL;
+    NodeStoreCount = 0;
+    if (NodeStoreFd >= 0) close(NodeStoreFd);
+    NodeStoreFd = -1;
+
+    for (i = 0; i < nExtractBuckets; i++) {
+	free(ExtractBuckets[i].ways);
+	free(ExtractBuckets[i].places);
+    }
+    free(ExtractBuckets);
+    ExtractBuckets = NULL;
+    nExtractBuckets = 0;
+    nExtractGrids = 0;
+
+    for (i = 0; i < nExtractRels; i++)
+	free(ExtractRels[i].name);
+    nExtractRels = 0;
+    free(ExtractRelFirst);
+    ExtractRelFirst = NULL;
+    nExtractMembers = 0;
+    free(ExtractByWay);
+    ExtractByWay = NULL;
+
+    for (i = 0; i < nExtractPlaces; i++)
+	free(ExtractPlaces[i].name);
+    nExtractPlaces = 0;
+
+    free(ExtractName);
+    ExtractName = NULL;
+    ExtractLoaded = 0;
+}
+
+/**
+ * @brief declare the PBF extract the tiles will be cut out of.
+ *	it is only read when the first tile needs it, or when
+ *	buildmap_osm_text_extract_load() is called.
+ * @param fn the extract
+ * @param tiles the tiles which will be built from it
+ * @param count
+ */
+void
+buildmap_osm_text_extract(const char *fn, const int *tiles, int count)
+{
+    int i, j;
+
+    buildmap_osm_text_extract_free();
+
+    ExtractName = strdup(fn);
+    buildmap_check_allocated(ExtractName);
+
+    ExtractBuckets = calloc(count + 1, sizeof(*ExtractBuckets));
+    buildmap_check_allocated(ExtractBuckets);
+
+    for (i = 0; i < count; i++) {
+
+	ExtractBuckets[nExtractBuckets++].tileid = tiles[i];
+
+	for (j = 0; j < nExtractGrids; j++) {
+	    if (ExtractGrids[j].bits == tileid2bits(tiles[i]))
+		break;
+	}
+	if (j == nExtractGrids) {
+	    memset(&ExtractGrids[j], 0, sizeof(ExtractGrids[j]));
+	    ExtractGrids[j].bits = tileid2bits(tiles[i]);
+	    nExtractGrids++;
+	}
+    }
+    qsort(ExtractBuckets, nExtractBuckets, sizeof(*ExtractBuckets),
+		qsort_compare_buckets);
+}
+
+/**
+ * @brief read the extract declared with buildmap_osm_text_extract(),
+ *	unless this was already done.  this is called before forking
+ *	the processes that build the tiles, so that they share it.
+ */
+void
+buildmap_osm_text_extract_load(void)
+{
+    int i, r;
+    int tileid = CurrentTileID;
+
+    if (ExtractName == NULL || ExtractLoaded)
+	return;
+
+    buildmap_info("Reading %s once for %d tiles",
+		ExtractName, nExtractBuckets);
+
+    buildmap_osm_text_find_layers();
+
+    /* the neighbors' coverage is decided tile by tile */
+    CurrentTileID = 0;
+
+    nExtractNodes = nExtractWays = nExtractRelations = 0;
+
+    NodeStoreFd = buildmap_osm_text_tempfile("nodes");
+    WayStore = fdopen(buildmap_osm_text_tempfile("ways"), "w+");
+    if (WayStore == NULL)
+	buildmap_fatal(0, "can't open the way store: %s", strerror(errno));
+
+    buildmap_osm_text_parse(ExtractName, "extract",
+		parse_node_extract, parse_way_extract, parse_relation_extract);
+
+    if (fflush(WayStore) != 0)
+	buildmap_fatal(0, "can't write the way store: %s", strerror(errno));
+
+    if (ExtractWaysSize > 0) {
+	if ((long long)(size_t)ExtractWaysSize != ExtractWaysSize)
+	    buildmap_fatal(0, "the way store is too large to map");
+	ExtractWays = mmap(NULL, ExtractWaysSize, PROT_READ, MAP_SHARED,
+			fileno(WayStore), 0);
+	if (ExtractWays == MAP_FAILED)
+	    buildmap_fatal(0, "can't map the way store: %s", strerror(errno));
+    }
+    fclose(WayStore);
+    WayStore = NULL;
+
+    /* where each relation's members start, and who claims each way */
+    ExtractRelFirst = malloc((nExtractRels + 1) * sizeof(*ExtractRelFirst));
+    buildmap_check_allocated(ExtractRelFirst);
+    for (i = 0, r = 0; r <= nExtractRels; r++) {
+	while (i < nExtractMembers && ExtractMembers[i].seq < r)
+	    i++;
+	ExtractRelFirst[r] = i;
+    }
+
+    ExtractByWay = malloc((nExtractMembers + 1) * sizeof(*ExtractByWay));
+    buildmap_check_allocated(ExtractByWay);
+    memcpy(ExtractByWay, ExtractMembers,
+		nExtractMembers * sizeof(*ExtractByWay));
+    qsort(ExtractByWay, nExtractMembers, sizeof(*ExtractByWay),
+		qsort_compare_relmembers);
+
+    buildmap_info("Extract: %d nodes, %d ways, %d relations, %lld Kbytes "
+		"of ways", nExtractNodes, nExtractWays, nExtractRelations,
+		ExtractWaysSize / 1024);
+
+    ExtractLoaded = 1;
+    CurrentTileID = tileid;
+}
+
+/**
+ * @brief read a way back from the extract's way store
+ * @return the offset of the next way
+ */
+static long long
+buildmap_osm_text_extract_way(long long offset, struct waystore_rec *rec,
+		const char **name, const char **refs)
+{
+    const char *p = ExtractWays + offset;
+
+    memcpy(rec, p, sizeof(*rec));
+    *name = p + sizeof(*rec);
+    *refs = *name + rec->name_length;
+
+    return offset + sizeof(*rec) + rec->name_length +
+		rec->node_count * sizeof(long long);
+}
+
+/**
+ * @brief cut the current tile out of the extract: fill the single pass
+ *	stores with what lies in the tile, then resolve them as usual.
+ */
+static void
+buildmap_osm_text_extract_tile_read(int tileid)
+{
+    struct extractbucket *bucket = buildmap_osm_text_extract_bucket(tileid);
+    struct waystore_rec rec;
+    struct relmember *m;
+    struct placenode *pn;
+    const char *name, *refs;
+    long long offset, next, ref;
+    char *claimed;
+    relinfo *rp;
+    int lon, lat;
+    int count;
+    int i, j;
+
+    buildmap_info("Cutting tile 0x%x out of %s", tileid, ExtractName);
+
+    WayStore = fdopen(buildmap_osm_text_tempfile("ways"), "w+");
+    if (WayStore == NULL)
+	buildmap_fatal(0, "can't open the way store: %s", strerror(errno));
+
+    claimed = calloc(nExtractRels + 1, 1);
+    buildmap_check_allocated(claimed);
+
+    /* the ways with at least one node in the tile, like a bounding
+     * box query.  without a bucket, look at all of them.
+     */
+    count = bucket ? bucket->nways : -1;
+    for (i = 0, offset = 0;
+	    bucket ? i < count : offset < ExtractWaysSize;
+	    i++, offset = next) {
+
+	if (bucket)
+	    offset = bucket->ways[i];
+	next = buildmap_osm_text_extract_way(offset, &rec, &name, &refs);
+
+	for (j = 0; j < rec.node_count; j++) {
+	    memcpy(&ref, refs + j * sizeof(ref), sizeof(ref));
+	    if (buildmap_osm_text_node_store_get(ref, &lon, &lat)
+		    && buildmap_osm_text_in_tile(lon, lat))
+		break;
+	}
+	if (j == rec.node_count)
+	    continue;
+
+	rec.dropped = buildmap_osm_text_check_neighbor_way(rec.id);
+	buildmap_osm_text_way_store_write(WayStore, &rec, name, refs);
+
+	m = buildmap_osm_text_first_relation
+		(ExtractByWay, nExtractMembers, rec.id);
+	for (j = 0; m && m + j < ExtractByWay + nExtractMembers &&
+			m[j].wayid == rec.id; j++)
+	    claimed[m[j].seq] = 1;
+    }
+
+    /* the relations with a member in the tile, in file order */
+    for (i = 0; i < nExtractRels; i++) {
+
+	if (!claimed[i])
+	    continue;
+
+	rp = &ExtractRels[i];
+	if (buildmap_osm_text_check_neighbor_relation(rp->id)) {
+	    buildmap_verbose("dropping relation %lld because a neighbor "
+			"already has it", rp->id);
+	    continue;
+	}
+
+	for (j = ExtractRelFirst[i]; j < ExtractRelFirst[i+1]; j++) {
+	    if (nRelMembers == maxRelMembers) {
+		maxRelMembers = maxRelMembers ? maxRelMembers * 2 : 1000;
+		RelMembers = realloc(RelMembers,
+				sizeof(*RelMembers) * maxRelMembers);
+		buildmap_check_allocated(RelMembers);
+	    }
+	    RelMembers[nRelMembers] = ExtractMembers[j];
+	    RelMembers[nRelMembers].seq = nRelTable;
+	    nRelMembers++;
+	}
+
+	saveInterestingRelation(rp->id,
+			rp->name ? buildmap_arena_strdup(rp->name) : 0,
+			rp->layer, rp->flags);
+    }
+    free(claimed);
+
+    /* the places in the tile */
+    count = bucket ? bucket->nplaces : nExtractPlaces;
+    for (i = 0; i < count; i++) {
+	pn = &ExtractPlaces[bucket ? bucket->places[i] : i];
+	if (buildmap_osm_text_node_store_get(pn->id, &lon, &lat)
+		&& buildmap_osm_text_in_tile(lon, lat))
+	    buildmap_osm_text_place_add(pn->id, pn->layer, pn->name);
+    }
+
+    nNodes = nExtractNodes;
+    nWays = nExtractWays;
+    nRels = nExtractRelations;
+
+    buildmap_info("Resolving ways and relations");
+    buildmap_osm_text_single_pass_resolve();
+
+    buildmap_osm_text_ways_shapeinfo();
+
+    buildmap_info("Relations %d, interesting %d", nRels, nRelTable);
+    buildmap_info("Ways %d, interesting %d", nWays, nWayTable);
+    buildmap_info("Number of nodes : %d", nNodes);
+    buildmap_info("Number of points: %d", nPoints);
+
+    buildmap_osm_text_single_pass_reset();
+}
+
+/**
+ * @brief This is the gut of buildmap_osm_text : parse an OSM XML file
+ * @param fdata an open file pointer, this will get read twice
+ * @param country_num the country id that we're working for
+ * @param division_num the country subdivision id that we're working for
+ *
+ * currently this only handles tiles.  the country and division parameters
+ *  are ignored.
+ *
+ */
+void 
+buildmap_osm_text_read(char *fn, int tileid,
+			int country_num, int division_num)
+{
+
+    if (tileid)
+	buildmap_osm_text_neighbor_way_maps(tileid);
+
+    CurrentTileID = tileid;
+
+    buildmap_osm_text_point_hash_reset();
+
+    DictionaryPrefix = buildmap_dictionary_open("prefix");
+    DictionaryStreet = buildmap_dictionary_open("street");
+    DictionaryType = buildmap_dictionary_open("type");
+    DictionarySuffix = buildmap_dictionary_open("suffix");
+    DictionaryCity = buildmap_dictionary_open("city");
+
+    buildmap_osm_text_find_layers();
+
+    nRels = 0;
+    nWays = 0;
+    nNodes = 0;
+    nShapes = 0;
+    nRelTable = 0;
+    nWayTable = 0;
+    nSearchableWays = 0;
+    buildmap_osm_text_reset_nodes();
+    PolygonId = 0;
+    LineId = 0;
+
+    /* a tile can be cut out of a PBF extract, which requires
+     * all the node positions: only the single pass mode has them.
+     */
+    TileFilter = tileid && buildmap_osm_pbf_is_pbf(fn);
+    if (TileFilter) {
+	roadmap_osm_tileid_to_bbox(tileid, &TileArea);
+
+	/* the extract is read once for all the tiles in it */
+	if (ExtractName == NULL || strcmp(ExtractName, fn) != 0)
+	    buildmap_osm_text_extract(fn, &tileid, 1);
+	buildmap_osm_text_extract_load();
+
+	buildmap_osm_text_extract_tile_read(tileid);
+	return;
+    }
+
+    if (BuildMapSinglePass) {
+	buildmap_osm_text_single_pass(fn);
+	return;
+    }
+
+    /* pass 1:
+     *  record entire interesting relations, including layer and name, and
+     *  record the ways and nodes they refer to.
+     */
+    buildmap_readosm_pass(1, fn);
+
+    qsort(RelTable, nRelTable, sizeof(*RelTable), qsort_compare_osm_ids);
+    qsort(WayTable, nWayTable, sizeof(*WayTable), qsort_compare_osm_ids);
+    nSearchableWays = nWayTable;
+
+    /* pass 2:
+     *  record interesting ways, including layer and and name.  if there's
+     * FIXME:  how is naming done?  bbox of entire relation?  assigned
+     * to biggest member?  at what point do i have all the information
+     * present to calculate this?
+     */
+    buildmap_readosm_pass(2, fn);
+
+    /* we've added to the WayTable, so need to sort again, and bump
+     * the number of searchable ways.
+     */
+    qsort(WayTable, nWayTable, sizeof(*WayTable), qsort_compare_osm_ids);
+    nSearchableWays = nWayTable;
+
+    buildmap_osm_text_sort_nodes();
+
+    /* pass 3:
+     *  save interesting nodes, either previously recorded,
+     *      or which are interesting by themselves.
+     *  save recorded ways
+     *  save recorded relations.  assign relation's layer and/or name to
+     *      some or all of the related ways.
+     */
+    buildmap_readosm_pass(3, fn);
+
+    buildmap_osm_text_ways_shapeinfo();
+
+    buildmap_info("Relations %d", nRels);
+    buildmap_info("Ways %d, interesting %d", nWays, nWayTable);
+    buildmap_info("Number of nodes : %d, interesting %d", nNodes, nNodeTable);
+    buildmap_info("Number of points: %d", nPoints);
+}
+
+
+/* the sections of the finer tiles an overview tile is built from */
+static roadmap_db_model *OverviewModel = NULL;
+
+/**
+ * @brief copy a line of a finer tile, with its name and shape
+ * @param line the line in the finer tile
+ * @param layer its layer
+ * @param first_shape_line the shapes of the line's square
+ * @param last_shape_line
+ * @return the line's LineId in the overview tile
+ */
+static int
+buildmap_osm_text_overview_line(int line, int layer,
+			int first_shape_line, int last_shape_line)
+{
+    RoadMapStreetProperties properties;
+    RoadMapPosition from, to, position;
+    RoadMapString rms_name;
+    int from_point, to_point, first_shape, last_shape;
+    int *lonsbuf, *latsbuf;
+    int count, i, j;
+
+    roadmap_line_from(line, &from);
+    roadmap_line_to(line, &to);
+
+    count = 2;
+    if (first_shape_line >= 0 &&
+	    roadmap_shape_of_line(line, first_shape_line, last_shape_line,
+				  &first_shape, &last_shape) > 0)
+	count += last_shape - first_shape + 1;
+    else
+	first_shape = last_shape = -1;
+
+    /* freed with the other shapes, at exit */
+    lonsbuf = calloc(count, sizeof(int));
+    latsbuf = calloc(count, sizeof(int));
+    buildmap_check_allocated(lonsbuf);
+    buildmap_check_allocated(latsbuf);
+
+    /* the shape points are relative to the previous one */
+    position = from;
+    lonsbuf[0] = from.longitude;
+    latsbuf[0] = from.latitude;
+    for (i = 1, j = first_shape; j >= 0 && j <= last_shape; i++, j++) {
+	roadmap_shape_get_position(j, &position);
+	lonsbuf[i] = position.longitude;
+	latsbuf[i] = position.latitude;
+    }
+    lonsbuf[count-1] = to.longitude;
+    latsbuf[count-1] = to.latitude;
+
+    for (i = 0; i < count; i++)
+	buildmap_square_adjust_limits(lonsbuf[i], latsbuf[i]);
+
+    from_point = buildmap_point_add(from.longitude, from.latitude);
+    to_point = buildmap_point_add(to.longitude, to.latitude);
+
+    roadmap_street_get_properties(line, &properties);
+    rms_name = str2dict(DictionaryStreet,
+			roadmap_street_get_street_fename(&properties));
+
+    LineId++;
+    line = buildmap_line_add(LineId,
+	    layer, from_point, to_point, ROADMAP_LINE_DIRECTION_BOTH);
+    buildmap_range_add_no_address(line,
+	    buildmap_street_add(layer,
+		str2dict(DictionaryPrefix, ""), rms_name,
+		str2dict(DictionaryType, ""), str2dict(DictionarySuffix, ""),
+		line));
+
+    buildmap_osm_text_shape_add(lonsbuf, latsbuf, count);
+
+    return LineId;
+}
+
+/**
+ * @brief copy what is still drawn at the overview's zoom from a finer tile
+ * @param path the maps directory
+ * @param name the finer tile's .rdm file
+ */
+static void
+buildmap_osm_text_overview_tile(const char *path, const char *name)
+{
+    RoadMapPosition position;
+    RoadMapArea *polyarea;
+    int *lineids;
+    char *outlines;
+    int *polylines;
+    int nlayers, square, layer, line, first, last;
+    int first_shape_line, last_shape_line;
+    int count, i, j;
+
+    if (!roadmap_db_open(path, name, OverviewModel))
+	buildmap_fatal(0, "cannot open %s/%s", path, name);
+    roadmap_db_activate(path, name);
+
+    lineids = calloc(roadmap_line_count() + 1, sizeof(*lineids));
+    outlines = calloc(roadmap_line_count() + 1, sizeof(*outlines));
+    buildmap_check_allocated(lineids);
+    buildmap_check_allocated(outlines);
+
+    /* the outlines of the areas still drawn are kept, whatever the
+     * layer of their lines.  (0 marks a line the polygon lost.)
+     */
+    for (i = 0; i < roadmap_polygon_count(); i++) {
+	if (buildmap_osm_text_overview_drops(roadmap_polygon_category(i)))
+	    continue;
+	count = roadmap_polygon_lines(i, &polylines);
+	for (j = 0; j < count; j++)
+	    if (polylines[j])
+		outlines[abs(polylines[j])] = 1;
+    }
+
+    nlayers = buildmap_layer_count();
+
+    for (square = 0; square < roadmap_square_count(); square++) {
+
+	if (roadmap_square_index(square) < 0)
+	    continue;
+
+	roadmap_shape_in_square(square, &first_shape_line, &last_shape_line);
+
+	for (layer = 1; layer <= nlayers; layer++) {
+
+	    if (roadmap_line_in_square(square, layer, &first, &last)) {
+		for (line = first; line <= last; line++) {
+		    if (buildmap_osm_text_overview_drops(layer) &&
+			    !outlines[line])
+			continue;
+		    lineids[line] = buildmap_osm_text_overview_line
+			(line, layer, first_shape_line, last_shape_line);
+		}
+	    }
+
+	    if (buildmap_osm_text_overview_drops(layer))
+		continue;
+
+	    if (roadmap_place_in_square(square, layer, &first, &last)) {
+		for (i = first; i <= last; i++) {
+		    roadmap_place_point(i, &position);
+		    buildmap_square_adjust_limits
+			(position.longitude, position.latitude);
+		    buildmap_place_add
+			(str2dict(DictionaryCity, roadmap_place_get_name(i)),
+			 layer,
+			 buildmap_point_add
+			    (position.longitude, position.latitude));
+		}
+	    }
+	}
+    }
+
+    /* the maps don't give access to the areas' names, which RoadMap
+     * does not draw anyway.
+     */
+    for (i = 0; i < roadmap_polygon_count(); i++) {
+
+	layer = roadmap_polygon_category(i);
+	if (buildmap_osm_text_overview_drops(layer))
+	    continue;
+
+	PolygonId++;
+	buildmap_polygon_add_landmark
+	    (PolygonId, layer, str2dict(DictionaryStreet, ""));
+	buildmap_polygon_add(PolygonId, 0, PolygonId, &polyarea);
+	roadmap_polygon_edges(i, polyarea);
+
+	count = roadmap_polygon_lines(i, &polylines);
+	for (j = 0; j < count; j++) {
+	    line = abs(polylines[j]);
+	    if (line == 0 || lineids[line] == 0)
+		continue;
+	    buildmap_polygon_add_line(0, PolygonId, lineids[line],
+		polylines[j] < 0 ? POLYGON_SIDE_LEFT : POLYGON_SIDE_RIGHT);
+	}
+    }
+
+    free(lineids);
+    free(outlines);
+
+    roadmap_db_close(path, name);
+}
+
+/**
+ * @brief build an overview tile from the finer tiles it covers
+ * @param tileid the overview tile
+ * @param names the .rdm files of the finer tiles, in the maps directory
+ * @param count how many there are
+ *
+ * The finer tiles went through the layer selection and the neighbor
+ * coverage already: only the layers still drawn at the overview's zoom
+ * are copied, and their shapes simplified again for that zoom.  Reading
+ * them costs a fraction of cutting the tile out of the full OSM data.
+ */
+void
+buildmap_osm_text_read_overview(int tileid, char **names, int count)
+{
+    int i;
+
+    if (OverviewModel == NULL) {
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "zip", &RoadMapZipHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "street", &RoadMapStreetHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "range", &RoadMapRangeHandler);
+	OverviewModel =
+	    roadmap_db_register
+		(OverviewModel, "polygons", &RoadMapPolygonHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "shape", &RoadMapShapeHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "line", &RoadMapLineHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "place", &RoadMapPlaceHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "point", &RoadMapPointHandler);
+	OverviewModel =
+	    roadmap_db_register(OverviewModel, "square", &RoadMapSquareHandler);
+	OverviewModel =
+	    roadmap_db_register
+		(OverviewModel, "string", &RoadMapDictionaryHandler);
+    }
+
+    CurrentTileID = tileid;
+
+    buildmap_osm_text_point_hash_reset();
+
+    DictionaryPrefix = buildmap_dictionary_open("prefix");
+    DictionaryStreet = buildmap_dictionary_open("street");
+    DictionaryType = buildmap_dictionary_open("type");
+    DictionarySuffix = buildmap_dictionary_open("suffix");
+    DictionaryCity = buildmap_dictionary_open("city");
+
+    /* nothing read from OSM: the tile's .cov lists no way */
+    nRels = 0;
+    nWays = 0;
+    nNodes = 0;
+    nShapes = 0;
+    nRelTable = 0;
+    nWayTable = 0;
+    nSearchableWays = 0;
+    buildmap_osm_text_reset_nodes();
+    PolygonId = 0;
+    LineId = 0;
+
+    for (i = 0; i < count; i++) {
+	buildmap_verbose("reading %s", names[i]);
+	buildmap_osm_text_overview_tile(BuildMapResult, names[i]);
+    }
+
+    buildmap_osm_text_ways_shapeinfo();
+
+    buildmap_info("Tiles %d, lines %d, areas %d", count, LineId, PolygonId);
 }
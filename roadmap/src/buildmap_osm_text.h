@@ -30,3 +30,8 @@
 
 void buildmap_osm_text_read(char *filename, int tileid, int country_num, int division_num);
 void buildmap_osm_text_save_wayids(const char *path, const char *outfile);
+int buildmap_osm_text_coverage_uses(int tileid, long long *ids[3], int counts[3]);
+void buildmap_osm_text_overview(int zoom);
+void buildmap_osm_text_read_overview(int tileid, char **names, int count);
+void buildmap_osm_text_extract(const char *filename, const int *tiles, int count);
+void buildmap_osm_text_extract_load(void);
@@ -0,0 +1,153 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/**
+ * @file
+ * @brief write the coordinate tables in compressed form.
+ *
+ * See roadmap_db_packed.h for the format. The compressed tables are
+ * only written when requested, since older versions of RoadMap cannot
+ * read them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap_db_packed.h"
+
+#include "buildmap.h"
+
+
+static int BuildMapPacked = 0;
+
+
+/**
+ * @brief select the format of the coordinate tables
+ * @param packed 1 to write the compressed tables, 0 for the fixed size ones
+ */
+void buildmap_packed_enable (int packed) {
+
+   BuildMapPacked = packed;
+}
+
+
+int buildmap_packed_enabled (void) {
+
+   return BuildMapPacked;
+}
+
+
+static unsigned char *buildmap_packed_encode (unsigned char *cursor,
+                                              unsigned short delta) {
+
+   unsigned int zigzag =
+      ((unsigned int)delta << 1) ^ ((delta & 0x8000) ? 0x1ffff : 0);
+
+   zigzag &= 0x1ffff;
+
+   while (zigzag >= 0x80) {
+      *(cursor++) = (unsigned char) (zigzag | 0x80);
+      zigzag >>= 7;
+   }
+   *(cursor++) = (unsigned char) zigzag;
+
+   return cursor;
+}
+
+
+/**
+ * @brief add a table of pairs of 16 bits values, compressed if that
+ *        makes it smaller
+ *
+ * Values that jump around from one record to the next take up to 3 bytes
+ * each once compressed: such a table is written as a plain "data" table.
+ *
+ * @param parent the section the table belongs to
+ * @param values the records, two values each
+ * @param count the number of records
+ */
+void buildmap_packed_add (buildmap_db *parent,
+                          const unsigned short *values, int count) {
+
+   int i;
+   int block_count;
+   int size;
+   int *blocks;
+   unsigned short previous[2];
+   unsigned char *data;
+   unsigned char *cursor;
+   buildmap_db *table;
+
+
+   block_count = (count + ROADMAP_DB_PACKED_BLOCK - 1) / ROADMAP_DB_PACKED_BLOCK;
+
+   blocks = malloc ((block_count + 1) * sizeof(int));
+   buildmap_check_allocated(blocks);
+
+   /* No value takes more than 3 bytes. */
+   data = malloc (6 * count + 1);
+   buildmap_check_allocated(data);
+
+   cursor = data;
+
+   for (i = 0; i < 2 * count; ++i) {
+
+      if (i % (2 * ROADMAP_DB_PACKED_BLOCK) == 0) {
+         blocks[i / (2 * ROADMAP_DB_PACKED_BLOCK)] = cursor - data;
+         previous[0] = previous[1] = 0;
+      }
+
+      cursor = buildmap_packed_encode
+                  (cursor, (unsigned short) (values[i] - previous[i & 1]));
+      previous[i & 1] = values[i];
+   }
+
+   size = cursor - data;
+   blocks[block_count] = size;
+
+   if (size + (block_count + 1) * sizeof(int) >= 2 * count * sizeof(short)) {
+
+      table = buildmap_db_add_child
+                 (parent, "data", count, 2 * sizeof(short));
+      memcpy (buildmap_db_get_data (table), values, 2 * count * sizeof(short));
+
+      free (data);
+      free (blocks);
+      return;
+   }
+
+   table = buildmap_db_add_section (parent, "packed");
+   if (table == NULL) buildmap_fatal (0, "Can't add a new section");
+
+   if (size > 0) {
+      buildmap_db_add_data (table, size, 1);
+      memcpy (buildmap_db_get_data (table), data, size);
+   }
+
+   /* The count of this table is the number of records, not of bytes. */
+   table->head->count = count;
+
+   table = buildmap_db_add_child
+              (parent, "blocks", block_count + 1, sizeof(int));
+   memcpy (buildmap_db_get_data (table), blocks, (block_count + 1) * sizeof(int));
+
+   free (data);
+   free (blocks);
+}
@@ -272,47 +272,6 @@ int buildmap_place_get_square_sorted (int place) {
              (buildmap_place_get_record_sorted(place)->point);
 }
 
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */
-
-static int buildmap_place_compare (const void *r1, const void *r2) {
-
-   int square1;
-   int square2;
-
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapPlace *record1;
-   BuildMapPlace *record2;
-
-   record1 = Place[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Place[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-
-   /* The Places are first sorted by square.
-    * Within a square, Places are sorted by category.
-    * Within a layer, Places are sorted by point.
-    */
-
-   square1 = buildmap_point_get_square_sorted (record1->point);
-   square2 = buildmap_point_get_square_sorted (record2->point);
-
-   if (square1 != square2) {
-      return square1 - square2;
-   }
-
-   if (record1->layer != record2->layer) {
-      return record1->layer - record2->layer;
-   }
-
-   return record1->point - record2->point;
-}
-
 /**
  * @brief
  */
@@ -321,6 +280,7 @@ static void buildmap_place_sort (void) {
    int i;
    int j;
    BuildMapPlace *one_place;
+   unsigned long long *keys;
 
    if (PlaceCount == 0) return;
 
@@ -341,7 +301,7 @@ static void buildmap_place_sort (void) {
     * sorted point_id, so we keep the place items in valid.
     *
     * Also note that we load up SortPlace with sequential indexes to
-    * the unsorted places. After the qsort() below this array will have
+    * the unsorted places. After the sort below this array will have
     * the indexes reordered by the sorted order.
     */
    
@@ -351,7 +311,28 @@ static void buildmap_place_sort (void) {
       one_place->point = buildmap_point_get_sorted (one_place->point);
    }
 
-   qsort (SortedPlace, PlaceCount, sizeof(int), buildmap_place_compare);
+   /* The Places are first sorted by square.
+    * Within a square, Places are sorted by category.
+    * Within a layer, Places are sorted by point.
+    */
+   keys = malloc (PlaceCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
+   for (i = 0; i < PlaceCount; ++i) {
+      one_place = Place[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (one_place->point, 0);
+   }
+   buildmap_sort_on_key (SortedPlace, PlaceCount, keys);
+
+   for (i = 0; i < PlaceCount; ++i) {
+      one_place = Place[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key
+                   (buildmap_point_get_square_sorted (one_place->point),
+                    one_place->layer);
+   }
+   buildmap_sort_on_key (SortedPlace, PlaceCount, keys);
+
+   free (keys);
 
    /* 
     * Now that we have indexes to the places sorted by Place we can 
@@ -585,12 +566,15 @@ static void buildmap_place_reset (void) {
 /**
  * @brief
  */
+static const char *const BuildMapPlaceSortAfter[] = {"point", NULL};
+
 static buildmap_db_module BuildMapPlaceModule = {
    "place",
    buildmap_place_sort,
    buildmap_place_save,
    buildmap_place_summary,
-   buildmap_place_reset
+   buildmap_place_reset,
+   BuildMapPlaceSortAfter
 }; 
    
 /**
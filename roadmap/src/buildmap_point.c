@@ -46,14 +46,14 @@ typedef struct {
    int latitude;
    int sorted;
    int squareid;           /* Before sorting. */
-   unsigned short square;  /* After sorting. */
+   int square;             /* After sorting. */
 } BuildMapPoint;
 
 
 static int PointCount = 0;
 static BuildMapPoint *Point[BUILDMAP_BLOCK] = {NULL};
 
-static RoadMapHash *PointByPosition = NULL;
+static RoadMapIntHash *PointByPosition = NULL;
 
 static int *SortedPoint = NULL;
 
@@ -65,12 +65,9 @@ static void buildmap_point_register (void);
 static void buildmap_point_initialize (void) {
 
    PointByPosition =
-      roadmap_hash_new ("PointByPosition", BUILDMAP_BLOCK);
+      roadmap_hash_int_new ("PointByPosition", BUILDMAP_BLOCK);
 
-   Point[0] = calloc (BUILDMAP_BLOCK, sizeof(BuildMapPoint));
-   if (Point[0] == NULL) {
-      buildmap_fatal (0, "no more memory");
-   }
+   Point[0] = buildmap_arena_calloc (BUILDMAP_BLOCK, sizeof(BuildMapPoint));
 
    PointCount = 0;
 
@@ -88,6 +85,7 @@ int buildmap_point_add (int longitude, int latitude) {
    int i;
    int block;
    int offset;
+   long long position;
    BuildMapPoint *this_point;
 
 
@@ -96,18 +94,12 @@ int buildmap_point_add (int longitude, int latitude) {
 
    /* First check if the point is already known. */
 
-   for (i = roadmap_hash_get_first (PointByPosition, longitude);
-        i >= 0;
-        i = roadmap_hash_get_next (PointByPosition, i)) {
-
-      this_point = Point[i / BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+   position = (long long)
+      (((unsigned long long)(unsigned int)longitude << 32) |
+         (unsigned int)latitude);
 
-      if ((this_point->latitude == latitude) &&
-          (this_point->longitude == longitude)) {
-          
-         return i;
-      }
-   }
+   i = roadmap_hash_int_get (PointByPosition, position);
+   if (i >= 0) return i;
 
 
    /* This is a new point: create a new entry. */
@@ -125,15 +117,11 @@ int buildmap_point_add (int longitude, int latitude) {
 
       /* We need to add a new block to the table. */
 
-      Point[block] = calloc (BUILDMAP_BLOCK, sizeof(BuildMapPoint));
-      if (Point[block] == NULL) {
-         buildmap_fatal (0, "no more memory");
-      }
-
-      roadmap_hash_resize (PointByPosition, (block+1) * BUILDMAP_BLOCK);
+      Point[block] =
+         buildmap_arena_calloc (BUILDMAP_BLOCK, sizeof(BuildMapPoint));
    }
 
-   roadmap_hash_add (PointByPosition, longitude, PointCount);
+   roadmap_hash_int_set (PointByPosition, position, PointCount);
 
    this_point = Point[block] + offset;
 
@@ -265,42 +253,6 @@ int  buildmap_point_get_latitude_sorted  (int point) {
    return buildmap_point_get(SortedPoint[point])->latitude;
 }
 
-/**
- * @brief compare two points
- * @param r1 the first point
- * @param r2 the second point
- * @return 0 if equal
- */
-static int buildmap_point_compare (const void *r1, const void *r2) {
-
-   int result;
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapPoint *record1;
-   BuildMapPoint *record2;
-
-   record1 = Point[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Point[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-
-   /* group together the points that are in the same square. */
-
-   if (record1->square != record2->square) {
-      return record1->square - record2->square;
-   }
-
-   /* The two points are inside the same square: compare exact location. */
-
-   result = record1->longitude - record2->longitude;
-
-   if (result != 0) {
-      return result;
-   }
-
-   return record1->latitude - record2->latitude;
-}
-
 /**
  * @brief sort the points
  */
@@ -309,6 +261,7 @@ void buildmap_point_sort (void) {
    int i;
    int j;
    BuildMapPoint *record;
+   unsigned long long *keys;
 
    if (PointCount == 0) return;
 
@@ -343,7 +296,25 @@ void buildmap_point_sort (void) {
       SortedPoint[i] = i;
    }
 
-   qsort (SortedPoint, PointCount, sizeof(int), buildmap_point_compare);
+   /* Group together the points that are in the same square,
+    * then order them by exact location.
+    */
+   keys = malloc (PointCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
+   for (i = 0; i < PointCount; i++) {
+      record = Point[i / BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (record->longitude, record->latitude);
+   }
+   buildmap_sort_on_key (SortedPoint, PointCount, keys);
+
+   for (i = 0; i < PointCount; i++) {
+      record = Point[i / BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (record->square, 0);
+   }
+   buildmap_sort_on_key (SortedPoint, PointCount, keys);
+
+   free (keys);
 
    for (i = 0; i < PointCount; i++) {
       j = SortedPoint[i];
@@ -386,12 +357,21 @@ static int buildmap_point_save (void) {
       return 1;
    }
 
-   table_data = buildmap_db_add_section (root, "data");
-   if (table_data == NULL) {
-      buildmap_error (0, "Can't add a new section");
-      return 1;
+   if (buildmap_packed_enabled ()) {
+
+      /* The compressed table is written once all the points are known. */
+      table_data = NULL;
+      db_points = buildmap_arena_alloc (PointCount * sizeof(RoadMapPoint));
+
+   } else {
+
+      table_data = buildmap_db_add_section (root, "data");
+      if (table_data == NULL) {
+         buildmap_error (0, "Can't add a new section");
+         return 1;
+      }
+      buildmap_db_add_data (table_data, PointCount, sizeof(RoadMapPoint));
    }
-   buildmap_db_add_data (table_data, PointCount, sizeof(RoadMapPoint));
 
    table_bysquare = buildmap_db_add_section (root, "bysquare");
    if (table_bysquare == NULL) {
@@ -401,7 +381,9 @@ static int buildmap_point_save (void) {
    buildmap_db_add_data
       (table_bysquare, square_count, sizeof(RoadMapPointBySquare));
 
-   db_points   = (RoadMapPoint *) buildmap_db_get_data (table_data);
+   if (table_data != NULL) {
+      db_points = (RoadMapPoint *) buildmap_db_get_data (table_data);
+   }
    db_bysquare = (RoadMapPointBySquare *) buildmap_db_get_data (table_bysquare);
 
 
@@ -431,6 +413,11 @@ static int buildmap_point_save (void) {
          (unsigned short) (one_point->latitude - reference_latitude);
    }
 
+   if (table_data == NULL) {
+      buildmap_packed_add
+         (root, (const unsigned short *) db_points, PointCount);
+   }
+
    return 0;
 }
 
@@ -450,11 +437,9 @@ static void buildmap_point_reset (void) {
 
    int i;
 
+   /* The blocks themselves belong to the buildmap arena. */
    for (i = 0; i < BUILDMAP_BLOCK; i++) {
-      if (Point[i] != NULL) {
-         free (Point[i]);
-         Point[i] = NULL;
-      }
+      Point[i] = NULL;
    }
 
    if (SortedPoint != NULL) {
@@ -464,7 +449,7 @@ static void buildmap_point_reset (void) {
 
    PointCount = 0;
 
-   roadmap_hash_delete (PointByPosition);
+   roadmap_hash_int_delete (PointByPosition);
    PointByPosition = NULL;
 
 }
@@ -477,7 +462,8 @@ static buildmap_db_module BuildMapPointModule = {
    buildmap_point_sort,
    buildmap_point_save,
    buildmap_point_summary,
-   buildmap_point_reset
+   buildmap_point_reset,
+   NULL
 };
 
 /**
@@ -66,6 +66,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "roadmap_db_polygon.h"
 
@@ -93,7 +94,7 @@ typedef struct {
    int           polyid;
 
    char  cfcc;
-   short square[4];
+   int   square[4];
 
    int count;
    int sorted;
@@ -109,7 +110,7 @@ typedef struct {
    int   tlid;
    int   line;
    char  side;   /* left or right. */
-   short square;
+   int   square;
 
 } BuildMapPolygonLine;
 
@@ -630,52 +631,6 @@ int  buildmap_polygon_add_line
 }
 
 
-static int buildmap_polygon_compare (const void *r1, const void *r2) {
-
-   int i;
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapPolygon *record1;
-   BuildMapPolygon *record2;
-
-   record1 = Polygon[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Polygon[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-
-   /* Empty polygons are moved to the end, to be removed later. */
-   if (record1->count <= 1) {
-      if (record2->count > 1) {
-         return 1;
-      }
-   } else if (record2->count <= 1) {
-      return -1;
-   }
-
-   /* The polygons are first sorted by square.
-    * Within a square, polygons are sorted by category.
-    */
-
-   if (record1->square[0] != record2->square[0]) {
-      return record1->square[0] - record2->square[0];
-   }
-
-   if (record1->cfcc != record2->cfcc) {
-      return record1->cfcc - record2->cfcc;
-   }
-
-   for (i = 1; i < 4; i++) {
-
-      if (record1->square[i] != record2->square[i]) {
-         return record1->square[i] - record2->square[i];
-      }
-      if (record1->square[i] < 0) break;
-   }
-
-   return 0;
-}
-
-
 int buildmap_polygon_use_line (int tlid) {
 
    int index;
@@ -700,46 +655,6 @@ int buildmap_polygon_use_line (int tlid) {
 }
 
 
-static int buildmap_polygon_compare_lines (const void *r1, const void *r2) {
-
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapPolygonLine *record1;
-   BuildMapPolygonLine *record2;
-
-   record1 = PolygonLine[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = PolygonLine[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-
-   /* The lines are first sorted by polygons, then by square. */
-
-   if (record1->polygon != record2->polygon) {
-
-      if (record1->polygon == NULL) {
-         return 1;
-      }
-      if (record2->polygon == NULL) {
-         return -1;
-      }
-      return record1->polygon->sorted - record2->polygon->sorted;
-   }
-
-   if (record1->square != record2->square) {
-      return record1->square - record2->square;
-   }
-
-   if (record1->polygon == NULL) {
-      return 0;
-   }
-   if (record1->polygon->cfcc != record2->polygon->cfcc) {
-      return record1->polygon->cfcc - record2->polygon->cfcc;
-   }
-
-   return 0;
-}
-
-
 static void buildmap_polygon_sort (void) {
 
    int i;
@@ -747,8 +662,10 @@ static void buildmap_polygon_sort (void) {
    int k;
    int first_empty_polygon;
    int first_unused_line;
+   int square[4];
    BuildMapPolygon *one_polygon;
    BuildMapPolygonLine *one_line;
+   unsigned long long *keys;
 
    if (!PolygonLineCount || !PolygonCount) return;
 
@@ -814,7 +731,7 @@ static void buildmap_polygon_sort (void) {
 
             if (one_polygon->square[j] > one_polygon->square[k]) {
 
-               short temp = one_polygon->square[j];
+               int temp = one_polygon->square[j];
 
                one_polygon->square[j] = one_polygon->square[k];
                one_polygon->square[k] = temp;
@@ -830,11 +747,41 @@ static void buildmap_polygon_sort (void) {
       buildmap_fatal (0, "no more memory");
    }
 
+   /* Empty polygons are moved to the end, to be removed later.
+    * The other polygons are first sorted by square, then by category,
+    * then by their other squares.  The squares that follow an unused
+    * (negative) one are not significant: they are blanked in the key.
+    */
+   keys = malloc (PolygonCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
    for (i = 0; i < PolygonCount; i++) {
+
       SortedPolygon[i] = i;
+      one_polygon = Polygon[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+
+      square[1] = one_polygon->square[1];
+      for (j = 2; j < 4; j++) {
+         square[j] = (square[j-1] < 0) ? -1 : one_polygon->square[j];
+      }
+      keys[i] = buildmap_sort_key (square[2], square[3]);
    }
+   buildmap_sort_on_key (SortedPolygon, PolygonCount, keys);
 
-   qsort (SortedPolygon, PolygonCount, sizeof(int), buildmap_polygon_compare);
+   for (i = 0; i < PolygonCount; i++) {
+      one_polygon = Polygon[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (one_polygon->cfcc, one_polygon->square[1]);
+   }
+   buildmap_sort_on_key (SortedPolygon, PolygonCount, keys);
+
+   for (i = 0; i < PolygonCount; i++) {
+      one_polygon = Polygon[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key
+                   (one_polygon->count <= 1, one_polygon->square[0]);
+   }
+   buildmap_sort_on_key (SortedPolygon, PolygonCount, keys);
+
+   free (keys);
 
    first_empty_polygon = PolygonCount;
 
@@ -871,12 +818,23 @@ static void buildmap_polygon_sort (void) {
       buildmap_fatal (0, "no more memory");
    }
 
+   /* The lines are first sorted by polygons, then by square.
+    * The lines that belong to no polygon go to the end.
+    */
+   keys = malloc (PolygonLineCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
    for (i = 0; i < PolygonLineCount; i++) {
       SortedPolygonLine[i] = i;
+      one_line = PolygonLine[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key
+                   (one_line->polygon == NULL ?
+                       INT_MAX : one_line->polygon->sorted,
+                    one_line->square);
    }
+   buildmap_sort_on_key (SortedPolygonLine, PolygonLineCount, keys);
 
-   qsort (SortedPolygonLine, PolygonLineCount,
-          sizeof(int), buildmap_polygon_compare_lines);
+   free (keys);
 
    first_unused_line = PolygonLineCount;
 
@@ -1083,12 +1041,15 @@ static void buildmap_polygon_reset (void) {
 }
 
 
+static const char *const BuildMapPolygonSortAfter[] = {"point", "line", NULL};
+
 static buildmap_db_module BuildMapPolygonModule = {
    "polygons",
    buildmap_polygon_sort,
    buildmap_polygon_save,
    buildmap_polygon_summary,
-   buildmap_polygon_reset
+   buildmap_polygon_reset,
+   BuildMapPolygonSortAfter
 }; 
       
          
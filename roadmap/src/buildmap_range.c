@@ -423,70 +423,6 @@ void buildmap_range_add_place (RoadMapString place, RoadMapString city) {
    RangePlaceCount += 1;
 }
 
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */
-static int buildmap_range_compare (const void *r1, const void *r2) {
-
-   int result;
-
-   int i1 = *((int *)r1);
-   int i2 = *((int *)r2);
-
-   BuildMapRange *record1;
-   BuildMapRange *record2;
-
-   record1 = Range[i1/BUILDMAP_BLOCK] + (i1 % BUILDMAP_BLOCK);
-   record2 = Range[i2/BUILDMAP_BLOCK] + (i2 % BUILDMAP_BLOCK);
-
-   result = record1->street - record2->street;
-
-   if (result != 0) {
-      return result;
-   }
-
-   result = (int) (record1->city) - (int) (record2->city);
-
-   if (result != 0) {
-      return result;
-   }
-
-   result =
-      buildmap_line_get_sorted (record1->line & (~ CONTINUATION_FLAG)) -
-      buildmap_line_get_sorted (record2->line & (~ CONTINUATION_FLAG));
-
-   if (result != 0) {
-      return result;
-   }
-
-   /* Preserve the order of range insertion */
-
-   return i1 - i2;
-}
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */
-static int buildmap_range_compare_no_addr (const void *r1, const void *r2) {
-
-   int i1 = *((int *)r1);
-   int i2 = *((int *)r2);
-
-   RoadMapRangeNoAddress *record1;
-   RoadMapRangeNoAddress *record2;
-
-
-   record1 = RangeNoAddress[i1/BUILDMAP_BLOCK] + (i1 % BUILDMAP_BLOCK);
-   record2 = RangeNoAddress[i2/BUILDMAP_BLOCK] + (i2 % BUILDMAP_BLOCK);
-
-   return record1->line - record2->line;
-}
-
 /**
  * @brief
  */
@@ -495,6 +431,7 @@ static void buildmap_range_sort (void) {
    int i;
    BuildMapRange *this_range;
    RoadMapRangeNoAddress *this_noaddr;
+   unsigned long long *keys;
 
    if (RangeCount && SortedRange == NULL) {
 
@@ -520,7 +457,27 @@ static void buildmap_range_sort (void) {
 		| (this_range->line & CONTINUATION_FLAG);
        }
 
-       qsort (SortedRange, RangeCount, sizeof(int), buildmap_range_compare);
+       /* Sort by street, then city, then line. The sort is stable,
+        * so ranges of the same line keep their insertion order.
+        */
+       keys = malloc (RangeCount * sizeof(*keys));
+       buildmap_check_allocated(keys);
+
+       for (i = 0; i < RangeCount; i++) {
+	  this_range = Range[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+	  keys[i] = buildmap_sort_key
+	     (this_range->city,
+	      buildmap_line_get_sorted (this_range->line & (~ CONTINUATION_FLAG)));
+       }
+       buildmap_sort_on_key (SortedRange, RangeCount, keys);
+
+       for (i = 0; i < RangeCount; i++) {
+	  this_range = Range[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+	  keys[i] = buildmap_sort_key (this_range->street, 0);
+       }
+       buildmap_sort_on_key (SortedRange, RangeCount, keys);
+
+       free (keys);
    }
 
    if (RangeNoAddressCount && SortedNoAddress == NULL) {
@@ -539,8 +496,16 @@ static void buildmap_range_sort (void) {
 	  this_noaddr->line   = buildmap_line_get_sorted (this_noaddr->line);
        }
 
-       qsort (SortedNoAddress, RangeNoAddressCount, sizeof(int),
-	      buildmap_range_compare_no_addr);
+       keys = malloc (RangeNoAddressCount * sizeof(*keys));
+       buildmap_check_allocated(keys);
+
+       for (i = 0; i < RangeNoAddressCount; i++) {
+	  this_noaddr = RangeNoAddress[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+	  keys[i] = buildmap_sort_key (this_noaddr->line, 0);
+       }
+       buildmap_sort_on_key (SortedNoAddress, RangeNoAddressCount, keys);
+
+       free (keys);
    }
 }
 
@@ -1084,12 +1049,15 @@ static void buildmap_range_reset (void) {
 /**
  * @brief
  */
+static const char *const BuildMapRangeSortAfter[] = {"line", "street", NULL};
+
 static buildmap_db_module BuildMapRangeModule = {
    "range",
    buildmap_range_sort,
    buildmap_range_save,
    buildmap_range_summary,
-   buildmap_range_reset
+   buildmap_range_reset,
+   BuildMapRangeSortAfter
 };
 
 /**
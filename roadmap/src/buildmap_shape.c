@@ -66,7 +66,12 @@ static int ShapeMaxSequence = 0;
 
 static BuildMapShape *Shape[BUILDMAP_BLOCK] = {NULL};
 
-static RoadMapHash *ShapeByLine   = NULL;
+static RoadMapIntHash *ShapeByLine = NULL;
+
+/* ShapeByLine is keyed by line and sequence.  Each line with shapes also
+ * gets an entry with this (never used) sequence, to count the lines.
+ */
+#define SHAPE_ANY_SEQUENCE 0xffffffffU
 
 static int ShapeAddCount = 0;
 
@@ -75,12 +80,17 @@ static int *SortedShape = NULL;
 
 static void buildmap_shape_register (void);
 
+static long long buildmap_shape_key (int line, unsigned int sequence) {
+
+   return (long long)(((unsigned long long)(unsigned int)line << 32) | sequence);
+}
+
 /**
  * @brief
  */
 static void buildmap_shape_initialize (void) {
 
-   ShapeByLine = roadmap_hash_new ("ShapeByLine", BUILDMAP_BLOCK);
+   ShapeByLine = roadmap_hash_int_new ("ShapeByLine", BUILDMAP_BLOCK);
 
    ShapeMaxLine = 0;
 
@@ -116,31 +126,26 @@ int buildmap_shape_add (int line, int irec, int uid, int sequence, int longitude
 
    /* First search if that shape is not known yet. */
 
-   line_exists = 0;
+   index = roadmap_hash_int_get
+               (ShapeByLine, buildmap_shape_key (line, sequence));
 
-   for (index = roadmap_hash_get_first (ShapeByLine, line);
-        index >= 0;
-        index = roadmap_hash_get_next (ShapeByLine, index)) {
+   if (index >= 0) {
 
       this_shape = Shape[index / BUILDMAP_BLOCK] + (index % BUILDMAP_BLOCK);
 
-      if (this_shape->line == line) {
-
-         if (this_shape->sequence == (unsigned int)sequence) {
-
-            if ((this_shape->longitude != longitude) ||
-                (this_shape->latitude  != latitude )) {
-               buildmap_error
-                (0, "duplicated sequence number %d, irec %d, uid %d, %d/%d",
-                        sequence, irec, uid, longitude, latitude);
-            }
-
-            return index;
-         }
-         line_exists = 1;
+      if ((this_shape->longitude != longitude) ||
+          (this_shape->latitude  != latitude )) {
+         buildmap_error
+          (0, "duplicated sequence number %d, irec %d, uid %d, %d/%d",
+                  sequence, irec, uid, longitude, latitude);
       }
+
+      return index;
    }
 
+   line_exists = (roadmap_hash_int_get
+         (ShapeByLine, buildmap_shape_key (line, SHAPE_ANY_SEQUENCE)) >= 0);
+
    buildmap_long_line_test (line, longitude, latitude);
 
    /* This shape was not known yet: create a new one. */
@@ -162,11 +167,8 @@ int buildmap_shape_add (int line, int irec, int uid, int sequence, int longitude
 
       /* We need to add a new block to the table. */
 
-      Shape[block] = calloc (BUILDMAP_BLOCK, sizeof(BuildMapShape));
-      if (Shape[block] == NULL) {
-         buildmap_fatal (0, "no more memory");
-      }
-      roadmap_hash_resize (ShapeByLine, (block+1) * BUILDMAP_BLOCK);
+      Shape[block] =
+         buildmap_arena_calloc (BUILDMAP_BLOCK, sizeof(BuildMapShape));
    }
 
    this_shape = Shape[block] + offset;
@@ -180,6 +182,9 @@ int buildmap_shape_add (int line, int irec, int uid, int sequence, int longitude
 
       ShapeLineCount += 1;
 
+      roadmap_hash_int_set (ShapeByLine,
+            buildmap_shape_key (line, SHAPE_ANY_SEQUENCE), ShapeCount);
+
       if (line > ShapeMaxLine) {
          ShapeMaxLine = line;
       }
@@ -189,7 +194,8 @@ int buildmap_shape_add (int line, int irec, int uid, int sequence, int longitude
       }
    }
 
-   roadmap_hash_add (ShapeByLine, line, ShapeCount);
+   roadmap_hash_int_set
+      (ShapeByLine, buildmap_shape_key (line, sequence), ShapeCount);
 
    if (sequence > ShapeMaxSequence) {
 
@@ -203,36 +209,14 @@ int buildmap_shape_add (int line, int irec, int uid, int sequence, int longitude
    return ShapeCount++;
 }
 
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */
-static int buildmap_shape_compare (const void *r1, const void *r2) {
-
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapShape *record1;
-   BuildMapShape *record2;
-
-   record1 = Shape[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Shape[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-   if (record1->line != record2->line) {
-      return record1->line - record2->line;
-   }
-
-   return record1->sequence - record2->sequence;
-}
-
 /**
  * @brief
  */
 static void buildmap_shape_sort (void) {
 
    int i;
+   BuildMapShape *one_shape;
+   unsigned long long *keys;
 
    if (ShapeCount == 0) return;
 
@@ -245,11 +229,18 @@ static void buildmap_shape_sort (void) {
       buildmap_fatal (0, "no more memory");
    }
 
+   keys = malloc (ShapeCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
    for (i = 0; i < ShapeCount; i++) {
       SortedShape[i] = i;
+      one_shape = Shape[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = (unsigned long long)
+                   buildmap_shape_key (one_shape->line, one_shape->sequence);
    }
 
-   qsort (SortedShape, ShapeCount, sizeof(int), buildmap_shape_compare);
+   buildmap_sort_on_key (SortedShape, ShapeCount, keys);
+   free (keys);
 }
 
 /**
@@ -386,16 +377,26 @@ static int buildmap_shape_save (void) {
    buildmap_db_add_data (table_line,
                          ShapeLineCount, sizeof(RoadMapShapeByLine));
 
-   table_data = buildmap_db_add_section (root, "data");
-   if (table_data == NULL) {
-      buildmap_error (0, "Can't add a new section");
-      return 1;
+   if (buildmap_packed_enabled ()) {
+
+      /* The compressed table is written once all the shapes are known. */
+      table_data = NULL;
+      db_shape = buildmap_arena_alloc (shape_count * sizeof(RoadMapShape));
+
+   } else {
+
+      table_data = buildmap_db_add_section (root, "data");
+      if (table_data == NULL) {
+         buildmap_error (0, "Can't add a new section");
+         return 1;
+      }
+      buildmap_db_add_data (table_data, shape_count, sizeof(RoadMapShape));
+
+      db_shape = (RoadMapShape *) buildmap_db_get_data (table_data);
    }
-   buildmap_db_add_data (table_data, shape_count, sizeof(RoadMapShape));
 
    db_bysquare = (RoadMapShapeBySquare *) buildmap_db_get_data (table_square);
    db_byline = (RoadMapShapeByLine *) buildmap_db_get_data (table_line);
-   db_shape  = (RoadMapShape *) buildmap_db_get_data (table_data);
 
 
    last_line = -1;
@@ -533,6 +534,11 @@ static int buildmap_shape_save (void) {
       return 1;
    }
 
+   if (table_data == NULL) {
+      buildmap_packed_add
+         (root, (const unsigned short *) db_shape, shape_count);
+   }
+
    return 0;
 }
 
@@ -557,11 +563,9 @@ static void  buildmap_shape_reset (void) {
 
    int i;
 
+   /* The blocks themselves belong to the buildmap arena. */
    for (i = 0; i < BUILDMAP_BLOCK; i++) {
-      if (Shape[i] != NULL) {
-         free(Shape[i]);
-         Shape[i] = NULL;
-      }
+      Shape[i] = NULL;
    }
 
    free (SortedShape);
@@ -573,7 +577,7 @@ static void  buildmap_shape_reset (void) {
    ShapeMaxLine = 0;
    ShapeMaxSequence = 0;
 
-   roadmap_hash_delete (ShapeByLine);
+   roadmap_hash_int_delete (ShapeByLine);
    ShapeByLine = NULL;
 
    ShapeAddCount = 0;
@@ -587,7 +591,8 @@ static buildmap_db_module BuildMapShapeModule = {
    buildmap_shape_sort,
    buildmap_shape_save,
    buildmap_shape_summary,
-   buildmap_shape_reset
+   buildmap_shape_reset,
+   NULL
 };
 
 /**
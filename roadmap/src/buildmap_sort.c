@@ -0,0 +1,128 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/**
+ * @file
+ * @brief sort the buildmap tables on precomputed keys.
+ *
+ * The tables are sorted through an array of indexes. Instead of calling
+ * a comparison function that walks the table blocks (and often other
+ * modules) for every comparison, the caller computes one 64 bits key
+ * per record and the indexes are sorted with a radix sort.
+ *
+ * The sort is stable, so a table ordered on several keys that do not
+ * fit in 64 bits is sorted once per key, least significant key first.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buildmap.h"
+
+
+typedef struct {
+   unsigned long long key;
+   int index;
+} BuildMapSortItem;
+
+
+/**
+ * @brief sort an array of indexes on the keys of the records
+ * @param index the record indexes to sort, modified in place
+ * @param count the number of indexes
+ * @param keys the key of each record, indexed by record
+ */
+void buildmap_sort_on_key (int *index, int count,
+                           const unsigned long long *keys) {
+
+   int i;
+   int shift;
+   int bucket;
+   int position;
+   int histogram[256];
+
+   unsigned long long key_and;
+   unsigned long long key_or;
+
+   BuildMapSortItem *items;
+   BuildMapSortItem *work;
+   BuildMapSortItem *swap;
+
+
+   if (count < 2) return;
+
+   items = malloc (2 * count * sizeof(BuildMapSortItem));
+   buildmap_check_allocated(items);
+   work = items + count;
+
+   key_and = ~0ULL;
+   key_or = 0;
+
+   for (i = 0; i < count; ++i) {
+      items[i].index = index[i];
+      items[i].key = keys[index[i]];
+      key_and &= items[i].key;
+      key_or |= items[i].key;
+   }
+
+   for (shift = 0; shift < 64; shift += 8) {
+
+      /* Skip the bytes that are the same in every key. */
+      if (((key_and ^ key_or) >> shift & 0xff) == 0) continue;
+
+      memset (histogram, 0, sizeof(histogram));
+
+      for (i = 0; i < count; ++i) {
+         histogram[(items[i].key >> shift) & 0xff] += 1;
+      }
+
+      for (bucket = 0, position = 0; bucket < 256; ++bucket) {
+         int size = histogram[bucket];
+         histogram[bucket] = position;
+         position += size;
+      }
+
+      for (i = 0; i < count; ++i) {
+         work[histogram[(items[i].key >> shift) & 0xff]++] = items[i];
+      }
+
+      swap = items;
+      items = work;
+      work = swap;
+   }
+
+   for (i = 0; i < count; ++i) {
+      index[i] = items[i].index;
+   }
+
+   free (items < work ? items : work);
+}
+
+
+/**
+ * @brief build a key that sorts like two signed integers
+ * @param high the most significant value
+ * @param low the least significant value
+ * @return the key
+ */
+unsigned long long buildmap_sort_key (int high, int low) {
+
+   return ((unsigned long long)((unsigned int)high ^ 0x80000000U) << 32)
+             | ((unsigned int)low ^ 0x80000000U);
+}
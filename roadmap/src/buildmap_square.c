@@ -38,7 +38,7 @@
  *
  *   int   buildmap_square_add  (int longitude, int latitude);
  *
- *   short buildmap_square_get_sorted (int squareid);
+ *   int   buildmap_square_get_sorted (int squareid);
  *   int   buildmap_square_get_count (void);
  *   void  buildmap_square_get_reference_sorted
  *            (int square, int *longitude, int *latitude);
@@ -301,7 +301,7 @@ int buildmap_square_add (int longitude, int latitude) {
 
 
 
-short buildmap_square_get_sorted (int squareid) {
+int   buildmap_square_get_sorted (int squareid) {
 
    if (SortedSquare == NULL) {
       buildmap_fatal (0, "squares have not been sorted yet");
@@ -391,10 +391,56 @@ int buildmap_square_is_long_line (int from_point, int to_point,
 }
 
 
+/**
+ * @brief the distance of a grid cell along a Hilbert curve
+ * @param size the side of the curve's square, a power of 2
+ * @param x the column of the cell (longitude)
+ * @param y the row of the cell (latitude)
+ * @return the rank of the cell along the curve
+ */
+static unsigned int buildmap_square_hilbert (int size, int x, int y) {
+
+   unsigned int distance = 0;
+   int half;
+   int rx;
+   int ry;
+   int t;
+
+   for (half = size / 2; half > 0; half /= 2) {
+
+      rx = (x & half) != 0;
+      ry = (y & half) != 0;
+      distance += (unsigned int) half * half * ((3 * rx) ^ ry);
+
+      /* rotate the quadrant, so that the curve stays continuous */
+      if (ry == 0) {
+         if (rx == 1) {
+            x = size - 1 - x;
+            y = size - 1 - y;
+         }
+         t = x;
+         x = y;
+         y = t;
+      }
+   }
+   return distance;
+}
+
+
+/**
+ * @brief order the squares along a Hilbert curve
+ *
+ * All the other tables are sorted by square, in that order.  In grid
+ * order the neighbors of a square to the east and west are a whole
+ * column away in the file, while along the curve most of the squares
+ * drawn together are also stored together.
+ */
 void buildmap_square_sort (void) {
 
    int i;
+   int size;
    int final_count;
+   unsigned long long *keys;
 
    if (SquareCount == 0) return;
 
@@ -403,20 +449,33 @@ void buildmap_square_sort (void) {
    buildmap_info ("sorting squares...");
 
    SortedSquare = calloc (SquareCount, sizeof(int));
-   if (SortedSquare == NULL) {
+   keys = calloc (SquareCount, sizeof(*keys));
+   if (SortedSquare == NULL || keys == NULL) {
       buildmap_fatal (0, "no more memory");
    }
 
+   for (size = 1;
+        size < SortCountLongitude || size < SortCountLatitude; size *= 2) ;
+
    final_count = 0;
 
    for (i = 0; i < SquareCount; i++) {
       if (Square[i].count != 0) {
-         Square[i].sorted = final_count;
+         keys[i] = buildmap_square_hilbert
+               (size, i / SortCountLatitude, i % SortCountLatitude);
          SortedSquare[final_count] = i;
          final_count += 1;
       }
    }
 
+   buildmap_sort_on_key (SortedSquare, final_count, keys);
+
+   for (i = 0; i < final_count; i++) {
+      Square[SortedSquare[i]].sorted = i;
+   }
+
+   free (keys);
+
    SquareCount = final_count;
 }
 
@@ -523,12 +582,16 @@ static void buildmap_square_reset (void) {
 }
 
 
+/* The squares are generated, and sorted, by the point sort. */
+static const char *const BuildMapSquareSortAfter[] = {"point", NULL};
+
 static buildmap_db_module BuildMapSquareModule = {
    "square",
    buildmap_square_sort,
    buildmap_square_save,
    buildmap_square_summary,
-   buildmap_square_reset
+   buildmap_square_reset,
+   BuildMapSquareSortAfter
 }; 
    
 
@@ -29,7 +29,7 @@ void  buildmap_square_adjust_limits(int longitude, int latitude);
 
 int   buildmap_square_add  (int longitude, int latitude);
 
-short buildmap_square_get_sorted (int squareid);
+int   buildmap_square_get_sorted (int squareid);
 int   buildmap_square_get_count (void);
 void  buildmap_square_get_reference_sorted
          (int square, int *longitude, int *latitude);
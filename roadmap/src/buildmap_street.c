@@ -207,28 +207,6 @@ int  buildmap_street_add
    return StreetCount++;
 }
 
-/**
- * @brief
- * @param r1
- * @param r2
- * @return
- */
-static int buildmap_street_compare (const void *r1, const void *r2) {
-
-   int i1 = *((int *)r1);
-   int i2 = *((int *)r2);
-
-   BuildMapStreet *record1;
-   BuildMapStreet *record2;
-
-
-   record1 = Street[i1/BUILDMAP_BLOCK] + (i1 % BUILDMAP_BLOCK);
-   record2 = Street[i2/BUILDMAP_BLOCK] + (i2 % BUILDMAP_BLOCK);
-
-   return buildmap_line_get_sorted (record1->start)
-             - buildmap_line_get_sorted (record2->start);
-}
-
 /**
  * @brief
  */
@@ -237,6 +215,7 @@ void buildmap_street_sort (void) {
    int i;
    int j;
    BuildMapStreet *this_street;
+   unsigned long long *keys;
 
    if (StreetCount == 0) return;
 
@@ -252,11 +231,18 @@ void buildmap_street_sort (void) {
       buildmap_fatal (0, "no more memory");
    }
 
+   keys = malloc (StreetCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
    for (i = 0; i < StreetCount; i++) {
       SortedStreet[i] = i;
+      this_street = Street[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key
+                   (buildmap_line_get_sorted (this_street->start), 0);
    }
 
-   qsort (SortedStreet, StreetCount, sizeof(int), buildmap_street_compare);
+   buildmap_sort_on_key (SortedStreet, StreetCount, keys);
+   free (keys);
 
    for (i = 0; i < StreetCount; i++) {
       j = SortedStreet[i];
@@ -411,12 +397,15 @@ static void buildmap_street_reset (void) {
 /**
  * @brief
  */
+static const char *const BuildMapStreetSortAfter[] = {"line", NULL};
+
 static buildmap_db_module BuildMapStreetModule = {
    "street",
    buildmap_street_sort,
    buildmap_street_save,
    buildmap_street_summary,
-   buildmap_street_reset
+   buildmap_street_reset,
+   BuildMapStreetSortAfter
 };
 
 /**
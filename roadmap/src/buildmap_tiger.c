@@ -150,7 +150,7 @@ static void tigerAdjust (char *line, int *start, int *end) {
    while (line[*start] == ' ') (*start)++;
 }
 
-static int tiger2int (char *line, int start, int end) {
+static int tiger2int_checked (char *line, int start, int end) {
 
    int i;
    int sign;
@@ -189,6 +189,43 @@ static int tiger2int (char *line, int start, int end) {
    return sign * result;
 }
 
+static int tiger2int (char *line, int start, int end) {
+
+   /* The numbers are right aligned, with leading spaces and an optional
+    * sign: decode that in one pass over the field. Anything else (trailing
+    * spaces, bad characters, too many digits) is left to the slower code
+    * above, which reports the errors.
+    */
+   char *cursor = line + start - 1;
+   char *last   = line + end;
+   int   sign   = 1;
+   int   result = 0;
+   unsigned int digit;
+
+   while (cursor < last && *cursor == ' ') cursor++;
+
+   if (cursor == last) return 0;
+
+   if (*cursor == '-') {
+      sign = -1;
+      cursor++;
+   } else if (*cursor == '+') {
+      cursor++;
+   }
+
+   if (cursor == last || last - cursor > 11) {
+      return tiger2int_checked (line, start, end);
+   }
+
+   for (; cursor < last; cursor++) {
+      digit = (unsigned int)(*cursor - '0');
+      if (digit > 9) return tiger2int_checked (line, start, end);
+      result = (result * 10) + digit;
+   }
+
+   return sign * result;
+}
+
 static unsigned int tiger2address (char *line, int start, int end) {
 
    tigerAdjust (line, &start, &end);
@@ -349,11 +386,14 @@ static char *buildmap_tiger_read
    file = open (full_name, O_RDONLY);
    if (file < 0) {
       buildmap_error (0, "cannot open file %s", full_name);
+      free (full_name);
       return NULL;
    }
+   free (full_name);
 
    if (fstat (file, &state_result) != 0) {
       buildmap_error (0, "cannot stat file");
+      close (file);
       return NULL;
    }
 
@@ -362,13 +402,19 @@ static char *buildmap_tiger_read
    }
 
    data = mmap (NULL, state_result.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+   close (file);
+
    if (data == MAP_FAILED) {
       buildmap_error (0, "cannot mmap");
       return NULL;
    }
 
-   close (file);
-   free  (full_name);
+#ifdef MADV_SEQUENTIAL
+   /* The records are read in order: ask for an aggressive read-ahead,
+    * and let the pages already read go first when memory gets tight.
+    */
+   madvise (data, state_result.st_size, MADV_SEQUENTIAL);
+#endif
 
    *size = state_result.st_size;
    return data;
@@ -646,6 +692,15 @@ static void buildmap_tiger_read_rt1 (const char *source, int verbose) {
 
 /* Table 2: shapes. */
 
+/* The shape records, decoded once and kept until the lines are sorted. */
+typedef struct {
+   int tlid;
+   int sequence;
+   int line;      /* position in the file, for error messages. */
+   int longitude[10];
+   int latitude[10];
+} BuildMapTigerShape;
+
 static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
 
    static int LocationOfPoint[] = {19, 38, 57, 76, 95, 114, 133, 152, 171, 190};
@@ -654,6 +709,7 @@ static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
    int    estimated_lines;
    int    line_count;
    int    record_count;
+   int    shape_count;
    char  *data;
    char  *cursor;
    char  *end_of_data;
@@ -661,12 +717,13 @@ static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
    int    i;
 
    int    location;
-   int    tlid;
-   int    sequence;
    int    longitude;
    int    latitude;
    int    line_index;
 
+   BuildMapTigerShape *shapes;
+   BuildMapTigerShape *shape;
+
 
    data = buildmap_tiger_read (source, ".RT2", verbose, &size);
    if (data == NULL) return;
@@ -675,10 +732,15 @@ static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
 
    end_of_data = data + size;
 
+   shapes = malloc ((estimated_lines + 1) * sizeof(BuildMapTigerShape));
+   buildmap_check_allocated(shapes);
+
    /* since lines are sorted by square, we need to have all the
-    * square limits before we sort the lines
+    * square limits before we sort the lines. The records are decoded
+    * now, so that the file is only scanned once.
     */
    line_count = 0;
+   shape_count = 0;
    for (cursor = data; cursor < end_of_data; cursor += 209) {
 
       line_count += 1;
@@ -689,17 +751,25 @@ static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
          continue;
       }
 
-      tlid = tiger2int (cursor, 6, 15);
+      shape = shapes + shape_count++;
+
+      shape->tlid = tiger2int (cursor, 6, 15);
+      shape->sequence = tiger2int (cursor, 16, 18) - 1;
+      shape->line = line_count;
 
       for (i = 0; i < 10; i++) {
 
          location  = LocationOfPoint[i];
          longitude = tiger2int (cursor, location, location + 9);
 
+         shape->longitude[i] = longitude;
+
          if (longitude != 0) {
 
             latitude = tiger2int (cursor, location+10, location+18);
 
+            shape->latitude[i] = latitude;
+
             buildmap_square_adjust_limits(longitude, latitude);
          }
       }
@@ -712,42 +782,29 @@ static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
       }
    }
 
+   munmap (data, size);
+
    /* We need the lines to be sorted, because we will order the shape
     * according to the orders of the lines.
     */
    buildmap_line_sort();
 
-   line_count = 0;
    record_count = 0;
-   for (cursor = data; cursor < end_of_data; cursor += 209) {
-
-      line_count += 1;
-      buildmap_set_line (line_count);
-
-      if (cursor[0] != '2') {
-         buildmap_error (0, "bad type %c", cursor[0]);
-         continue;
-      }
+   for (shape = shapes; shape < shapes + shape_count; shape++) {
 
-      tlid = tiger2int (cursor, 6, 15);
+      buildmap_set_line (shape->line);
 
-      line_index = buildmap_line_find_sorted (tlid);
+      line_index = buildmap_line_find_sorted (shape->tlid);
 
       if (line_index >= 0) {
 
-         sequence = tiger2int (cursor, 16, 18) - 1;
-
          for (i = 0; i < 10; i++) {
 
-            location  = LocationOfPoint[i];
-            longitude = tiger2int (cursor, location, location + 9);
-
-            if (longitude != 0) {
-
-               latitude = tiger2int (cursor, location+10, location+18);
+            if (shape->longitude[i] != 0) {
 
                buildmap_shape_add
-                  (line_index, 0, tlid, (10 * sequence) + i, longitude, latitude);
+                  (line_index, 0, shape->tlid, (10 * shape->sequence) + i,
+                   shape->longitude[i], shape->latitude[i]);
 
                record_count += 1;
             }
@@ -755,20 +812,13 @@ static void buildmap_tiger_read_rt2 (const char *source, int verbose) {
       }
 
       if (verbose) {
-         if ((line_count & 0xff) == 0) {
-            buildmap_progress (line_count, estimated_lines);
+         if ((shape->line & 0xff) == 0) {
+            buildmap_progress (shape->line, estimated_lines);
          }
       }
-
-      if (cursor[208] == '\r') {
-         cursor += 1;   /* Case of an MS-DOS format file. */
-      }
-      if (cursor[208] != '\n') {
-         buildmap_error (0, "bad end of line");
-      }
    }
 
-   munmap (data, size);
+   free (shapes);
 
    tiger_summary (verbose, record_count);
 }
@@ -188,41 +188,14 @@ int buildmap_turn_restrictions_exists (int node, int from_line, int to_line) {
    return 0;
 }
 
-/**
- * @brief support function for sorting the turns
- * @param r1
- * @param r2
- * @return
- */
-static int buildmap_turns_compare (const void *r1, const void *r2) {
-
-   int index1 = *((int *)r1);
-   int index2 = *((int *)r2);
-
-   BuildMapTurns *record1;
-   BuildMapTurns *record2;
-
-   record1 = Turns[index1/BUILDMAP_BLOCK] + (index1 % BUILDMAP_BLOCK);
-   record2 = Turns[index2/BUILDMAP_BLOCK] + (index2 % BUILDMAP_BLOCK);
-
-   if (record1->node != record2->node) {
-      return record1->node - record2->node;
-   }
-
-   if (record1->from_line != record2->from_line) {
-      return record1->from_line - record2->from_line;
-   }
-
-   return record1->to_line - record2->to_line;
-}
-
-
 /**
  * @brief Sort turns by node id, then by line ids.
  */
 void buildmap_turn_restrictions_sort (void) {
 
    int i;
+   BuildMapTurns *one_turn;
+   unsigned long long *keys;
 
    if (SortedTurns != NULL) return; /* Sort was already performed. */
 
@@ -233,11 +206,23 @@ void buildmap_turn_restrictions_sort (void) {
       buildmap_fatal (0, "no more memory");
    }
 
+   keys = malloc (TurnsCount * sizeof(*keys));
+   buildmap_check_allocated(keys);
+
    for (i = 0; i < TurnsCount; i++) {
       SortedTurns[i] = i;
+      one_turn = Turns[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (one_turn->from_line, one_turn->to_line);
+   }
+   buildmap_sort_on_key (SortedTurns, TurnsCount, keys);
+
+   for (i = 0; i < TurnsCount; i++) {
+      one_turn = Turns[i/BUILDMAP_BLOCK] + (i % BUILDMAP_BLOCK);
+      keys[i] = buildmap_sort_key (one_turn->node, 0);
    }
+   buildmap_sort_on_key (SortedTurns, TurnsCount, keys);
 
-   qsort (SortedTurns, TurnsCount, sizeof(int), buildmap_turns_compare);
+   free (keys);
 }
 
 /**
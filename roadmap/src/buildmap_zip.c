@@ -226,7 +226,8 @@ static buildmap_db_module BuildMapZipModule = {
    NULL,
    buildmap_zip_save,
    buildmap_zip_summary,
-   buildmap_zip_reset
+   buildmap_zip_reset,
+   NULL
 };
 
 
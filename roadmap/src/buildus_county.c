@@ -669,6 +669,7 @@ static buildmap_db_module BuildUsCountyModule = {
    buildus_county_sort,
    buildus_county_save,
    NULL,
+   NULL,
    NULL
 };
 
@@ -35,6 +35,8 @@
 #include "roadmap_dictionary.h"
 #include "roadmap_metadata.h"
 #include "roadmap_index.h"
+#include "roadmap_packed.h"
+#include "roadmap_time.h"
 #include "buildmap_opt.h"
 
 
@@ -46,6 +48,7 @@ static int   DumpMapVerbose = 0;
 static int   DumpMapShowStrings = 0;
 static int   DumpMapShowAttributes = 0;
 static int   DumpMapShowIndex = 0;
+static int   DumpMapBenchmark = 0;
 static char *DumpMapShowDump = "";
 static char *DumpMapShowVolume = "";
 static char *DumpMapSearchStringOption = "";
@@ -439,6 +442,116 @@ roadmap_db_handler DumpMapHexaDump =
     {"hexadump", dumpmap_hexadump_map, NULL, NULL};
 
 
+/**
+ * Benchmark module
+ *
+ * Measure how fast the coordinate tables (point, shape) can be read,
+ * to compare the fixed size tables with the compressed ones.
+ */
+
+#define DUMPMAP_BENCHMARK_MILLIS  500
+
+/* keeps the timed loops from being optimized out */
+static volatile unsigned int DumpMapBenchmarkSink;
+
+static void *dumpmap_benchmark_map (roadmap_db *root) {
+
+   roadmap_db *data_table;
+   const unsigned short *data = NULL;
+   RoadMapPacked *packed = NULL;
+   const unsigned short *values;
+   unsigned long start;
+   unsigned long elapsed;
+   unsigned int random;
+   unsigned int sum = 0;
+   unsigned int checksum = 0;
+   int count;
+   int size;
+   int loops;
+   int i;
+
+   data_table = roadmap_db_get_subsection (root, "data");
+
+   if (data_table != NULL) {
+      data = (const unsigned short *) roadmap_db_get_data (data_table);
+      count = roadmap_db_get_count (data_table);
+      size = roadmap_db_get_size (data_table);
+   } else {
+      packed = roadmap_packed_map (root);
+      if (packed == NULL) return "OK";
+      count = roadmap_packed_count (packed);
+      size = roadmap_packed_size (packed);
+   }
+
+   fprintf (out, "%s: %d records, %s, ",
+            roadmap_db_get_name (root), count,
+            packed != NULL ? "compressed" : "fixed size");
+   dumpmap_show_size (size);
+   if (count > 0) {
+      fprintf (out, " (%d.%02d bytes per record)",
+               size / count, (100 * (size % count)) / count);
+   }
+   fprintf (out, "\n");
+
+   if (count == 0) {
+      if (packed != NULL) roadmap_packed_unmap (packed);
+      return "OK";
+   }
+
+   /* The checksum covers one pass, so that it does not depend on the
+    * speed of the machine and can be compared between two maps.
+    */
+   for (i = 0; i < count; ++i) {
+      values = (packed != NULL) ? roadmap_packed_get (packed, i) : data + 2*i;
+      checksum = checksum * 31 + values[0];
+      checksum = checksum * 31 + values[1];
+   }
+
+   start = roadmap_time_get_millis ();
+   loops = 0;
+   do {
+      for (i = 0; i < count; ++i) {
+         values = (packed != NULL) ? roadmap_packed_get (packed, i) : data + 2*i;
+         sum += values[0] + values[1];
+      }
+      loops += 1;
+      elapsed = roadmap_time_get_millis () - start;
+   } while (elapsed < DUMPMAP_BENCHMARK_MILLIS);
+
+   fprintf (out, "   sequential: %.1f Mrecords/s\n",
+            ((double)loops * count) / (elapsed * 1000.0));
+
+   start = roadmap_time_get_millis ();
+   random = 1;
+   loops = 0;
+   do {
+      for (i = 0; i < count; ++i) {
+         int index;
+         random = random * 1103515245 + 12345;
+         index = (random >> 8) % count;
+         values = (packed != NULL) ?
+                     roadmap_packed_get (packed, index) : data + 2*index;
+         sum += values[0] + values[1];
+      }
+      loops += 1;
+      elapsed = roadmap_time_get_millis () - start;
+   } while (elapsed < DUMPMAP_BENCHMARK_MILLIS);
+
+   fprintf (out, "   random:     %.1f Mrecords/s\n",
+            ((double)loops * count) / (elapsed * 1000.0));
+   fprintf (out, "   checksum:   %08x\n", checksum);
+
+   DumpMapBenchmarkSink = sum;
+
+   if (packed != NULL) roadmap_packed_unmap (packed);
+
+   return "OK";
+}
+
+roadmap_db_handler DumpMapBenchmarkHandler =
+    {"benchmark", dumpmap_benchmark_map, NULL, NULL};
+
+
 /**
  * Main program.
  */
@@ -455,6 +568,8 @@ struct opt_defs options[] = {
         "Show map attributes"},
    {"index", "i", opt_flag, "0",
         "Show map index"},
+   {"benchmark", "", opt_flag, "0",
+        "Measure the size and read speed of the coordinate tables"},
    {"verbose", "v", opt_flag, "0",
         "Show more progress information"},
    OPT_DEFS_END
@@ -500,7 +615,8 @@ int main (int argc, char **argv) {
            opt_val("search", &DumpMapSearchStringOption) ||
            opt_val("dump", &DumpMapShowDump) ||
            opt_val("attributes", &DumpMapShowAttributes) ||
-           opt_val("index", &DumpMapShowIndex);
+           opt_val("index", &DumpMapShowIndex) ||
+           opt_val("benchmark", &DumpMapBenchmark);
    if (error)
       usage(argv[0], opt_strerror(error));
 
@@ -537,6 +653,15 @@ int main (int argc, char **argv) {
          roadmap_db_register
             (RoadMapModel, "/", &DumpMapSearchString);
 
+   } else if (DumpMapBenchmark) {
+
+      RoadMapModel =
+         roadmap_db_register
+            (RoadMapModel, "point", &DumpMapBenchmarkHandler);
+      RoadMapModel =
+         roadmap_db_register
+            (RoadMapModel, "shape", &DumpMapBenchmarkHandler);
+
    } else if (*DumpMapShowDump) {
 
       RoadMapModel =
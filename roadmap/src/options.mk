@@ -195,7 +195,7 @@ endif
 
 # libreadosm support needed for building OSM maps
 ifneq ($(strip $(READOSM)),NO)
-	LIBS += -lreadosm
+	LIBS += -lreadosm -lz -lpthread
 endif
 
 # rotation support in QT/QPE?
@@ -328,6 +328,10 @@ static void rdmxchange_dictionary_save_one (buildmap_db *root,
    }
    memcpy (db_data, volume->data, volume->size);
 
+   /* The hash table is not exported: it is rebuilt from the strings. */
+   buildmap_dictionary_add_hash
+      (child, volume->data, volume->string_index, volume->string_count);
+
    /* Do not save this data ever again. */
    free (volume->tree);
    free (volume->node);
@@ -380,7 +384,7 @@ static struct dictionary_volume *rdmxchange_dictionary_find (const char *name) {
 
 static void rdmxchange_dictionary_import_table (const char *name, int count) {
 
-   char *p;
+   const char *p;
    struct dictionary_volume *volume;
 
 
@@ -388,13 +392,16 @@ static void rdmxchange_dictionary_import_table (const char *name, int count) {
 
    if (strncmp (name, "string/", 7) == 0) {
 
-      /* Separate the volume name. */
+      /* Separate the volume name: p must not point into the copy,
+       * which is released below if the volume already exists.
+       */
 
       char *volume_name = strdup (name + 7);
 
-      p = strchr (volume_name, '/');
+      p = strchr (name + 7, '/');
       if (p == NULL) buildmap_fatal (1, "invalid table name %s", name);
-      *(p++) = 0;
+      volume_name[p - (name + 7)] = 0;
+      p++;
 
       /* Retrieve the volume, or create a new one. */
 
@@ -286,7 +286,8 @@ int main (int argc, const char **argv) {
 
          if (strcasecmp (argv[i], "-h") == 0 ||
                strcasecmp (argv[i], "--help") == 0) {
-            printf ("Usage: rdmxchange [-v|--verbose] [--path=path] file ...\n");
+            printf ("Usage: rdmxchange [-v|--verbose] [--path=path] "
+                    "[--packed] file ...\n");
             exit(0);
          }
 
@@ -303,6 +304,11 @@ int main (int argc, const char **argv) {
 
             RdmXchangePath = strdup(argv[i]+7);
          }
+         else if (strcasecmp (argv[i], "--packed") == 0) {
+
+            /* The maps imported after this option are compressed. */
+            buildmap_packed_enable (1);
+         }
          else {
             fprintf (stderr, "invalid option %s\n", argv[i]);
             exit(1);
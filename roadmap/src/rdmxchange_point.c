@@ -27,6 +27,7 @@
 
 #include "roadmap.h"
 #include "roadmap_dbread.h"
+#include "roadmap_packed.h"
 
 #include "rdmxchange.h"
 
@@ -39,6 +40,7 @@ typedef struct {
 
    RoadMapPoint *Point;
    int           PointCount;
+   int           PointUnpacked;
 
    RoadMapPointBySquare *BySquare;
    int                   BySquareCount;
@@ -69,18 +71,44 @@ static void *rdmxchange_point_map (roadmap_db *root) {
 
    context->BySquare =
       (RoadMapPointBySquare *) roadmap_db_get_data (bysquare_table);
-   context->Point = (RoadMapPoint *) roadmap_db_get_data (point_table);
-
    context->BySquareCount = roadmap_db_get_count (bysquare_table);
-   context->PointCount    = roadmap_db_get_count (point_table);
 
    if (roadmap_db_get_size(bysquare_table) !=
           context->BySquareCount * sizeof(RoadMapPointBySquare)) {
       roadmap_log (ROADMAP_FATAL, "invalid point/bysquare structure");
    }
-   if (roadmap_db_get_size(point_table) !=
-          context->PointCount * sizeof(RoadMapPoint)) {
-      roadmap_log (ROADMAP_FATAL, "invalid point/data structure");
+
+   if (point_table != NULL) {
+
+      context->Point = (RoadMapPoint *) roadmap_db_get_data (point_table);
+      context->PointCount = roadmap_db_get_count (point_table);
+      context->PointUnpacked = 0;
+
+      if (roadmap_db_get_size(point_table) !=
+             context->PointCount * sizeof(RoadMapPoint)) {
+         roadmap_log (ROADMAP_FATAL, "invalid point/data structure");
+      }
+
+   } else {
+
+      /* A compressed map: export the points as if it was not. */
+      RoadMapPacked *packed = roadmap_packed_map (root);
+      int i;
+
+      if (packed == NULL) {
+         roadmap_log (ROADMAP_FATAL, "no point/data table");
+      }
+      context->PointCount = roadmap_packed_count (packed);
+      context->Point = calloc (context->PointCount + 1, sizeof(RoadMapPoint));
+      roadmap_check_allocated(context->Point);
+      context->PointUnpacked = 1;
+
+      for (i = 0; i < context->PointCount; ++i) {
+         const unsigned short *values = roadmap_packed_get (packed, i);
+         context->Point[i].longitude = values[0];
+         context->Point[i].latitude  = values[1];
+      }
+      roadmap_packed_unmap (packed);
    }
 
    rdmxchange_point_register_export();
@@ -106,6 +134,9 @@ static void rdmxchange_point_unmap (void *context) {
    if (point_context == RoadMapPointActive) {
       RoadMapPointActive = NULL;
    }
+   if (point_context->PointUnpacked) {
+      free (point_context->Point);
+   }
    free (point_context);
 }
 
@@ -191,22 +222,30 @@ static void rdmxchange_point_save (void) {
    root  = buildmap_db_add_section (NULL, "point");
    if (root == NULL) buildmap_fatal (0, "Can't add a new section");
 
-   table_data = buildmap_db_add_section (root, "data");
-   if (table_data == NULL) buildmap_fatal (0, "Can't add a new section");
-   buildmap_db_add_data (table_data, PointCount, sizeof(RoadMapPoint));
+   if (buildmap_packed_enabled ()) {
+      table_data = NULL;
+   } else {
+      table_data = buildmap_db_add_section (root, "data");
+      if (table_data == NULL) buildmap_fatal (0, "Can't add a new section");
+      buildmap_db_add_data (table_data, PointCount, sizeof(RoadMapPoint));
+   }
 
    table_bysquare = buildmap_db_add_section (root, "bysquare");
    if (table_bysquare == NULL) buildmap_fatal (0, "Can't add a new section");
    buildmap_db_add_data
       (table_bysquare, PointBySquareCount, sizeof(RoadMapPointBySquare));
 
-   db_points   = (RoadMapPoint *) buildmap_db_get_data (table_data);
    db_bysquare = (RoadMapPointBySquare *) buildmap_db_get_data (table_bysquare);
 
    /* Fill the data in. */
 
-   for (i = 0; i < PointCount; ++i) {
-      db_points[i] = Point[i];
+   if (table_data != NULL) {
+      db_points = (RoadMapPoint *) buildmap_db_get_data (table_data);
+      for (i = 0; i < PointCount; ++i) {
+         db_points[i] = Point[i];
+      }
+   } else {
+      buildmap_packed_add (root, (const unsigned short *) Point, PointCount);
    }
 
    for (i = 0; i < PointBySquareCount; ++i) {
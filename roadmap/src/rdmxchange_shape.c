@@ -36,6 +36,7 @@
 
 #include "roadmap.h"
 #include "roadmap_dbread.h"
+#include "roadmap_packed.h"
 
 #include "rdmxchange.h"
 
@@ -50,6 +51,7 @@ typedef struct {
 
    RoadMapShape *Shape;
    int           ShapeCount;
+   int           ShapeUnpacked;
 
    RoadMapShapeByLine *ShapeByLine;
    int                 ShapeByLineCount;
@@ -83,12 +85,36 @@ static void *rdmxchange_shape_map (roadmap_db *root) {
    line_table   = roadmap_db_get_subsection (root, "byline");
    square_table = roadmap_db_get_subsection (root, "bysquare");
 
-   context->Shape = (RoadMapShape *) roadmap_db_get_data (shape_table);
-   context->ShapeCount = roadmap_db_get_count (shape_table);
+   if (shape_table != NULL) {
 
-   if (roadmap_db_get_size (shape_table) !=
-       context->ShapeCount * sizeof(RoadMapShape)) {
-      roadmap_log (ROADMAP_FATAL, "invalid shape/data structure");
+      context->Shape = (RoadMapShape *) roadmap_db_get_data (shape_table);
+      context->ShapeCount = roadmap_db_get_count (shape_table);
+      context->ShapeUnpacked = 0;
+
+      if (roadmap_db_get_size (shape_table) !=
+          context->ShapeCount * sizeof(RoadMapShape)) {
+         roadmap_log (ROADMAP_FATAL, "invalid shape/data structure");
+      }
+
+   } else {
+
+      RoadMapPacked *packed = roadmap_packed_map (root);
+      int i;
+
+      if (packed == NULL) {
+         roadmap_log (ROADMAP_FATAL, "no shape/data table");
+      }
+      context->ShapeCount = roadmap_packed_count (packed);
+      context->Shape = calloc (context->ShapeCount + 1, sizeof(RoadMapShape));
+      roadmap_check_allocated(context->Shape);
+      context->ShapeUnpacked = 1;
+
+      for (i = 0; i < context->ShapeCount; ++i) {
+         const unsigned short *values = roadmap_packed_get (packed, i);
+         context->Shape[i].delta_longitude = (short) values[0];
+         context->Shape[i].delta_latitude  = (short) values[1];
+      }
+      roadmap_packed_unmap (packed);
    }
 
    context->ShapeByLine =
@@ -138,6 +164,9 @@ static void rdmxchange_shape_unmap (void *context) {
    if (RoadMapShapeActive == shape_context) {
       RoadMapShapeActive = NULL;
    }
+   if (shape_context->ShapeUnpacked) {
+      free (shape_context->Shape);
+   }
    free(shape_context);
 }
 
@@ -252,13 +281,16 @@ static void rdmxchange_shape_save (void) {
    buildmap_db_add_data (table_line,
          ShapeByLineCount, sizeof(RoadMapShapeByLine));
 
-   table_data = buildmap_db_add_section (root, "data");
-   if (table_data == NULL) buildmap_fatal (0, "Can't add a new section");
-   buildmap_db_add_data (table_data, ShapeCount, sizeof(RoadMapShape));
+   if (buildmap_packed_enabled ()) {
+      table_data = NULL;
+   } else {
+      table_data = buildmap_db_add_section (root, "data");
+      if (table_data == NULL) buildmap_fatal (0, "Can't add a new section");
+      buildmap_db_add_data (table_data, ShapeCount, sizeof(RoadMapShape));
+   }
 
    db_bysquare = (RoadMapShapeBySquare *) buildmap_db_get_data (table_square);
    db_byline = (RoadMapShapeByLine *) buildmap_db_get_data (table_line);
-   db_shape  = (RoadMapShape *) buildmap_db_get_data (table_data);
 
 
    for (i = ShapeBySquareCount-1; i >= 0; --i) {
@@ -269,8 +301,13 @@ static void rdmxchange_shape_save (void) {
       db_byline[i] = ShapeByLine[i];
    }
 
-   for (i = ShapeCount-1; i >= 0; --i) {
-      db_shape[i] = Shape[i];
+   if (table_data != NULL) {
+      db_shape = (RoadMapShape *) buildmap_db_get_data (table_data);
+      for (i = ShapeCount-1; i >= 0; --i) {
+         db_shape[i] = Shape[i];
+      }
+   } else {
+      buildmap_packed_add (root, (const unsigned short *) Shape, ShapeCount);
    }
 
    /* Do not save this data ever again. */
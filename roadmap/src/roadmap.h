@@ -93,6 +93,7 @@ char *roadmap_userpath (void);
 char *roadmap_icon_path (void);
 
 int roadmap_option_cache  (void);
+int roadmap_option_cache_memory (void);
 int roadmap_option_width  (const char *name);
 int roadmap_option_height (const char *name);
 
@@ -102,9 +103,15 @@ typedef void (*RoadMapUsage) (const char *section);
 void roadmap_option (int argc, char **argv, int pass, RoadMapUsage usage);
 
 
-/* This function is hidden by a macro: */
+/* This function is hidden by a macro. It only tests the pointer, which
+ * gcc would otherwise take as a read of the memory just allocated.
+ */
 void roadmap_check_allocated_with_source_line
-                (const char *source, int line, const void *allocated);
+                (const char *source, int line, const void *allocated)
+#if defined(__GNUC__) && (__GNUC__ >= 10)
+                __attribute__ ((access (none, 3)))
+#endif
+                ;
 
 typedef void (* RoadMapCallback) (void);
 
@@ -31,6 +31,9 @@
  *   string.*.tree      for each node, the list of children nodes.
  *   string.*.node      the tree nodes, reference either a tree branch
  *                      or a leaf (i.e. the offset to the string data).
+ *   string.*.index     the offset of each string in the data buffer.
+ *   string.*.hash      a hash table of the string indexes, for exact
+ *                      searches (optional: older maps do not have it).
  *
  *   The tree structure speeds up the retrieval of a given string. It is also
  *   designed to help enter a string by predicting which characters are
@@ -77,6 +80,15 @@ struct roadmap_dictionary_tree {
 #endif
 };
 
+/**
+ * Layout of tables string.*.hash
+ *
+ * An open addressing table of RoadMapString, with a power of 2 size at
+ * least twice the number of strings.  A string goes into the slot given
+ * by roadmap_dictionary_hash(), or into the next free slot after it.
+ * Index 0 (the empty string) marks a free slot.
+ */
+
 typedef struct roadmap_dictionary_reference RoadMapDictionaryReference;
 typedef struct roadmap_dictionary_tree      RoadMapDictionaryTree;
 
@@ -0,0 +1,44 @@
+/* roadmap_db_packed.h - the compressed form of the coordinate tables.
+ *
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   The tables made of pairs of 16 bits values (point.data, shape.data)
+ *   can be replaced with these two tables (.rdm v2), when this makes them
+ *   smaller:
+ *
+ *   xxx.packed   the records, in blocks of ROADMAP_DB_PACKED_BLOCK records.
+ *                The count of this section is the number of records.
+ *   xxx.blocks   the offset of each block in xxx.packed, followed by the
+ *                size of xxx.packed.
+ *
+ *   In a block, each value is stored as its difference with the same
+ *   value of the previous record (or 0 for the first record), modulo
+ *   65536. The difference is zigzag encoded (0, -1, 1, -2.. give 0, 1,
+ *   2, 3..) and written 7 bits per byte, least significant bits first,
+ *   with the high bit set on all the bytes but the last one.
+ */
+
+#ifndef _ROADMAP_DB_PACKED__H_
+#define _ROADMAP_DB_PACKED__H_
+
+#define ROADMAP_DB_PACKED_BLOCK  64
+
+#endif // _ROADMAP_DB_PACKED__H_
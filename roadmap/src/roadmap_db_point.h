@@ -26,6 +26,9 @@
  *
  *   point.bysquare   for each square, the list of points in that square.
  *   point.data       the point position, relative to the center of the square.
+ *
+ *   The points are stored in square order, and every square has points:
+ *   the square of a point is the last square starting at or before it.
  */
 
 #ifndef _ROADMAP_DB_POINT__H_
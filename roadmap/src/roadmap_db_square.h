@@ -33,6 +33,10 @@
  *   square.global     Some global information regarding the territory.
  *   square.data       The position of each square.
  *
+ *   The squares are stored along a Hilbert curve over the grid, not in
+ *   grid order: the position of a square is its index in the grid
+ *   (column-major), and readers must map it to the data index.
+ *
  *   The square are built so that a relative location fits into a signed
  *   16 bits value.
  */
@@ -34,6 +34,7 @@
 #include "roadmap_file.h"
 
 #include "roadmap.h"
+#include "roadmap_time.h"
 #include "roadmap_dbread.h"
 
 /**
@@ -49,6 +50,9 @@ typedef struct roadmap_db_database_s {
    int   size;
    roadmap_db root;
 
+   roadmap_db *sections;   /**< all the sections but the root, in one block */
+   int section_count;
+
    struct roadmap_db_database_s *next;
    struct roadmap_db_database_s *previous;
 
@@ -58,6 +62,22 @@ typedef struct roadmap_db_database_s {
 
 static roadmap_db_database *RoadmapDatabaseFirst  = NULL;
 
+static int           RoadMapDbOpenCount = 0;
+static unsigned long RoadMapDbOpenTotal = 0;
+static unsigned long RoadMapDbOpenMax   = 0;
+
+/**
+ * @brief how the pages of the sections are expected to be accessed
+ *
+ * The sections listed here are used every time the map is searched or
+ * drawn, so they are read in advance. The small sections are mostly
+ * headers and are read in advance as well. The other sections are
+ * accessed square by square: read-ahead would only load unused pages.
+ */
+static const char *RoadMapDbPreloaded[] = {"square", "metadata", NULL};
+
+#define ROADMAP_DB_SMALL_SECTION 16384
+
 
 
 /**
@@ -97,48 +117,113 @@ static roadmap_db_database *roadmap_db_find (const char *path,
    return NULL;
 }
 
+/**
+ * @brief count the sections below a section, to size the section directory
+ * @param database
+ * @param head
+ * @return the number of sections
+ */
+static int roadmap_db_count_sections
+               (roadmap_db_database *database,
+                struct roadmap_db_section *head) {
+
+   int count = 0;
+   int child_offset;
+   struct roadmap_db_section *child;
+
+   if (head->first < 0) {
+      roadmap_log (ROADMAP_FATAL, "section %s: head.first invalid", head->name);
+   }
+
+   for (child_offset = head->first;
+        child_offset > 0;
+        child_offset = child->next) {
+
+      if (child_offset >= database->size) {
+         roadmap_log (ROADMAP_FATAL,
+                      "illegal offset %d in database %s",
+                      child_offset,
+                      database->name);
+      }
+
+      child = roadmap_db_locate (database, (child_offset + 7) & (~7));
+
+      count += 1 + roadmap_db_count_sections (database, child);
+   }
+
+   if (child_offset < 0) {
+      roadmap_log (ROADMAP_FATAL,
+                   "illegal offset %d in database %s",
+                   child_offset,
+                   database->name);
+   }
+
+   return count;
+}
+
+/**
+ * @brief tell the OS how the data of a section will be accessed
+ * @param database
+ * @param section a section without subsections
+ * @param preload the section belongs to a table that is always used
+ */
+static void roadmap_db_advise
+               (roadmap_db_database *database, roadmap_db *section,
+                int preload) {
+
+   int offset = (char *)(section->head + 1) - database->base;
+   int size = section->head->size;
+
+   if (size <= 0 || offset + size > database->size) return;
+
+   if (preload || size <= ROADMAP_DB_SMALL_SECTION) {
+      roadmap_file_advise
+         (database->file, offset, size, ROADMAP_FILE_ADVISE_WILLNEED);
+   } else {
+      roadmap_file_advise
+         (database->file, offset, size, ROADMAP_FILE_ADVISE_RANDOM);
+   }
+}
+
 /**
  * @brief
  * @param database
  * @param parent
+ * @param preload all subsections are read in advance
  */
 static void roadmap_db_make_tree
-               (roadmap_db_database *database, roadmap_db *parent) {
+               (roadmap_db_database *database, roadmap_db *parent,
+                int preload) {
 
+   int i;
    int child_offset;
    roadmap_db *child = NULL;
 
+   parent->first = NULL;
+   parent->last = NULL;
+
    if (parent->head->first <= 0) {
-      if (parent->head->first < 0) {
-         roadmap_log (ROADMAP_FATAL,
-                      "section %s: head.first invalid", parent->head->name);
+      if (parent != &database->root) {
+         roadmap_db_advise (database, parent, preload);
       }
-      parent->first = NULL;
-      parent->last = NULL;
       return;
    }
 
-   parent->first = NULL;
-
    for (child_offset = parent->head->first;
         child_offset != 0;
         child_offset = child->head->next) {
 
-      if ((child_offset < 0) || (child_offset >= database->size)) {
-         roadmap_log (ROADMAP_FATAL,
-                      "illegal offset %d in database %s",
-                      child_offset,
-                      database->name);
-      }
-
       child_offset = (child_offset + 7) & (~7);
 
-      child = (roadmap_db *) malloc (sizeof(roadmap_db));
+      child = database->sections + database->section_count++;
 
       child->head = roadmap_db_locate (database, child_offset);
       child->parent = parent;
+      child->first = NULL;
+      child->last = NULL;
       child->next = NULL;
       child->level = parent->level + 1;
+      child->handler_context = NULL;
 
       if (parent->first == NULL) {
          parent->first = child;
@@ -147,31 +232,17 @@ static void roadmap_db_make_tree
       }
       parent->last = child;
 
-      roadmap_db_make_tree (database, child);
-
-      if (child->head->next > 0) {
-         int aligned = (child->head->next + 7) & (~7);
-         child->next = (roadmap_db *) (database->base + aligned);
-      } else {
-         child->next = NULL;
+      if (parent == &database->root) {
+         preload = 0;
+         for (i = 0; RoadMapDbPreloaded[i] != NULL; ++i) {
+            if (strcasecmp (child->head->name, RoadMapDbPreloaded[i]) == 0) {
+               preload = 1;
+               break;
+            }
+         }
       }
-   }
-}
 
-/**
- * @brief
- * @param parent
- */
-static void roadmap_db_free_subtree (roadmap_db *parent) {
-
-   roadmap_db *child;
-   roadmap_db *next;
-
-   for (child = parent->first; child != NULL; child = next) {
-
-      roadmap_db_free_subtree (child);
-      next = child->next;
-      free (child);
+      roadmap_db_make_tree (database, child, preload);
    }
 }
 
@@ -342,7 +413,7 @@ static void roadmap_db_close_database (roadmap_db_database *database) {
 
       roadmap_db_call_unmap (database);
 
-      roadmap_db_free_subtree (&database->root);
+      free (database->sections);
    }
 
    if (database->file != NULL) {
@@ -426,12 +497,16 @@ int roadmap_db_open (const char *path,
 
    RoadMapFileContext   file;
    roadmap_db_database *database = roadmap_db_find (path, name);
+   unsigned long        start;
+   unsigned long        elapsed;
 
    if (database != NULL) {
       roadmap_db_call_activate (database);
       return 1; /* Already open. */
    }
 
+   start = roadmap_time_get_millis ();
+
    if (roadmap_file_map (path, name, "r", &file) == NULL) {
 
       roadmap_log (ROADMAP_INFO,
@@ -439,8 +514,6 @@ int roadmap_db_open (const char *path,
       return 0;
    }
 
-   roadmap_log (ROADMAP_INFO, "Opening database file %s in %s", name, path);
-
    database = malloc(sizeof(*database));
    roadmap_check_allocated(database);
 
@@ -462,9 +535,19 @@ int roadmap_db_open (const char *path,
 
    database->root.head = (struct roadmap_db_section *) database->base;
    database->root.parent = NULL;
+   database->root.next = NULL;
    database->root.level = 0;
+   database->root.handler_context = NULL;
+
+   /* All the sections are described in one block, allocated at once. */
+   database->section_count =
+      roadmap_db_count_sections (database, database->root.head);
+   database->sections =
+      calloc (database->section_count + 1, sizeof(roadmap_db));
+   roadmap_check_allocated(database->sections);
 
-   roadmap_db_make_tree (database, &database->root);
+   database->section_count = 0;
+   roadmap_db_make_tree (database, &database->root, 0);
 
    if (! roadmap_db_call_map  (database)) {
       roadmap_db_close_database (database);
@@ -473,6 +556,16 @@ int roadmap_db_open (const char *path,
 
    roadmap_db_call_activate (database);
 
+   elapsed = roadmap_time_get_millis () - start;
+
+   RoadMapDbOpenCount += 1;
+   RoadMapDbOpenTotal += elapsed;
+   if (elapsed > RoadMapDbOpenMax) RoadMapDbOpenMax = elapsed;
+
+   roadmap_log (ROADMAP_INFO,
+                "Opened database file %s in %s (%d sections, %lu ms)",
+                name, path, database->section_count, elapsed);
+
    return 1;
 }
 
@@ -496,6 +589,19 @@ void roadmap_db_activate (const char *path, const char *name) {
    roadmap_db_call_activate (database);
 }
 
+/**
+ * @brief the size of a database file, as mapped in memory
+ * @param path directory name
+ * @param name file name
+ * @return the size in bytes, 0 if the database is not open
+ */
+int roadmap_db_size (const char *path, const char *name) {
+
+   roadmap_db_database *database = roadmap_db_find (path, name);
+
+   return (database != NULL) ? database->size : 0;
+}
+
 /**
  * @brief
  * @param parent
@@ -659,17 +765,30 @@ void roadmap_db_close (const char *path, const char *name) {
 }
 
 
+/**
+ * @brief report how long opening the databases took
+ */
+void roadmap_db_summary (void) {
+
+   if (RoadMapDbOpenCount <= 0) return;
+
+   roadmap_log (ROADMAP_INFO,
+                "%d databases opened in %lu ms (average %lu ms, max %lu ms)",
+                RoadMapDbOpenCount,
+                RoadMapDbOpenTotal,
+                RoadMapDbOpenTotal / RoadMapDbOpenCount,
+                RoadMapDbOpenMax);
+}
+
+
 /**
  * @brief close all databases
  */
 void roadmap_db_end (void) {
 
-   roadmap_db_database *database;
+   roadmap_db_summary ();
 
-   for (database = RoadmapDatabaseFirst;
-        database != NULL;
-        database = database->next) {
-
-      roadmap_db_close_database (database);
+   while (RoadmapDatabaseFirst != NULL) {
+      roadmap_db_close_database (RoadmapDatabaseFirst);
    }
 }
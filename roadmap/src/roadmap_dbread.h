@@ -80,6 +80,7 @@ int  roadmap_db_open (const char *path,
                       const char *name, roadmap_db_model *model);
 
 void roadmap_db_activate (const char *path, const char *name);
+int  roadmap_db_size     (const char *path, const char *name);
 
 roadmap_db *roadmap_db_get_subsection (roadmap_db *parent, char *path);
 
@@ -94,4 +95,6 @@ roadmap_db *roadmap_db_get_next  (roadmap_db *section);
 void roadmap_db_close (const char *path, const char *name);
 void roadmap_db_end   (void);
 
+void roadmap_db_summary (void);
+
 #endif // INCLUDED__ROADMAP_DBREAD__H
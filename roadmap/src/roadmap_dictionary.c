@@ -35,6 +35,9 @@
  * - the references are indexes into an indirection table (to keep
  *   the references small), either the string table (leaf)
  *   or the node table (node).
+ *
+ * The tree follows one reference list per character.  A whole string
+ * is found faster through the hash table that recent maps include.
  */
 
 #include <stdio.h>
@@ -60,6 +63,9 @@ struct dictionary_volume {
    unsigned int *string_index;
    int string_count;
 
+   RoadMapString *hash;
+   unsigned int   hash_mask;
+
    char *data;
    int   size;
 };
@@ -255,6 +261,16 @@ static struct dictionary_volume *
    dictionary->string_index = (unsigned int *) roadmap_db_get_data (table);
    dictionary->string_count = roadmap_db_get_count (table);
 
+   table = roadmap_db_get_subsection (child, "hash");
+
+   if (table != NULL) {
+      dictionary->hash = (RoadMapString *) roadmap_db_get_data (table);
+      dictionary->hash_mask = roadmap_db_get_count (table) - 1;
+   } else {
+      dictionary->hash = NULL;
+      dictionary->hash_mask = 0;
+   }
+
    return dictionary;
 }
 
@@ -517,10 +533,42 @@ void roadmap_dictionary_free_cursor (RoadMapDictionaryCursor c) {
 }
 
 
+/**
+ * @brief the hash of a string, regardless of its case
+ * @param string
+ * @return the hash value (32 bits FNV-1a)
+ */
+unsigned int roadmap_dictionary_hash (const char *string) {
+
+   unsigned int hash = 2166136261U;
+
+   while (*string != 0) {
+      hash ^= (unsigned char) tolower((unsigned char) *(string++));
+      hash *= 16777619U;
+   }
+   return hash;
+}
+
+
 RoadMapString roadmap_dictionary_locate (RoadMapDictionary d,
                                          const char *string) {
 
    int result;
+   unsigned int slot;
+
+   if (d->hash != NULL) {
+
+      for (slot = roadmap_dictionary_hash (string) & d->hash_mask;
+           d->hash[slot] != 0;
+           slot = (slot + 1) & d->hash_mask) {
+
+         if (strcasecmp
+                (string, d->data + d->string_index[d->hash[slot]]) == 0) {
+            return d->hash[slot];
+         }
+      }
+      return 0;
+   }
 
    result = roadmap_dictionary_search (d, string, strlen(string));
 
@@ -48,6 +48,7 @@ void roadmap_dictionary_free_cursor (RoadMapDictionaryCursor c);
 
 RoadMapString roadmap_dictionary_locate (RoadMapDictionary d,
                                          const char *string);
+unsigned int  roadmap_dictionary_hash   (const char *string);
 void          roadmap_dictionary_dump   (void);
 void          roadmap_dictionary_dump_volume (char *name);
 
@@ -41,6 +41,7 @@
 #include "roadmap_screen.h"
 #include "roadmap_state.h"
 #include "roadmap_locator.h"
+#include "roadmap_osm.h"
 #include "roadmap_messagebox.h"
 #include "roadmap_dialog.h"
 #include "roadmap_start.h"
@@ -400,6 +401,7 @@ static void roadmap_download_ok (const char *name, void *context) {
 
             roadmap_download_uncompress (destination);
             RoadMapDownloadRefresh = 1;
+            if (fips < 0) roadmap_osm_tiles_changed ();
          }
          roadmap_download_unblock (fips);
          roadmap_start_unfreeze ();
@@ -34,6 +34,11 @@
  *
  *   The function roadmap_file_map() maps the given file into memory and
  *   returns the base address of the mapping, or NULL if the mapping failed.
+ *   The function roadmap_file_advise() tells how a part of a mapped file
+ *   will be accessed. This is only a hint: it may do nothing.
+ *   The function roadmap_file_prefetch() asks the OS to read a whole file
+ *   in the background, without opening it for RoadMap. It may do nothing
+ *   as well.
  *
  *   Any function that takes a path and name parameter follows the
  *   conventions as set for roadmap_path_join(), i.e. the path parameter
@@ -70,6 +75,7 @@ void  roadmap_file_close (RoadMapFile file);
 void  roadmap_file_remove (const char *path, const char *name);
 int   roadmap_file_exists (const char *path, const char *name);
 int   roadmap_file_length (const char *path, const char *name);
+void  roadmap_file_prefetch (const char *path, const char *name);
 int   roadmap_file_rename (const char *path, const char *name, const char *newname);
 void  roadmap_file_backup (const char *path, const char *name);
 
@@ -98,6 +104,12 @@ const char *roadmap_file_map (const char *path,
 void *roadmap_file_base (RoadMapFileContext file);
 int   roadmap_file_size (RoadMapFileContext file);
 
+#define ROADMAP_FILE_ADVISE_RANDOM   0
+#define ROADMAP_FILE_ADVISE_WILLNEED 1
+
+void  roadmap_file_advise (RoadMapFileContext file,
+                           int offset, int size, int advice);
+
 void roadmap_file_unmap (RoadMapFileContext *file);
 
 const char *roadmap_file_unique (const char *base);
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <math.h>
 
 #include "roadmap.h"
 #include "roadmap_types.h"
@@ -37,6 +38,7 @@
 #include "roadmap_object.h"
 #include "roadmap_config.h"
 #include "roadmap_messagebox.h"
+#include "roadmap_time.h"
 
 #include "roadmap_net.h"
 #include "roadmap_file.h"
@@ -77,6 +79,18 @@ static RoadMapConfigDescriptor RoadMapConfigGPSTimeout =
 static RoadMapConfigDescriptor RoadMapConfigGPSLostFixTimeout =
                         ROADMAP_CONFIG_ITEM("GPS", "LostFixWarningTimeout");
 
+static RoadMapConfigDescriptor RoadMapConfigGPSFilter =
+                        ROADMAP_CONFIG_ITEM("GPS", "Filter");
+
+static RoadMapConfigDescriptor RoadMapConfigGPSFilterAcceleration =
+                        ROADMAP_CONFIG_ITEM("GPS", "Filter Acceleration");
+
+static RoadMapConfigDescriptor RoadMapConfigGPSDisplayLatency =
+                        ROADMAP_CONFIG_ITEM("GPS", "Display Latency");
+
+static RoadMapConfigDescriptor RoadMapConfigGPSListenerInterval =
+                        ROADMAP_CONFIG_ITEM("GPS", "Listener Interval");
+
 
 static char RoadMapGpsTitle[] = "GPS receiver";
 
@@ -110,10 +124,18 @@ static time_t RoadMapGpsLatestData = 0;
 static int    RoadMapGpsEstimatedError = 0;
 int    RoadMapGpsRetryPending = 0;
 static time_t RoadMapGpsReceivedTime = 0;
+static int    RoadMapGpsReceivedMillis = -1; /* -1: whole seconds only. */
 int    RoadMapGpsReception = GPS_RECEPTION_NA;
 
 static RoadMapGpsPosition RoadMapGpsReceivedPosition;
 
+/* What the listeners actually see: the received position, possibly
+ * smoothed and extrapolated by the filter below.
+ */
+static RoadMapGpsPosition RoadMapGpsPublishedPosition;
+static unsigned long      RoadMapGpsPublishedMillis;
+static int                RoadMapGpsPublishPending = 0;
+
 
 /* Monitors information (GPS system status) ---------------------------- */
 
@@ -250,6 +272,306 @@ static void roadmap_gps_got_data(void) {
     RoadMapGpsLatestData = time(NULL);
 }
 
+/* Position filter ----------------------------------------------------- */
+
+/* A constant-velocity Kalman filter, run independently on the east and
+ * north axes. Positions are kept in meters relative to a local origin,
+ * which is moved along with the vehicle so that a flat earth remains
+ * a good enough approximation.
+ */
+typedef struct {
+
+   double position;
+   double velocity;
+   double p11, p12, p22;    /* Covariance of (position, velocity). */
+
+} RoadMapGpsAxisFilter;
+
+static struct {
+
+   int active;
+   unsigned long millis;    /* Arrival time of the latest update. */
+
+   int origin_latitude;
+   int origin_longitude;
+   double meters_per_longitude;
+
+   double time;             /* GPS time of the latest update, or -1. */
+
+   int last_time;           /* Used to detect repeated fixes. */
+   int last_millis;
+   int last_latitude;
+   int last_longitude;
+
+   RoadMapGpsAxisFilter east;
+   RoadMapGpsAxisFilter north;
+
+} RoadMapGpsFilter;
+
+#define ROADMAP_GPS_METERS_PER_LATITUDE  0.1113195 /* Per micro-degree. */
+#define ROADMAP_GPS_FILTER_JUMP        200.0       /* Meters. */
+#define ROADMAP_GPS_FILTER_REBASE    10000.0       /* Meters. */
+
+
+static void roadmap_gps_filter_axis_reset (RoadMapGpsAxisFilter *axis,
+                                           double variance) {
+
+   axis->position = 0.0;
+   axis->velocity = 0.0;
+   axis->p11 = variance;
+   axis->p12 = 0.0;
+   axis->p22 = 100.0;   /* Velocity unknown: (10 m/s)^2. */
+}
+
+
+/**
+ * @brief one predict + correct cycle of the filter on one axis
+ * @param axis the state of this axis
+ * @param dt the time since the previous update, in seconds
+ * @param q the variance of the acceleration, (m/s2)^2
+ * @param measured the measured position, in meters
+ * @param r the variance of the measured position, m^2
+ */
+static void roadmap_gps_filter_axis_update (RoadMapGpsAxisFilter *axis,
+                                            double dt,
+                                            double q,
+                                            double measured,
+                                            double r) {
+
+   double dt2 = dt * dt;
+   double p11, p12, p22;
+   double s, k1, k2;
+   double innovation;
+
+   /* Predict, with the acceleration modelled as white noise. */
+   axis->position += axis->velocity * dt;
+
+   p11 = axis->p11 + dt * (2.0 * axis->p12 + dt * axis->p22)
+                   + q * dt2 * dt2 / 4.0;
+   p12 = axis->p12 + dt * axis->p22 + q * dt2 * dt / 2.0;
+   p22 = axis->p22 + q * dt2;
+
+   /* Correct with the measured position. */
+   s  = p11 + r;
+   k1 = p11 / s;
+   k2 = p12 / s;
+
+   innovation = measured - axis->position;
+
+   axis->position += k1 * innovation;
+   axis->velocity += k2 * innovation;
+
+   axis->p11 = (1.0 - k1) * p11;
+   axis->p12 = (1.0 - k1) * p12;
+   axis->p22 = p22 - k2 * p12;
+}
+
+
+/**
+ * @brief the GPS time of the received fix, in seconds
+ * @return the time, or -1 if the source only gives whole seconds
+ */
+static double roadmap_gps_filter_fix_time (void) {
+
+   if (RoadMapGpsReceivedMillis < 0) return -1.0;
+
+   return RoadMapGpsReceivedTime + RoadMapGpsReceivedMillis / 1000.0;
+}
+
+
+static void roadmap_gps_filter_reset (const RoadMapGpsPosition *position,
+                                      unsigned long now,
+                                      double r) {
+
+   RoadMapGpsFilter.active = 1;
+   RoadMapGpsFilter.millis = now;
+   RoadMapGpsFilter.time = roadmap_gps_filter_fix_time ();
+
+   RoadMapGpsFilter.origin_latitude  = position->latitude;
+   RoadMapGpsFilter.origin_longitude = position->longitude;
+   RoadMapGpsFilter.meters_per_longitude =
+      ROADMAP_GPS_METERS_PER_LATITUDE
+         * cos (position->latitude * M_PI / 180000000.0);
+
+   roadmap_gps_filter_axis_reset (&RoadMapGpsFilter.east, r);
+   roadmap_gps_filter_axis_reset (&RoadMapGpsFilter.north, r);
+}
+
+
+/**
+ * @brief move the local origin to the current estimate.
+ */
+static void roadmap_gps_filter_rebase (void) {
+
+   RoadMapGpsFilter.origin_latitude +=
+      (int) (RoadMapGpsFilter.north.position
+                / ROADMAP_GPS_METERS_PER_LATITUDE);
+   RoadMapGpsFilter.origin_longitude +=
+      (int) (RoadMapGpsFilter.east.position
+                / RoadMapGpsFilter.meters_per_longitude);
+
+   RoadMapGpsFilter.meters_per_longitude =
+      ROADMAP_GPS_METERS_PER_LATITUDE
+         * cos (RoadMapGpsFilter.origin_latitude * M_PI / 180000000.0);
+
+   RoadMapGpsFilter.east.position = 0.0;
+   RoadMapGpsFilter.north.position = 0.0;
+}
+
+
+/**
+ * @brief feed a new fix to the filter and replace its coordinates
+ * with the filtered estimate (moved ahead by the display latency, if any).
+ * @param position the received position, updated in place
+ * @param now the arrival time of this fix, in milliseconds
+ */
+static void roadmap_gps_filter (RoadMapGpsPosition *position,
+                                unsigned long now) {
+
+   double dt;
+   double q;
+   double r;
+   double sigma;
+   double east;
+   double north;
+   double lead;
+   double fix_time;
+   int timeout;
+
+
+   /* The position error is roughly 5 meters per unit of HDOP. */
+   if (RoadMapGpsQuality.dilution_horizontal > 0.0) {
+      sigma = 5.0 * RoadMapGpsQuality.dilution_horizontal;
+   } else {
+      sigma = 10.0;
+   }
+   if (sigma < 2.0) sigma = 2.0;
+   r = sigma * sigma;
+
+   timeout = roadmap_config_get_integer (&RoadMapConfigGPSTimeout);
+
+   if ((! RoadMapGpsFilter.active) ||
+       (now - RoadMapGpsFilter.millis > (unsigned long)timeout * 1000)) {
+      roadmap_gps_filter_reset (position, now, r);
+
+   } else if ((position->latitude  != RoadMapGpsFilter.last_latitude) ||
+              (position->longitude != RoadMapGpsFilter.last_longitude) ||
+              (RoadMapGpsReceivedTime != RoadMapGpsFilter.last_time) ||
+              (RoadMapGpsReceivedMillis != RoadMapGpsFilter.last_millis)) {
+
+      /* The same fix is often reported by several sentences (RMC, GGA):
+       * it is only used once.
+       *
+       * The GPS time tells when the fix was measured, whatever the
+       * delays of the link and of the main loop. The arrival time is
+       * only used when the GPS time is not precise enough, or did not
+       * advance (GLL sentences carry no time).
+       */
+      fix_time = roadmap_gps_filter_fix_time ();
+
+      if ((fix_time > RoadMapGpsFilter.time) &&
+          (RoadMapGpsFilter.time >= 0.0) &&
+          (fix_time - RoadMapGpsFilter.time <= timeout)) {
+         dt = fix_time - RoadMapGpsFilter.time;
+      } else {
+         dt = (now - RoadMapGpsFilter.millis) / 1000.0;
+      }
+
+      east  = (position->longitude - RoadMapGpsFilter.origin_longitude)
+                 * RoadMapGpsFilter.meters_per_longitude;
+      north = (position->latitude - RoadMapGpsFilter.origin_latitude)
+                 * ROADMAP_GPS_METERS_PER_LATITUDE;
+
+      if ((fabs (east - RoadMapGpsFilter.east.position
+                      - RoadMapGpsFilter.east.velocity * dt)
+              > ROADMAP_GPS_FILTER_JUMP) ||
+          (fabs (north - RoadMapGpsFilter.north.position
+                       - RoadMapGpsFilter.north.velocity * dt)
+              > ROADMAP_GPS_FILTER_JUMP)) {
+
+         /* Not a plausible move (e.g. replaying a new file): restart. */
+         roadmap_gps_filter_reset (position, now, r);
+
+      } else {
+
+         q = roadmap_config_get_integer (&RoadMapConfigGPSFilterAcceleration);
+         q = q * q;
+
+         roadmap_gps_filter_axis_update
+            (&RoadMapGpsFilter.east, dt, q, east, r);
+         roadmap_gps_filter_axis_update
+            (&RoadMapGpsFilter.north, dt, q, north, r);
+
+         RoadMapGpsFilter.millis = now;
+         RoadMapGpsFilter.time = fix_time;
+
+         if ((fabs (RoadMapGpsFilter.east.position)
+                 > ROADMAP_GPS_FILTER_REBASE) ||
+             (fabs (RoadMapGpsFilter.north.position)
+                 > ROADMAP_GPS_FILTER_REBASE)) {
+            roadmap_gps_filter_rebase ();
+         }
+      }
+   }
+
+   RoadMapGpsFilter.last_time = RoadMapGpsReceivedTime;
+   RoadMapGpsFilter.last_millis = RoadMapGpsReceivedMillis;
+   RoadMapGpsFilter.last_latitude  = position->latitude;
+   RoadMapGpsFilter.last_longitude = position->longitude;
+
+   /* Compensate for the display latency, if requested. */
+   lead = roadmap_config_get_integer (&RoadMapConfigGPSDisplayLatency) / 1000.0;
+
+   east  = RoadMapGpsFilter.east.position
+              + RoadMapGpsFilter.east.velocity * lead;
+   north = RoadMapGpsFilter.north.position
+              + RoadMapGpsFilter.north.velocity * lead;
+
+   position->longitude = RoadMapGpsFilter.origin_longitude
+      + (int) floor (east / RoadMapGpsFilter.meters_per_longitude + 0.5);
+   position->latitude  = RoadMapGpsFilter.origin_latitude
+      + (int) floor (north / ROADMAP_GPS_METERS_PER_LATITUDE + 0.5);
+}
+
+
+/**
+ * @brief make a new fix available to the listeners.
+ * The fix goes through the filter (if enabled), then the listeners are
+ * called unless they were called less than "GPS.Listener Interval"
+ * milliseconds ago. In that case the fix is kept pending and will be
+ * superseded by the next one, so that high rate receivers do not cause
+ * a repaint for every single fix.
+ *
+ * The interval is 0 (no throttling) by default: the sentences of one
+ * epoch (GGA, then RMC) arrive a few milliseconds apart, and the GPS
+ * time, in seconds, cannot tell them from the next epoch.  With a
+ * non-zero interval, the speed and heading carried by the second
+ * sentence wait for the next fix, or for the keep-alive.
+ */
+static void roadmap_gps_publish (void) {
+
+   unsigned long now = roadmap_time_get_millis ();
+   int interval;
+
+   RoadMapGpsPublishedPosition = RoadMapGpsReceivedPosition;
+
+   if (roadmap_config_match (&RoadMapConfigGPSFilter, "kalman")) {
+      roadmap_gps_filter (&RoadMapGpsPublishedPosition, now);
+   } else {
+      RoadMapGpsFilter.active = 0;
+   }
+
+   interval = roadmap_config_get_integer (&RoadMapConfigGPSListenerInterval);
+
+   if ((interval > 0) &&
+       (now - RoadMapGpsPublishedMillis < (unsigned long)interval)) {
+      RoadMapGpsPublishPending = 1;
+      return;
+   }
+
+   roadmap_gps_call_all_listeners ();
+}
+
 /**
  * @brief spread information that comes in periodically to all 'listeners'.
  * Similar mechanism to "monitors", the information provided is different.
@@ -259,6 +581,9 @@ static void roadmap_gps_call_all_listeners (void) {
    int i;
    int count = 0;
 
+   RoadMapGpsPublishedMillis = roadmap_time_get_millis ();
+   RoadMapGpsPublishPending = 0;
+
    for (i = 0; i < ROADMAP_GPS_CLIENTS; ++i) {
 
       if (RoadMapGpsListeners[i] == NULL) break;
@@ -267,7 +592,7 @@ static void roadmap_gps_call_all_listeners (void) {
       (RoadMapGpsListeners[i]) (RoadMapGpsReception,
                                 RoadMapGpsReceivedTime,
                                 &RoadMapGpsQuality,
-                                &RoadMapGpsReceivedPosition);
+                                &RoadMapGpsPublishedPosition);
    }
 
    if (count == 0) {
@@ -329,6 +654,13 @@ static void roadmap_gps_keep_alive (void) {
 
    roadmap_gps_update_reception ();
 
+   /* Deliver a fix held back by the listener interval, if the receiver
+    * went quiet since.
+    */
+   if (RoadMapGpsPublishPending) {
+      roadmap_gps_call_all_listeners ();
+   }
+
    now = time(NULL);
 
    /* should the "lost satellite" message go away */
@@ -415,6 +747,7 @@ static void roadmap_gps_gga (void *context, const RoadMapNmeaFields *fields) {
       roadmap_gps_update_status ('A');
 
       RoadMapGpsReceivedTime = fields->gga.fixtime;
+      RoadMapGpsReceivedMillis = fields->gga.fixmillis;
 
       RoadMapGpsReceivedPosition.latitude  = fields->gga.latitude;
       RoadMapGpsReceivedPosition.longitude = fields->gga.longitude;
@@ -423,7 +756,7 @@ static void roadmap_gps_gga (void *context, const RoadMapNmeaFields *fields) {
          roadmap_math_to_current_unit (fields->gga.altitude,
                                        fields->gga.altitude_unit);
 
-      roadmap_gps_call_all_listeners();
+      roadmap_gps_publish();
    }
 
    roadmap_gps_got_data();
@@ -446,7 +779,7 @@ static void roadmap_gps_gll (void *context, const RoadMapNmeaFields *fields) {
       /* altitude not available: keep previous value. */
       /* steering not available: keep previous value. */
 
-      roadmap_gps_call_all_listeners();
+      roadmap_gps_publish();
    }
 
    roadmap_gps_got_data();
@@ -466,6 +799,7 @@ static void roadmap_gps_rmc (void *context, const RoadMapNmeaFields *fields) {
    if (status == 'A') {
 
       RoadMapGpsReceivedTime = fields->rmc.fixtime;
+      RoadMapGpsReceivedMillis = fields->rmc.fixmillis;
 
       RoadMapGpsReceivedPosition.latitude  = fields->rmc.latitude;
       RoadMapGpsReceivedPosition.longitude = fields->rmc.longitude;
@@ -482,7 +816,7 @@ static void roadmap_gps_rmc (void *context, const RoadMapNmeaFields *fields) {
          RoadMapGpsReceivedPosition.steering  = fields->rmc.steering;
       }
 
-      roadmap_gps_call_all_listeners();
+      roadmap_gps_publish();
    }
 }
 
@@ -652,6 +986,7 @@ void roadmap_gps_navigation (char status,
    if (status == 'A') {
 
       RoadMapGpsReceivedTime = gmt_time;
+      RoadMapGpsReceivedMillis = -1;
 
       if (latitude != ROADMAP_NO_VALID_DATA) {
          RoadMapGpsReceivedPosition.latitude  = latitude;
@@ -675,7 +1010,7 @@ void roadmap_gps_navigation (char status,
          RoadMapGpsReceivedPosition.steering  = steering;
       }
 
-      roadmap_gps_call_all_listeners();
+      roadmap_gps_publish();
 
    }
 }
@@ -777,7 +1112,7 @@ static void roadmap_gps_object_listener (RoadMapDynamicString id,
    RoadMapGpsReceivedPosition = *position;
 
    (void)roadmap_gps_update_status ('A');
-   roadmap_gps_call_all_listeners();
+   roadmap_gps_publish();
 
    (*RoadMapGpsNextObjectListener) (id, position);
 
@@ -831,6 +1166,15 @@ void roadmap_gps_initialize (void) {
       roadmap_config_declare
          ("preferences", &RoadMapConfigGPSLostFixTimeout, "10000");
 
+      roadmap_config_declare_enumeration
+         ("preferences", &RoadMapConfigGPSFilter, "none", "kalman", NULL);
+      roadmap_config_declare
+         ("preferences", &RoadMapConfigGPSFilterAcceleration, "3");
+      roadmap_config_declare
+         ("preferences", &RoadMapConfigGPSDisplayLatency, "0");
+      roadmap_config_declare
+         ("preferences", &RoadMapConfigGPSListenerInterval, "0");
+
       RoadMapGpsInitialized = 1;
 
       roadmap_state_add ("get_GPS_reception", &roadmap_gps_reception_state);
@@ -856,6 +1200,9 @@ void roadmap_gps_shutdown (void) {
 
    roadmap_io_close (&RoadMapGpsLink);
 
+   RoadMapGpsFilter.active = 0;
+   RoadMapGpsPublishPending = 0;
+
    RoadMapGpsInitialized = 0;
    for (i=0; i<ROADMAP_GPS_CLIENTS; ++i) {
       RoadMapGpsListeners[i] = NULL;
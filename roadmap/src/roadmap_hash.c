@@ -35,6 +35,7 @@
 
 
 static RoadMapHash *HashLast = NULL;
+static RoadMapIntHash *IntHashLast = NULL;
 
 /**
  * @brief
@@ -205,15 +206,259 @@ void *roadmap_hash_get_value (RoadMapHash *hash, int index) {
    return hash->values[index];
 }
 
+/**
+ * @brief mix all the bits of a key, so that sequential ids spread out
+ * @param key
+ * @return
+ */
+static unsigned int roadmap_hash_int_code (long long key) {
+
+   unsigned long long x = (unsigned long long) key;
+
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdULL;
+   x ^= x >> 33;
+   x *= 0xc4ceb9fe1a85ec53ULL;
+   x ^= x >> 33;
+
+   return (unsigned int) x;
+}
+
+/**
+ * @brief allocate the slots of an integer hash, all empty
+ * @param hash
+ * @param capacity must be a power of 2
+ */
+static void roadmap_hash_int_allocate (RoadMapIntHash *hash, int capacity) {
+
+   int i;
+
+   hash->slots = malloc (capacity * sizeof(struct roadmap_hash_int_slot));
+   roadmap_check_allocated(hash->slots);
+
+   for (i = 0; i < capacity; i++) {
+      hash->slots[i].value = -1;
+   }
+   hash->capacity = capacity;
+   hash->count = 0;
+}
+
+/**
+ * @brief create a hash table for unique integer keys
+ * @param name
+ * @param size the expected number of keys (the table grows as needed)
+ * @return
+ */
+RoadMapIntHash *roadmap_hash_int_new (char *name, int size) {
+
+   int capacity = 16;
+   RoadMapIntHash *hash = malloc (sizeof(RoadMapIntHash));
+
+   roadmap_check_allocated(hash);
+
+   hash->name = name;
+
+   while (capacity < size + size / 3) capacity *= 2;
+
+   roadmap_hash_int_allocate (hash, capacity);
+
+   hash->count_get = 0;
+   hash->count_probe = 0;
+   hash->longest_probe = 0;
+
+   hash->next_hash = IntHashLast;
+   IntHashLast = hash;
+
+   return hash;
+}
+
+/**
+ * @brief add a key, or change the value of a key already present
+ * @param hash
+ * @param key
+ * @param value must not be negative
+ */
+void roadmap_hash_int_set (RoadMapIntHash *hash, long long key, int value) {
+
+   struct roadmap_hash_int_slot slot;
+   struct roadmap_hash_int_slot swap;
+   unsigned int mask;
+   unsigned int position;
+   unsigned int distance;
+   unsigned int other;
+
+   if (value < 0) {
+      roadmap_log (ROADMAP_FATAL, "invalid value %d in hash table %s",
+                         value, hash->name);
+   }
+
+   if ((hash->count + 1) * 4 > hash->capacity * 3) {
+
+      /* Keep the table at most 3/4 full: reinsert all in twice the room. */
+      struct roadmap_hash_int_slot *old = hash->slots;
+      int old_capacity = hash->capacity;
+      int i;
+
+      roadmap_hash_int_allocate (hash, old_capacity * 2);
+
+      for (i = 0; i < old_capacity; i++) {
+         if (old[i].value >= 0) {
+            roadmap_hash_int_set (hash, old[i].key, old[i].value);
+         }
+      }
+      free (old);
+   }
+
+   mask = hash->capacity - 1;
+   slot.key = key;
+   slot.value = value;
+   position = roadmap_hash_int_code (key) & mask;
+
+   for (distance = 0; ; distance++, position = (position + 1) & mask) {
+
+      if (hash->slots[position].value < 0) {
+         hash->slots[position] = slot;
+         hash->count += 1;
+         return;
+      }
+
+      if (hash->slots[position].key == slot.key) {
+         hash->slots[position].value = slot.value;
+         return;
+      }
+
+      /* Robin hood: the key closest to its home slot moves on. */
+      other = (position -
+                 roadmap_hash_int_code (hash->slots[position].key)) & mask;
+
+      if (other < distance) {
+         swap = hash->slots[position];
+         hash->slots[position] = slot;
+         slot = swap;
+         distance = other;
+      }
+   }
+}
+
+/**
+ * @brief find the value for a key
+ * @param hash
+ * @param key
+ * @return the value, or -1 if the key is not present
+ */
+int roadmap_hash_int_get (RoadMapIntHash *hash, long long key) {
+
+   unsigned int mask = hash->capacity - 1;
+   unsigned int position = roadmap_hash_int_code (key) & mask;
+   unsigned int distance;
+   int value = -1;
+
+   for (distance = 0; ; distance++, position = (position + 1) & mask) {
+
+      if (hash->slots[position].value < 0) break;
+
+      if (hash->slots[position].key == key) {
+         value = hash->slots[position].value;
+         break;
+      }
+
+      /* Any further key would have displaced this one. */
+      if (((position -
+             roadmap_hash_int_code (hash->slots[position].key)) & mask)
+                < distance) {
+         break;
+      }
+   }
+
+   hash->count_get += 1;
+   hash->count_probe += distance + 1;
+   if ((int)distance >= hash->longest_probe) {
+      hash->longest_probe = distance + 1;
+   }
+
+   return value;
+}
+
+/**
+ * @brief remove a key, if present
+ * @param hash
+ * @param key
+ */
+void roadmap_hash_int_remove (RoadMapIntHash *hash, long long key) {
+
+   unsigned int mask = hash->capacity - 1;
+   unsigned int position = roadmap_hash_int_code (key) & mask;
+   unsigned int distance;
+   unsigned int next;
+
+   for (distance = 0; ; distance++, position = (position + 1) & mask) {
+
+      if (hash->slots[position].value < 0) return;
+
+      if (hash->slots[position].key == key) break;
+
+      if (((position -
+             roadmap_hash_int_code (hash->slots[position].key)) & mask)
+                < distance) {
+         return;
+      }
+   }
+
+   /* Move the keys that follow one slot back, until one is at home. */
+   for (;;) {
+      next = (position + 1) & mask;
+      if (hash->slots[next].value < 0 ||
+          ((next - roadmap_hash_int_code (hash->slots[next].key)) & mask)
+             == 0) {
+         break;
+      }
+      hash->slots[position] = hash->slots[next];
+      position = next;
+   }
+
+   hash->slots[position].value = -1;
+   hash->count -= 1;
+}
+
+/**
+ * @brief
+ * @param hash
+ */
+void roadmap_hash_int_delete (RoadMapIntHash *hash) {
+
+   RoadMapIntHash *cursor;
+
+   if (hash == NULL) return;
+
+   if (IntHashLast == hash) {
+      IntHashLast = hash->next_hash;
+   } else {
+      for (cursor = IntHashLast; cursor != NULL; cursor = cursor->next_hash) {
+         if (cursor->next_hash == hash) {
+            cursor->next_hash = hash->next_hash;
+            break;
+         }
+      }
+   }
+
+   free (hash->slots);
+   free (hash);
+}
+
 /**
  * @brief
  */
 void  roadmap_hash_summary (void) {
 
    RoadMapHash *hash;
+   RoadMapIntHash *int_hash;
 
    for (hash = HashLast; hash != NULL; hash = hash->next_hash) {
 
+      int i;
+      int length;
+      int longest = 0;
+
       fprintf (stderr, "-- hash table %s:", hash->name);
 
       fprintf (stderr,
@@ -237,6 +482,36 @@ void  roadmap_hash_summary (void) {
                   (hash->count_get_first + hash->count_get_next)
                       / hash->count_get_first);
       }
+
+      for (i = 0; i < ROADMAP_HASH_MODULO; i++) {
+         int index;
+         length = 0;
+         for (index = hash->head[i]; index >= 0; index = hash->next[index]) {
+            length += 1;
+         }
+         if (length > longest) longest = length;
+      }
+      fprintf (stderr, "\n--      longest list %d", longest);
+      fprintf (stderr, "\n");
+   }
+
+   for (int_hash = IntHashLast;
+        int_hash != NULL;
+        int_hash = int_hash->next_hash) {
+
+      fprintf (stderr, "-- hash table %s:", int_hash->name);
+
+      fprintf (stderr,
+               "\n--      %d items, %d slots",
+               int_hash->count, int_hash->capacity);
+
+      fprintf (stderr, "\n--      %d get", int_hash->count_get);
+      if (int_hash->count_get > 0) {
+         fprintf (stderr,
+                  " (%.2f probes/search, longest %d)",
+                  (double)int_hash->count_probe / int_hash->count_get,
+                  int_hash->longest_probe);
+      }
       fprintf (stderr, "\n");
    }
 }
@@ -286,6 +561,10 @@ void roadmap_hash_reset (void) {
       roadmap_hash_free (hash);
    }
    HashLast = NULL;
+
+   while (IntHashLast != NULL) {
+      roadmap_hash_int_delete (IntHashLast);
+   }
 }
 
 /**
@@ -49,6 +49,35 @@ struct roadmap_hash_struct {
 typedef struct roadmap_hash_struct RoadMapHash;
 
 
+/* An open addressing table (robin hood hashing), for unique integer keys.
+ * Each key maps to one non-negative value.  The table grows as needed.
+ */
+struct roadmap_hash_int_slot {
+
+   long long key;
+   int       value; /* -1 if the slot is empty. */
+};
+
+struct roadmap_hash_int_struct {
+
+   char *name;
+
+   struct roadmap_hash_int_struct *next_hash;
+
+   int    capacity; /* Always a power of 2. */
+   int    count;
+   struct roadmap_hash_int_slot *slots;
+
+   /* Statistics: */
+   int count_get;
+   long long count_probe;
+   int longest_probe;
+
+};
+
+typedef struct roadmap_hash_int_struct RoadMapIntHash;
+
+
 RoadMapHash *roadmap_hash_new (char *name, int size);
 
 void roadmap_hash_add       (RoadMapHash *hash, unsigned int key, int index);
@@ -61,6 +90,13 @@ void roadmap_hash_delete (RoadMapHash *hash);
 void  roadmap_hash_set_value (RoadMapHash *hash, int index, void *value);
 void *roadmap_hash_get_value (RoadMapHash *hash, int index);
 
+RoadMapIntHash *roadmap_hash_int_new (char *name, int size);
+
+void roadmap_hash_int_set    (RoadMapIntHash *hash, long long key, int value);
+int  roadmap_hash_int_get    (RoadMapIntHash *hash, long long key);
+void roadmap_hash_int_remove (RoadMapIntHash *hash, long long key);
+void roadmap_hash_int_delete (RoadMapIntHash *hash);
+
 void  roadmap_hash_summary (void);
 void  roadmap_hash_reset   (void);
 
@@ -35,11 +35,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "roadmap.h"
 #include "roadmap_types.h"
 #include "roadmap_scan.h"
+#include "roadmap_file.h"
 #include "roadmap_dbread.h"
+#include "roadmap_hash.h"
 #include "roadmap_dictionary.h"
 #include "roadmap_point.h"
 #include "roadmap_square.h"
@@ -59,13 +62,21 @@
 #include "roadmap_locator.h"
 
 
+/* The cache keeps the maps open until they use more memory than
+ * allowed (Map.Cache Memory), but it always keeps a few of them
+ * (Map.Cache, at least ROADMAP_CACHE_SIZE), and never too many since
+ * each one holds a file descriptor.
+ */
 #define ROADMAP_CACHE_SIZE 8
+#define ROADMAP_CACHE_MAX  256
 
 struct roadmap_cache_entry {
 
    int          fips;
    const char  *path;
-   unsigned int last_access;
+   unsigned int size;   // bytes mapped
+   int newer;           // the LRU list, -1 at both ends
+   int older;           // (also chains the free entries)
    short *db_to_roadmap;
    short *roadmap_to_db;;
    short mapcount; // zero indicates no mapping found 
@@ -73,7 +84,21 @@ struct roadmap_cache_entry {
 
 static struct roadmap_cache_entry *RoadMapCountyCache = NULL;
 
-static int RoadMapCountyCacheSize = 0;
+static int RoadMapCountyCacheSize = 0;     /* entries allocated */
+static int RoadMapCountyCacheUsed = 0;     /* maps open */
+static int RoadMapCountyCacheMinimum = 0;  /* maps kept open anyway */
+static int RoadMapCountyCacheFree = -1;
+static int RoadMapCountyCacheNewest = -1;
+static int RoadMapCountyCacheOldest = -1;
+
+static RoadMapIntHash *RoadMapCountyCacheIndex = NULL;
+
+static unsigned long RoadMapCountyCacheBytes = 0;
+static unsigned long RoadMapCountyCacheBudget = 0;
+
+static int RoadMapCountyCacheHits = 0;
+static int RoadMapCountyCacheMisses = 0;
+static int RoadMapCountyCacheEvictions = 0;
 
 static int RoadMapActiveCounty;
 static int RoadMapActiveCountyCache;
@@ -99,13 +124,89 @@ roadmap_locator_use_counties(int yesno)
 
 
 
+/**
+ * @brief add entries to the cache, on its free list
+ * @param size the new number of entries
+ */
+static void roadmap_locator_grow (int size) {
+
+   int i;
+
+   RoadMapCountyCache = (struct roadmap_cache_entry *)
+      realloc (RoadMapCountyCache, size * sizeof(struct roadmap_cache_entry));
+   roadmap_check_allocated (RoadMapCountyCache);
+
+   for (i = size - 1; i >= RoadMapCountyCacheSize; i--) {
+
+      memset (&RoadMapCountyCache[i], 0, sizeof(struct roadmap_cache_entry));
+
+      RoadMapCountyCache[i].db_to_roadmap =
+            calloc (roadmap_layer_max_defined(), sizeof(short));
+      roadmap_check_allocated (RoadMapCountyCache[i].db_to_roadmap );
+      RoadMapCountyCache[i].roadmap_to_db =
+            calloc (roadmap_layer_max_defined(), sizeof(short));
+      roadmap_check_allocated (RoadMapCountyCache[i].roadmap_to_db );
+
+      RoadMapCountyCache[i].newer = -1;
+      RoadMapCountyCache[i].older = RoadMapCountyCacheFree;
+      RoadMapCountyCacheFree = i;
+   }
+   RoadMapCountyCacheSize = size;
+}
+
+/**
+ * @brief take an entry out of the LRU list
+ * @param index
+ */
+static void roadmap_locator_unlink (int index) {
+
+   struct roadmap_cache_entry *entry = &RoadMapCountyCache[index];
+
+   if (entry->newer >= 0) {
+      RoadMapCountyCache[entry->newer].older = entry->older;
+   } else {
+      RoadMapCountyCacheNewest = entry->older;
+   }
+   if (entry->older >= 0) {
+      RoadMapCountyCache[entry->older].newer = entry->newer;
+   } else {
+      RoadMapCountyCacheOldest = entry->newer;
+   }
+   entry->newer = entry->older = -1;
+}
+
+/**
+ * @brief put an entry at the head of the LRU list
+ * @param index
+ */
+static void roadmap_locator_touch (int index) {
+
+   struct roadmap_cache_entry *entry = &RoadMapCountyCache[index];
+
+   if (RoadMapCountyCacheNewest == index) return;
+
+   if (entry->newer >= 0 || entry->older >= 0 ||
+       RoadMapCountyCacheOldest == index) {
+      roadmap_locator_unlink (index);
+   }
+
+   entry->older = RoadMapCountyCacheNewest;
+   entry->newer = -1;
+   if (RoadMapCountyCacheNewest >= 0) {
+      RoadMapCountyCache[RoadMapCountyCacheNewest].newer = index;
+   }
+   RoadMapCountyCacheNewest = index;
+   if (RoadMapCountyCacheOldest < 0) {
+      RoadMapCountyCacheOldest = index;
+   }
+}
+
 /*
  * @brief
  */
 static void roadmap_locator_configure (void) {
 
    const char *path;
-   int i;
 
    if (RoadMapCountyCache == NULL) {
 
@@ -150,21 +251,20 @@ static void roadmap_locator_configure (void) {
          roadmap_db_register
             (RoadMapUsModel, "string", &RoadMapDictionaryHandler);
 
-      RoadMapCountyCacheSize = roadmap_option_cache ();
-      if (RoadMapCountyCacheSize < ROADMAP_CACHE_SIZE) {
-         RoadMapCountyCacheSize = ROADMAP_CACHE_SIZE;
+      RoadMapCountyCacheMinimum = roadmap_option_cache ();
+      if (RoadMapCountyCacheMinimum < ROADMAP_CACHE_SIZE) {
+         RoadMapCountyCacheMinimum = ROADMAP_CACHE_SIZE;
       }
-      RoadMapCountyCache = (struct roadmap_cache_entry *)
-         calloc (RoadMapCountyCacheSize, sizeof(struct roadmap_cache_entry));
-      roadmap_check_allocated (RoadMapCountyCache);
-      for (i = 0; i < RoadMapCountyCacheSize; i++) {
-          RoadMapCountyCache[i].db_to_roadmap =
-                calloc (roadmap_layer_max_defined(), sizeof(short));
-          roadmap_check_allocated (RoadMapCountyCache[i].db_to_roadmap );
-          RoadMapCountyCache[i].roadmap_to_db =
-                calloc (roadmap_layer_max_defined(), sizeof(short));
-          roadmap_check_allocated (RoadMapCountyCache[i].roadmap_to_db );
+      if (RoadMapCountyCacheMinimum > ROADMAP_CACHE_MAX) {
+         RoadMapCountyCacheMinimum = ROADMAP_CACHE_MAX;
       }
+      RoadMapCountyCacheBudget =
+         (unsigned long) roadmap_option_cache_memory () * 1024 * 1024;
+
+      roadmap_locator_grow (RoadMapCountyCacheMinimum);
+
+      RoadMapCountyCacheIndex =
+         roadmap_hash_int_new ("MapCache", RoadMapCountyCacheMinimum);
 
       for (path = roadmap_scan ("maps", "usdir.rdm");
            path != NULL;
@@ -215,48 +315,55 @@ char *roadmap_locator_filename(char *buf, int fips) {
 }
 
 /**
- * @brief
+ * @brief close a map and free its cache entry
  * @param index
  */
 static void roadmap_locator_remove (int index) {
 
-   roadmap_db_close (RoadMapCountyCache[index].path,
-        roadmap_locator_filename(NULL, RoadMapCountyCache[index].fips));
+   struct roadmap_cache_entry *entry = &RoadMapCountyCache[index];
 
-   RoadMapCountyCache[index].fips = 0;
-   RoadMapCountyCache[index].path = NULL;
-   RoadMapCountyCache[index].last_access = 0;
-   RoadMapCountyCache[index].mapcount = 0;
-}
+   roadmap_db_close (entry->path,
+        roadmap_locator_filename(NULL, entry->fips));
 
-/**
- * @brief
- * @return
- */
-static unsigned int roadmap_locator_new_access (void) {
+   if (entry->fips == RoadMapActiveCounty) {
+      RoadMapActiveCounty = 0;
+   }
 
-   static unsigned int RoadMapLocatorAccessCount = 0;
+   roadmap_hash_int_remove (RoadMapCountyCacheIndex, entry->fips);
+   roadmap_locator_unlink (index);
 
-   int i;
+   RoadMapCountyCacheBytes -= entry->size;
+   RoadMapCountyCacheUsed -= 1;
 
+   entry->fips = 0;
+   entry->path = NULL;
+   entry->size = 0;
+   entry->mapcount = 0;
 
-   RoadMapLocatorAccessCount += 1;
+   entry->older = RoadMapCountyCacheFree;
+   RoadMapCountyCacheFree = index;
+}
 
-   if (RoadMapLocatorAccessCount == 0) { /* Rollover. */
+/**
+ * @brief close the least recently used maps, until there is room
+ * @param size the bytes about to be added
+ * @param keep an entry that must stay open, or -1
+ */
+static void roadmap_locator_make_room (unsigned int size, int keep) {
 
-      for (i = 0; i < RoadMapCountyCacheSize; i++) {
+   int oldest;
 
-         if (RoadMapCountyCache[i].fips != 0) {
-            roadmap_locator_remove (i);
-         }
-      }
-      RoadMapActiveCounty = 0;
-      RoadMapActiveCountyCache = 0;
+   while (RoadMapCountyCacheUsed >= ROADMAP_CACHE_MAX ||
+          (RoadMapCountyCacheUsed >= RoadMapCountyCacheMinimum &&
+           RoadMapCountyCacheBytes + size > RoadMapCountyCacheBudget)) {
 
-      RoadMapLocatorAccessCount += 1;
-   }
+      oldest = RoadMapCountyCacheOldest;
+      if (oldest == keep) oldest = RoadMapCountyCache[oldest].newer;
+      if (oldest < 0) break;
 
-   return RoadMapLocatorAccessCount;
+      roadmap_locator_remove (oldest);
+      RoadMapCountyCacheEvictions += 1;
+   }
 }
 
 static void roadmap_locator_layer_mapping_init(void) {
@@ -317,8 +424,11 @@ static void roadmap_locator_layer_mapping_init(void) {
 int roadmap_locator_layer_to_roadmap(int i) {
     int l;
 
-    /* if no mappings exists, use a transparent mapping */
-    if (RoadMapCountyCache[RoadMapActiveCountyCache].mapcount == 0)
+    /* if no mappings exists, use a transparent mapping.  the build
+     * tools read maps without the locator, hence without a cache.
+     */
+    if (RoadMapCountyCache == NULL ||
+        RoadMapCountyCache[RoadMapActiveCountyCache].mapcount == 0)
         return i;
 
     l = RoadMapCountyCache[RoadMapActiveCountyCache].db_to_roadmap[i-1];
@@ -333,8 +443,11 @@ int roadmap_locator_layer_to_roadmap(int i) {
 int roadmap_locator_layer_to_db(int i) {
     int l;
 
-    /* if no mappings exists, use a transparent mapping */
-    if (RoadMapCountyCache[RoadMapActiveCountyCache].mapcount == 0)
+    /* if no mappings exists, use a transparent mapping.  the build
+     * tools read maps without the locator, hence without a cache.
+     */
+    if (RoadMapCountyCache == NULL ||
+        RoadMapCountyCache[RoadMapActiveCountyCache].mapcount == 0)
         return i;
 
     l = RoadMapCountyCache[RoadMapActiveCountyCache].roadmap_to_db[i-1];
@@ -354,8 +467,7 @@ int roadmap_locator_layer_to_db(int i) {
 static int roadmap_locator_open (int fips) {
 
    int i;
-   int access;
-   int oldest = 0;
+   struct roadmap_cache_entry *entry;
 
    const char *path;
    char map_name[64];
@@ -367,34 +479,30 @@ static int roadmap_locator_open (int fips) {
 
    roadmap_locator_filename(map_name, fips);
 
-   access = roadmap_locator_new_access ();
-
-   /* Look for the oldest entry in the cache. */
+   i = roadmap_hash_int_get (RoadMapCountyCacheIndex, fips);
 
-   for (i = RoadMapCountyCacheSize-1; i >= 0; --i) {
+   if (i >= 0) {
 
-      if (RoadMapCountyCache[i].fips == fips) {
+      entry = &RoadMapCountyCache[i];
 
-         roadmap_db_activate (RoadMapCountyCache[i].path, map_name);
-         RoadMapActiveCounty = fips;
-         RoadMapActiveCountyCache = i;
-         RoadMapCountyCache[i].last_access = access;
+      roadmap_db_activate (entry->path, map_name);
+      RoadMapActiveCounty = fips;
+      RoadMapActiveCountyCache = i;
+      roadmap_locator_touch (i);
 
-         return ROADMAP_US_OK;
-      }
+      RoadMapCountyCacheHits += 1;
+      return ROADMAP_US_OK;
+   }
 
-      if (RoadMapCountyCache[i].last_access
-             < RoadMapCountyCache[oldest].last_access) {
+   RoadMapCountyCacheMisses += 1;
 
-         oldest = i;
-      }
-   }
+   /* Make sure there is a free entry: the size is not known yet. */
+   roadmap_locator_make_room (0, -1);
 
-   if (RoadMapCountyCache[oldest].fips != 0) {
-       if (RoadMapCountyCache[oldest].fips == RoadMapActiveCounty) {
-           RoadMapActiveCounty = 0;
-       }
-       roadmap_locator_remove (oldest);
+   if (RoadMapCountyCacheFree < 0) {
+      int size = 2 * RoadMapCountyCacheSize;
+      if (size > ROADMAP_CACHE_MAX) size = ROADMAP_CACHE_MAX;
+      roadmap_locator_grow (size);
    }
 
    do {
@@ -405,14 +513,27 @@ static int roadmap_locator_open (int fips) {
 
          if (roadmap_db_open (path, map_name, RoadMapCountyModel)) {
 
-            RoadMapCountyCache[oldest].fips = fips;
-            RoadMapCountyCache[oldest].path = path;
-            RoadMapCountyCache[oldest].last_access = access;
+            i = RoadMapCountyCacheFree;
+            entry = &RoadMapCountyCache[i];
+            RoadMapCountyCacheFree = entry->older;
+
+            entry->fips = fips;
+            entry->path = path;
+            entry->size = roadmap_db_size (path, map_name);
+            entry->newer = entry->older = -1;
+            roadmap_locator_touch (i);
+
+            roadmap_hash_int_set (RoadMapCountyCacheIndex, fips, i);
+            RoadMapCountyCacheBytes += entry->size;
+            RoadMapCountyCacheUsed += 1;
 
             RoadMapActiveCounty = fips;
-            RoadMapActiveCountyCache = oldest;
+            RoadMapActiveCountyCache = i;
             roadmap_locator_layer_mapping_init();
 
+            /* The new map is active: the others can be closed. */
+            roadmap_locator_make_room (0, i);
+
             return ROADMAP_US_OK;
          }
       }
@@ -432,15 +553,28 @@ void roadmap_locator_close (int fips) {
 
    if (RoadMapCountyCache != NULL) {
 
-      for (i = RoadMapCountyCacheSize-1; i >= 0; --i) {
-
-         if (RoadMapCountyCache[i].fips == fips) {
-            roadmap_locator_remove (i);
-         }
+      i = roadmap_hash_int_get (RoadMapCountyCacheIndex, fips);
+      if (i >= 0) {
+         roadmap_locator_remove (i);
       }
    }
 }
 
+/**
+ * @brief log how well the map cache worked
+ */
+void roadmap_locator_summary (void) {
+
+   if (RoadMapCountyCache == NULL) return;
+
+   roadmap_log (ROADMAP_INFO,
+                "map cache: %d hits, %d misses, %d evictions, "
+                "%d maps open (%lu Kbytes)",
+                RoadMapCountyCacheHits, RoadMapCountyCacheMisses,
+                RoadMapCountyCacheEvictions, RoadMapCountyCacheUsed,
+                RoadMapCountyCacheBytes / 1024);
+}
+
 /**
  * @brief
  * @param fipslistp
@@ -505,6 +639,30 @@ int roadmap_locator_by_position
    return roadmap_osm_by_position (position, &focus, fipslistp, count);
 }
 
+/**
+ * @brief same as roadmap_locator_by_position(), for drawing the screen:
+ *        overview maps may be listed in place of the detailed ones
+ * @param position
+ * @param fipslistp
+ * @return
+ */
+int roadmap_locator_by_view
+        (const RoadMapPosition *position, int **fipslistp) {
+
+   int count;
+   RoadMapArea focus;
+
+   count = roadmap_locator_allocate (fipslistp);
+   if (count < 0) return 0;
+
+   if (RoadMapUseCounties)
+      count = roadmap_county_by_position (position, *fipslistp, count);
+
+   roadmap_math_get_focus (&focus);
+
+   return roadmap_osm_by_view (position, &focus, fipslistp, count);
+}
+
 /**
  * @brief
  * @param state_symbol
@@ -578,6 +736,61 @@ int roadmap_locator_activate (int fips) {
    return roadmap_locator_open (fips);
 }
 
+/**
+ * @brief have the OS read the maps around a position before they are needed
+ *
+ * The maps are not opened here: this only asks the OS to read the files
+ * of the maps that are not open yet, so that opening them when they come
+ * into view does not wait for the disk. The cache and the active map do
+ * not change. Missing maps are not downloaded.
+ *
+ * @param position where the maps will be needed
+ * @param area the area that will be shown around that position
+ * @return the number of map files read ahead
+ */
+int roadmap_locator_prefetch
+        (const RoadMapPosition *position, const RoadMapArea *area) {
+
+   int *fipslist = NULL;
+   int advised = 0;
+   int count;
+   int i;
+
+   const char *path;
+   char map_name[64];
+
+   count = roadmap_locator_allocate (&fipslist);
+   if (RoadMapCountyCache == NULL) {
+      free (fipslist);
+      return 0;
+   }
+
+   if (RoadMapUseCounties)
+      count = roadmap_county_by_position (position, fipslist, count);
+
+   count = roadmap_osm_by_position (position, area, &fipslist, count);
+
+   for (i = 0; i < count; ++i) {
+
+      if (roadmap_hash_int_get (RoadMapCountyCacheIndex, fipslist[i]) >= 0) {
+         continue; /* Already open. */
+      }
+
+      roadmap_locator_filename (map_name, fipslist[i]);
+
+      /* The first file found is the one roadmap_locator_open() uses. */
+      path = roadmap_scan ("maps", map_name);
+      if (path != NULL) {
+         roadmap_file_prefetch (path, map_name);
+         advised += 1;
+      }
+   }
+
+   free (fipslist);
+
+   return advised;
+}
+
 /**
  * @brief
  * @return
@@ -39,14 +39,19 @@ void roadmap_locator_declare_downloader (RoadMapInstaller download);
 
 int roadmap_locator_by_position
         (const RoadMapPosition *position, int **fips);
+int roadmap_locator_by_view
+        (const RoadMapPosition *position, int **fips);
 int roadmap_locator_by_state (const char *state_symbol, int **fips);
 
 int  roadmap_locator_by_city (const char *city, const char *state, int **fips);
 
 int  roadmap_locator_activate    (int fips);
+int  roadmap_locator_prefetch
+        (const RoadMapPosition *position, const RoadMapArea *area);
 int  roadmap_locator_active      (void);
 
 void roadmap_locator_close (int fips);
+void roadmap_locator_summary (void);
 
 RoadMapString roadmap_locator_get_state (const char *state);
 
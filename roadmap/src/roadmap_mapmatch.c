@@ -0,0 +1,696 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief Hidden Markov model map matching.
+ *
+ * Each GPS fix is an observation, and the candidate lines returned by
+ * roadmap_street_get_closest() are the hidden states. The emission cost
+ * of a state grows with the distance from the fix to the line and with
+ * the angle between the line and the GPS steering. The transition cost
+ * between two states compares the straight distance between the two fixes
+ * with the shortest route between the two matched positions. That route is
+ * searched over the candidate lines of both fixes, which make the road
+ * network around them, each line being measured along its shape: a line
+ * that cannot be reached through this neighbourhood gets a fixed penalty.
+ * The most likely sequence of lines is found with the Viterbi algorithm,
+ * working on negative log likelihoods.
+ *
+ * The online matcher keeps the last ROADMAP_MAPMATCH_WINDOW fixes. Before
+ * the oldest one is dropped, its state on the most likely path is
+ * committed: the current states that do not descend from it are pruned,
+ * so that the current line stays consistent with the past it was chosen
+ * from. The batch matcher keeps the whole track and back tracks once at
+ * the end.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_math.h"
+#include "roadmap_fuzzy.h"
+#include "roadmap_square.h"
+#include "roadmap_shape.h"
+#include "roadmap_navigate.h"
+
+#include "roadmap_mapmatch.h"
+
+
+static RoadMapConfigDescriptor RoadMapConfigMapMatching =
+                        ROADMAP_CONFIG_ITEM("Navigation", "Map Matching");
+
+/* Extra cost for a transition with no route through the nearby lines. */
+#define ROADMAP_MAPMATCH_DISCONNECTED  3.0
+
+/* Standard deviation of the GPS steering, in degrees. */
+#define ROADMAP_MAPMATCH_SIGMA_DIRECTION  30.0
+
+/* Cost of a state that contradicts the committed past. */
+#define ROADMAP_MAPMATCH_PRUNED  1000000.0
+
+/* The end points of the candidate lines of two fixes. */
+#define ROADMAP_MAPMATCH_NODES  (4 * ROADMAP_MAPMATCH_STATES)
+
+typedef struct {
+
+   RoadMapPosition  position;
+
+   int              count;
+   RoadMapNeighbour candidate[ROADMAP_MAPMATCH_STATES];
+   RoadMapPosition  endpoint[ROADMAP_MAPMATCH_STATES][2];
+
+   /* Along the line shape, from its first end point. */
+   int              offset[ROADMAP_MAPMATCH_STATES];
+   int              length[ROADMAP_MAPMATCH_STATES];
+
+   double           cost[ROADMAP_MAPMATCH_STATES];
+   int              back[ROADMAP_MAPMATCH_STATES];
+
+} RoadMapMatchStep;
+
+typedef struct {
+
+   RoadMapMatchStep *steps;
+   int               capacity;
+   int               first;
+   int               count;
+
+} RoadMapMatchLattice;
+
+/* The road network around two consecutive fixes. */
+typedef struct {
+
+   int              count;
+   RoadMapPosition  position[ROADMAP_MAPMATCH_NODES];
+
+   int              edge_count;
+   int              edge[2 * ROADMAP_MAPMATCH_STATES][2];
+   int              length[2 * ROADMAP_MAPMATCH_STATES];
+
+} RoadMapMatchGraph;
+
+static RoadMapMatchStep    RoadMapMatchWindow[ROADMAP_MAPMATCH_WINDOW];
+static RoadMapMatchLattice RoadMapMatchOnline =
+                              {RoadMapMatchWindow, ROADMAP_MAPMATCH_WINDOW, 0, 0};
+
+/* Scale of the distance costs, derived from the street accuracy. */
+static double RoadMapMatchSigma;
+static double RoadMapMatchBeta;
+
+
+static void roadmap_mapmatch_start_cycle (void) {
+
+   double accuracy = roadmap_fuzzy_max_distance ();
+
+   RoadMapMatchSigma = accuracy / 6.0;
+   RoadMapMatchBeta  = accuracy / 3.0;
+
+   if (RoadMapMatchSigma < 1.0) RoadMapMatchSigma = 1.0;
+   if (RoadMapMatchBeta  < 1.0) RoadMapMatchBeta  = 1.0;
+}
+
+
+static double roadmap_mapmatch_emission (const RoadMapNeighbour *line,
+                                         int steering) {
+
+   double distance = line->distance / RoadMapMatchSigma;
+   double delta;
+
+   /* Lines have no direction here: fold the angle into 0..90. */
+   delta = roadmap_math_delta_direction
+              (roadmap_math_azymuth (&line->from, &line->to), steering);
+   if (delta < 0) delta = -delta;
+   if (delta > 90) delta = 180 - delta;
+
+   delta /= ROADMAP_MAPMATCH_SIGMA_DIRECTION;
+
+   return 0.5 * (distance * distance + delta * delta);
+}
+
+
+/**
+ * @brief Measure a candidate line along its shape.
+ * Sets the length of the line and the offset of the matched position
+ * from the first end point of the line.
+ */
+static void roadmap_mapmatch_measure (RoadMapMatchStep *step, int j) {
+
+   const RoadMapNeighbour *line = step->candidate + j;
+
+   RoadMapPosition from;
+   RoadMapPosition to;
+   RoadMapPosition intersection;
+   int first_shape_line;
+   int last_shape_line;
+   int first_shape = -1;
+   int last_shape = -2;
+   int smallest = 0x7fffffff;
+   int length = 0;
+   int distance;
+   int square;
+   int i;
+
+   if (line->line.plugin_id == ROADMAP_PLUGIN_ID) {
+
+      square = roadmap_square_search (&step->endpoint[j][0]);
+
+      if (square >= 0 &&
+          roadmap_shape_in_square
+             (square, &first_shape_line, &last_shape_line) > 0) {
+
+         if (roadmap_shape_of_line (line->line.line_id,
+                                    first_shape_line, last_shape_line,
+                                    &first_shape, &last_shape) <= 0) {
+            first_shape = -1;
+            last_shape = -2;
+         }
+      }
+   }
+
+   step->offset[j] = 0;
+
+   from = step->endpoint[j][0];
+   to   = from;
+
+   for (i = first_shape; i <= last_shape + 1; ++i) {
+
+      if (i <= last_shape) {
+         roadmap_shape_get_position (i, &to);
+      } else {
+         to = step->endpoint[j][1];
+      }
+
+      distance = roadmap_math_get_distance_from_segment
+                    (&line->intersection, &from, &to, &intersection, NULL);
+
+      if (distance < smallest) {
+         smallest = distance;
+         step->offset[j] = length + roadmap_math_distance (&from, &intersection);
+      }
+
+      length += roadmap_math_distance (&from, &to);
+      from = to;
+   }
+
+   step->length[j] = length;
+}
+
+
+static int roadmap_mapmatch_node (RoadMapMatchGraph *graph,
+                                  const RoadMapPosition *position) {
+
+   int i;
+
+   for (i = 0; i < graph->count; ++i) {
+      if (graph->position[i].latitude  == position->latitude &&
+          graph->position[i].longitude == position->longitude) {
+         return i;
+      }
+   }
+   graph->position[i] = *position;
+   graph->count += 1;
+
+   return i;
+}
+
+
+static void roadmap_mapmatch_add_lines (RoadMapMatchGraph *graph,
+                                        const RoadMapMatchStep *step) {
+
+   int j;
+
+   for (j = 0; j < step->count; ++j) {
+
+      int *edge = graph->edge[graph->edge_count];
+
+      edge[0] = roadmap_mapmatch_node (graph, &step->endpoint[j][0]);
+      edge[1] = roadmap_mapmatch_node (graph, &step->endpoint[j][1]);
+
+      graph->length[graph->edge_count] = step->length[j];
+      graph->edge_count += 1;
+   }
+}
+
+
+/**
+ * @brief Find the shortest routes from one state of the previous fix.
+ * The search is bounded by the graph: it only follows the candidate
+ * lines of the two fixes, in either direction.
+ * @param graph the lines of the previous fix, then those of the current one
+ * @param route receives the length of the route to each state of the
+ *        current fix, or -1 if none was found.
+ */
+static void roadmap_mapmatch_route (const RoadMapMatchGraph *graph,
+                                    const RoadMapMatchStep *from,
+                                    int i,
+                                    const RoadMapMatchStep *to,
+                                    int *route) {
+
+   int  distance[ROADMAP_MAPMATCH_NODES];
+   char done[ROADMAP_MAPMATCH_NODES];
+   const int *edge = graph->edge[i];
+   int node;
+   int j, k;
+
+   for (node = 0; node < graph->count; ++node) {
+      distance[node] = -1;
+      done[node] = 0;
+   }
+   distance[edge[0]] = from->offset[i];
+   distance[edge[1]] = from->length[i] - from->offset[i];
+
+   for (;;) {
+
+      int best = -1;
+
+      for (node = 0; node < graph->count; ++node) {
+         if (done[node] || distance[node] < 0) continue;
+         if (best < 0 || distance[node] < distance[best]) best = node;
+      }
+      if (best < 0) break;
+
+      done[best] = 1;
+
+      for (k = 0; k < graph->edge_count; ++k) {
+
+         int next;
+
+         if (graph->edge[k][0] == best) {
+            next = graph->edge[k][1];
+         } else if (graph->edge[k][1] == best) {
+            next = graph->edge[k][0];
+         } else {
+            continue;
+         }
+         if (distance[next] < 0 ||
+             distance[best] + graph->length[k] < distance[next]) {
+            distance[next] = distance[best] + graph->length[k];
+         }
+      }
+   }
+
+   for (j = 0; j < to->count; ++j) {
+
+      const int *target = graph->edge[from->count + j];
+
+      route[j] = -1;
+
+      if (roadmap_plugin_same_line (&from->candidate[i].line,
+                                    &to->candidate[j].line)) {
+         route[j] = abs (to->offset[j] - from->offset[i]);
+      }
+      if (distance[target[0]] >= 0) {
+         k = distance[target[0]] + to->offset[j];
+         if (route[j] < 0 || k < route[j]) route[j] = k;
+      }
+      if (distance[target[1]] >= 0) {
+         k = distance[target[1]] + to->length[j] - to->offset[j];
+         if (route[j] < 0 || k < route[j]) route[j] = k;
+      }
+   }
+}
+
+
+static double roadmap_mapmatch_transition (const RoadMapMatchStep *from,
+                                           int i,
+                                           const RoadMapMatchStep *to,
+                                           int j,
+                                           double straight,
+                                           int route) {
+
+   if (route >= 0) {
+      return fabs (route - straight) / RoadMapMatchBeta;
+   }
+
+   /* Not connected through the lines around the two fixes: the actual
+    * route is at least twice the straight line between the projections.
+    */
+   route = 2 * roadmap_math_distance (&from->candidate[i].intersection,
+                                      &to->candidate[j].intersection);
+
+   return fabs (route - straight) / RoadMapMatchBeta
+             + ROADMAP_MAPMATCH_DISCONNECTED;
+}
+
+
+static RoadMapMatchStep *roadmap_mapmatch_at (RoadMapMatchLattice *lattice,
+                                               int index) {
+
+   return lattice->steps + (lattice->first + index) % lattice->capacity;
+}
+
+
+static RoadMapMatchStep *roadmap_mapmatch_last (RoadMapMatchLattice *lattice) {
+
+   if (lattice->count <= 0) return NULL;
+
+   return roadmap_mapmatch_at (lattice, lattice->count - 1);
+}
+
+
+static int roadmap_mapmatch_best (const RoadMapMatchStep *step) {
+
+   int state;
+   int i;
+
+   for (state = 0, i = 1; i < step->count; ++i) {
+      if (step->cost[i] < step->cost[state]) state = i;
+   }
+   return state;
+}
+
+
+/**
+ * @brief Commit the state of the oldest fix, before it leaves the window.
+ * The state is the one on the most likely path. The current states whose
+ * path goes through another state of the oldest fix are pruned.
+ */
+static void roadmap_mapmatch_commit (RoadMapMatchLattice *lattice) {
+
+   char pruned[ROADMAP_MAPMATCH_STATES];
+   char next[ROADMAP_MAPMATCH_STATES];
+   RoadMapMatchStep *step;
+   int committed;
+   int index;
+   int j;
+
+   step = roadmap_mapmatch_last (lattice);
+   committed = roadmap_mapmatch_best (step);
+
+   for (index = lattice->count - 1; index > 0 && committed >= 0; --index) {
+      committed = roadmap_mapmatch_at (lattice, index)->back[committed];
+   }
+   if (committed < 0) return;
+
+   for (index = 1; index < lattice->count; ++index) {
+
+      step = roadmap_mapmatch_at (lattice, index);
+
+      for (j = 0; j < step->count; ++j) {
+
+         int back = step->back[j];
+
+         if (back < 0) {
+            next[j] = 1;
+         } else if (index == 1) {
+            next[j] = (back != committed);
+         } else {
+            next[j] = pruned[back];
+         }
+      }
+      memcpy (pruned, next, step->count);
+   }
+
+   for (j = 0; j < step->count; ++j) {
+      if (pruned[j]) step->cost[j] = ROADMAP_MAPMATCH_PRUNED;
+   }
+}
+
+
+/**
+ * @brief Run one Viterbi step on the lattice.
+ * @return the index of the most likely current candidate, -1 if none.
+ */
+static int roadmap_mapmatch_step (RoadMapMatchLattice *lattice,
+                                  const RoadMapPosition *position,
+                                  int steering,
+                                  const RoadMapNeighbour *candidates,
+                                  int count) {
+
+   RoadMapMatchStep *previous;
+   RoadMapMatchStep *step;
+   RoadMapMatchGraph graph;
+   int route[ROADMAP_MAPMATCH_STATES][ROADMAP_MAPMATCH_STATES];
+   double straight = 0.0;
+   double best;
+   int found;
+   int i, j;
+
+   if (count <= 0) {
+      /* The chain is broken: start again with the next fix. */
+      lattice->count = 0;
+      return -1;
+   }
+   if (count > ROADMAP_MAPMATCH_STATES) count = ROADMAP_MAPMATCH_STATES;
+
+   previous = roadmap_mapmatch_last (lattice);
+
+   if (lattice->count < lattice->capacity) {
+      lattice->count += 1;
+   } else {
+      roadmap_mapmatch_commit (lattice);
+      lattice->first = (lattice->first + 1) % lattice->capacity;
+   }
+   step = roadmap_mapmatch_last (lattice);
+
+   step->position = *position;
+   step->count = count;
+   memcpy (step->candidate, candidates, count * sizeof(*candidates));
+
+   for (j = 0; j < count; ++j) {
+
+      if (roadmap_plugin_activate_db (&candidates[j].line) == -1) {
+         step->endpoint[j][0] = candidates[j].from;
+         step->endpoint[j][1] = candidates[j].to;
+      } else {
+         roadmap_plugin_line_from (&candidates[j].line, &step->endpoint[j][0]);
+         roadmap_plugin_line_to   (&candidates[j].line, &step->endpoint[j][1]);
+      }
+      roadmap_mapmatch_measure (step, j);
+   }
+
+   if (previous != NULL) {
+
+      straight = roadmap_math_distance (&previous->position, position);
+
+      graph.count = 0;
+      graph.edge_count = 0;
+      roadmap_mapmatch_add_lines (&graph, previous);
+      roadmap_mapmatch_add_lines (&graph, step);
+
+      for (i = 0; i < previous->count; ++i) {
+         roadmap_mapmatch_route (&graph, previous, i, step, route[i]);
+      }
+   }
+
+   best  = 0.0;
+   found = 0;
+
+   for (j = 0; j < count; ++j) {
+
+      double cost = roadmap_mapmatch_emission (candidates + j, steering);
+
+      step->back[j] = -1;
+
+      if (previous != NULL) {
+
+         double best_transition = 0.0;
+
+         for (i = 0; i < previous->count; ++i) {
+
+            double transition =
+               previous->cost[i] +
+                  roadmap_mapmatch_transition
+                     (previous, i, step, j, straight, route[i][j]);
+
+            if (step->back[j] < 0 || transition < best_transition) {
+               best_transition = transition;
+               step->back[j] = i;
+            }
+         }
+         cost += best_transition;
+      }
+
+      step->cost[j] = cost;
+
+      if (j == 0 || cost < best) {
+         best  = cost;
+         found = j;
+      }
+   }
+
+   /* Keep the costs small, only their differences matter. */
+   for (j = 0; j < count; ++j) {
+      step->cost[j] -= best;
+   }
+
+   return found;
+}
+
+
+/**
+ * @brief Follow the back pointers from the best current state.
+ * @param matched receives one line per step of the lattice, oldest first
+ */
+static void roadmap_mapmatch_backtrack (RoadMapMatchLattice *lattice,
+                                        RoadMapNeighbour *matched) {
+
+   int state;
+   int index;
+   RoadMapMatchStep *step = roadmap_mapmatch_last (lattice);
+
+   if (step == NULL) return;
+
+   state = roadmap_mapmatch_best (step);
+
+   for (index = lattice->count - 1; index >= 0; --index) {
+
+      step = roadmap_mapmatch_at (lattice, index);
+
+      if (state < 0) {
+         INVALIDATE_PLUGIN(matched[index].line);
+         continue;
+      }
+      matched[index] = step->candidate[state];
+
+      state = step->back[state];
+   }
+}
+
+
+/**
+ * @brief Tell if the navigation should use the HMM map matcher.
+ */
+int roadmap_mapmatch_enabled (void) {
+
+   return roadmap_config_match (&RoadMapConfigMapMatching, "hmm");
+}
+
+
+/**
+ * @brief Forget the fixes seen so far (e.g. after a GPS loss).
+ */
+void roadmap_mapmatch_reset (void) {
+
+   RoadMapMatchOnline.first = 0;
+   RoadMapMatchOnline.count = 0;
+}
+
+
+/**
+ * @brief Add one GPS fix to the online matcher.
+ * @param position the (adjusted) GPS position
+ * @param steering the GPS steering, in degrees
+ * @param candidates the lines close to the position
+ * @param count the number of candidates
+ * @return the index of the most likely line in candidates, -1 if none.
+ */
+int roadmap_mapmatch_update (const RoadMapPosition  *position,
+                             int steering,
+                             const RoadMapNeighbour *candidates,
+                             int count) {
+
+   roadmap_mapmatch_start_cycle ();
+
+   return roadmap_mapmatch_step
+             (&RoadMapMatchOnline, position, steering, candidates, count);
+}
+
+
+/**
+ * @brief Match a whole track (e.g. loaded from a GPX file).
+ * @param fixes the track points, in time order
+ * @param count the number of track points
+ * @param navigation_mode which layers to consider
+ * @param matched receives the line and the matched position of each track
+ *        point, the line being invalid if the point could not be matched
+ * @return the number of matched track points
+ */
+int roadmap_mapmatch_track (const RoadMapGpsPosition *fixes,
+                            int count,
+                            int navigation_mode,
+                            RoadMapNeighbour *matched) {
+
+   RoadMapMatchLattice lattice;
+   RoadMapNeighbour neighbours[ROADMAP_MAPMATCH_STATES];
+   RoadMapPosition position;
+   RoadMapArea focus;
+   int start;
+   int found;
+   int i;
+
+   if (count <= 0) return 0;
+
+   roadmap_mapmatch_start_cycle ();
+
+   lattice.steps = malloc (count * sizeof(RoadMapMatchStep));
+   roadmap_check_allocated(lattice.steps);
+   lattice.capacity = count;
+   lattice.first = 0;
+   lattice.count = 0;
+
+   start = 0;
+   found = 0;
+
+   for (i = 0; i < count; ++i) {
+
+      int neighbour_count;
+
+      position.longitude = fixes[i].longitude;
+      position.latitude  = fixes[i].latitude;
+
+      roadmap_math_focus_area
+         (&focus, &position, roadmap_fuzzy_max_distance());
+
+      neighbour_count = roadmap_navigate_get_neighbours
+                           (&focus, &position,
+                            neighbours, ROADMAP_MAPMATCH_STATES,
+                            navigation_mode);
+
+      if (neighbour_count <= 0) {
+
+         /* Close the current segment of the track, and skip this fix. */
+         roadmap_mapmatch_backtrack (&lattice, matched + start);
+
+         INVALIDATE_PLUGIN(matched[i].line);
+         lattice.first = 0;
+         lattice.count = 0;
+         start = i + 1;
+         continue;
+      }
+
+      roadmap_mapmatch_step (&lattice, &position, fixes[i].steering,
+                             neighbours, neighbour_count);
+   }
+
+   roadmap_mapmatch_backtrack (&lattice, matched + start);
+
+   free (lattice.steps);
+
+   for (i = 0; i < count; ++i) {
+      if (PLUGIN_VALID(matched[i].line)) found += 1;
+   }
+
+   return found;
+}
+
+
+/**
+ * @brief initialize this module
+ */
+void roadmap_mapmatch_initialize (void) {
+
+   roadmap_config_declare_enumeration
+      ("preferences", &RoadMapConfigMapMatching, "fuzzy", "hmm", NULL);
+}
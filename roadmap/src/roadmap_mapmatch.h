@@ -0,0 +1,54 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief roadmap_mapmatch.h - hidden Markov model map matching.
+ */
+
+#ifndef INCLUDED__ROADMAP_MAPMATCH__H
+#define INCLUDED__ROADMAP_MAPMATCH__H
+
+#include "roadmap_gps.h"
+#include "roadmap_plugin.h"
+
+/* Maximum number of candidate lines considered for one GPS fix. */
+#define ROADMAP_MAPMATCH_STATES  16
+
+/* Number of fixes kept for back tracking in the online matcher. */
+#define ROADMAP_MAPMATCH_WINDOW  8
+
+int  roadmap_mapmatch_enabled (void);
+
+void roadmap_mapmatch_reset (void);
+
+int  roadmap_mapmatch_update (const RoadMapPosition  *position,
+                              int steering,
+                              const RoadMapNeighbour *candidates,
+                              int count);
+
+int  roadmap_mapmatch_track (const RoadMapGpsPosition *fixes,
+                             int count,
+                             int navigation_mode,
+                             RoadMapNeighbour *matched);
+
+void roadmap_mapmatch_initialize (void);
+
+#endif // INCLUDED__ROADMAP_MAPMATCH__H
@@ -43,6 +43,7 @@
 #include "roadmap_locator.h"
 #include "roadmap_fuzzy.h"
 #include "roadmap_adjust.h"
+#include "roadmap_mapmatch.h"
 
 #include "roadmap_navigate.h"
 
@@ -167,6 +168,7 @@ int roadmap_navigate_get_neighbours (const RoadMapArea *focus,
 void roadmap_navigate_disable (void)
 {
     RoadMapNavigateEnabled = 0;
+    roadmap_mapmatch_reset ();
     roadmap_display_hide ("Approach");
     roadmap_display_hide ("Current Street");
 
@@ -537,14 +539,19 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position)
 
     RoadMapLatestGpsPosition = *gps_position;
 
-    if (gps_position->speed < roadmap_gps_speed_accuracy())
-	    return;
+    if (gps_position->speed < roadmap_gps_speed_accuracy()) {
+        /* Standing still: the steering is meaningless, and the next
+         * fix may be far from the last one matched.
+         */
+        roadmap_mapmatch_reset ();
+        return;
+    }
 
     roadmap_fuzzy_start_cycle ();
 
     roadmap_adjust_position (gps_position, &RoadMapLatestPosition);
 
-    if (RoadMapConfirmedStreet.valid) {
+    if (RoadMapConfirmedStreet.valid && ! roadmap_mapmatch_enabled ()) {
         /* We have an existing street match: check it is still valid. */
 
         RoadMapFuzzy before = RoadMapConfirmedStreet.fuzzyfied;
@@ -575,14 +582,38 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position)
     count = roadmap_navigate_get_neighbours (&focus, &RoadMapLatestPosition,
                  RoadMapNeighbourhood, ROADMAP_NEIGHBOURHOOD, navigation_mode);
 
-    for (i = 0, best = roadmap_fuzzy_false(), found = 0; i < count; ++i) {
-        result = roadmap_navigate_fuzzify (&candidate, RoadMapNeighbourhood+i,
-                      gps_position->steering);
+    if (roadmap_mapmatch_enabled ()) {
+
+        /* The HMM matcher picks the line from the recent fixes history,
+         * the fuzzy logic only decides if it is close enough.
+         */
+        found = roadmap_mapmatch_update (&RoadMapLatestPosition,
+                    gps_position->steering, RoadMapNeighbourhood, count);
+
+        best = roadmap_fuzzy_false();
+
+        if (found >= 0) {
+            roadmap_navigate_fuzzify (&nominated, RoadMapNeighbourhood+found,
+                                      gps_position->steering);
+            nominated.direction =
+                roadmap_math_azymuth (&RoadMapNeighbourhood[found].from,
+                                      &RoadMapNeighbourhood[found].to);
+            best = roadmap_fuzzy_distance (RoadMapNeighbourhood[found].distance);
+        } else {
+            found = 0;
+        }
+
+    } else {
+
+        for (i = 0, best = roadmap_fuzzy_false(), found = 0; i < count; ++i) {
+            result = roadmap_navigate_fuzzify (&candidate, RoadMapNeighbourhood+i,
+                          gps_position->steering);
 
-        if (result > best) {
-            found = i;
-            best = result;
-            nominated = candidate;
+            if (result > best) {
+                found = i;
+                best = result;
+                nominated = candidate;
+            }
         }
     }
 
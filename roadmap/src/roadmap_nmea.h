@@ -55,6 +55,7 @@ typedef union {
 
    struct {
       time_t fixtime;
+      int    fixmillis;
       char   status;
       int    latitude;
       int    longitude;
@@ -64,6 +65,7 @@ typedef union {
 
    struct {
       time_t fixtime;
+      int    fixmillis;
       int    latitude;
       int    longitude;
       int    quality;
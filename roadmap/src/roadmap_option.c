@@ -54,6 +54,9 @@ static RoadMapConfigDescriptor RoadMapConfigGeneralIcons =
 static RoadMapConfigDescriptor RoadMapConfigMapCache =
                         ROADMAP_CONFIG_ITEM("Map", "Cache");
 
+static RoadMapConfigDescriptor RoadMapConfigMapCacheMemory =
+                        ROADMAP_CONFIG_ITEM("Map", "Cache Memory");
+
 static RoadMapConfigDescriptor RoadMapConfigTripName =
                         ROADMAP_CONFIG_ITEM("Trip", "Name");
 
@@ -149,6 +152,13 @@ int roadmap_option_cache (void) {
 }
 
 
+/* in megabytes */
+int roadmap_option_cache_memory (void) {
+
+   return roadmap_config_get_integer (&RoadMapConfigMapCacheMemory);
+}
+
+
 int roadmap_option_width (const char *name) {
 
     const char *option = roadmap_option_get_geometry (name);
@@ -581,5 +591,6 @@ void roadmap_option_initialize (void) {
       ("preferences", &RoadMapConfigGeneralIcons, "yes", "no", NULL);
 
    roadmap_config_declare ("preferences", &RoadMapConfigMapCache, "8");
+   roadmap_config_declare ("preferences", &RoadMapConfigMapCacheMemory, "64");
 }
 
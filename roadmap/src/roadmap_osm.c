@@ -77,12 +77,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "roadmap.h"
 #include "roadmap_types.h"
 #include "roadmap_config.h"
 #include "roadmap_math.h"
 #include "roadmap_scan.h"
-#include "roadmap_file.h"
+#include "roadmap_path.h"
 #include "roadmap_osm.h"
 
 static RoadMapConfigDescriptor RoadMapConfigOSMBits =
@@ -273,12 +274,121 @@ static void roadmap_osm_add_tile_to_list(int tileid) {
     roadmap_osm_tilelist[roadmap_osm_tilelist_len-1] = -tileid;
 }
 
-// FIXME -- need to make these accessible, so they can be
-// reset manually, or when we somehow know new maps are available.
+/* these are reset by roadmap_osm_tiles_changed() */
 static int roadmap_osm_maps_available = -1;
 static int roadmap_osm_maps_biggest, roadmap_osm_maps_smallest;
+static int roadmap_osm_overview_levels;  /* bitmask, by tile bits */
 static const char *roadmap_osm_bits_paths[32];
 
+/* how far roadmap_osm_add_if_exists() looks for smaller tiles */
+static int roadmap_osm_split_limit;
+
+/* the tiles found in each qtN directory, sorted, so that looking
+ * for a tile on each repaint does not cost a stat() per tile.
+ */
+static int *roadmap_osm_tiles[32];
+static int  roadmap_osm_tiles_count[32];
+
+static int roadmap_osm_compare_tileids (const void *a, const void *b) {
+
+    int t1 = *(const int *)a;
+    int t2 = *(const int *)b;
+
+    return (t1 > t2) - (t1 < t2);
+}
+
+/* list the tiles of one size, which are stored in qtN/xx/yy/ */
+static void roadmap_osm_index_tiles(int bits) {
+
+    char bitsdir[16];
+    char name[32];
+    char *top, *middle, *bottom;
+    char **level1, **level2, **files;
+    char **d1, **d2, **f;
+    unsigned int tileid;
+    int max = 0;
+
+    sprintf(bitsdir, "qt%d", bits);
+    top = roadmap_path_join (roadmap_osm_bits_paths[bits], bitsdir);
+
+    level1 = roadmap_path_list (top, NULL);
+    for (d1 = level1; *d1 != NULL; d1++) {
+
+        middle = roadmap_path_join (top, *d1);
+        level2 = roadmap_path_list (middle, NULL);
+
+        for (d2 = level2; *d2 != NULL; d2++) {
+
+            bottom = roadmap_path_join (middle, *d2);
+            files = roadmap_path_list (bottom, ".rdm");
+
+            for (f = files; *f != NULL; f++) {
+
+                /* only keep the names that buildmap_osm would write */
+                if (sscanf (*f, "qt%8x", &tileid) != 1 ||
+                    tileid2bits((int)tileid) != bits ||
+                    strcmp (*f, roadmap_osm_filename
+                                    (name, 0, tileid, ".rdm")) != 0) {
+                    continue;
+                }
+
+                if (roadmap_osm_tiles_count[bits] == max) {
+                    max = max ? 2 * max : 256;
+                    roadmap_osm_tiles[bits] = realloc
+                        (roadmap_osm_tiles[bits], max * sizeof(int));
+                    roadmap_check_allocated(roadmap_osm_tiles[bits]);
+                }
+                roadmap_osm_tiles[bits][roadmap_osm_tiles_count[bits]++] =
+                    tileid;
+            }
+            roadmap_path_list_free (files);
+            roadmap_path_free (bottom);
+        }
+        roadmap_path_list_free (level2);
+        roadmap_path_free (middle);
+    }
+    roadmap_path_list_free (level1);
+    roadmap_path_free (top);
+
+    qsort (roadmap_osm_tiles[bits], roadmap_osm_tiles_count[bits],
+           sizeof(int), roadmap_osm_compare_tileids);
+
+    roadmap_log (ROADMAP_INFO, "found %d tiles in %s/%s",
+                 roadmap_osm_tiles_count[bits],
+                 roadmap_osm_bits_paths[bits], bitsdir);
+}
+
+static int roadmap_osm_tile_exists(int tileid) {
+
+    int bits = tileid2bits(tileid);
+
+    return roadmap_osm_tiles_count[bits] > 0 &&
+           bsearch (&tileid, roadmap_osm_tiles[bits],
+                    roadmap_osm_tiles_count[bits], sizeof(int),
+                    roadmap_osm_compare_tileids) != NULL;
+}
+
+/**
+ * @brief forget which tiles are available, so that the maps directories
+ *        are scanned again the next time tiles are needed
+ *
+ * This must be called when tiles were added or removed while RoadMap runs.
+ */
+void roadmap_osm_tiles_changed(void) {
+
+    int bits;
+
+    for (bits = 0; bits < 32; bits++) {
+        free (roadmap_osm_tiles[bits]);
+        roadmap_osm_tiles[bits] = NULL;
+        roadmap_osm_tiles_count[bits] = 0;
+        roadmap_osm_bits_paths[bits] = NULL;
+    }
+    roadmap_osm_maps_available = -1;
+    roadmap_osm_maps_biggest = roadmap_osm_maps_smallest = 0;
+    roadmap_osm_overview_levels = 0;
+}
+
 /* we want to add a tile, but if it doesn't exist, we want to see
  * if its children exist, so we can add them instead.
  */
@@ -289,12 +399,10 @@ static void roadmap_osm_add_if_exists(int tileid) {
     
     bits = tileid2bits(tileid);
 
-    if (roadmap_osm_bits_paths[bits] &&
-        roadmap_file_exists (roadmap_osm_bits_paths[bits],
-		roadmap_osm_filename(NULL, 1, tileid, ".rdm"))) {
+    if (roadmap_osm_tile_exists(tileid)) {
         roadmap_osm_add_tile_to_list(tileid);
     } else {
-        if (bits < roadmap_osm_maps_smallest) {
+        if (bits < roadmap_osm_split_limit) {
             int children[2];
             roadmap_osm_tilesplit(tileid, children, 1);
             for (i = 0; i < 2; i++) {
@@ -304,10 +412,42 @@ static void roadmap_osm_add_if_exists(int tileid) {
     }
 }
 
-/* load the externally-provided list with tileids. */
-int roadmap_osm_by_position
+/* find the qtN directories, and the tiles in them.  the sizes below
+ * Map.QuadTile bits only hold overview tiles.
+ */
+static void roadmap_osm_find_maps(void) {
+
+    char bitsdir[16];
+    const char *path;
+    int bits;
+
+    roadmap_osm_maps_available = 0;
+    for (bits = TILE_MINBITS; bits <= TILE_MAXBITS; bits++) {
+        sprintf(bitsdir, "qt%d", bits);
+        path = roadmap_scan ("maps", bitsdir);
+        if (!path) continue;
+
+        roadmap_osm_bits_paths[bits] = path;
+        roadmap_osm_index_tiles(bits);
+
+        if (bits < RoadMapOSMBits) {
+            roadmap_osm_overview_levels |= (1 << bits);
+            continue;
+        }
+        if (!roadmap_osm_maps_biggest)
+            roadmap_osm_maps_biggest = bits;
+        roadmap_osm_maps_smallest = bits;
+        roadmap_osm_maps_available = 1;
+    }
+}
+
+/* list the tiles of the given size around the position, or the
+ * smaller tiles down to the split limit where they are missing.
+ */
+static int roadmap_osm_list_tiles
         (const RoadMapPosition *position,
-         const RoadMapArea *focus, int **fips, int in_count) {
+         const RoadMapArea *focus, int **fips, int in_count,
+         int bits, int split_limit) {
 
     int i, d, width;
     int tileid;
@@ -315,35 +455,12 @@ int roadmap_osm_by_position
     RoadMapArea tileedges;
     int reallyfound, oreally;
 
-    if (RoadMapOSMBits <= 0) return in_count;  /* master shutoff */
-
-    if (roadmap_osm_maps_available < 0) {
-	char bitsdir[16];
-	 const char *path;
-	int bits;
-
-	roadmap_osm_maps_available = 0;
-	for (bits = RoadMapOSMBits; bits <= TILE_MAXBITS; bits++) {
-	    sprintf(bitsdir, "qt%d", bits);
-	    path = roadmap_scan ("maps", bitsdir);
-	    if (path) {
-		if (!roadmap_osm_maps_biggest)
-		    roadmap_osm_maps_biggest = bits;
-		roadmap_osm_maps_smallest = bits;
-		roadmap_osm_bits_paths[bits] = path;
-		roadmap_osm_maps_available = 1;
-	    }
-	}
-    }
-
-    if ( !roadmap_osm_maps_available )
-	return in_count;
-
     roadmap_osm_tilelist_len = in_count;
     roadmap_osm_tilelist = *fips;
+    roadmap_osm_split_limit = split_limit;
 
     tileid = roadmap_osm_latlon2tileid
-            (position->latitude, position->longitude, roadmap_osm_maps_biggest);
+            (position->latitude, position->longitude, bits);
     roadmap_osm_add_if_exists(tileid);
 
 
@@ -393,6 +510,58 @@ int roadmap_osm_by_position
     return roadmap_osm_tilelist_len;
 }
 
+/* load the externally-provided list with tileids. */
+int roadmap_osm_by_position
+        (const RoadMapPosition *position,
+         const RoadMapArea *focus, int **fips, int in_count) {
+
+    if (RoadMapOSMBits <= 0) return in_count;  /* master shutoff */
+
+    if (roadmap_osm_maps_available < 0)
+        roadmap_osm_find_maps();
+
+    if ( !roadmap_osm_maps_available )
+	return in_count;
+
+    return roadmap_osm_list_tiles (position, focus, fips, in_count,
+                roadmap_osm_maps_biggest, roadmap_osm_maps_smallest);
+}
+
+/* the zoom an overview tile is meant to be drawn at */
+int roadmap_osm_overview_zoom(int bits) {
+
+    return (MaxLon >> ((bits - 1) / 2)) / ROADMAP_OSM_OVERVIEW_PIXELS;
+}
+
+/* same as roadmap_osm_by_position(), but for drawing the focus area at
+ * the current zoom: when zoomed out enough, the overview tiles replace
+ * the many detailed tiles that would be in view.
+ */
+int roadmap_osm_by_view
+        (const RoadMapPosition *position,
+         const RoadMapArea *focus, int **fips, int in_count) {
+
+    int bits;
+    int zoom;
+
+    if (RoadMapOSMBits <= 0) return in_count;  /* master shutoff */
+
+    if (roadmap_osm_maps_available < 0)
+        roadmap_osm_find_maps();
+
+    /* the coarsest overview that is still detailed enough at this zoom */
+    zoom = roadmap_math_get_zoom ();
+    for (bits = TILE_MINBITS; bits < RoadMapOSMBits; bits++) {
+        if ((roadmap_osm_overview_levels & (1 << bits)) &&
+            zoom >= roadmap_osm_overview_zoom(bits)) {
+            return roadmap_osm_list_tiles
+                        (position, focus, fips, in_count, bits, bits);
+        }
+    }
+
+    return roadmap_osm_by_position (position, focus, fips, in_count);
+}
+
 void roadmap_osm_initialize (void) {
 
     roadmap_config_declare
@@ -50,6 +50,11 @@
 #define mktileid(tru, bits)     \
     (((tru) << (4 + (27 - (bits)))) | ((bits) - 12))
 
+/* the tiles with fewer bits than Map.QuadTile bits are overview tiles,
+ * each meant to be drawn about this many pixels wide.
+ */
+#define ROADMAP_OSM_OVERVIEW_PIXELS 256
+
 int roadmap_osm_latlon2tileid(int lat, int lon, int bits);
 void roadmap_osm_tileid_to_bbox(int tileid, RoadMapArea *edges);
 char *roadmap_osm_filename(char *buf, int dirpath, int tileid, char *suffix);
@@ -59,11 +64,18 @@ int  roadmap_osm_by_position
         (const RoadMapPosition *position,
          const RoadMapArea *focus, int **fips, int in_count);
 
+int  roadmap_osm_by_view
+        (const RoadMapPosition *position,
+         const RoadMapArea *focus, int **fips, int in_count);
+
+int  roadmap_osm_overview_zoom(int bits);
+
 int  roadmap_osm_by_position_munged
         (const RoadMapPosition *position,
          const RoadMapArea *focus, int **fips, int in_count);
 
 void roadmap_osm_initialize(void);
+void roadmap_osm_tiles_changed(void);
    
 
 int roadmap_osm_tileid_to_neighbor(int tileid, int dir);
@@ -0,0 +1,169 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief read the compressed coordinate tables.
+ *
+ * The records are decoded one block at a time, when first accessed.
+ * The last decoded blocks are kept in a small cache: the points of a
+ * square, or the shape of a line, are usually read one after the other.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_dbread.h"
+#include "roadmap_db_packed.h"
+
+#include "roadmap_packed.h"
+
+
+#define ROADMAP_PACKED_CACHE  8   /* must be a power of 2 */
+
+struct roadmap_packed_context {
+
+   const unsigned char *data;
+   const int           *blocks;
+   int                  count;
+   int                  size;
+
+   int            cached[ROADMAP_PACKED_CACHE];
+   unsigned short values[ROADMAP_PACKED_CACHE][ROADMAP_DB_PACKED_BLOCK * 2];
+};
+
+
+/**
+ * @brief find the compressed table in a section
+ * @param parent the section (point, shape..)
+ * @return the table, or NULL if this section is not compressed
+ */
+RoadMapPacked *roadmap_packed_map (roadmap_db *parent) {
+
+   int i;
+   int block_count;
+   roadmap_db *data_table;
+   roadmap_db *blocks_table;
+   RoadMapPacked *packed;
+
+   data_table = roadmap_db_get_subsection (parent, "packed");
+   blocks_table = roadmap_db_get_subsection (parent, "blocks");
+
+   if (data_table == NULL || blocks_table == NULL) return NULL;
+
+   packed = malloc (sizeof(RoadMapPacked));
+   roadmap_check_allocated(packed);
+
+   packed->data   = (const unsigned char *) roadmap_db_get_data (data_table);
+   packed->count  = roadmap_db_get_count (data_table);
+   packed->size   = roadmap_db_get_size (data_table);
+   packed->blocks = (const int *) roadmap_db_get_data (blocks_table);
+
+   block_count = (packed->count + ROADMAP_DB_PACKED_BLOCK - 1)
+                    / ROADMAP_DB_PACKED_BLOCK;
+
+   if (roadmap_db_get_count (blocks_table) != block_count + 1 ||
+       roadmap_db_get_size (blocks_table) != (block_count + 1) * sizeof(int) ||
+       packed->blocks[block_count] != packed->size) {
+      roadmap_log (ROADMAP_FATAL, "invalid %s/blocks structure",
+                   roadmap_db_get_name (parent));
+   }
+
+   for (i = 0; i < ROADMAP_PACKED_CACHE; ++i) {
+      packed->cached[i] = -1;
+   }
+
+   return packed;
+}
+
+
+void roadmap_packed_unmap (RoadMapPacked *packed) {
+
+   free (packed);
+}
+
+
+int roadmap_packed_count (const RoadMapPacked *packed) {
+
+   return packed->count;
+}
+
+
+int roadmap_packed_size (const RoadMapPacked *packed) {
+
+   return packed->size;
+}
+
+
+static void roadmap_packed_decode (RoadMapPacked *packed,
+                                   int block, unsigned short *values) {
+
+   const unsigned char *cursor = packed->data + packed->blocks[block];
+   const unsigned char *end = packed->data + packed->blocks[block+1];
+
+   unsigned short previous[2] = {0, 0};
+   unsigned int   zigzag;
+   unsigned char  byte;
+   int shift;
+   int count;
+   int i;
+
+   count = packed->count - (block * ROADMAP_DB_PACKED_BLOCK);
+   if (count > ROADMAP_DB_PACKED_BLOCK) count = ROADMAP_DB_PACKED_BLOCK;
+
+   for (i = 0; i < 2 * count; ++i) {
+
+      zigzag = 0;
+      shift = 0;
+      do {
+         if (cursor >= end) {
+            roadmap_log (ROADMAP_FATAL, "corrupted compressed block %d", block);
+         }
+         byte = *(cursor++);
+         zigzag |= (unsigned int)(byte & 0x7f) << shift;
+         shift += 7;
+      } while (byte & 0x80);
+
+      previous[i & 1] += (unsigned short) ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+      values[i] = previous[i & 1];
+   }
+}
+
+
+/**
+ * @brief get one record
+ * @param packed
+ * @param index the record index
+ * @return the two values of the record, valid until the next call
+ */
+const unsigned short *roadmap_packed_get (RoadMapPacked *packed, int index) {
+
+   int block = index / ROADMAP_DB_PACKED_BLOCK;
+   int slot = block & (ROADMAP_PACKED_CACHE - 1);
+
+   if (packed->cached[slot] != block) {
+      roadmap_packed_decode (packed, block, packed->values[slot]);
+      packed->cached[slot] = block;
+   }
+
+   return packed->values[slot] + 2 * (index % ROADMAP_DB_PACKED_BLOCK);
+}
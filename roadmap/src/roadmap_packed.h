@@ -0,0 +1,41 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief read the compressed coordinate tables.
+ */
+
+#ifndef INCLUDED__ROADMAP_PACKED__H
+#define INCLUDED__ROADMAP_PACKED__H
+
+#include "roadmap_dbread.h"
+
+typedef struct roadmap_packed_context RoadMapPacked;
+
+RoadMapPacked *roadmap_packed_map (roadmap_db *parent);
+void roadmap_packed_unmap (RoadMapPacked *packed);
+
+int  roadmap_packed_count (const RoadMapPacked *packed);
+int  roadmap_packed_size  (const RoadMapPacked *packed);
+
+const unsigned short *roadmap_packed_get (RoadMapPacked *packed, int index);
+
+#endif // INCLUDED__ROADMAP_PACKED__H
@@ -34,6 +34,7 @@
 #include "roadmap_dbread.h"
 #include "roadmap_db_point.h"
 
+#include "roadmap_packed.h"
 #include "roadmap_square.h"
 #include "roadmap_point.h"
 
@@ -47,15 +48,17 @@ typedef struct {
    RoadMapPoint *Point;	/**< */
    int           PointCount;	/**< */
 
+   RoadMapPacked *Packed;	/**< the points, if stored compressed */
+
    RoadMapPointBySquare *BySquare;	/**< */
    int                   BySquareCount;	/**< */
-
-   int            *PointToSquare;	/**< */
+   int                   BySquareUsed;	/**< squares up to the last point */
 
 } RoadMapPointContext;
 
 static RoadMapPointContext *RoadMapPointActive = NULL;
-static int RoadMapPointPositionLastSquare = -2;
+static int RoadMapPointPositionLastFirst = 0;
+static int RoadMapPointPositionLastEnd = 0;
 static RoadMapPosition RoadMapPointPositionLastMin;
 
 /**
@@ -79,21 +82,43 @@ static void *roadmap_point_map (roadmap_db *root) {
 
    context->BySquare =
       (RoadMapPointBySquare *) roadmap_db_get_data (bysquare_table);
-   context->Point = (RoadMapPoint *) roadmap_db_get_data (point_table);
-
    context->BySquareCount = roadmap_db_get_count (bysquare_table);
-   context->PointCount    = roadmap_db_get_count (point_table);
 
    if (roadmap_db_get_size(bysquare_table) !=
           context->BySquareCount * sizeof(RoadMapPointBySquare)) {
       roadmap_log (ROADMAP_FATAL, "invalid point/bysquare structure");
    }
-   if (roadmap_db_get_size(point_table) !=
-          context->PointCount * sizeof(RoadMapPoint)) {
-      roadmap_log (ROADMAP_FATAL, "invalid point/data structure");
+
+   if (point_table != NULL) {
+
+      context->Packed = NULL;
+      context->Point = (RoadMapPoint *) roadmap_db_get_data (point_table);
+      context->PointCount = roadmap_db_get_count (point_table);
+
+      if (roadmap_db_get_size(point_table) !=
+             context->PointCount * sizeof(RoadMapPoint)) {
+         roadmap_log (ROADMAP_FATAL, "invalid point/data structure");
+      }
+
+   } else {
+
+      context->Packed = roadmap_packed_map (root);
+      if (context->Packed == NULL) {
+         roadmap_log (ROADMAP_FATAL, "no point/data table");
+      }
+      context->Point = NULL;
+      context->PointCount = roadmap_packed_count (context->Packed);
    }
 
-   context->PointToSquare = NULL;
+   /* The points are stored in square order, and each square starts
+    * where the previous one ends: the square of a point can be found
+    * in this table, no reverse table is needed.
+    */
+   context->BySquareUsed = context->BySquareCount;
+   while (context->BySquareUsed > 0 &&
+          context->BySquare[context->BySquareUsed-1].count == 0) {
+      context->BySquareUsed -= 1;
+   }
 
    return context;
 }
@@ -112,7 +137,8 @@ static void roadmap_point_activate (void *context) {
       roadmap_log (ROADMAP_FATAL, "cannot activate (invalid context type)");
    }
    RoadMapPointActive = point_context;
-   RoadMapPointPositionLastSquare = -2;
+   RoadMapPointPositionLastFirst = 0;
+   RoadMapPointPositionLastEnd = 0;
 }
 
 /**
@@ -128,8 +154,8 @@ static void roadmap_point_unmap (void *context) {
       RoadMapPointActive = NULL;
    }
 
-   if (point_context->PointToSquare != NULL) {
-      free (point_context->PointToSquare);
+   if (point_context->Packed != NULL) {
+      roadmap_packed_unmap (point_context->Packed);
    }
    free (point_context);
 }
@@ -145,35 +171,36 @@ roadmap_db_handler RoadMapPointHandler = {
 };
 
 /**
- * @brief
+ * @brief find the square a point belongs to
+ * @param point
+ * @return the square index
  */
-static void roadmap_point_retrieve_square (void) {
+static int roadmap_point_square (int point) {
 
-   int i;
-   int j;
-   int            *point2square;
+   RoadMapPointBySquare *bysquare = RoadMapPointActive->BySquare;
+   int low = 0;
+   int high = RoadMapPointActive->BySquareUsed - 1;
+   int middle;
 
-   point2square = RoadMapPointActive->PointToSquare;
-   if (point2square == NULL) {
+   /* Search the last square that starts at or before this point. */
+   while (low < high) {
 
-       point2square = calloc (RoadMapPointActive->PointCount, sizeof(int));
-       roadmap_check_allocated(point2square);
+      middle = (low + high + 1) / 2;
 
-       RoadMapPointActive->PointToSquare = point2square;
+      if (bysquare[middle].first <= point) {
+         low = middle;
+      } else {
+         high = middle - 1;
+      }
    }
 
-   for (i = 0; i < RoadMapPointActive->BySquareCount; i++) {
-
-      int square;
-      int end = RoadMapPointActive->BySquare[i].first
-                   + RoadMapPointActive->BySquare[i].count;
-
-      square = roadmap_square_from_index (i);
-
-      for (j = RoadMapPointActive->BySquare[i].first; j < end; j++) {
-         point2square[j] = square;
-      }
+   if (high < 0 ||
+       point < bysquare[low].first ||
+       point >= bysquare[low].first + bysquare[low].count) {
+      roadmap_log (ROADMAP_FATAL, "point %d is in no square", point);
    }
+
+   return low;
 }
 
 /**
@@ -215,33 +242,36 @@ void roadmap_point_position  (int point, RoadMapPosition *position) {
    }
 #endif
 
-   if (RoadMapPointActive->PointToSquare != NULL) {
-      point_square = RoadMapPointActive->PointToSquare[point];
-   } else {
-      point_square = -1;
+   if (point < RoadMapPointPositionLastFirst ||
+       point >= RoadMapPointPositionLastEnd) {
+
+      point_square = roadmap_point_square (point);
+
+      RoadMapPointPositionLastFirst =
+         RoadMapPointActive->BySquare[point_square].first;
+      RoadMapPointPositionLastEnd = RoadMapPointPositionLastFirst
+         + RoadMapPointActive->BySquare[point_square].count;
+      roadmap_square_min
+         (roadmap_square_from_index (point_square),
+          &RoadMapPointPositionLastMin);
    }
 
-   if (RoadMapPointPositionLastSquare != point_square) {
+   if (RoadMapPointActive->Point != NULL) {
+
+      Point = RoadMapPointActive->Point + point;
+      position->longitude =
+	   RoadMapPointPositionLastMin.longitude + Point->longitude;
+      position->latitude =
+	   RoadMapPointPositionLastMin.latitude  + Point->latitude;
 
-      if (point_square < 0) {
+   } else {
 
-         roadmap_point_retrieve_square ();
+      const unsigned short *packed =
+         roadmap_packed_get (RoadMapPointActive->Packed, point);
 
-         if (RoadMapPointActive->PointToSquare != NULL) {
-            point_square = RoadMapPointActive->PointToSquare[point];
-         } else {
-            roadmap_log (ROADMAP_FATAL, "bad PointToSquare pointers");
-         }
-      }
-      RoadMapPointPositionLastSquare = point_square;
-      roadmap_square_min (point_square, &RoadMapPointPositionLastMin);
+      position->longitude = RoadMapPointPositionLastMin.longitude + packed[0];
+      position->latitude  = RoadMapPointPositionLastMin.latitude  + packed[1];
    }
-
-   Point = RoadMapPointActive->Point + point;
-   position->longitude =
-	RoadMapPointPositionLastMin.longitude + Point->longitude;
-   position->latitude =
-	RoadMapPointPositionLastMin.latitude  + Point->latitude;
 }
 
 #ifdef HAVE_NAVIGATE_PLUGIN
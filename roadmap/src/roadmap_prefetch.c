@@ -0,0 +1,159 @@
+/*
+ * LICENSE:
+ *
+ *   This file is part of RoadMap.
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * @brief read the maps ahead of the GPS position, before they are drawn.
+ *
+ * At highway speed a new map (county or OSM tile) comes into view every
+ * few minutes, and reading it from the disk in the middle of a repaint
+ * shows as a pause. This module guesses where the vehicle will be in a
+ * little while, from its speed and heading, or from the next point of
+ * the route when one is followed, and asks the OS to read the files of
+ * the maps around that position in the background.
+ *
+ * This runs from the GPS listener, so it never opens a map: the maps are
+ * opened as usual when they are drawn, and only find their pages already
+ * in memory.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_types.h"
+#include "roadmap_config.h"
+#include "roadmap_gps.h"
+#include "roadmap_math.h"
+#include "roadmap_trip.h"
+#include "roadmap_locator.h"
+
+#include "roadmap_prefetch.h"
+
+
+static RoadMapConfigDescriptor RoadMapConfigPrefetchAhead =
+                        ROADMAP_CONFIG_ITEM("Map", "Prefetch Seconds");
+
+/* Do not look ahead more often than this (seconds). */
+#define ROADMAP_PREFETCH_PERIOD     5
+
+/* Below this speed (knots) the maps in view change slowly enough. */
+#define ROADMAP_PREFETCH_MIN_SPEED  10
+
+/* One knot during one second, in millionths of a degree of latitude
+ * (1852 / 3600 meters, with 0.11132 meter per millionth of a degree).
+ */
+#define ROADMAP_PREFETCH_KNOT_SECOND  4.621
+
+static int RoadMapPrefetchLast = 0;
+
+
+/**
+ * @brief where the vehicle is expected to be after some time
+ * @param gps the current GPS position, speed and heading
+ * @param seconds how far ahead to look
+ * @param ahead the expected position
+ */
+static void roadmap_prefetch_predict (const RoadMapGpsPosition *gps,
+                                      int seconds,
+                                      RoadMapPosition *ahead) {
+
+   const RoadMapPosition *next = roadmap_trip_get_next_position ();
+   RoadMapPosition here;
+   double distance;
+   double angle;
+   double dlongitude;
+   double dlatitude;
+
+   here.longitude = gps->longitude;
+   here.latitude  = gps->latitude;
+
+   distance = gps->speed * seconds * ROADMAP_PREFETCH_KNOT_SECOND;
+
+   /* The route says where the road turns, the heading does not. */
+   if (next != NULL) {
+      angle = roadmap_math_azymuth (&here, next);
+   } else {
+      angle = gps->steering;
+   }
+   angle = angle * M_PI / 180.0;
+
+   dlatitude  = distance * cos (angle);
+   dlongitude = distance * sin (angle)
+                   / cos (here.latitude * M_PI / 180000000.0);
+
+   if (next != NULL &&
+       fabs (dlatitude) >= abs (next->latitude - here.latitude) &&
+       fabs (dlongitude) >= abs (next->longitude - here.longitude)) {
+
+      /* The route point will be reached first. */
+      *ahead = *next;
+      return;
+   }
+
+   ahead->longitude = here.longitude + (int) dlongitude;
+   ahead->latitude  = here.latitude  + (int) dlatitude;
+}
+
+
+static void roadmap_prefetch_gps_update
+               (int reception, int gps_time,
+                const RoadMapGpsPrecision *dilution,
+                const RoadMapGpsPosition *gps_position) {
+
+   int seconds;
+   RoadMapPosition ahead;
+   RoadMapArea area;
+
+   if (reception <= GPS_RECEPTION_NONE) return;
+   if (gps_position->speed < ROADMAP_PREFETCH_MIN_SPEED) return;
+
+   if (gps_time >= RoadMapPrefetchLast &&
+       gps_time < RoadMapPrefetchLast + ROADMAP_PREFETCH_PERIOD) {
+      return;
+   }
+   RoadMapPrefetchLast = gps_time;
+
+   seconds = roadmap_config_get_integer (&RoadMapConfigPrefetchAhead);
+   if (seconds <= 0) return;
+
+   roadmap_prefetch_predict (gps_position, seconds, &ahead);
+
+   /* The area that would be shown there, at the current scale. */
+   roadmap_math_get_focus (&area);
+   area.east  += ahead.longitude - gps_position->longitude;
+   area.west  += ahead.longitude - gps_position->longitude;
+   area.north += ahead.latitude  - gps_position->latitude;
+   area.south += ahead.latitude  - gps_position->latitude;
+
+   if (roadmap_locator_prefetch (&ahead, &area) > 0) {
+      roadmap_log (ROADMAP_DEBUG, "reading the maps around %d,%d",
+                   ahead.longitude, ahead.latitude);
+   }
+}
+
+
+void roadmap_prefetch_initialize (void) {
+
+   roadmap_config_declare
+      ("preferences", &RoadMapConfigPrefetchAhead, "60");
+
+   roadmap_gps_register_listener (roadmap_prefetch_gps_update);
+}
@@ -1567,7 +1567,7 @@ void roadmap_screen_repaint (void) {
     /* Repaint the drawing buffer. */
     
     /* - Identifies the candidate counties. */
-    count = roadmap_locator_by_position
+    count = roadmap_locator_by_view
                 (roadmap_math_get_center(), &fipslist);
 
     if (count == 0) {
@@ -35,6 +35,7 @@
 #include "roadmap_db_shape.h"
 
 #include "roadmap_line.h"
+#include "roadmap_packed.h"
 #include "roadmap_shape.h"
 #include "roadmap_square.h"
 
@@ -48,6 +49,8 @@ typedef struct {
    RoadMapShape *Shape;
    int           ShapeCount;
 
+   RoadMapPacked *Packed; /* the shapes, if stored compressed. */
+
    RoadMapShapeByLine *ShapeByLine;
    int                 ShapeByLineCount;
 
@@ -88,12 +91,25 @@ static void *roadmap_shape_map (roadmap_db *root) {
    line_table   = roadmap_db_get_subsection (root, "byline");
    square_table = roadmap_db_get_subsection (root, "bysquare");
 
-   context->Shape = (RoadMapShape *) roadmap_db_get_data (shape_table);
-   context->ShapeCount = roadmap_db_get_count (shape_table);
+   if (shape_table != NULL) {
+
+      context->Packed = NULL;
+      context->Shape = (RoadMapShape *) roadmap_db_get_data (shape_table);
+      context->ShapeCount = roadmap_db_get_count (shape_table);
+
+      if (roadmap_db_get_size (shape_table) !=
+          context->ShapeCount * sizeof(RoadMapShape)) {
+         roadmap_log (ROADMAP_FATAL, "invalid shape/data structure");
+      }
+
+   } else {
 
-   if (roadmap_db_get_size (shape_table) !=
-       context->ShapeCount * sizeof(RoadMapShape)) {
-      roadmap_log (ROADMAP_FATAL, "invalid shape/data structure");
+      context->Packed = roadmap_packed_map (root);
+      if (context->Packed == NULL) {
+         roadmap_log (ROADMAP_FATAL, "no shape/data table");
+      }
+      context->Shape = NULL;
+      context->ShapeCount = roadmap_packed_count (context->Packed);
    }
 
    context->ShapeByLine =
@@ -129,15 +145,6 @@ static void roadmap_shape_activate (void *context) {
       if (shape_context->type != RoadMapShapeType) {
          roadmap_log (ROADMAP_FATAL, "cannot activate shape (bad type)");
       }
-
-      if (shape_context->shape_cache == NULL) {
-
-         shape_context->shape_cache_size = roadmap_line_count();
-         shape_context->shape_cache =
-            calloc ((shape_context->shape_cache_size / (8 * sizeof(int))) + 1,
-                  sizeof(int));
-         roadmap_check_allocated(shape_context->shape_cache);
-      }
    }
 
    RoadMapShapeActive = shape_context;
@@ -156,6 +163,9 @@ static void roadmap_shape_unmap (void *context) {
    if (shape_context->shape_cache != NULL) {
       free (shape_context->shape_cache);
    }
+   if (shape_context->Packed != NULL) {
+      roadmap_packed_unmap (shape_context->Packed);
+   }
    free(shape_context);
 }
 
@@ -257,8 +267,22 @@ int  roadmap_shape_of_line (int line, int begin, int end,
       return shape_by_line[end].count;
    }
 
-   RoadMapShapeActive->shape_cache[line / (8 * sizeof(int))] |=
-      RoadMapShape2Mask[line & ((8*sizeof(int))-1)];
+   /* The cache is allocated on the first miss, not when the map is
+    * activated: most maps never get there.
+    */
+   if (RoadMapShapeActive->shape_cache == NULL) {
+
+      RoadMapShapeActive->shape_cache_size = roadmap_line_count();
+      RoadMapShapeActive->shape_cache =
+         calloc ((RoadMapShapeActive->shape_cache_size / (8 * sizeof(int))) + 1,
+               sizeof(int));
+      roadmap_check_allocated(RoadMapShapeActive->shape_cache);
+   }
+
+   if (line >= 0 && line < RoadMapShapeActive->shape_cache_size) {
+      RoadMapShapeActive->shape_cache[line / (8 * sizeof(int))] |=
+         RoadMapShape2Mask[line & ((8*sizeof(int))-1)];
+   }
 
    *first = *last = -1;
    return 0;
@@ -270,6 +294,16 @@ int  roadmap_shape_of_line (int line, int begin, int end,
  * @param position parameter to return incremental results in
  */
 void roadmap_shape_get_position (int shape, RoadMapPosition *position) {
-   position->longitude += RoadMapShapeActive->Shape[shape].delta_longitude;
-   position->latitude  += RoadMapShapeActive->Shape[shape].delta_latitude;
+
+   const unsigned short *packed;
+
+   if (RoadMapShapeActive->Shape != NULL) {
+      position->longitude += RoadMapShapeActive->Shape[shape].delta_longitude;
+      position->latitude  += RoadMapShapeActive->Shape[shape].delta_latitude;
+      return;
+   }
+
+   packed = roadmap_packed_get (RoadMapShapeActive->Packed, shape);
+   position->longitude += (short) packed[0];
+   position->latitude  += (short) packed[1];
 }
@@ -54,42 +54,48 @@ typedef struct {
    RoadMapGlobal *SquareGlobal;
    RoadMapSquare *Square;
 
-   short *SquareGrid; /**< keep small: large grids can use a lot of them */
    int  SquareGridCount;
-   int SquareGridBitmapped;
-   int SquareLastLookup;  /**< lookup cache for bitmapped grids */
-   int SquareLastIndex;
-} RoadMapSquareContext;
 
-static RoadMapSquareContext *RoadMapSquareActive = NULL;
+   /* Dense grids: the index of each square of the grid, plus 1. */
+   int *SquareGrid;
 
-static void *roadmap_square_map (roadmap_db *root) {
-
-   RoadMapSquareContext *context;
+   /* Sparse grids: one bit per square of the grid, the number of bits
+    * set before each word of the bitmap, and the index of each square
+    * in the order of the grid.
+    */
+   unsigned int *SquareBits;
+   int *SquareRank;
+   int *SquareByRank;
 
-   int i;
-   int count;
-   roadmap_db *global_table;
-   roadmap_db *square_table;
+} RoadMapSquareContext;
 
-   context = malloc(sizeof(RoadMapSquareContext));
-   roadmap_check_allocated(context);
+static RoadMapSquareContext *RoadMapSquareActive = NULL;
 
-   context->type = RoadMapSquareType;
 
-   global_table  = roadmap_db_get_subsection (root, "global");
-   square_table = roadmap_db_get_subsection (root, "data");
+static int roadmap_square_popcount (unsigned int bits) {
 
-   context->SquareGlobal = (RoadMapGlobal *) roadmap_db_get_data (global_table);
-   context->Square       = (RoadMapSquare *) roadmap_db_get_data (square_table);
+#ifdef __GNUC__
+   return __builtin_popcount (bits);
+#else
+   bits = bits - ((bits >> 1) & 0x55555555);
+   bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+   bits = (bits + (bits >> 4)) & 0x0f0f0f0f;
+   return (bits * 0x01010101) >> 24;
+#endif
+}
 
-   count = context->SquareGlobal->count_longitude
-              * context->SquareGlobal->count_latitude;
+/**
+ * @brief build the grid that locates the squares, on first use
+ * @param context
+ */
+static void roadmap_square_build_grid (RoadMapSquareContext *context) {
 
-   if (!count) {
-      free(context);
-      return NULL;
-   }
+   int i;
+   int rank;
+   int words;
+   int position;
+   int count = context->SquareGridCount;
+   int count_squares = context->SquareGlobal->count_squares;
 
    /* See if the grid seems like it will be very sparse, by
     * comparing the number of squares in the whole grid to those
@@ -100,18 +106,15 @@ static void *roadmap_square_map (roadmap_db *root) {
     * only the endpoints of the lines count as features).  So the
     * value used for comparison isn't really very critical.
     */
-   if (count / context->SquareGlobal->count_squares < 50) {
+   if (count / count_squares < 50) {
 
        /* Allocate the entire grid representing the area
         * covered by these squares.
         */
-       context->SquareGridBitmapped = 0;
-       context->SquareGrid = (short *) calloc (count, sizeof(short));
+       context->SquareGrid = (int *) calloc (count, sizeof(int));
        roadmap_check_allocated(context->SquareGrid);
 
-       context->SquareGridCount = count;
-
-       for (i = context->SquareGlobal->count_squares - 1; i >= 0; --i) {
+       for (i = count_squares - 1; i >= 0; --i) {
           /* store "i + 1" so that 0 can be the "invalid" marker. 
            * we'll subtract 1 every time we dereference, and
            * compare against negative.
@@ -120,26 +123,77 @@ static void *roadmap_square_map (roadmap_db *root) {
        }
 
    } else {
-       /* For very sparse grids, we save memory by only
-        * allocating a bitmap.  the bitmap will tell us whether
-        * we need to linear search the list for our square.
+       /* For very sparse grids, we save memory by only allocating
+        * a bitmap.  The index of a square is found from the number
+        * of squares that come before it in the grid (its rank):
+        * counting them only takes the running count kept for each
+        * word of the bitmap, and the bits set before it in its word.
         */
-       context->SquareGridBitmapped = 1;
-       context->SquareGrid = (short *) calloc((count / 16) + 1, sizeof(short));
-       roadmap_check_allocated(context->SquareGrid);
+       words = (count / 32) + 1;
+
+       context->SquareBits = (unsigned int *) calloc (words, sizeof(int));
+       context->SquareRank = (int *) malloc (words * sizeof(int));
+       context->SquareByRank = (int *) malloc (count_squares * sizeof(int));
+       roadmap_check_allocated(context->SquareBits);
+       roadmap_check_allocated(context->SquareRank);
+       roadmap_check_allocated(context->SquareByRank);
+
+       for (i = count_squares - 1; i >= 0; --i) {
+          position = context->Square[i].position;
+          context->SquareBits[position / 32] |= (1U << (position % 32));
+       }
 
-       context->SquareGridCount = count;
+       for (i = 0, rank = 0; i < words; ++i) {
+          context->SquareRank[i] = rank;
+          rank += roadmap_square_popcount (context->SquareBits[i]);
+       }
 
-       for (i = context->SquareGlobal->count_squares - 1; i >= 0; --i) {
-          int index = context->Square[i].position / 16;
-          int bit  = context->Square[i].position % 16;
-          context->SquareGrid[index] |= (1 << bit);
+       for (i = count_squares - 1; i >= 0; --i) {
+          position = context->Square[i].position;
+          rank = context->SquareRank[position / 32]
+               + roadmap_square_popcount
+                    (context->SquareBits[position / 32]
+                        & ((1U << (position % 32)) - 1));
+          context->SquareByRank[rank] = i;
        }
+   }
+}
+
+static void *roadmap_square_map (roadmap_db *root) {
+
+   RoadMapSquareContext *context;
+
+   int count;
+   roadmap_db *global_table;
+   roadmap_db *square_table;
 
+   context = malloc(sizeof(RoadMapSquareContext));
+   roadmap_check_allocated(context);
 
+   context->type = RoadMapSquareType;
+
+   global_table  = roadmap_db_get_subsection (root, "global");
+   square_table = roadmap_db_get_subsection (root, "data");
+
+   context->SquareGlobal = (RoadMapGlobal *) roadmap_db_get_data (global_table);
+   context->Square       = (RoadMapSquare *) roadmap_db_get_data (square_table);
+
+   count = context->SquareGlobal->count_longitude
+              * context->SquareGlobal->count_latitude;
+
+   if (!count) {
+      free(context);
+      return NULL;
    }
 
-   context->SquareLastLookup = -1;
+   /* The grid is only built when a square is first looked up: many maps
+    * are opened only to check whether they cover a position.
+    */
+   context->SquareGrid = NULL;
+   context->SquareGridCount = count;
+   context->SquareBits = NULL;
+   context->SquareRank = NULL;
+   context->SquareByRank = NULL;
 
    return context;
 }
@@ -147,38 +201,27 @@ static void *roadmap_square_map (roadmap_db *root) {
 static int grid_index(int square)
 {
 
-   if (!RoadMapSquareActive->SquareGridBitmapped) {
-
-      return RoadMapSquareActive->SquareGrid[square] - 1;
+   RoadMapSquareContext *context = RoadMapSquareActive;
+   unsigned int word;
+   unsigned int bit;
 
-   } else {
-      int i;
-      int index;
-      int bit;
-
-      if (square == RoadMapSquareActive->SquareLastLookup) {
-         return RoadMapSquareActive->SquareLastIndex;
-      }
+   if (context->SquareGrid == NULL && context->SquareBits == NULL) {
+      roadmap_square_build_grid (context);
+   }
 
-      RoadMapSquareActive->SquareLastLookup = square;
+   if (context->SquareGrid != NULL) {
 
-      index = square / 16;
-      bit  = square % 16;
+      return context->SquareGrid[square] - 1;
 
-      if ((RoadMapSquareActive->SquareGrid[index] & (1 << bit)) == 0)
-         return RoadMapSquareActive->SquareLastIndex = -1;
+   }
 
-      for (i = RoadMapSquareActive->SquareGlobal->count_squares - 1;
-               i >= 0; --i) {
-         if (RoadMapSquareActive->Square[i].position == square) {
-            return RoadMapSquareActive->SquareLastIndex = i;
-         }
-      }
+   word = context->SquareBits[square / 32];
+   bit  = 1U << (square % 32);
 
-      roadmap_log (ROADMAP_WARNING, "bitmapping BUG");
-      return RoadMapSquareActive->SquareLastIndex = -1;
-   }
+   if ((word & bit) == 0) return -1;
 
+   return context->SquareByRank[context->SquareRank[square / 32]
+                                + roadmap_square_popcount (word & (bit - 1))];
 }
 
 static void roadmap_square_activate (void *context) {
@@ -203,6 +246,9 @@ static void roadmap_square_unmap (void *context) {
       RoadMapSquareActive = NULL;
    }
    free(square_context->SquareGrid);
+   free(square_context->SquareBits);
+   free(square_context->SquareRank);
+   free(square_context->SquareByRank);
    free(square_context);
 }
 
@@ -62,6 +62,7 @@
 #include "roadmap_trip.h"
 #include "roadmap_tripdb.h"
 #include "roadmap_track.h"
+#include "roadmap_prefetch.h"
 #include "roadmap_landmark.h"
 #include "roadmap_features.h"
 #include "roadmap_adjust.h"
@@ -70,6 +71,7 @@
 #include "roadgps_logger.h"
 #include "roadmap_fuzzy.h"
 #include "roadmap_navigate.h"
+#include "roadmap_mapmatch.h"
 #include "roadmap_label.h"
 #include "roadmap_display.h"
 #include "roadmap_locator.h"
@@ -800,6 +802,10 @@ static RoadMapAction RoadMapStartActions[] = {
       "Create a new route from the currently selected track", NULL,
       roadmap_trip_track_to_route },
 
+   {"matchtrack", "Match Track to Roads", "MatchTrack", NULL,
+      "Create a copy of the selected track moved onto the roads", NULL,
+      roadmap_trip_track_match },
+
    {"addtrack", "Add Current Track to Trip", "AddTrack", NULL,
       "Add a copy of the current GPS breadcrumb track to the trip", NULL,
       roadmap_trip_currenttrack_to_track },
@@ -1119,6 +1125,7 @@ static const char *RoadMapStartMenu[] = {
    ROADMAP_SUBMENU "Tracks...",
 
       "tracktoroute",
+      "matchtrack",
 
       RoadMapFactorySeparator,
 
@@ -1370,6 +1377,7 @@ static void roadmap_start_gps_listen
       if (reception <= GPS_RECEPTION_NONE) {
 
          roadmap_gps_unset_messages();
+         roadmap_mapmatch_reset ();
 
       } else {
 
@@ -1732,10 +1740,12 @@ void roadmap_start (int argc, char **argv) {
    roadmap_screen_initialize   ();
    roadmap_fuzzy_initialize    ();
    roadmap_navigate_initialize ();
+   roadmap_mapmatch_initialize ();
    roadmap_label_initialize    ();
    roadmap_display_initialize  ();
    roadmap_voice_initialize    ();
    roadmap_track_initialize    ();
+   roadmap_prefetch_initialize ();
    roadgps_screen_initialize ();
    roadmap_canvas_register_configure_handler (roadmap_start_screen_configure);
    roadgps_logger_initialize ();
@@ -1875,6 +1885,7 @@ void roadmap_start_exit (void)
     roadmap_trip_preserve_focus();
 #endif
     roadmap_trip_shutdown ();
+    roadmap_locator_summary ();
     roadmap_config_save (0);
     roadmap_screen_shutdown();
     roadmap_dialog_shutdown ();
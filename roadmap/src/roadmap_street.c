@@ -48,6 +48,31 @@ static char *RoadMapStreetType = "RoadMapStreetContext";
 static char *RoadMapZipType    = "RoadMapZipContext";
 static char *RoadMapRangeType  = "RoadMapRangeContext";
 
+/* One straight segment of a line, shape points included. */
+typedef struct {
+
+   int line;
+   int rank;   /* Of the line in its index: 0 .. line_count - 1. */
+   int west;
+   RoadMapPosition from;
+   RoadMapPosition to;
+
+} RoadMapStreetSegment;
+
+/* All the segments of one layer in one square, sorted by west edge. */
+typedef struct roadmap_street_segment_index {
+
+   struct roadmap_street_segment_index *next;
+
+   int layer;
+   int count;
+   int line_count;
+   int max_width;
+
+   RoadMapStreetSegment *segments;
+
+} RoadMapStreetSegmentIndex;
+
 typedef struct {
 
    char *type;
@@ -56,6 +81,10 @@ typedef struct {
    char                 *RoadMapStreetType;
    int                   RoadMapStreetsCount;
 
+   /* Built on demand, per square index, by roadmap_street_segments(). */
+   RoadMapStreetSegmentIndex **SegmentIndex;
+   int                         SegmentIndexCount;
+
 } RoadMapStreetContext;
 
 typedef struct {
@@ -121,6 +150,8 @@ static void *roadmap_street_map (roadmap_db *root) {
    roadmap_check_allocated(context);
 
    context->type = RoadMapStreetType;
+   context->SegmentIndex = NULL;
+   context->SegmentIndexCount = 0;
 
    table = roadmap_db_get_subsection (root, "name");
    context->RoadMapStreets = (RoadMapStreet *) roadmap_db_get_data (table);
@@ -173,6 +204,24 @@ static void roadmap_street_unmap (void *context) {
    if (RoadMapStreetActive == this) {
       RoadMapStreetActive = NULL;
    }
+
+   if (this->SegmentIndex != NULL) {
+
+      int i;
+
+      for (i = 0; i < this->SegmentIndexCount; ++i) {
+
+         while (this->SegmentIndex[i] != NULL) {
+
+            RoadMapStreetSegmentIndex *index = this->SegmentIndex[i];
+
+            this->SegmentIndex[i] = index->next;
+            free (index->segments);
+            free (index);
+         }
+      }
+      free (this->SegmentIndex);
+   }
    free (this);
 }
 
@@ -1238,60 +1287,146 @@ int roadmap_street_get_distance (const RoadMapPosition *position, int line, int
 }
 
 
-static int roadmap_street_get_closest_in_square
-              (const RoadMapPosition *position, int square, int layer,
-               RoadMapNeighbour *neighbours, int count, int max) {
+static void roadmap_street_add_segment (RoadMapStreetSegmentIndex *index,
+                                        int *allocated,
+                                        int line,
+                                        const RoadMapPosition *from,
+                                        const RoadMapPosition *to) {
+
+   RoadMapStreetSegment *segment;
+   int width;
+
+   if (index->count >= *allocated) {
+      *allocated = (*allocated == 0) ? 64 : *allocated * 2;
+      index->segments =
+         realloc (index->segments, *allocated * sizeof(RoadMapStreetSegment));
+      roadmap_check_allocated(index->segments);
+   }
+
+   segment = index->segments + index->count++;
+
+   segment->line = line;
+   segment->rank = index->line_count;
+   segment->from = *from;
+   segment->to   = *to;
+
+   if (from->longitude < to->longitude) {
+      segment->west = from->longitude;
+      width = to->longitude - from->longitude;
+   } else {
+      segment->west = to->longitude;
+      width = from->longitude - to->longitude;
+   }
+   if (width > index->max_width) index->max_width = width;
+}
+
+
+/**
+ * @brief flatten a line and its shape points into the index
+ * Note: the position of a shape point is relative to the position
+ * of the previous point, starting with the from point.
+ */
+static void roadmap_street_add_line_segments
+              (RoadMapStreetSegmentIndex *index, int *allocated, int line,
+               int first_shape_line, int last_shape_line, int shape_count) {
+
+   int i;
+   int first_shape;
+   int last_shape;
+   RoadMapPosition from;
+   RoadMapPosition to;
+
+   roadmap_line_from (line, &from);
+
+   if (shape_count > 0 &&
+       roadmap_shape_of_line (line, first_shape_line, last_shape_line,
+                              &first_shape, &last_shape) > 0) {
+
+      to = from;
+
+      for (i = first_shape; i <= last_shape; i++) {
+
+         roadmap_shape_get_position (i, &to);
+         roadmap_street_add_segment (index, allocated, line, &from, &to);
+         from = to;
+      }
+   }
+
+   roadmap_line_to (line, &to);
+   roadmap_street_add_segment (index, allocated, line, &from, &to);
+
+   index->line_count += 1;
+}
+
 
+static int roadmap_street_segment_compare (const void *r1, const void *r2) {
+
+   const RoadMapStreetSegment *s1 = (const RoadMapStreetSegment *) r1;
+   const RoadMapStreetSegment *s2 = (const RoadMapStreetSegment *) r2;
+
+   if (s1->west != s2->west) return (s1->west < s2->west) ? -1 : 1;
+
+   return s1->line - s2->line;
+}
+
+
+/**
+ * @brief retrieve (building it the first time) the segment index of
+ * one layer in one square of the active map.
+ * @param square the square
+ * @param layer the layer
+ * @return the index, or NULL if there is no line
+ */
+static RoadMapStreetSegmentIndex *roadmap_street_segments (int square,
+                                                           int layer) {
+
+   int slot;
    int line;
-   int found;
    int first_line;
    int last_line;
    int first_shape_line;
    int last_shape_line;
-   int first_shape;
-   int last_shape;
+   int shape_count;
+   int allocated;
 
-   RoadMapNeighbour this;
+   RoadMapStreetSegmentIndex *index;
+   RoadMapStreetContext *context = RoadMapStreetActive;
 
-   int fips = roadmap_locator_active ();
 
+   if (context == NULL) return NULL;
 
-   if (roadmap_line_in_square (square, layer, &first_line, &last_line) > 0) {
+   slot = roadmap_square_index (square);
+   if (slot < 0) return NULL;
 
-      if (roadmap_shape_in_square (square, &first_shape_line,
-                                           &last_shape_line) > 0) {
+   if (context->SegmentIndex == NULL) {
 
-         for (line = first_line; line <= last_line; line++) {
+      context->SegmentIndexCount = roadmap_square_count ();
+      context->SegmentIndex =
+         calloc (context->SegmentIndexCount, sizeof(*context->SegmentIndex));
+      roadmap_check_allocated(context->SegmentIndex);
+   }
+   if (slot >= context->SegmentIndexCount) return NULL;
 
-            if (roadmap_plugin_override_line (line, layer, fips)) continue;
+   for (index = context->SegmentIndex[slot];
+        index != NULL; index = index->next) {
+      if (index->layer == layer) return index;
+   }
 
-            if (roadmap_shape_of_line (line, first_shape_line,
-                                             last_shape_line,
-                                             &first_shape, &last_shape) > 0) {
+   index = calloc (1, sizeof(RoadMapStreetSegmentIndex));
+   roadmap_check_allocated(index);
 
-               found =
-                  roadmap_street_get_distance_with_shape
-                     (position, line, layer, first_shape, last_shape, &this);
+   index->layer = layer;
+   allocated = 0;
 
-            } else {
-               found =
-                   roadmap_street_get_distance_no_shape (position,
-                                                         line, layer, &this);
-            }
-            if (found) {
-               count = roadmap_street_replace (neighbours, count, max, &this);
-            }
-         }
-
-      } else {
+   if (roadmap_line_in_square (square, layer, &first_line, &last_line) > 0) {
 
-         for (line = first_line; line <= last_line; line++) {
+      shape_count =
+         roadmap_shape_in_square (square, &first_shape_line, &last_shape_line);
 
-            if (roadmap_street_get_distance_no_shape (position,
-                                                      line, layer, &this)) {
-               count = roadmap_street_replace (neighbours, count, max, &this);
-            }
-         }
+      for (line = first_line; line <= last_line; line++) {
+         roadmap_street_add_line_segments
+            (index, &allocated, line,
+             first_shape_line, last_shape_line, shape_count);
       }
    }
 
@@ -1300,9 +1435,10 @@ static int roadmap_street_get_closest_in_square
       int previous_square  = -1;
       int real_square;
       int line_cursor;
-      int shape_count = 0;
       RoadMapPosition reference_position;
 
+      shape_count = 0;
+
       for (line_cursor = first_line; line_cursor <= last_line; ++line_cursor) {
 
          line = roadmap_line_get_from_index2 (line_cursor);
@@ -1311,35 +1447,141 @@ static int roadmap_street_get_closest_in_square
 
          real_square = roadmap_square_search (&reference_position);
          if (real_square < 0) continue;
-          
+
          if (real_square != previous_square) {
             shape_count =
                roadmap_shape_in_square
                   (real_square, &first_shape_line, &last_shape_line);
             previous_square = real_square;
          }
-         
-         if (roadmap_plugin_override_line (line, layer, fips)) continue;
 
-         if (shape_count > 0 &&
-             roadmap_shape_of_line (line, first_shape_line,
-                                    last_shape_line,
-                                    &first_shape, &last_shape) > 0) {
+         roadmap_street_add_line_segments
+            (index, &allocated, line,
+             first_shape_line, last_shape_line, shape_count);
+      }
+   }
 
-               found =
-                  roadmap_street_get_distance_with_shape
-                     (position, line, layer, first_shape, last_shape, &this);
+   if (index->count > 1) {
+      qsort (index->segments, index->count,
+             sizeof(RoadMapStreetSegment), roadmap_street_segment_compare);
+   }
 
-         } else {
-             found =
-                roadmap_street_get_distance_no_shape (position,
-                                                      line, layer, &this);
-         }
+   index->next = context->SegmentIndex[slot];
+   context->SegmentIndex[slot] = index;
 
-         if (found) {
-            count = roadmap_street_replace (neighbours, count, max, &this);
-         }
+   return index;
+}
+
+
+static int roadmap_street_get_closest_in_square
+              (const RoadMapPosition *position, int square, int layer,
+               RoadMapNeighbour *neighbours, int count, int max) {
+
+   /* Indexed by the rank of the line in the segment index; an entry is
+    * valid only if its stamp matches the one of the current call.
+    */
+   static RoadMapNeighbour *closest = NULL;
+   static int *closest_stamp = NULL;
+   static int *closest_found = NULL;
+   static int closest_size = 0;
+   static int stamp = 0;
+
+   int i;
+   int low;
+   int high;
+   int west;
+   int found;
+   int distance;
+   RoadMapArea focus;
+   RoadMapPosition intersection;
+   RoadMapStreetSegment *segment;
+   RoadMapStreetSegmentIndex *index;
+
+   int fips = roadmap_locator_active ();
+
+
+   index = roadmap_street_segments (square, layer);
+   if (index == NULL || index->count <= 0) return count;
+
+   /* Only the segments whose west edge is within reach of the focus can
+    * be visible: find the first one, and stop past the east edge.
+    */
+   roadmap_math_get_focus (&focus);
+
+   west = focus.west - index->max_width;
+   low  = 0;
+   high = index->count;
+   while (low < high) {
+      int middle = (low + high) / 2;
+      if (index->segments[middle].west < west) {
+         low = middle + 1;
+      } else {
+         high = middle;
+      }
+   }
+
+   if (index->line_count > closest_size) {
+      closest = realloc (closest, index->line_count * sizeof(*closest));
+      roadmap_check_allocated(closest);
+      closest_stamp =
+         realloc (closest_stamp, index->line_count * sizeof(int));
+      roadmap_check_allocated(closest_stamp);
+      closest_found =
+         realloc (closest_found, index->line_count * sizeof(int));
+      roadmap_check_allocated(closest_found);
+
+      memset (closest_stamp + closest_size, 0,
+              (index->line_count - closest_size) * sizeof(int));
+      closest_size = index->line_count;
+   }
+
+   if (++stamp <= 0) {
+      memset (closest_stamp, 0, closest_size * sizeof(int));
+      stamp = 1;
+   }
+
+   found = 0;
+
+   for (segment = index->segments + low;
+        segment < index->segments + index->count; ++segment) {
+
+      if (segment->west > focus.east) break;
+
+      if (! roadmap_math_line_is_visible (&segment->from, &segment->to)) {
+         continue;
+      }
+
+      distance =
+         roadmap_math_get_distance_from_segment
+            (position, &segment->from, &segment->to, &intersection, NULL);
+
+      /* Keep only the closest segment of each line. */
+      i = segment->rank;
+
+      if (closest_stamp[i] != stamp) {
+         closest_stamp[i] = stamp;
+         closest_found[found++] = i;
+         roadmap_plugin_set_line
+            (&closest[i].line, ROADMAP_PLUGIN_ID, segment->line, layer, fips);
+
+      } else if (distance >= closest[i].distance) {
+         continue;
+      }
+
+      closest[i].distance     = distance;
+      closest[i].from         = segment->from;
+      closest[i].to           = segment->to;
+      closest[i].intersection = intersection;
+   }
+
+   for (i = 0; i < found; ++i) {
+
+      RoadMapNeighbour *line = closest + closest_found[i];
+
+      if (roadmap_plugin_override_line (line->line.line_id, layer, fips)) {
+         continue;
       }
+      count = roadmap_street_replace (neighbours, count, max, line);
    }
 
    return count;
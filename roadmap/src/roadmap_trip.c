@@ -61,6 +61,8 @@
 #include "roadmap_track.h"
 #include "roadmap_landmark.h"
 #include "roadmap_voice.h"
+#include "roadmap_navigate.h"
+#include "roadmap_mapmatch.h"
 #ifdef HAVE_NAVIGATE_PLUGIN
 #include "roadmap_tripdb.h"
 #endif
@@ -2000,6 +2002,16 @@ int roadmap_trip_get_speed (void) {
     return 0;
 }
 
+/* returns where the route goes next, NULL if not following a route */
+const RoadMapPosition *roadmap_trip_get_next_position (void) {
+
+    if (RoadMapRouteInProgress && RoadMapTripNext != NULL) {
+        return &RoadMapTripNext->pos;
+    }
+
+    return NULL;
+}
+
 /**
  * @brief
  * @return
@@ -3346,22 +3358,95 @@ void roadmap_trip_copy_route
 }
 
 
+/* This moves each point of a track onto the road it was recorded
+ * on, as chosen by the map matcher over the whole track.  Points
+ * too far from any road are copied unchanged.
+ */
+static int roadmap_trip_match_route
+        (const route_head *orig_route, route_head *new_route) {
+
+    RoadMapGpsPosition *fixes;
+    RoadMapNeighbour *matched;
+    RoadMapListItem *elem, *tmp;
+    waypoint *waypointp;
+    int count;
+    int found;
+    int i;
+
+    count = 0;
+    ROADMAP_LIST_FOR_EACH (&orig_route->waypoint_list, elem, tmp) {
+        count++;
+    }
+    if (count <= 0) return 0;
+
+    fixes = malloc (count * sizeof(RoadMapGpsPosition));
+    roadmap_check_allocated(fixes);
+    matched = malloc (count * sizeof(RoadMapNeighbour));
+    roadmap_check_allocated(matched);
+
+    i = 0;
+    ROADMAP_LIST_FOR_EACH (&orig_route->waypoint_list, elem, tmp) {
+        waypointp = (waypoint *) elem;
+        fixes[i].longitude = waypointp->pos.longitude;
+        fixes[i].latitude  = waypointp->pos.latitude;
+        fixes[i].altitude  = 0;
+        fixes[i].speed     = 0;
+        i++;
+    }
+
+    /* Tracks seldom record the course: use the direction of travel. */
+    for (i = 0; i < count; i++) {
+        RoadMapPosition from, to;
+        int j = (i < count - 1) ? i : i - 1;
+        if (j < 0) {
+            fixes[i].steering = 0;
+            continue;
+        }
+        from.longitude = fixes[j].longitude;
+        from.latitude  = fixes[j].latitude;
+        to.longitude = fixes[j+1].longitude;
+        to.latitude  = fixes[j+1].latitude;
+        fixes[i].steering = roadmap_math_azymuth (&from, &to);
+    }
+
+    found = roadmap_mapmatch_track
+                (fixes, count, roadmap_navigate_get_mode(), matched);
+
+    i = 0;
+    ROADMAP_LIST_FOR_EACH (&orig_route->waypoint_list, elem, tmp) {
+        waypointp = waypt_dupe( (waypoint *)elem );
+        if (PLUGIN_VALID(matched[i].line)) {
+            waypointp->pos = matched[i].intersection;
+        }
+        waypt_add(&new_route->waypoint_list, waypointp);
+        i++;
+    }
+
+    free (matched);
+    free (fixes);
+
+    return found;
+}
+
+
 static void roadmap_trip_route_convert_worker
         (route_head *orig_route, char *new_name, 
-            int simplify, int wanttrack, int reverse) {
+            int simplify, int match, int wanttrack, int reverse) {
 
-    int dropped = 0;
+    int changed = 1;
     route_head *new_route;
 
     new_route = route_head_alloc();
     
     if (simplify) {
-        dropped = roadmap_trip_simplify_route (orig_route, new_route);
+        changed = roadmap_trip_simplify_route (orig_route, new_route);
+    } else if (match) {
+        changed = roadmap_trip_match_route (orig_route, new_route);
     } else {
         roadmap_trip_copy_route (orig_route, new_route);
     }
 
-    if (!simplify || dropped > 0) {
+    if (changed > 0) {
 
         if (new_name) {
             new_route->rte_name = xstrdup(new_name);
@@ -3412,7 +3497,7 @@ void roadmap_trip_track_to_route (void) {
         namep = name;
     }
 
-    roadmap_trip_route_convert_worker (RoadMapCurrentRoute, namep, 0, 0, 0);
+    roadmap_trip_route_convert_worker (RoadMapCurrentRoute, namep, 0, 0, 0, 0);
 
 }
 
@@ -3430,7 +3515,29 @@ void roadmap_trip_route_simplify (void) {
         namep = name;
     }
 
-    roadmap_trip_route_convert_worker (RoadMapCurrentRoute, namep, 1, 0, 0);
+    roadmap_trip_route_convert_worker (RoadMapCurrentRoute, namep, 1, 0, 0, 0);
+
+}
+
+void roadmap_trip_track_match (void) {
+
+    char name[50];
+    char *namep = NULL;
+
+    if (RoadMapCurrentRoute == NULL) {
+        return;
+    }
+
+    if (! RoadMapCurrentRoute->rte_is_track) {
+        return;
+    }
+
+    if (RoadMapCurrentRoute->rte_name) {
+        snprintf(name, 50, "Matched %s", RoadMapCurrentRoute->rte_name);
+        namep = name;
+    }
+
+    roadmap_trip_route_convert_worker (RoadMapCurrentRoute, namep, 0, 1, 1, 0);
 
 }
 
@@ -3444,7 +3551,7 @@ void roadmap_trip_currenttrack_to_route (void) {
     strftime(name, sizeof(name), "Backtrack-%Y-%m-%d-%H:%M:%S",
                 localtime(&now));
 
-    roadmap_trip_route_convert_worker (RoadMapTrack, name, 0, 0, 1);
+    roadmap_trip_route_convert_worker (RoadMapTrack, name, 0, 0, 0, 1);
 
 }
 
@@ -3458,7 +3565,7 @@ void roadmap_trip_currenttrack_to_track (void) {
     strftime(name, sizeof(name), "Track-%Y-%m-%d-%H:%M:%S",
                 localtime(&now));
 
-    roadmap_trip_route_convert_worker (RoadMapTrack, name, 0, 1, 0);
+    roadmap_trip_route_convert_worker (RoadMapTrack, name, 0, 0, 1, 0);
 
 }
 
@@ -59,6 +59,7 @@ int   roadmap_trip_is_refresh_needed (void);
 
 int   roadmap_trip_get_orientation (void);
 int   roadmap_trip_get_speed (void);
+const RoadMapPosition *roadmap_trip_get_next_position (void);
 const char *roadmap_trip_get_focus_name (void);
 
 const RoadMapPosition *roadmap_trip_get_focus_position (void);
@@ -103,6 +104,7 @@ void roadmap_trip_lost_route_manage_dialog (void);
 
 void roadmap_trip_track_to_route (void);
 void roadmap_trip_route_simplify (void);
+void roadmap_trip_track_match (void);
 void roadmap_trip_currenttrack_to_route (void);
 void roadmap_trip_currenttrack_to_track (void);
 
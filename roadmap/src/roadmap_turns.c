@@ -146,15 +146,6 @@ static void roadmap_turns_activate (void *context) {
       if (turns_context->type != RoadMapTurnsType) {
          roadmap_log (ROADMAP_FATAL, "cannot activate turns (bad type)");
       }
-
-      if (turns_context->turns_cache == NULL) {
-
-         turns_context->turns_cache_size = roadmap_point_count();
-         turns_context->turns_cache =
-            calloc ((turns_context->turns_cache_size / (8 * sizeof(int))) + 1,
-                  sizeof(int));
-         roadmap_check_allocated(turns_context->turns_cache);
-      }
    }
 
    RoadMapTurnsActive = turns_context;
@@ -278,8 +269,22 @@ int roadmap_turns_of_node (int node, int begin, int end,
       return turns_by_node[end].count;
    }
 
-   RoadMapTurnsActive->turns_cache[node / (8 * sizeof(int))] |=
-      RoadMapTurns2Mask[node & ((8*sizeof(int))-1)];
+   /* Allocated here rather than on activation: routing is what
+    * looks up turns, and it only does so on a few maps.
+    */
+   if (RoadMapTurnsActive->turns_cache == NULL) {
+
+      RoadMapTurnsActive->turns_cache_size = roadmap_point_count();
+      RoadMapTurnsActive->turns_cache =
+         calloc ((RoadMapTurnsActive->turns_cache_size / (8 * sizeof(int))) + 1,
+               sizeof(int));
+      roadmap_check_allocated(RoadMapTurnsActive->turns_cache);
+   }
+
+   if (node >= 0 && node < RoadMapTurnsActive->turns_cache_size) {
+      RoadMapTurnsActive->turns_cache[node / (8 * sizeof(int))] |=
+         RoadMapTurns2Mask[node & ((8*sizeof(int))-1)];
+   }
 
    return 0;
 }
@@ -128,6 +128,28 @@ int roadmap_file_exists (const char *path, const char *name) {
    return (status == 0);
 }
 
+/**
+ * @brief ask the kernel to read a file in the background
+ * @param path
+ * @param name
+ */
+void roadmap_file_prefetch (const char *path, const char *name) {
+
+#ifdef POSIX_FADV_WILLNEED
+   int fd;
+   const char *full_name = roadmap_path_join (path, name);
+
+   fd = open (full_name, O_RDONLY);
+   roadmap_path_free (full_name);
+
+   if (fd < 0) return;
+
+   /* This only queues the reads: it does not wait for them. */
+   posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+   close (fd);
+#endif
+}
+
 /**
  * @brief
  * @param path
@@ -399,6 +421,34 @@ int roadmap_file_size (RoadMapFileContext file)
    return file->size;
 }
 
+/**
+ * @brief tell the kernel how a part of a mapped file will be accessed
+ * @param file
+ * @param offset the start of the part, from the start of the file
+ * @param size the size of the part
+ * @param advice ROADMAP_FILE_ADVISE_RANDOM or ROADMAP_FILE_ADVISE_WILLNEED
+ */
+void roadmap_file_advise (RoadMapFileContext file,
+                          int offset, int size, int advice) {
+
+#ifdef MADV_WILLNEED
+   long page = sysconf (_SC_PAGESIZE);
+   char *start;
+   char *end;
+
+   if (file == NULL || file->base == NULL || size <= 0) return;
+
+   /* madvise() wants the start of a page. */
+   start = (char *)file->base + offset;
+   end = start + size;
+   start = (char *)file->base + ((offset / page) * page);
+
+   madvise (start, (size_t)(end - start),
+            (advice == ROADMAP_FILE_ADVISE_WILLNEED) ?
+                MADV_WILLNEED : MADV_RANDOM);
+#endif
+}
+
 /**
  * @brief
  * @param file
@@ -153,6 +153,15 @@ int roadmap_file_exists (const char *path, const char *name)
 	}
 }
 
+/**
+ * @brief ask the OS to read a file in the background (not used here)
+ * @param path
+ * @param name
+ */
+void roadmap_file_prefetch (const char *path, const char *name)
+{
+}
+
 /**
  * @brief
  * @param path
@@ -456,6 +465,18 @@ int roadmap_file_size (RoadMapFileContext file)
 	return file->size;
 }
 
+/**
+ * @brief tell how a part of a mapped file will be accessed (not used here)
+ * @param file
+ * @param offset
+ * @param size
+ * @param advice
+ */
+void roadmap_file_advise (RoadMapFileContext file,
+                          int offset, int size, int advice)
+{
+}
+
 /**
  * @brief
  * @param file
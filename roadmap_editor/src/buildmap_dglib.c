@@ -145,12 +145,13 @@ void  buildmap_dglib_save (const char *path, const char *name) {
    printf( "done.\n" );
 
    printf( "graph write..." ); fflush(stdout);
-   if ( (fd = fopen( full_name , "w")) == NULL ) {
+   if ( (fd = fopen( full_name , "wb")) == NULL ) {
       buildmap_fatal (0, "dgl open error.\n");
    }
-   nret = dglWrite( & graph , fd );
+   /* Write a flat image, so that navigate can map it in place. */
+   nret = dglWriteImage( & graph , fd );
    if ( nret < 0 ) {
-      buildmap_fatal (0, "dglWrite error: %s\n", dglStrerror( &graph ) );
+      buildmap_fatal (0, "dglWriteImage error: %s\n", dglStrerror( &graph ) );
    }
    fclose( fd );
    printf( "done.\n" );
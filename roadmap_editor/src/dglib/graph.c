@@ -108,6 +108,11 @@ int dglRelease( dglGraph_s * pGraph )
 
 int dglUnflatten( dglGraph_s * pGraph )
 {
+	if ( pGraph->Flags & DGL_GS_MAPPED ) {
+		/* the flat buffers belong to the caller's mapping */
+		pGraph->iErrno = DGL_ERR_BadOnFlatGraph;
+		return -pGraph->iErrno;
+	}
 	switch( pGraph->Version ) {
 	case 1: return dgl_unflatten_V1(pGraph);
 #ifdef DGL_V2
@@ -720,6 +725,149 @@ int dglRead( dglGraph_s * pGraph, FILE *fd )
 }
 
 
+int dglWriteImage( dglGraph_s * pGraph, FILE *fd )
+{
+	dglImageHeader_s	header;
+
+	if ( ! (pGraph->Flags & DGL_GS_FLAT) ) {
+		pGraph->iErrno = DGL_ERR_BadOnTreeGraph;
+		return -pGraph->iErrno;
+	}
+
+	memset( & header, 0, sizeof(header) );
+	memcpy( header.achSignature, DGL_IMAGE_SIGNATURE, sizeof(header.achSignature) );
+	header.Version      = pGraph->Version;
+	header.Endian       = pGraph->Endian;
+	header.NodeAttrSize = pGraph->NodeAttrSize;
+	header.EdgeAttrSize = pGraph->EdgeAttrSize;
+	header.cNode        = pGraph->cNode;
+	header.cHead        = pGraph->cHead;
+	header.cTail        = pGraph->cTail;
+	header.cAlone       = pGraph->cAlone;
+	header.cEdge        = pGraph->cEdge;
+	header.iNodeBuffer  = pGraph->iNodeBuffer;
+	header.iEdgeBuffer  = pGraph->iEdgeBuffer;
+	header.nnCost       = pGraph->nnCost;
+	memcpy( header.aOpaqueSet, pGraph->aOpaqueSet, sizeof(header.aOpaqueSet) );
+
+	if ( fwrite( & header, sizeof(header), 1, fd ) != 1 ||
+		 (pGraph->iNodeBuffer > 0 &&
+		  fwrite( pGraph->pNodeBuffer, pGraph->iNodeBuffer, 1, fd ) != 1) ||
+		 (pGraph->iEdgeBuffer > 0 &&
+		  fwrite( pGraph->pEdgeBuffer, pGraph->iEdgeBuffer, 1, fd ) != 1) )
+	{
+		pGraph->iErrno = DGL_ERR_Write;
+		return -pGraph->iErrno;
+	}
+	return 0;
+}
+
+int dglIsImage( const void * pvImage, long cbImage )
+{
+	return cbImage >= (long) sizeof(dglImageHeader_s) &&
+		   memcmp( pvImage, DGL_IMAGE_SIGNATURE, 8 ) == 0;
+}
+
+/*
+ * Attach a graph to an image produced by dglWriteImage(). When the image
+ * has the host byte order and is suitably aligned (as a file mapping is),
+ * the node and edge buffers point straight into it and nothing is copied:
+ * the caller must keep the image alive until dglRelease(). Otherwise the
+ * buffers are copied and byte-swapped as dglRead() would do.
+ */
+int dglMapImage( dglGraph_s * pGraph, const void * pvImage, long cbImage )
+{
+	const dglImageHeader_s *	pHeader = (const dglImageHeader_s *) pvImage;
+	const dglByte_t *			pbData;
+	dglImageHeader_s			header;
+	dglInt32_t *				pn;
+	int							i, cn, fSwap, nret;
+
+	if ( ! dglIsImage( pvImage, cbImage ) ) {
+		pGraph->iErrno = DGL_ERR_BadImage;
+		return -pGraph->iErrno;
+	}
+
+	memcpy( & header, pHeader, sizeof(header) );
+
+	fSwap = 0;
+#ifdef DGL_ENDIAN_BIG
+	if ( header.Endian == DGL_ENDIAN_LITTLE ) fSwap = 1;
+#else
+	if ( header.Endian == DGL_ENDIAN_BIG    ) fSwap = 1;
+#endif
+	if ( fSwap ) {
+		dgl_swapInt32Bytes( & header.NodeAttrSize );
+		dgl_swapInt32Bytes( & header.EdgeAttrSize );
+		dgl_swapInt32Bytes( & header.cNode );
+		dgl_swapInt32Bytes( & header.cHead );
+		dgl_swapInt32Bytes( & header.cTail );
+		dgl_swapInt32Bytes( & header.cAlone );
+		dgl_swapInt32Bytes( & header.cEdge );
+		dgl_swapInt32Bytes( & header.iNodeBuffer );
+		dgl_swapInt32Bytes( & header.iEdgeBuffer );
+		dgl_swapInt64Bytes( & header.nnCost );
+		for ( i = 0 ; i < 16 ; i ++ ) {
+			dgl_swapInt32Bytes( & header.aOpaqueSet[ i ] );
+		}
+	}
+
+	if ( header.iNodeBuffer < 0 || header.iEdgeBuffer < 0 ||
+		 (long) sizeof(header) + header.iNodeBuffer + header.iEdgeBuffer > cbImage ) {
+		pGraph->iErrno = DGL_ERR_BadImage;
+		return -pGraph->iErrno;
+	}
+
+	if ( (nret = dglInitialize( pGraph, header.Version, header.NodeAttrSize, header.EdgeAttrSize, header.aOpaqueSet )) < 0 )
+	{
+		return nret;
+	}
+
+	pGraph->nnCost      = header.nnCost;
+	pGraph->cNode       = header.cNode;
+	pGraph->cHead       = header.cHead;
+	pGraph->cTail       = header.cTail;
+	pGraph->cAlone      = header.cAlone;
+	pGraph->cEdge       = header.cEdge;
+	pGraph->iNodeBuffer = header.iNodeBuffer;
+	pGraph->iEdgeBuffer = header.iEdgeBuffer;
+
+	pbData = (const dglByte_t *) pvImage + sizeof(header);
+
+	if ( ! fSwap && ((unsigned long) pbData % sizeof(dglInt32_t)) == 0 ) {
+		pGraph->pNodeBuffer = (dglByte_t *) pbData;
+		pGraph->pEdgeBuffer = (dglByte_t *) pbData + header.iNodeBuffer;
+		pGraph->Flags |= DGL_GS_FLAT | DGL_GS_MAPPED;
+		return 0;
+	}
+
+	if ( (pGraph->pNodeBuffer = malloc( header.iNodeBuffer )) == NULL ||
+		 (pGraph->pEdgeBuffer = malloc( header.iEdgeBuffer )) == NULL )
+	{
+		dglRelease( pGraph );
+		pGraph->iErrno = DGL_ERR_MemoryExhausted;
+		return -pGraph->iErrno;
+	}
+	memcpy( pGraph->pNodeBuffer, pbData, header.iNodeBuffer );
+	memcpy( pGraph->pEdgeBuffer, pbData + header.iNodeBuffer, header.iEdgeBuffer );
+
+	if ( fSwap ) {
+		pn = (dglInt32_t*) pGraph->pNodeBuffer;
+		cn = pGraph->iNodeBuffer / sizeof(dglInt32_t);
+		for ( i = 0 ; i < cn ; i ++ ) {
+			dgl_swapInt32Bytes( & pn[i] );
+		}
+		pn = (dglInt32_t*) pGraph->pEdgeBuffer;
+		cn = pGraph->iEdgeBuffer / sizeof(dglInt32_t);
+		for ( i = 0 ; i < cn ; i ++ ) {
+			dgl_swapInt32Bytes( & pn[i] );
+		}
+	}
+
+	pGraph->Flags |= DGL_GS_FLAT;
+	return 0;
+}
+
 int dglShortestPath	(
 					 	dglGraph_s * 	 pGraph,
 						dglSPReport_s **ppReport,
@@ -1119,6 +1267,8 @@ char * dglStrerror( dglGraph_s * pgraph )
 		return "Edge Already Exist";
 	case DGL_ERR_BadArgument:
 		return "Bad Argument";
+	case DGL_ERR_BadImage:
+		return "Bad Graph Image";
 	}
 
 	return "unknown graph error code";
@@ -37,6 +37,7 @@ __BEGIN_DECLS
  * Graph State bitmask - returned by dglGet_State() function
  */
 #define DGL_GS_FLAT			0x1		/* otherwise is TREE */
+#define DGL_GS_MAPPED		0x2		/* flat buffers are owned by the caller */
 
 /*
  * Graph Family
@@ -295,6 +296,7 @@ typedef struct {
 #define DGL_ERR_NodeIsAComponent		21
 #define DGL_ERR_EdgeAlreadyExist		22
 #define DGL_ERR_BadArgument				23
+#define DGL_ERR_BadImage				24
 
 
 
@@ -380,6 +382,37 @@ int         dglAddEdgeX(
 int dglWrite( dglGraph_s * pGraph, FILE *fd );
 int dglRead( dglGraph_s * pGraph, FILE *fd );
 
+/*
+ * Flat graph image: a flattened graph written with a fixed size, aligned
+ * header so that the node and edge buffers can be used in place from a
+ * memory mapping of the file (see dglMapImage). The image is written in
+ * the host byte order.
+ */
+#define DGL_IMAGE_SIGNATURE		"DGLIMAGE"
+
+typedef struct {
+	dglByte_t		achSignature[8];
+	dglByte_t		Version;
+	dglByte_t		Endian;
+	dglByte_t		abReserved[2];
+	dglInt32_t		NodeAttrSize;
+	dglInt32_t		EdgeAttrSize;
+	dglInt32_t		cNode;
+	dglInt32_t		cHead;
+	dglInt32_t		cTail;
+	dglInt32_t		cAlone;
+	dglInt32_t		cEdge;
+	dglInt32_t		iNodeBuffer;
+	dglInt32_t		iEdgeBuffer;
+	dglInt64_t		nnCost;
+	dglInt32_t		aOpaqueSet[ 16 ];
+	dglByte_t		abPad[8];		/* header size = 128 */
+} dglImageHeader_s;
+
+int dglWriteImage( dglGraph_s * pGraph, FILE *fd );
+int dglIsImage( const void * pvImage, long cbImage );
+int dglMapImage( dglGraph_s * pGraph, const void * pvImage, long cbImage );
+
 typedef struct {
 	dglGraph_s * pG;
 	int nState;
@@ -131,8 +131,10 @@ int dgl_release_V1( dglGraph_s * pgraph )
 
 	if ( pgraph->pNodeTree ) avl_destroy( pgraph->pNodeTree, dglTreeNodeCancel );
 	if ( pgraph->pEdgeTree ) avl_destroy( pgraph->pEdgeTree, dglTreeEdgeCancel );
-	if ( pgraph->pNodeBuffer ) free( pgraph->pNodeBuffer );
-	if ( pgraph->pEdgeBuffer ) free( pgraph->pEdgeBuffer );
+	if ( ! (pgraph->Flags & DGL_GS_MAPPED) ) {
+		if ( pgraph->pNodeBuffer ) free( pgraph->pNodeBuffer );
+		if ( pgraph->pEdgeBuffer ) free( pgraph->pEdgeBuffer );
+	}
 	if ( pgraph->edgePrioritizer.pvAVL ) avl_destroy( pgraph->edgePrioritizer.pvAVL, dglTreeEdgePri32Cancel );
 	if ( pgraph->nodePrioritizer.pvAVL ) avl_destroy( pgraph->nodePrioritizer.pvAVL, dglTreeNodePri32Cancel );
 
@@ -32,6 +32,7 @@
 #include "graph.h"
 #include "roadmap.h"
 #include "roadmap_path.h"
+#include "roadmap_file.h"
 #include "roadmap_line.h"
 #include "roadmap_locator.h"
 #include "roadmap_main.h"
@@ -47,6 +48,7 @@
 static int fips_data_loaded = 0;
 static dglGraph_s graph;
 static dglSPCache_s spCache;
+static RoadMapFileContext graph_file = NULL;
 
 typedef struct {
    PluginLine from_line;
@@ -100,58 +102,86 @@ static int  clipper     (
 }
 
 
+static void navigate_release_data (void) {
+
+   dglReleaseSPCache (&graph, &spCache);
+   dglRelease (&graph);
+
+   if (graph_file != NULL) roadmap_file_unmap (&graph_file);
+
+   fips_data_loaded = 0;
+}
+
+
+/* Read a graph written in the original dglWrite() stream format. */
+static int navigate_read_data (const char *name) {
+
+   FILE *fd;
+   int nret;
+   const char *sequence;
+
+   for (sequence = roadmap_path_first("maps");
+        sequence != NULL;
+        sequence = roadmap_path_next("maps", sequence)) {
+
+      fd = roadmap_file_fopen (sequence, name, "srb");
+      if (fd != NULL) {
+         nret = dglRead (&graph, fd);
+         fclose (fd);
+         return nret;
+      }
+   }
+
+   return -1;
+}
+
+
 int navigate_reload_data (void) {
    
    if (fips_data_loaded == 0) return 0;
       
-   fips_data_loaded = 0;
-   dglRelease (& graph);
+   navigate_release_data ();
 
    return navigate_load_data ();
 }
 
    
 int navigate_load_data (void) {
-   FILE *fd;
    int nret;
-   char path[255];
+   char name[64];
    int fips;
    time_t map_unix_time;
-   const char *sequence;
 
    fips = roadmap_locator_active ();
    if (fips_data_loaded == fips) return 0;
 
-   sequence = roadmap_path_first("maps");
-   if (sequence == NULL) {
-      return -1;
-   }
+   if (fips_data_loaded != 0) navigate_release_data ();
 
-   roadmap_main_set_cursor (ROADMAP_CURSOR_WAIT);
+   snprintf (name, sizeof(name), "usc%05d.dgl", fips);
 
-   do {
-      snprintf (path, sizeof(path), "%s/usc%05d.dgl", sequence, fips);
-      
-      fd = fopen( path, "rb" );
-      if ( fd != NULL ) break;
-
-      sequence = roadmap_path_next("maps", sequence);
-
-   } while (sequence != NULL);
-
-   if ( fd == NULL ) {  
-      roadmap_main_set_cursor (ROADMAP_CURSOR_NORMAL);
+   if (roadmap_file_map ("maps", name, NULL, "r", &graph_file) == NULL) {
       roadmap_messagebox ("Error", "Can't find route data.");
       return -1;
    }
 
-   nret = dglRead( & graph , fd );
+   if (dglIsImage (roadmap_file_base (graph_file),
+                   roadmap_file_size (graph_file))) {
 
-   fclose( fd );
+      /* The graph is used in place: no copy, pages shared with others. */
+      nret = dglMapImage (&graph,
+                          roadmap_file_base (graph_file),
+                          roadmap_file_size (graph_file));
+   } else {
+
+      roadmap_file_unmap (&graph_file);
 
-   roadmap_main_set_cursor (ROADMAP_CURSOR_NORMAL);
+      roadmap_main_set_cursor (ROADMAP_CURSOR_WAIT);
+      nret = navigate_read_data (name);
+      roadmap_main_set_cursor (ROADMAP_CURSOR_NORMAL);
+   }
 
    if ( nret < 0 ) {
+      if (graph_file != NULL) roadmap_file_unmap (&graph_file);
       roadmap_messagebox ("Error", "Can't load route data.");
       return -1;
    }
@@ -160,6 +190,8 @@ int navigate_load_data (void) {
                      (roadmap_metadata_get_attribute ("Version", "UnixTime"));
 
    if ((time_t) *dglGet_Opaque (&graph) != map_unix_time) {
+      dglRelease (&graph);
+      if (graph_file != NULL) roadmap_file_unmap (&graph_file);
       roadmap_messagebox ("Error", "Navigation data is too old.");
       return -1;
    }